@@ -286,6 +286,9 @@ async::result<void> scatterGather(DeviceToHostType, Chain &chain, Queue *queue,
 
 struct Request {
 	void (*complete)(Request *);
+
+	// Number of bytes that the device wrote to the chain. Valid in complete().
+	size_t written = 0;
 };
 
 // Represents a single virtq.
@@ -1,5 +1,6 @@
 
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
 #include <unordered_map>
 #include <optional>
@@ -245,7 +246,8 @@ async::detached LegacyPciTransport::_processIrqs() {
 		}
 		if(isr & 1)
 			for(auto &queue : _queues)
-				queue->processInterrupt();
+				if(queue)
+					queue->processInterrupt();
 	}
 }
 
@@ -268,6 +270,9 @@ void LegacyPciQueue::notifyTransport() {
 
 namespace {
 
+// Upper bound on the number of MSI-X vectors that are used for virtqs.
+constexpr unsigned int maxQueueMsis = 16;
+
 struct StandardPciQueue;
 
 struct StandardPciTransport : Transport {
@@ -278,7 +283,7 @@ struct StandardPciTransport : Transport {
 			Mapping common_mapping, Mapping notify_mapping,
 			Mapping isr_mapping, Mapping device_mapping,
 			unsigned int notify_multiplier, helix::UniqueDescriptor irq,
-			helix::UniqueDescriptor queueMsi);
+			std::vector<helix::UniqueDescriptor> queueMsis);
 
 	protocols::hw::Device &hwDevice() override {
 		return _hwDevice;
@@ -304,18 +309,17 @@ private:
 	arch::mem_space _deviceSpace() { return arch::mem_space{_deviceMapping.get()}; }
 
 	async::detached _processIrqs();
-	async::detached _processQueueMsi();
+	async::detached _processQueueMsi(unsigned int vector);
 
 	protocols::hw::Device _hwDevice;
-	bool _useMsi;
 	Mapping _commonMapping;
 	Mapping _notifyMapping;
 	Mapping _isrMapping;
 	Mapping _deviceMapping;
 	unsigned int _notifyMultiplier;
 	helix::UniqueDescriptor _irq;
-	helix::UniqueDescriptor _queueMsi;
-
+	// MSI-X vectors for the virtqs. Queue i uses vector i modulo the number of vectors.
+	std::vector<helix::UniqueDescriptor> _queueMsis;
 
 	std::vector<std::unique_ptr<StandardPciQueue>> _queues;
 };
@@ -324,7 +328,11 @@ struct StandardPciQueue final : Queue {
 	StandardPciQueue(StandardPciTransport *transport,
 			unsigned int queue_index, size_t queue_size,
 			spec::Descriptor *table, spec::AvailableRing *available, spec::UsedRing *used,
-			arch::scalar_register<uint16_t> notify_register);
+			arch::scalar_register<uint16_t> notify_register, unsigned int msi_vector);
+
+	unsigned int msiVector() {
+		return _msiVector;
+	}
 
 protected:
 	void notifyTransport() override;
@@ -332,20 +340,19 @@ protected:
 private:
 	StandardPciTransport *_transport;
 	arch::scalar_register<uint16_t> _notifyRegister;
+	unsigned int _msiVector;
 };
 
 StandardPciTransport::StandardPciTransport(protocols::hw::Device hw_device,
-		bool useMsi,
 		Mapping common_mapping, Mapping notify_mapping,
 		Mapping isr_mapping, Mapping device_mapping,
 		unsigned int notify_multiplier, helix::UniqueDescriptor irq,
-		helix::UniqueDescriptor queueMsi)
+		std::vector<helix::UniqueDescriptor> queueMsis)
 : _hwDevice{std::move(hw_device)},
-		_useMsi{useMsi},
 		_commonMapping{std::move(common_mapping)}, _notifyMapping{std::move(notify_mapping)},
 		_isrMapping{std::move(isr_mapping)}, _deviceMapping{std::move(device_mapping)},
 		_notifyMultiplier{notify_multiplier}, _irq{std::move(irq)},
-		_queueMsi{std::move(queueMsi)} { }
+		_queueMsis{std::move(queueMsis)} { }
 
 uint8_t StandardPciTransport::loadConfig8(size_t offset) {
 	return _deviceSpace().load(arch::scalar_register<uint8_t>(offset));
@@ -422,9 +429,10 @@ Queue *StandardPciTransport::setupQueue(unsigned int queue_index) {
 	auto table = reinterpret_cast<spec::Descriptor *>((char *)window);
 	auto available = reinterpret_cast<spec::AvailableRing *>((char *)window + available_offset);
 	auto used = reinterpret_cast<spec::UsedRing *>((char *)window + used_offset);
+	unsigned int msi_vector = _queueMsis.empty() ? 0 : queue_index % _queueMsis.size();
 	_queues[queue_index] = std::make_unique<StandardPciQueue>(this, queue_index, queue_size,
 			table, available, used,
-			arch::scalar_register<uint16_t>{_notifyMultiplier * notify_index});
+			arch::scalar_register<uint16_t>{_notifyMultiplier * notify_index}, msi_vector);
 
 	// Hand the queue to the device.
 	uintptr_t table_physical, available_physical, used_physical;
@@ -439,9 +447,9 @@ Queue *StandardPciTransport::setupQueue(unsigned int queue_index) {
 	_commonSpace().store(PCI_QUEUE_USED[1], used_physical >> 32);
 
 	// Setup MSI-X.
-	if(_useMsi) {
-		_commonSpace().store(PCI_QUEUE_MSIX_VECTOR, 0);
-		if(_commonSpace().load(PCI_QUEUE_MSIX_VECTOR) != 0)
+	if(!_queueMsis.empty()) {
+		_commonSpace().store(PCI_QUEUE_MSIX_VECTOR, msi_vector);
+		if(_commonSpace().load(PCI_QUEUE_MSIX_VECTOR) != msi_vector)
 			throw std::runtime_error("Device failed to allocate MSI-X interrupt");
 	}
 
@@ -454,8 +462,8 @@ void StandardPciTransport::runDevice() {
 	// Finally set the DRIVER_OK bit to finish the configuration.
 	_commonSpace().store(PCI_DEVICE_STATUS, _commonSpace().load(PCI_DEVICE_STATUS) | DRIVER_OK);
 
-	if(_useMsi)
-		_processQueueMsi();
+	for(unsigned int i = 0; i < _queueMsis.size(); i++)
+		_processQueueMsi(i);
 	_processIrqs();
 }
 
@@ -526,7 +534,8 @@ async::detached StandardPciTransport::_processIrqs() {
 
 		if(await.bitset() & 1)
 			for(auto &queue : _queues)
-				queue->processInterrupt();
+				if(queue)
+					queue->processInterrupt();
 	}
 #else
 	co_await _hwDevice.enableBusIrq();
@@ -558,31 +567,35 @@ async::detached StandardPciTransport::_processIrqs() {
 
 		if(isr & 1)
 			for(auto &queue : _queues)
-				queue->processInterrupt();
+				if(queue)
+					queue->processInterrupt();
 	}
 #endif
 }
 
-async::detached StandardPciTransport::_processQueueMsi() {
+async::detached StandardPciTransport::_processQueueMsi(unsigned int vector) {
+	auto &msi = _queueMsis[vector];
+
 	uint64_t sequence = 0;
 	while(true) {
-		auto await = co_await helix_ng::awaitEvent(_queueMsi, sequence);
+		auto await = co_await helix_ng::awaitEvent(msi, sequence);
 		HEL_CHECK(await.error());
 		sequence = await.sequence();
 
-		HEL_CHECK(helAcknowledgeIrq(_queueMsi.getHandle(), kHelAckAcknowledge, sequence));
+		HEL_CHECK(helAcknowledgeIrq(msi.getHandle(), kHelAckAcknowledge, sequence));
 
 		for(auto &queue : _queues)
-			queue->processInterrupt();
+			if(queue && queue->msiVector() == vector)
+				queue->processInterrupt();
 	}
 }
 
 StandardPciQueue::StandardPciQueue(StandardPciTransport *transport,
 		unsigned int queue_index, size_t queue_size,
 		spec::Descriptor *table, spec::AvailableRing *available, spec::UsedRing *used,
-		arch::scalar_register<uint16_t> notify_register)
+		arch::scalar_register<uint16_t> notify_register, unsigned int msi_vector)
 : Queue{queue_index, queue_size, table, available, used},
-		_transport{transport}, _notifyRegister{notify_register} { }
+		_transport{transport}, _notifyRegister{notify_register}, _msiVector{msi_vector} { }
 
 void StandardPciQueue::notifyTransport() {
 	_transport->_notifySpace().store(_notifyRegister, queueIndex());
@@ -661,12 +674,14 @@ discover(protocols::hw::Device hw_device, DiscoverMode mode) {
 			common_space.store(PCI_DEVICE_STATUS, 0);
 			assert(!common_space.load(PCI_DEVICE_STATUS));
 
-			helix::UniqueDescriptor queueMsi;
+			std::vector<helix::UniqueDescriptor> queueMsis;
 
-			// Enable MSI-X.
+			// Enable MSI-X. Devices with multiple virtqs may interrupt on each one separately.
 			if (info.numMsis) {
 				co_await hw_device.enableMsi();
-				queueMsi = co_await hw_device.installMsi(0);
+				auto numVectors = std::min(info.numMsis, maxQueueMsis);
+				for(unsigned int i = 0; i < numVectors; i++)
+					queueMsis.push_back(co_await hw_device.installMsi(i));
 			}
 
 			// Set the ACKNOWLEDGE and DRIVER bits.
@@ -678,10 +693,9 @@ discover(protocols::hw::Device hw_device, DiscoverMode mode) {
 
 			std::cout << "virtio: Using standard PCI transport" << std::endl;
 			co_return std::make_unique<StandardPciTransport>(std::move(hw_device),
-					info.numMsis,
 					std::move(*common_mapping), std::move(*notify_mapping),
 					std::move(*isr_mapping), std::move(*device_mapping),
-					notify_multiplier, std::move(irq), std::move(queueMsi));
+					notify_multiplier, std::move(irq), std::move(queueMsis));
 		}
 	}
 
@@ -870,6 +884,7 @@ void Queue::processInterrupt() {
 		auto request = _activeRequests[table_index];
 		assert(request);
 		_activeRequests[table_index] = nullptr;
+		request->written = _usedRing->elements[ring_index].written.load();
 
 		// Free all descriptors in the descriptor chain.
 		auto chain_index = table_index;
@@ -0,0 +1,27 @@
+#include <iostream>
+
+#include <arch/dma_structs.hpp>
+
+#include "benchmark.hpp"
+
+async::result<void> benchmarkPort(Port *port, arch::dma_pool *pool) {
+	constexpr size_t blockSize = 4096;
+
+	// One buffer per request.
+	constexpr size_t maxDepth = 32;
+	arch::dma_array<uint8_t> buffers{pool, maxDepth * blockSize};
+
+	for (size_t depth = 1; depth <= maxDepth; depth *= 2) {
+		auto iops = co_await blockfs::measureRandomIops(port, {
+			.requestSize = blockSize,
+			.depth = depth,
+			.buffers = buffers.data(),
+			.bufferSize = blockSize
+		});
+		if (!iops)
+			co_return;
+
+		std::cout << "block/ahci: Port " << port->getIndex() << " random read (4 KiB, depth "
+				<< depth << "): " << iops << " IOPS" << std::endl;
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <arch/dma_pool.hpp>
+#include <async/result.hpp>
+
+#include "port.hpp"
+
+// Measures random 4 KiB read IOPS at increasing numbers of concurrent requests.
+// With NCQ, up to 32 of these requests are in flight on the device.
+// The I/O buffers are allocated from pool.
+async::result<void> benchmarkPort(Port *port, arch::dma_pool *pool);
@@ -29,8 +29,8 @@ void Command::notifyCompletion() {
 	event_.raise();
 }
 
-void Command::prepare(commandTable& table, commandHeader& header) {
-	auto tablePhys = helix::ptrToPhysical(&table);
+void Command::prepare(commandTable& table, commandHeader& header, uintptr_t tablePhys,
+		int ncqTag) {
 	assert((tablePhys & 0x7F) == 0 && tablePhys < std::numeric_limits<uint32_t>::max());
 	assert(numSectors_ < std::numeric_limits<uint16_t>::max());
 
@@ -54,24 +54,37 @@ void Command::prepare(commandTable& table, commandHeader& header) {
 	header.configBytes[1] = 0;
 	header.prdtLength = numEntries;
 	header.prdByteCount = 0;
-	header.ctBase = static_cast<uint32_t>(helix::ptrToPhysical(&table));
+	header.ctBase = static_cast<uint32_t>(tablePhys);
 	header.ctBaseUpper = 0;
 
 	switch (type_) {
 		case CommandType::read:
-			table.commandFis.command = 0x25; // READ DMA EXT
+			table.commandFis.command = ncqTag >= 0 ? 0x60 : 0x25; // READ FPDMA QUEUED / READ DMA EXT
 			break;
 		case CommandType::write:
-			table.commandFis.command = 0x35; // WRITE DMA EXT
+			table.commandFis.command = ncqTag >= 0 ? 0x61 : 0x35; // WRITE FPDMA QUEUED / WRITE DMA EXT
 			header.configBytes[0] |= 1 << 6; // Indicates we are writing
 			break;
 		case CommandType::identify:
+			assert(ncqTag < 0);
 			table.commandFis.command = 0xEC; // IDENTIFY DEVICE
 			break;
+		case CommandType::readLog:
+			assert(ncqTag < 0);
+			table.commandFis.command = 0x2F; // READ LOG EXT, log address in LBA 7:0
+			break;
 		default:
 			assert(!"unknown command type");
 	}
 
+	if (ncqTag >= 0) {
+		// FPDMA QUEUED commands take the sector count in the features field
+		// and the tag in bits 7:3 of the count field.
+		table.commandFis.features = numSectors_ & 0xFF;
+		table.commandFis.featuresUpper = (numSectors_ >> 8) & 0xFF;
+		table.commandFis.sectorCount = static_cast<uint16_t>(ncqTag << 3);
+	}
+
 	if (logCommands) {
 		printf("block/ahci: submitting %zu byte %s to %p at sector %" PRIu64 "\n",
 				numBytes_, cmdTypeToString(type_), buffer_, sector_);
@@ -80,50 +93,63 @@ void Command::prepare(commandTable& table, commandHeader& header) {
 
 /* Returns the number of PRDT entries written.
  *
- * Note on buffer_: libblockfs guarantees us that buffer_ is locked into memory,
- * and calling helPointerPhysical ensures that the pages are allocated and present
- * in the page tables. Hence, we know the buffer remains in memory during the DMA.
+ * Note on buffer_: libblockfs guarantees us that buffer_ is locked into memory.
+ * Buffers that span at most two pages are translated page by page, which takes at
+ * most two system calls. Larger buffers are locked again nevertheless since that gives
+ * us all physical segments of the buffer in a single system call.
+ * The lock is dropped when the command is destructed.
  */
 size_t Command::writeScatterGather_(commandTable& table) {
-	// TODO: Grab the page size for each individual address
-	size_t pageSize = getpagesize();
+	// A PRDT entry can describe at most 4 MiB.
+	constexpr size_t maxEntrySize = size_t{1} << 22;
+
+	static size_t pageSize = getpagesize();
 
 	size_t prdtIndex = 0;
-	auto addEntry = [&](uintptr_t phys, size_t bytesToWrite) {
-		assert(prdtIndex < commandTable::prdtEntries &&
-				phys < std::numeric_limits<uint32_t>::max() && !(phys & 1));
-
-		table.prdts[prdtIndex++] = prdtEntry {
-			static_cast<uint32_t>(phys),
-			0,
-			0,
-			static_cast<uint32_t>(std::min(pageSize, bytesToWrite)) - 1,
-		};
+	auto addSegment = [&] (uintptr_t physical, size_t length) {
+		while (length) {
+			auto chunk = std::min(length, maxEntrySize);
+			assert(prdtIndex < commandTable::prdtEntries &&
+					physical + chunk <= std::numeric_limits<uint32_t>::max()
+					&& !(physical & 1));
+
+			table.prdts[prdtIndex++] = prdtEntry {
+				static_cast<uint32_t>(physical),
+				0,
+				0,
+				static_cast<uint32_t>(chunk) - 1,
+			};
+
+			physical += chunk;
+			length -= chunk;
+		}
 	};
 
 	uintptr_t virtStart = reinterpret_cast<uintptr_t>(buffer_);
-	uintptr_t virtEnd = virtStart + numBytes_;
-	assert(virtEnd > virtStart);
-
-	// As virtStart may not be aligned to pageSize, we split off the initial
-	// unaligned part, then work with pageSize aligned chunks.
-	if (virtStart % pageSize > 0) {
-		auto nextAlignedAddr = (virtStart + pageSize) & ~(pageSize - 1);
-		auto bytesUntilAligned = nextAlignedAddr - virtStart;
-		auto bytesToWrite = std::min(numBytes_, bytesUntilAligned);
-		addEntry(helix::addressToPhysical(virtStart), bytesToWrite);
-
-		virtStart = nextAlignedAddr;
+	auto offset = virtStart % pageSize;
+
+	if (offset + numBytes_ <= pageSize * 2) {
+		auto firstLength = std::min(numBytes_, pageSize - offset);
+		auto firstPhysical = helix::addressToPhysical(virtStart);
+		if (firstLength == numBytes_) {
+			addSegment(firstPhysical, numBytes_);
+			return prdtIndex;
+		}
+
+		// Merge both pages into one entry if they are physically contiguous.
+		auto secondPhysical = helix::addressToPhysical(virtStart + firstLength);
+		if (secondPhysical == firstPhysical + firstLength) {
+			addSegment(firstPhysical, numBytes_);
+		} else {
+			addSegment(firstPhysical, firstLength);
+			addSegment(secondPhysical, numBytes_ - firstLength);
+		}
+		return prdtIndex;
 	}
 
-	// Insert every page in the buffer into the scatter-gather list.
-	for (uintptr_t virt = virtStart; virt < virtEnd; virt += pageSize) {
-		uintptr_t phys = helix::addressToPhysical(virt);
-		
-		// TODO: As a small optimisation, we could accumulate into the previous entry if they
-		// happen to be physically contiguous.
-		addEntry(phys, virtEnd - virt);
-	}
+	bufferLock_ = helix::LockedPhysical{buffer_, numBytes_};
+	for (auto segment : bufferLock_.segments())
+		addSegment(segment.physical, segment.length);
 
 	return prdtIndex;
 }
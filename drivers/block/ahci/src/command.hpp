@@ -1,13 +1,15 @@
 #pragma once
 
 #include <async/oneshot-event.hpp>
+#include <helix/memory.hpp>
 
 #include "spec.hpp"
 
 enum class CommandType {
 	read,
 	write,
-	identify
+	identify,
+	readLog
 };
 
 struct Command {
@@ -22,14 +24,30 @@ public:
 		assert(type == CommandType::identify);
 	}
 
-	void prepare(commandTable& table, commandHeader& header);
+	Command(ncqErrorLog *buffer, CommandType type)
+		: Command(ncqErrorLog::logAddress, 1, sizeof(ncqErrorLog),
+			reinterpret_cast<void *>(buffer), type) {
+		assert(type == CommandType::readLog);
+	}
+
+	// Issues reads and writes as NCQ commands if ncqTag is not negative.
+	void prepare(commandTable& table, commandHeader& header, uintptr_t tablePhys,
+			int ncqTag = -1);
 	void notifyCompletion(); 
 
+	// Called when the device reports that this command failed.
+	// Returns false if the command should not be retried anymore.
+	bool retryAfterError() {
+		return ++retries_ <= maxRetries;
+	}
+
 	auto getFuture() {
 		return event_.wait();
 	}
 
 private:
+	static constexpr int maxRetries = 3;
+
 	size_t writeScatterGather_(commandTable& table);
 
 private:
@@ -38,7 +56,9 @@ private:
 	size_t numBytes_;
 	void *buffer_;
 	CommandType type_;
+	int retries_ = 0;
 	async::oneshot_event event_;
+	helix::LockedPhysical bufferLock_;
 };
 
 constexpr const char *cmdTypeToString(CommandType type) {
@@ -49,6 +69,8 @@ constexpr const char *cmdTypeToString(CommandType type) {
 			return "write";
 		case CommandType::identify:
 			return "identify";
+		case CommandType::readLog:
+			return "read log";
 		default:
 			assert(!"unknown command type");
 	}
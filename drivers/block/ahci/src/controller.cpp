@@ -32,6 +32,7 @@ namespace flags {
 
 	namespace cap {
 		constexpr int supports64Bit   = 1 << 31;
+		constexpr int supportsNcq     = 1 << 30;
 		constexpr int staggeredSpinup = 1 << 27;
 	}
 
@@ -100,16 +101,18 @@ async::detached Controller::run() {
 	auto numCommandSlots = ((cap >> 8) & 0x1F) + 1;
 	auto iss = (cap >> 20) & 0xF;
 	bool ss = cap & flags::cap::staggeredSpinup;
+	bool sncq = cap & flags::cap::supportsNcq;
 	bool revertSingleMessage = regs_.load(regs::ghc) & flags::ghc::revertSingleMessage;
 	bool s64a = cap & flags::cap::supports64Bit;
 	assert(s64a); // TODO: We aren't allowed to read some fields if no 64-bit support
 
 	printf("block/ahci: Initialised controller: version %x, %d active ports, "
-			"%d slots, Gen %d, SS %s, 64-bit %s, MSI %s%s\n", version, std::popcount(portsImpl_),
-			numCommandSlots, iss, ss ? "yes" : "no", s64a ? "yes" : "no", useMsis_ ? "yes" : "no",
+			"%d slots, Gen %d, SS %s, 64-bit %s, NCQ %s, MSI %s%s\n", version, std::popcount(portsImpl_),
+			numCommandSlots, iss, ss ? "yes" : "no", s64a ? "yes" : "no", sncq ? "yes" : "no",
+			useMsis_ ? "yes" : "no",
 			revertSingleMessage ? "/reverted to single" : "");
 
-	if (!(co_await initPorts_(numCommandSlots, ss))) {
+	if (!(co_await initPorts_(numCommandSlots, ss, sncq))) {
 		std::cout << "\e[31mblock/ahci: No ports found, exiting\e[39m\n";
 		co_return;
 	}
@@ -186,11 +189,12 @@ async::detached Controller::handleIrqs_() {
 	}
 }
 
-async::result<bool> Controller::initPorts_(size_t numCommandSlots, bool ss) {
+async::result<bool> Controller::initPorts_(size_t numCommandSlots, bool ss, bool sncq) {
 	for (int i = 0; i < maxPorts_; i++) {
 		if (portsImpl_ & (1 << i)) {
 			auto offset = 0x100 + i * 0x80;
-			auto port = std::make_unique<Port>(parentId_, i, numCommandSlots, ss, regs_.subspace(offset));
+			auto port = std::make_unique<Port>(parentId_, i, numCommandSlots, ss, sncq,
+					regs_.subspace(offset));
 
 			if (co_await port->init())
 				activePorts_.push_back(std::move(port));
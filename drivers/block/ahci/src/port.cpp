@@ -3,6 +3,7 @@
 #include <helix/memory.hpp>
 #include <helix/timer.hpp>
 
+#include "benchmark.hpp"
 #include "port.hpp"
 
 namespace regs {
@@ -36,6 +37,7 @@ namespace flags {
 		constexpr int hostDataError   = 1 << 28;
 		constexpr int ifFatalError    = 1 << 27;
 		constexpr int ifNonFatalError = 1 << 26;
+		constexpr int setDeviceBits   = 1 << 3;
 		constexpr int d2hFis          = 1;
 	}
 
@@ -47,13 +49,18 @@ namespace flags {
 
 namespace {
 	constexpr size_t sectorSize = 512;
+
+	// Run a concurrent random read benchmark before the port is exposed to the system.
+	constexpr bool runBenchmark = false;
 }
 
 // TODO: We can use a more appropriate block size, but this breaks other parts of the OS.
-Port::Port(int64_t parentId, int portIndex, size_t numCommandSlots, bool staggeredSpinUp, arch::mem_space regs)
+Port::Port(int64_t parentId, int portIndex, size_t numCommandSlots, bool staggeredSpinUp,
+		bool hbaSupportsNcq, arch::mem_space regs)
 	: BlockDevice{::sectorSize, parentId},  regs_{regs}, deviceSize_{0},
 	numCommandSlots_{numCommandSlots}, commandsInFlight_{0}, portIndex_{portIndex}, 
-	staggeredSpinUp_{staggeredSpinUp}
+	staggeredSpinUp_{staggeredSpinUp}, hbaSupportsNcq_{hbaSupportsNcq}, ncq_{false},
+	recovering_{false}
 {
 }
 
@@ -123,9 +130,20 @@ void Port::dumpState() {
 	printf("  PxIS: %#x\n", regs_.load(regs::interruptStatus));
 	printf("  PxIE: %#x\n", regs_.load(regs::interruptEnable));
 	printf("  commandsInFlight: %zu\n", commandsInFlight_);
+	printf("  NCQ: %s%s\n", ncq_ ? "yes" : "no", recovering_ ? " (recovering)" : "");
 	printf("  submittedCmds slots used: %zu\n", std::count_if(submittedCmds_.begin(), submittedCmds_.end(), [](auto &p){ return p != nullptr; }));
 }
 
+void Port::start_() {
+	auto cas = regs_.load(regs::commandAndStatus);
+	regs_.store(regs::commandAndStatus, cas | flags::cmd::start);
+}
+
+void Port::stop_() {
+	auto cas = regs_.load(regs::commandAndStatus);
+	regs_.store(regs::commandAndStatus, cas & ~flags::cmd::start);
+}
+
 // Start port (10.3.1).
 async::result<bool> Port::run() {
 	printf("block/ahci: Starting port %d\n", portIndex_);
@@ -143,6 +161,8 @@ async::result<bool> Port::run() {
 	uintptr_t clPhys = helix::ptrToPhysical(commandList_.data()),
 			  ctPhys = helix::ptrToPhysical(&commandTables_[0]),
 			  rfPhys = helix::ptrToPhysical(receivedFis_.data());
+	// The command tables are physically contiguous, so there is no need to translate them per command.
+	commandTablesPhys_ = ctPhys;
 	assert((clPhys & 0x3FF) == 0 && clPhys < std::numeric_limits<uint32_t>::max());
 	assert((ctPhys & 0x7F) == 0 && ctPhys < std::numeric_limits<uint32_t>::max());
 	assert((rfPhys & 0xFF) == 0 && rfPhys < std::numeric_limits<uint32_t>::max());
@@ -176,7 +196,8 @@ async::result<bool> Port::run() {
 
 	arch::dma_object<identifyDevice> identify{&dmaPool_};
 	Command cmd = Command(identify.data(), CommandType::identify);
-	cmd.prepare(commandTables_[slot], commandList_->slots[slot]);
+	cmd.prepare(commandTables_[slot], commandList_->slots[slot],
+			commandTablesPhys_ + slot * sizeof(commandTable));
 
 	regs_.store(regs::commandIssue, 1 << slot);
 
@@ -195,9 +216,16 @@ async::result<bool> Port::run() {
 	auto model = identify->getModel();
 	deviceSize_ = logicalSize * sectorCount;
 
-	printf("block/ahci: Started port %d, model %s, size %.1fGiB (sectors: logical %zu, physical %zu, count %" PRIu64 ")\n",
+	// NCQ tags correspond to command slots, so the queue depth limits the usable slots.
+	if (hbaSupportsNcq_ && identify->supportsNcq()) {
+		ncq_ = true;
+		numCommandSlots_ = std::min(numCommandSlots_, identify->getQueueDepth());
+	}
+
+	printf("block/ahci: Started port %d, model %s, size %.1fGiB (sectors: logical %zu, physical %zu, count %" PRIu64 "), "
+			"NCQ %s, %zu slots\n",
 			portIndex_, model.c_str(), static_cast<float>(deviceSize_ / (1 << 30)),
-			logicalSize, physicalSize, sectorCount);
+			logicalSize, physicalSize, sectorCount, ncq_ ? "yes" : "no", numCommandSlots_);
 	assert(logicalSize == 512 && "block/ahci: logical sector size > 512 is not supported");
 
 	// Clear and enable interrupts on this port
@@ -206,6 +234,7 @@ async::result<bool> Port::run() {
 	auto ie = regs_.load(regs::interruptEnable);
 	regs_.store(regs::interruptEnable, ie
 			| flags::is::d2hFis
+			| flags::is::setDeviceBits
 			| flags::is::taskFileError
 			| flags::is::hostDataError
 			| flags::is::hostFatalError
@@ -214,13 +243,16 @@ async::result<bool> Port::run() {
 
 	submitPendingLoop_();
 
+	if (runBenchmark)
+		co_await benchmarkPort(this, &dmaPool_);
+
 	blockfs::runDevice(this);
 
 	co_return true;
 }
 
 async::result<size_t> Port::findFreeSlot_() {
-	while (commandsInFlight_ >= numCommandSlots_) {
+	while (recovering_ || commandsInFlight_ >= numCommandSlots_) {
 		if (logCommands) {
 			printf("block/ahci: submission queue full, waiting...\n");
 		}
@@ -269,12 +301,24 @@ void Port::handleIrq() {
 				regs_.load(regs::commandIssue), regs_.load(regs::commandAndStatus));
 	}
 
-	checkErrors();
+	// The port is stopped during recovery, which clears PxCI and PxSACT.
+	if (recovering_) {
+		regs_.store(regs::interruptStatus, is);
+		return;
+	}
+
+	// A failed NCQ command aborts all outstanding NCQ commands, but this is recoverable.
+	bool ncqError = ncq_ && (is & flags::is::taskFileError)
+			&& !(is & (flags::is::hostFatalError | flags::is::hostDataError
+				| flags::is::ifFatalError | flags::is::ifNonFatalError));
+	if (!ncqError)
+		checkErrors();
 
 	std::vector<Command *> completed;
 
-	// Notify all completed commands
-	auto cmdActiveMask = regs_.load(regs::commandIssue);
+	// Notify all completed commands. NCQ commands are complete once the device
+	// clears their PxSACT bit via a Set Device Bits FIS.
+	auto cmdActiveMask = regs_.load(regs::commandIssue) | regs_.load(regs::sataActive);
 	for (size_t i = 0; i < numCommandSlots_; i++) {
 		if (submittedCmds_[i] && !(cmdActiveMask & (1 << i))) {
 			completed.push_back(std::exchange(submittedCmds_[i], nullptr));
@@ -294,6 +338,75 @@ void Port::handleIrq() {
 	if (commandsInFlight_ + completed.size() == numCommandSlots_ && completed.size() > 0) {
 		freeSlotDoorbell_.raise();
 	}
+
+	if (ncqError) {
+		recovering_ = true;
+		recoverNcq_();
+	}
+}
+
+// Recovers from an NCQ error (AHCI spec 6.2.2.1 and 6.3.3).
+// The device aborts all outstanding commands. The failed command is found
+// through log page 10h; all aborted commands are then issued again.
+async::detached Port::recoverNcq_() {
+	printf("\e[33mblock/ahci: Port %d recovering from NCQ error\e[39m\n", portIndex_);
+	if (logCommands)
+		dumpState();
+
+	// Stopping the port clears PxCI and PxSACT.
+	stop_();
+	auto success = co_await helix::kindaBusyWait(500'000'000, [&](){
+		return !(regs_.load(regs::commandAndStatus) & flags::cmd::cmdListRunning); });
+	assert(success);
+
+	regs_.store(regs::sErr, regs_.load(regs::sErr));
+	regs_.store(regs::interruptStatus, regs_.load(regs::interruptStatus));
+
+	// TODO: Perform a COMRESET in this case.
+	if (regs_.load(regs::tfd) & (flags::tfd::bsy | flags::tfd::drq)) {
+		printf("\e[31mblock/ahci: Port %d is still busy after NCQ error\e[39m\n", portIndex_);
+		dumpState();
+		abort();
+	}
+
+	start_();
+
+	// All slots are free again as far as the HBA is concerned, so slot 0 can be borrowed.
+	arch::dma_object<ncqErrorLog> log{&dmaPool_};
+	Command logCmd{log.data(), CommandType::readLog};
+	logCmd.prepare(commandTables_[0], commandList_->slots[0], commandTablesPhys_);
+	regs_.store(regs::commandIssue, 1);
+
+	success = co_await helix::kindaBusyWait(500'000'000,
+			[&](){ return !(regs_.load(regs::commandIssue) & 1); });
+	if (!success || (regs_.load(regs::tfd) & 1)) {
+		printf("\e[31mblock/ahci: Port %d failed to read NCQ error log\e[39m\n", portIndex_);
+		dumpState();
+		abort();
+	}
+	regs_.store(regs::interruptStatus, regs_.load(regs::interruptStatus));
+
+	if (log->nonQueued()) {
+		printf("\e[31mblock/ahci: Port %d NCQ error was not caused by an NCQ command\e[39m\n",
+				portIndex_);
+	} else {
+		auto failed = submittedCmds_[log->getTag()];
+		printf("\e[31mblock/ahci: Port %d NCQ command %zu failed, status %#x, error %#x\e[39m\n",
+				portIndex_, log->getTag(), log->status, log->error);
+		if (failed && !failed->retryAfterError()) {
+			// TODO: Report the error to libblockfs instead.
+			dumpState();
+			abort();
+		}
+	}
+
+	// Issue the aborted commands again, in their old slots.
+	recovering_ = false;
+	for (size_t i = 0; i < numCommandSlots_; i++) {
+		if (submittedCmds_[i])
+			issueCommand_(i, submittedCmds_[i]);
+	}
+	freeSlotDoorbell_.raise();
 }
 
 async::detached Port::submitPendingLoop_() {
@@ -309,19 +422,27 @@ async::result<void> Port::submitCommand_(Command *cmd) {
 	assert(!(regs_.load(regs::commandIssue) & (1 << slot)));
 	assert(!submittedCmds_[slot]);
 
-	// Setup command table and FIS
-	cmd->prepare(commandTables_[slot], commandList_->slots[slot]);
-
-	// Issue command
 	submittedCmds_[slot] = cmd;
 	commandsInFlight_++;
+	issueCommand_(slot, cmd);
+	co_return;
+}
 
-	// Wait until not busy
-	while (regs_.load(regs::tfd) & (flags::tfd::bsy | flags::tfd::drq))
-		;
+void Port::issueCommand_(size_t slot, Command *cmd) {
+	// Setup command table and FIS. For NCQ commands, the tag is the slot.
+	cmd->prepare(commandTables_[slot], commandList_->slots[slot],
+			commandTablesPhys_ + slot * sizeof(commandTable), ncq_ ? static_cast<int>(slot) : -1);
+
+	if (ncq_) {
+		// PxSACT must be set before PxCI. The HBA handles a busy device itself.
+		regs_.store(regs::sataActive, 1 << slot);
+	} else {
+		// Wait until not busy
+		while (regs_.load(regs::tfd) & (flags::tfd::bsy | flags::tfd::drq))
+			;
+	}
 
 	regs_.store(regs::commandIssue, 1 << slot);
-	co_return;
 }
 
 async::result<void> Port::readSectors(uint64_t sector, void *buffer, size_t numSectors) {
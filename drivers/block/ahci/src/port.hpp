@@ -17,7 +17,7 @@
 class Port : public blockfs::BlockDevice {
 public:
 	Port(int64_t parentId, int index, size_t numCommandSlots, bool staggeredSpinUp,
-			arch::mem_space regs);
+			bool hbaSupportsNcq, arch::mem_space regs);
 
 public:
 	async::result<bool> init();
@@ -36,6 +36,8 @@ private:
 	async::result<size_t> findFreeSlot_();
 	async::detached submitPendingLoop_();
 	async::result<void> submitCommand_(Command *cmd);
+	void issueCommand_(size_t slot, Command *cmd);
+	async::detached recoverNcq_();
 	void start_();
 	void stop_();
 
@@ -46,6 +48,7 @@ private:
 	arch::contiguous_pool dmaPool_;
 	arch::dma_object<commandList> commandList_;
 	arch::dma_array<commandTable> commandTables_;
+	uintptr_t commandTablesPhys_;
 	arch::dma_object<receivedFis> receivedFis_;
 
 	// TODO: Move this to libasync
@@ -68,4 +71,9 @@ private:
 	size_t commandsInFlight_;
 	int portIndex_;
 	bool staggeredSpinUp_;
+	bool hbaSupportsNcq_;
+	// Whether reads and writes are issued as NCQ commands.
+	bool ncq_;
+	// Set while recovering from an NCQ error; no commands are issued in the meantime.
+	bool recovering_;
 };
@@ -90,7 +90,10 @@ static_assert(alignof(commandTable) >= 128);
 struct identifyDevice {
 	uint16_t _junkA[27];
 	uint16_t model[20];
-	uint16_t _junkB[36];
+	uint16_t _junkB[28];
+	uint16_t queueDepth;
+	uint16_t sataCapabilities;
+	uint16_t _junkG[6];
 	uint16_t capabilities;
 	uint16_t _junkC[16];
 	uint64_t maxLBA48;
@@ -143,5 +146,35 @@ struct identifyDevice {
 	bool supportsLba48() const {
 		return capabilities & (1 << 10);
 	}
+
+	bool supportsNcq() const {
+		return sataCapabilities & (1 << 8);
+	}
+
+	// Maximum number of outstanding NCQ commands.
+	size_t getQueueDepth() const {
+		return (queueDepth & 0x1F) + 1;
+	}
 };
 static_assert(sizeof(identifyDevice) == 512);
+
+// Log page 10h (NCQ Command Error log).
+struct ncqErrorLog {
+	static constexpr uint8_t logAddress = 0x10;
+
+	uint8_t tagInfo;
+	uint8_t _reservedA;
+	uint8_t status;
+	uint8_t error;
+	uint8_t _reservedB[508];
+
+	// Set if the failed command was not an NCQ command.
+	bool nonQueued() const {
+		return tagInfo & (1 << 7);
+	}
+
+	size_t getTag() const {
+		return tagInfo & 0x1F;
+	}
+};
+static_assert(sizeof(ncqErrorLog) == 512);
@@ -1,16 +1,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <queue>
 #include <memory>
 
 #include <async/result.hpp>
 #include <async/recurring-event.hpp>
 #include <async/oneshot-event.hpp>
+#include <arch/dma_pool.hpp>
+#include <arch/dma_structs.hpp>
 #include <arch/io_space.hpp>
 #include <arch/register.hpp>
+#include <helix/clock.hpp>
 #include <helix/ipc.hpp>
+#include <helix/memory.hpp>
 #include <helix/timer.hpp>
 #include <protocols/hw/client.hpp>
 #include <protocols/mbus/client.hpp>
@@ -20,6 +27,9 @@
 namespace {
 	constexpr bool logIrqs = false;
 	constexpr bool logRequests = false;
+
+	// Compare PIO and DMA read throughput before the device is exposed to the system.
+	constexpr bool runBenchmark = false;
 }
 
 // --------------------------------------------------------
@@ -42,13 +52,22 @@ namespace alt_regs {
 	inline constexpr arch::scalar_register<uint8_t> inStatus{0};
 }
 
+// Bus-master IDE registers of the primary channel.
+namespace bm_regs {
+	inline constexpr arch::scalar_register<uint8_t> command{0};
+	inline constexpr arch::scalar_register<uint8_t> status{2};
+	inline constexpr arch::scalar_register<uint32_t> prdtAddress{4};
+}
+
 class Controller : public blockfs::BlockDevice {
 	enum class IoResult {
 		none,
 		timeout,
 		notReady,
 		noData,
-		withData
+		withData,
+		// The device reported an error (ERR or DF).
+		error
 	};
 
 public:
@@ -59,6 +78,9 @@ public:
 public:
 	async::detached run();
 
+	// Switches to bus-master DMA using the I/O space of the PCI IDE function.
+	void enableDma(uint16_t bmOffset, helix::UniqueDescriptor bmBar);
+
 private:
 	async::detached _doRequestLoop();
 	async::result<IoResult> _pollForBsy();
@@ -79,6 +101,10 @@ private:
 		kCommandReadSectorsExt = 0x24,
 		kCommandWriteSectors = 0x30,
 		kCommandWriteSectorsExt = 0x34,
+		kCommandReadDma = 0xC8,
+		kCommandReadDmaExt = 0x25,
+		kCommandWriteDma = 0xCA,
+		kCommandWriteDmaExt = 0x35,
 		kCommandIdentify = 0xEC,
 	};
 
@@ -90,9 +116,39 @@ private:
 		kStatusBsy = 0x80,
 
 		kDeviceSlave = 0x10,
-		kDeviceLba = 0x40
+		kDeviceLba = 0x40,
+
+		kBmCommandStart = 0x01,
+		kBmCommandRead = 0x08,
+
+		kBmStatusActive = 0x01,
+		kBmStatusError = 0x02,
+		kBmStatusIrq = 0x04,
+
+		kPrdEndOfTable = 0x8000
+	};
+
+	// Physical region descriptor. A region must not cross a 64 KiB boundary;
+	// a byte count of zero stands for 64 KiB.
+	struct PrdEntry {
+		uint32_t physical;
+		uint16_t byteCount;
+		uint16_t flags;
+	};
+	static_assert(sizeof(PrdEntry) == 8);
+
+	// The table itself must not cross a 64 KiB boundary either.
+	struct alignas(4096) PrdTable {
+		static constexpr size_t numEntries = 512;
+
+		PrdEntry entries[numEntries];
 	};
 
+	// Each command of a request transfers at most this many sectors.
+	// For DMA, this guarantees that the buffer fits into the PRD table.
+	static constexpr size_t maxPioSectors = 255;
+	static constexpr size_t maxDmaSectors = 2048;
+
 	struct Request {
 		bool isWrite;
 		uint64_t sector;
@@ -102,8 +158,14 @@ private:
 	};
 
 	async::result<void> _performRequest(Request *request);
+	void _issueCommand(uint8_t command, uint64_t sector, size_t numSectors);
+	async::result<void> _transferPio(bool isWrite, uint64_t sector, uint8_t *buffer,
+			size_t numSectors);
+	async::result<bool> _transferDma(bool isWrite, uint64_t sector, uint8_t *buffer,
+			size_t numSectors);
 
 	async::result<bool> _detectDevice();
+	async::result<void> _benchmark();
 
 	std::queue<Request *> _requestQueue;
 	async::recurring_event _doorbell;
@@ -113,6 +175,17 @@ private:
 	arch::io_space _altSpace;
 
 	bool _supportsLBA48;
+	bool _supportsDma;
+	uint64_t _numSectors;
+
+	// Set once the bus-master registers are known.
+	helix::UniqueDescriptor _bmBar;
+	arch::io_space _bmSpace;
+	arch::contiguous_pool _dmaPool;
+	arch::dma_object<PrdTable> _prdt;
+	uintptr_t _prdtPhysical;
+	// Set if DMA failed or should not be used; requests then fall back to PIO.
+	bool _disableDma;
 
 	uint64_t _irqSequence;
 };
@@ -121,7 +194,8 @@ Controller::Controller(int64_t parentId, uint16_t mainOffset, uint16_t altOffset
 		helix::UniqueDescriptor mainBar, helix::UniqueDescriptor altBar,
 		helix::UniqueDescriptor irq)
 : BlockDevice{512, parentId}, _irq{std::move(irq)},
-		_ioSpace{mainOffset}, _altSpace{altOffset}, _supportsLBA48{false} {
+		_ioSpace{mainOffset}, _altSpace{altOffset}, _supportsLBA48{false},
+		_supportsDma{false}, _numSectors{0}, _bmSpace{0}, _prdtPhysical{0}, _disableDma{false} {
 	HEL_CHECK(helEnableIo(mainBar.getHandle()));
 	HEL_CHECK(helEnableIo(altBar.getHandle()));
 }
@@ -138,9 +212,30 @@ async::detached Controller::run() {
 
 	_doRequestLoop();
 
+	if(runBenchmark)
+		co_await _benchmark();
+
 	blockfs::runDevice(this);
 }
 
+void Controller::enableDma(uint16_t bmOffset, helix::UniqueDescriptor bmBar) {
+	assert(!_bmBar);
+	HEL_CHECK(helEnableIo(bmBar.getHandle()));
+	_bmBar = std::move(bmBar);
+	_bmSpace = arch::io_space{bmOffset};
+
+	_prdt = arch::dma_object<PrdTable>{&_dmaPool};
+	_prdtPhysical = helix::ptrToPhysical(_prdt.data());
+	assert(!(_prdtPhysical & 0xFFF) && _prdtPhysical < std::numeric_limits<uint32_t>::max());
+
+	// Make sure that no transfer of a previous owner is still running.
+	_bmSpace.store(bm_regs::command, 0);
+	_bmSpace.store(bm_regs::status, kBmStatusError | kBmStatusIrq);
+
+	std::cout << "block/ata: Found bus-master registers at 0x" << std::hex << bmOffset
+			<< std::dec << std::endl;
+}
+
 async::detached Controller::_doRequestLoop() {
 	while(true) {
 		if(_requestQueue.empty()) {
@@ -205,8 +300,8 @@ auto Controller::_waitForBsyIrq() -> async::result<IoResult> {
 		// TODO: Report those errors to the caller.
 		if(!(status & kStatusRdy)) // Device was disconnected?
 			co_return IoResult::notReady;
-		assert(!(status & kStatusErr));
-		assert(!(status & kStatusDf));
+		if(status & (kStatusErr | kStatusDf))
+			co_return IoResult::error;
 		co_return ((status & kStatusDrq) ? IoResult::withData : IoResult::noData);
 	}
 }
@@ -297,8 +392,22 @@ async::result<bool> Controller::_detectDevice() {
 
 	_supportsLBA48 = (ident_data[167] & (1 << 2))
 			&& (ident_data[173] & (1 << 2));
+	// Word 49, bit 8.
+	_supportsDma = ident_data[99] & 1;
+
+	auto identWord = [&] (int word) -> uint64_t {
+		return ident_data[2 * word] | (ident_data[2 * word + 1] << 8);
+	};
+	if(_supportsLBA48) {
+		_numSectors = identWord(100) | (identWord(101) << 16)
+				| (identWord(102) << 32) | (identWord(103) << 48);
+	}else{
+		_numSectors = identWord(60) | (identWord(61) << 16);
+	}
 
-	printf("block/ata: detected device, model: '%s', %s 48-bit LBA\n", model, _supportsLBA48 ? "supports" : "doesn't support");
+	printf("block/ata: detected device, model: '%s', %s 48-bit LBA, %s DMA\n", model,
+			_supportsLBA48 ? "supports" : "doesn't support",
+			_supportsDma ? "supports" : "doesn't support");
 
 	co_return true;
 }
@@ -309,77 +418,199 @@ async::result<void> Controller::_performRequest(Request *request) {
 				<< " sectors from " << request->sector << std::endl;
 
 	assert(!(request->sector & ~((size_t(1) << 48) - 1)));
-	assert(request->numSectors <= 255);
+
+	// Split the request into commands.
+	auto buffer = reinterpret_cast<uint8_t *>(request->buffer);
+	size_t progress = 0;
+	while(progress < request->numSectors) {
+		auto sector = request->sector + progress;
+		auto chunk = buffer + progress * 512;
+
+		// Without 48-bit LBA, the sector count register only has 8 bits (also for DMA).
+		bool useDma = _bmBar && _supportsDma && !_disableDma;
+		auto numSectors = std::min(request->numSectors - progress,
+				(useDma && _supportsLBA48) ? maxDmaSectors : maxPioSectors);
+
+		if(!useDma || !(co_await _transferDma(request->isWrite, sector, chunk, numSectors))) {
+			numSectors = std::min(numSectors, maxPioSectors);
+			co_await _transferPio(request->isWrite, sector, chunk, numSectors);
+		}
+		progress += numSectors;
+	}
+
+	if(logRequests)
+		std::cout << "block/ata: Reading/writing from " << request->sector
+				<< " complete" << std::endl;
+}
+
+void Controller::_issueCommand(uint8_t command, uint64_t sector, size_t numSectors) {
+	assert(numSectors <= (_supportsLBA48 ? maxDmaSectors : maxPioSectors));
 
 	_ioSpace.store(regs::outDevice, kDeviceLba);
 	// TODO: There should be a 400ns delay after drive selection.
 
 	if (_supportsLBA48) {
-		_ioSpace.store(regs::outSectorCount, (request->numSectors >> 8) & 0xFF);
-		_ioSpace.store(regs::outLba1, (request->sector >> 24) & 0xFF);
-		_ioSpace.store(regs::outLba2, (request->sector >> 32) & 0xFF);
-		_ioSpace.store(regs::outLba3, (request->sector >> 40) & 0xFF);
+		_ioSpace.store(regs::outSectorCount, (numSectors >> 8) & 0xFF);
+		_ioSpace.store(regs::outLba1, (sector >> 24) & 0xFF);
+		_ioSpace.store(regs::outLba2, (sector >> 32) & 0xFF);
+		_ioSpace.store(regs::outLba3, (sector >> 40) & 0xFF);
 	}
 
-	_ioSpace.store(regs::outSectorCount, request->numSectors & 0xFF);
-	_ioSpace.store(regs::outLba1, request->sector & 0xFF);
-	_ioSpace.store(regs::outLba2, (request->sector >> 8) & 0xFF);
-	_ioSpace.store(regs::outLba3, (request->sector >> 16) & 0xFF);
+	_ioSpace.store(regs::outSectorCount, numSectors & 0xFF);
+	_ioSpace.store(regs::outLba1, sector & 0xFF);
+	_ioSpace.store(regs::outLba2, (sector >> 8) & 0xFF);
+	_ioSpace.store(regs::outLba3, (sector >> 16) & 0xFF);
 
-	if(!request->isWrite) {
+	_ioSpace.store(regs::outCommand, command);
+}
+
+async::result<void> Controller::_transferPio(bool isWrite, uint64_t sector, uint8_t *buffer,
+		size_t numSectors) {
+	if(!isWrite) {
 		if (_supportsLBA48)
-			_ioSpace.store(regs::outCommand, kCommandReadSectorsExt);
+			_issueCommand(kCommandReadSectorsExt, sector, numSectors);
 		else
-			_ioSpace.store(regs::outCommand, kCommandReadSectors);
+			_issueCommand(kCommandReadSectors, sector, numSectors);
 
 		// Receive the result for each sector.
-		for(size_t k = 0; k < request->numSectors; k++) {
+		for(size_t k = 0; k < numSectors; k++) {
 			auto ioRes = co_await _waitForBsyIrq();
 			assert(ioRes == IoResult::withData);
 
 			// Read the data.
 			// TODO: Do we have to be careful with endianess here?
-			auto chunk = reinterpret_cast<uint8_t *>(request->buffer) + k * 512;
+			auto chunk = buffer + k * 512;
 			// TODO: The following is a hack. Lock the page into memory instead!
 			*static_cast<volatile uint8_t *>(chunk); // Fault in the page.
 			_ioSpace.load_iterative(regs::ioData, reinterpret_cast<uint16_t *>(chunk), 256);
 		}
 	}else{
 		if (_supportsLBA48)
-			_ioSpace.store(regs::outCommand, kCommandWriteSectorsExt);
+			_issueCommand(kCommandWriteSectorsExt, sector, numSectors);
 		else
-			_ioSpace.store(regs::outCommand, kCommandWriteSectors);
+			_issueCommand(kCommandWriteSectors, sector, numSectors);
 
 		// Write requests do not generate an IRQ for the first sector.
 		auto ioRes = co_await _pollForBsy();
 		assert(ioRes == IoResult::withData);
 
 		// Receive the result for each sector.
-		for(size_t k = 0; k < request->numSectors; k++) {
+		for(size_t k = 0; k < numSectors; k++) {
 			// Read the data.
 			// TODO: Do we have to be careful with endianess here?
-			auto chunk = reinterpret_cast<uint8_t *>(request->buffer) + k * 512;
+			auto chunk = buffer + k * 512;
 			// TODO: The following is a hack. Lock the page into memory instead!
 			*static_cast<volatile uint8_t *>(chunk); // Fault in the page.
 			_ioSpace.store_iterative(regs::ioData, reinterpret_cast<uint16_t *>(chunk), 256);
 
 			// Wait for the device to process the sector.
 			auto ioRes = co_await _waitForBsyIrq();
-			if(k + 1 < request->numSectors) {
+			if(k + 1 < numSectors) {
 				assert(ioRes == IoResult::withData);
 			}else{
 				assert(ioRes == IoResult::noData);
 			}
 		}
 	}
+}
 
-	if(logRequests)
-		std::cout << "block/ata: Reading/writing from " << request->sector
-				<< " complete" << std::endl;
+// Returns false if the transfer could not be done using DMA;
+// in this case, the caller falls back to PIO.
+async::result<bool> Controller::_transferDma(bool isWrite, uint64_t sector, uint8_t *buffer,
+		size_t numSectors) {
+	assert(numSectors <= (_supportsLBA48 ? maxDmaSectors : maxPioSectors));
+
+	// Build the PRD table. The bus master can only access the low 4 GiB,
+	// and regions must be word aligned.
+	helix::LockedPhysical bufferLock{buffer, numSectors * 512};
+	size_t numEntries = 0;
+	for(auto segment : bufferLock.segments()) {
+		while(segment.length) {
+			auto boundary = (segment.physical | 0xFFFF) + 1;
+			auto length = std::min(segment.length, boundary - segment.physical);
+			if(numEntries == PrdTable::numEntries
+					|| boundary > (uintptr_t{1} << 32)
+					|| (segment.physical & 1) || (length & 1))
+				co_return false;
+
+			_prdt->entries[numEntries++] = PrdEntry{
+				static_cast<uint32_t>(segment.physical),
+				static_cast<uint16_t>(length),
+				0
+			};
+			segment.physical += length;
+			segment.length -= length;
+		}
+	}
+	assert(numEntries);
+	_prdt->entries[numEntries - 1].flags = kPrdEndOfTable;
+
+	// Note that the direction is from the point of view of the bus master.
+	uint8_t direction = isWrite ? 0 : kBmCommandRead;
+	_bmSpace.store(bm_regs::command, direction);
+	_bmSpace.store(bm_regs::prdtAddress, static_cast<uint32_t>(_prdtPhysical));
+	_bmSpace.store(bm_regs::status, kBmStatusError | kBmStatusIrq);
+
+	if(isWrite)
+		_issueCommand(_supportsLBA48 ? kCommandWriteDmaExt : kCommandWriteDma,
+				sector, numSectors);
+	else
+		_issueCommand(_supportsLBA48 ? kCommandReadDmaExt : kCommandReadDma,
+				sector, numSectors);
+	_bmSpace.store(bm_regs::command, direction | kBmCommandStart);
+
+	// The device raises a single IRQ once the whole transfer is done.
+	auto ioRes = co_await _waitForBsyIrq();
+	auto bmStatus = _bmSpace.load(bm_regs::status);
+	_bmSpace.store(bm_regs::command, direction);
+	_bmSpace.store(bm_regs::status, kBmStatusError | kBmStatusIrq);
+
+	if(ioRes != IoResult::noData || (bmStatus & (kBmStatusError | kBmStatusActive))) {
+		std::cout << "\e[31m" "block/ata: DMA transfer failed (bus-master status 0x"
+				<< std::hex << static_cast<int>(bmStatus) << std::dec
+				<< "), falling back to PIO" "\e[39m" << std::endl;
+		_disableDma = true;
+		co_return false;
+	}
+
+	co_return true;
+}
+
+// Reads the start of the disk sequentially, using PIO and (if available) DMA.
+async::result<void> Controller::_benchmark() {
+	constexpr size_t totalSectors = 16384; // 8 MiB.
+	constexpr size_t maxSectors = 1024;
+	if(_numSectors < totalSectors)
+		co_return;
+
+	arch::dma_array<uint8_t> buffer{&_dmaPool, maxSectors * 512};
+
+	bool savedDisableDma = _disableDma;
+	for(bool dma : {false, true}) {
+		if(dma && !(_bmBar && _supportsDma && !savedDisableDma))
+			break;
+		_disableDma = !dma;
+
+		for(size_t numSectors : {size_t{8}, size_t{128}, maxSectors}) {
+			auto start = helix::currentClock();
+			for(size_t sector = 0; sector < totalSectors; sector += numSectors)
+				co_await readSectors(sector, buffer.data(), numSectors);
+			auto elapsed = helix::currentClock() - start;
+
+			std::cout << "block/ata: " << (dma ? "DMA" : "PIO") << " sequential read ("
+					<< numSectors * 512 / 1024 << " KiB requests): "
+					<< (totalSectors * 512 * 1000 / elapsed) << " MB/s" << std::endl;
+		}
+	}
+	_disableDma = savedDisableDma;
 }
 
 std::vector<std::shared_ptr<Controller>> globalControllers;
 
+// Bus-master registers that were found before the controller itself.
+std::optional<std::pair<uint16_t, helix::UniqueDescriptor>> pendingBusmaster;
+bool foundBusmaster = false;
+
 // ------------------------------------------------------------------------
 // Freestanding discovery functions.
 // ------------------------------------------------------------------------
@@ -397,10 +628,57 @@ async::detached bindController(mbus::Entity entity) {
 			info.barInfo[0].address, info.barInfo[1].address,
 			std::move(mainBar), std::move(altBar),
 			std::move(irq));
+	if(pendingBusmaster) {
+		controller->enableDma(pendingBusmaster->first, std::move(pendingBusmaster->second));
+		pendingBusmaster.reset();
+	}
 	controller->run();
 	globalControllers.push_back(std::move(controller));
 }
 
+// The legacy ATA ports usually belong to the compatibility mode channel of a
+// PCI IDE function (e.g., the PIIX). Its BAR 4 contains the bus-master registers.
+async::detached bindBusmaster(mbus::Entity entity) {
+	protocols::hw::Device device(co_await entity.bind());
+	auto info = co_await device.getPciInfo();
+
+	// Bit 0 of the programming interface is clear if the primary channel
+	// is in compatibility mode, i.e., uses the legacy ports.
+	auto progIf = co_await device.loadPciSpace(0x09, 1);
+	if((progIf & 1) || info.barInfo[4].ioType != protocols::hw::IoType::kIoTypePort)
+		co_return;
+	// Only a single legacy controller exists.
+	if(foundBusmaster)
+		co_return;
+	foundBusmaster = true;
+
+	co_await device.enableBusmaster();
+	auto bmBar = co_await device.accessBar(4);
+
+	if(globalControllers.empty()) {
+		pendingBusmaster.emplace(info.barInfo[4].address, std::move(bmBar));
+	}else{
+		globalControllers.front()->enableDma(info.barInfo[4].address, std::move(bmBar));
+	}
+}
+
+async::detached observeBusmasters() {
+	auto root = co_await mbus::Instance::global().getRoot();
+
+	auto filter = mbus::Conjunction({
+		mbus::EqualsFilter("pci-class", "01"),
+		mbus::EqualsFilter("pci-subclass", "01")
+	});
+
+	auto handler = mbus::ObserverHandler{}
+	.withAttach([] (mbus::Entity entity, mbus::Properties) {
+		printf("block/ata: detected PCI IDE function\n");
+		bindBusmaster(std::move(entity));
+	});
+
+	co_await root.linkObserver(std::move(filter), std::move(handler));
+}
+
 async::detached observeControllers() {
 	auto root = co_await mbus::Instance::global().getRoot();
 
@@ -424,6 +702,7 @@ async::detached observeControllers() {
 int main() {
 	printf("block/ata: Starting driver\n");
 
+	observeBusmasters();
 	observeControllers();
 	async::run_forever(helix::currentDispatcher);
 }
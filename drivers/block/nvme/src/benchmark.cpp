@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <iostream>
+
+#include <arch/dma_structs.hpp>
+#include <helix/clock.hpp>
+
+#include "benchmark.hpp"
+#include "command.hpp"
+
+namespace {
+
+constexpr size_t blockSize = 4096;
+
+// Compares buffer setup with and without a registered buffer.
+void benchmarkSetupBuffer(helix::PhysicalCache &cache) {
+	constexpr int iterations = 10000;
+
+	for (size_t size : {size_t{4096}, size_t{65536}}) {
+		arch::dma_array<uint8_t> buffer{nullptr, size};
+		arch::dma_buffer_view view{nullptr, buffer.data(), size};
+
+		auto start = helix::currentClock();
+		for (int i = 0; i < iterations; i++) {
+			Command cmd;
+			cmd.setupBuffer(view);
+		}
+		auto uncached = (helix::currentClock() - start) / iterations;
+
+		cache.add(buffer.data(), size);
+		start = helix::currentClock();
+		for (int i = 0; i < iterations; i++) {
+			Command cmd;
+			cmd.setupBuffer(view, &cache);
+		}
+		auto cached = (helix::currentClock() - start) / iterations;
+		cache.remove(buffer.data());
+
+		std::cout << "block/nvme: Buffer setup (" << size << " bytes): "
+				<< uncached << " ns, " << cached << " ns if registered" << std::endl;
+	}
+}
+
+} // anonymous namespace
+
+async::result<void> benchmarkNamespace(Namespace *ns, helix::PhysicalCache &cache) {
+	benchmarkSetupBuffer(cache);
+
+	if (ns->getNumSectors() << ns->getLbaShift() < blockSize)
+		co_return;
+
+	// One buffer per request, registered once such that I/O does not need to translate them.
+	constexpr size_t maxDepth = 64;
+	size_t bufferSize = std::max(blockSize, size_t{1} << ns->getLbaShift());
+	arch::dma_array<uint8_t> buffers{nullptr, maxDepth * bufferSize};
+	cache.add(buffers.data(), maxDepth * bufferSize);
+
+	for (bool write : {false, true}) {
+		for (size_t depth = 1; depth <= maxDepth; depth *= 4) {
+			auto iops = co_await blockfs::measureRandomIops(ns, {
+				.requestSize = blockSize,
+				.depth = depth,
+				.write = write,
+				.buffers = buffers.data(),
+				.bufferSize = bufferSize
+			});
+
+			std::cout << "block/nvme: Random " << (write ? "read+write" : "read")
+					<< " (4 KiB, depth " << depth << "): " << iops << " IOPS" << std::endl;
+		}
+	}
+
+	cache.remove(buffers.data());
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <async/result.hpp>
+#include <helix/memory.hpp>
+
+#include "namespace.hpp"
+
+// Measures the CPU time that is spent to set up the data buffer of a command,
+// followed by random 4 KiB read and write IOPS at increasing queue depths.
+// The I/O buffers are registered in cache.
+// The benchmark only rewrites data that it has just read from the same sectors,
+// but it must not run while the namespace is in use.
+async::result<void> benchmarkNamespace(Namespace *ns, helix::PhysicalCache &cache);
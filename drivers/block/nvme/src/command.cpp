@@ -4,7 +4,7 @@
 
 #include "command.hpp"
 
-void Command::setupBuffer(arch::dma_buffer_view view) {
+void Command::setupBuffer(arch::dma_buffer_view view, const helix::PhysicalCache *cache) {
 	using arch::convert_endian;
 	using arch::endian;
 
@@ -13,15 +13,30 @@ void Command::setupBuffer(arch::dma_buffer_view view) {
 	uintptr_t virtStart = reinterpret_cast<uintptr_t>(view.data());
 	auto offset = virtStart % pageSize;
 
+	// Buffers that span at most two pages are translated page by page. That takes at most
+	// two system calls, while taking a lock and dropping it again also takes two.
+	// Larger buffers are translated at once (or not at all if they are cached).
+	// The lock is held until the command is destructed, i.e., until the transfer is done.
+	const helix::LockedPhysical *locked = cache ? cache->find(view.data(), view.size()) : nullptr;
+	if (!locked && offset + view.size() > pageSize * 2) {
+		bufferLock_ = helix::LockedPhysical{view.data(), view.size()};
+		locked = &bufferLock_;
+	}
+	auto physical = [&] (uintptr_t virt) -> uintptr_t {
+		if (!locked)
+			return helix::addressToPhysical(virt);
+		return locked->translate(reinterpret_cast<const void *>(virt)).first;
+	};
+
 	if (offset + view.size() <= pageSize * 2) {
 		// Inline
 		command_.common.dataPtr.prp1 = convert_endian<endian::little, endian::native>(
-			helix::ptrToPhysical(view.data()));
+			physical(virtStart));
 
 		auto firstPrpLen = pageSize - offset;
 		if (view.size() > firstPrpLen) {
 			command_.common.dataPtr.prp2 = convert_endian<endian::little, endian::native>(
-				helix::ptrToPhysical(view.subview(firstPrpLen).data()));
+				physical(virtStart + firstPrpLen));
 		}
 
 		return;
@@ -30,7 +45,7 @@ void Command::setupBuffer(arch::dma_buffer_view view) {
 	uintptr_t prp1, prp2;
 	auto size = view.size();
 
-	prp1 = helix::addressToPhysical(virtStart);
+	prp1 = physical(virtStart);
 
 	if (offset + view.size() <= pageSize) {
 		command_.readWrite.dataPtr.prp1 = convert_endian<endian::little, endian::native>(prp1);
@@ -43,7 +58,7 @@ void Command::setupBuffer(arch::dma_buffer_view view) {
 	if (size <= pageSize) {
 		command_.readWrite.dataPtr.prp1 = convert_endian<endian::little, endian::native>(prp1);
 		command_.readWrite.dataPtr.prp2 = convert_endian<endian::little, endian::native>(
-			helix::addressToPhysical(virtStart));
+			physical(virtStart));
 		return;
 	}
 
@@ -67,7 +82,7 @@ void Command::setupBuffer(arch::dma_buffer_view view) {
 			i = 1;
 		}
 		prpList[i++] = convert_endian<endian::little, endian::native>(
-			helix::addressToPhysical(virtStart));
+			physical(virtStart));
 		virtStart += pageSize;
 
 		if (size <= pageSize)
@@ -4,6 +4,7 @@
 #include <async/promise.hpp>
 #include <frg/std_compat.hpp>
 #include <arch/dma_structs.hpp>
+#include <helix/memory.hpp>
 
 #include "spec.hpp"
 
@@ -14,7 +15,8 @@ struct Command {
 		return command_;
 	}
 
-	void setupBuffer(arch::dma_buffer_view view);
+	// Buffers that are found in the cache are not translated again.
+	void setupBuffer(arch::dma_buffer_view view, const helix::PhysicalCache *cache = nullptr);
 
 	async::future<Result, frg::stl_allocator> getFuture() {
 		return promise_.get_future();
@@ -28,4 +30,5 @@ private:
 	spec::Command command_;
 	async::promise<Result, frg::stl_allocator> promise_;
 	std::vector<arch::dma_array<uint64_t>> prpLists;
+	helix::LockedPhysical bufferLock_;
 };
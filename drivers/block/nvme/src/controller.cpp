@@ -1,8 +1,19 @@
+#include <algorithm>
+#include <iostream>
+
 #include <arch/bit.hpp>
 #include <helix/timer.hpp>
 
+#include "benchmark.hpp"
 #include "controller.hpp"
 
+namespace {
+	constexpr bool logQueues = false;
+
+	// Run a random I/O benchmark on the first namespace before it is exposed to the system.
+	constexpr bool runBenchmark = false;
+} // anonymous namespace
+
 namespace regs {
 	constexpr arch::bit_register<uint64_t> cap{0x0};
 	constexpr arch::scalar_register<uint32_t> vs{0x4};
@@ -37,40 +48,46 @@ namespace flags {
 } // namespace flags
 
 Controller::Controller(int64_t parentId, protocols::hw::Device hwDevice, helix::Mapping hbaRegs,
-					   helix::UniqueDescriptor, helix::UniqueDescriptor irq)
+					   helix::UniqueDescriptor, helix::UniqueDescriptor irq, unsigned int numMsis)
 	: hwDevice_{std::move(hwDevice)}, regsMapping_{std::move(hbaRegs)},
-	  regs_{regsMapping_.get()}, irq_{std::move(irq)}, parentId_{parentId} {
+	  regs_{regsMapping_.get()}, numMsis_{numMsis}, parentId_{parentId} {
+	irqs_.push_back(std::move(irq));
 }
 
 async::detached Controller::run() {
 	co_await hwDevice_.enableBusIrq();
 
-	handleIrqs();
+	handleIrqs(0);
 
 	co_await reset();
 	co_await scanNamespaces();
 
+	if (runBenchmark && !activeNamespaces_.empty())
+		co_await benchmarkNamespace(activeNamespaces_.front().get(), physicalCache_);
+
 	for (auto &ns : activeNamespaces_)
 		ns->run();
 }
 
-async::detached Controller::handleIrqs() {
-	irqSequence_ = 0;
+async::detached Controller::handleIrqs(unsigned int vector) {
+	uint64_t sequence = 0;
 
 	while (true) {
-		auto await = co_await helix_ng::awaitEvent(irq_, irqSequence_);
+		// Note that irqs_ may be reallocated while we wait.
+		auto await = co_await helix_ng::awaitEvent(irqs_[vector], sequence);
 		HEL_CHECK(await.error());
-		irqSequence_ = await.sequence();
+		sequence = await.sequence();
 
 		int found = 0;
 		for (auto &q : activeQueues_) {
-			found |= q->handleIrq();
+			if (q->getIrqVector() == vector)
+				found |= q->handleIrq();
 		}
 
 		if (found) {
-			HEL_CHECK(helAcknowledgeIrq(irq_.getHandle(), kHelAckAcknowledge, irqSequence_));
+			HEL_CHECK(helAcknowledgeIrq(irqs_[vector].getHandle(), kHelAckAcknowledge, sequence));
 		} else {
-			HEL_CHECK(helAcknowledgeIrq(irq_.getHandle(), kHelAckNack, irqSequence_));
+			HEL_CHECK(helAcknowledgeIrq(irqs_[vector].getHandle(), kHelAckNack, sequence));
 		}
 	}
 }
@@ -122,15 +139,73 @@ async::result<void> Controller::reset() {
 
 	co_await enable();
 
-	auto ioQ = std::make_unique<Queue>(1, queueDepth_, regs_.subspace(doorbellsOffset + 1 * 8 * dbStride_));
-	ioQ->init();
+	// Each I/O queue gets its own MSI-X vector (the first one is shared with the admin queue).
+	// Without MSI-X, all completions are signaled through a single IRQ anyway
+	// and we stick to a single I/O queue.
+	unsigned int wantedQueues = 1;
+	if (numMsis_ > 1)
+		wantedQueues = std::min(numMsis_, MAX_IO_QUEUES);
+	auto numIoQueues = co_await requestIoQueues(wantedQueues);
+
+	for (unsigned int i = 1; i <= numIoQueues; i++) {
+		unsigned int vector = 0;
+		if (i > 1) {
+			vector = i - 1;
+			auto irq = co_await hwDevice_.installMsi(vector);
+
+			// Route the completions of queue i to CPU i - 1.
+			// This fails if there is no such CPU; in that case, we have enough queues.
+			auto error = helSetIrqAffinity(irq.getHandle(), i - 1);
+			if (error == kHelErrIllegalArgs)
+				break;
+			if (error != kHelErrNone && error != kHelErrNoHardwareSupport)
+				HEL_CHECK(error);
+
+			assert(irqs_.size() == vector);
+			irqs_.push_back(std::move(irq));
+			handleIrqs(vector);
+		}
+
+		auto ioQ = std::make_unique<Queue>(i, queueDepth_,
+				regs_.subspace(doorbellsOffset + i * 8 * dbStride_), vector);
+		ioQ->init();
 
-	if (co_await setupIoQueue(ioQ.get())) {
+		if (!(co_await setupIoQueue(ioQ.get())))
+			break;
 		ioQ->run();
 		activeQueues_.push_back(std::move(ioQ));
 	}
 
 	assert(activeQueues_.size() >= 2 && "At least need one IO queue");
+	if (logQueues)
+		std::cout << "block/nvme: Using " << (activeQueues_.size() - 1)
+				<< " I/O queues" << std::endl;
+}
+
+async::result<unsigned int> Controller::requestIoQueues(unsigned int count) {
+	using arch::convert_endian;
+	using arch::endian;
+
+	auto &adminQ = activeQueues_.front();
+	auto cmd = std::make_unique<Command>();
+	auto &cmdBuf = cmd->getCommandBuffer().features;
+
+	// Both counts are zero-based.
+	uint32_t dword11 = ((count - 1) << 16) | (count - 1);
+
+	cmdBuf.opcode = spec::kSetFeatures;
+	cmdBuf.fid = convert_endian<endian::little, endian::native>((uint32_t)spec::kNumberOfQueues);
+	cmdBuf.dword11 = convert_endian<endian::little, endian::native>(dword11);
+
+	auto res = co_await adminQ->submitCommand(std::move(cmd));
+	if (res.first != 0)
+		co_return 1;
+
+	// The controller may allocate more or fewer queues than requested.
+	auto allocated = convert_endian<endian::little>(res.second.u32);
+	unsigned int numSqs = (allocated & 0xFFFF) + 1;
+	unsigned int numCqs = (allocated >> 16) + 1;
+	co_return std::min({count, numSqs, numCqs});
 }
 
 async::result<bool> Controller::setupIoQueue(Queue *q) {
@@ -160,7 +235,7 @@ async::result<Command::Result> Controller::createCQ(Queue *q) {
 	cmdBuf.cqid = convert_endian<endian::little, endian::native>((uint16_t)q->getQueueId());
 	cmdBuf.qSize = convert_endian<endian::little, endian::native>((uint16_t)q->getQueueDepth() - 1);
 	cmdBuf.cqFlags = convert_endian<endian::little, endian::native>((uint16_t)flags);
-	cmdBuf.irqVector = 0; // TODO: set to MSI vector
+	cmdBuf.irqVector = convert_endian<endian::little, endian::native>((uint16_t)q->getIrqVector());
 
 	return adminQ->submitCommand(std::move(cmd));
 }
@@ -272,6 +347,9 @@ async::result<void> Controller::scanNamespaces() {
 }
 
 async::result<void> Controller::createNamespace(unsigned int nsid) {
+	using arch::convert_endian;
+	using arch::endian;
+
 	spec::IdentifyNamespace id;
 
 	if ((co_await identifyNamespace(nsid, id)).first != 0)
@@ -284,12 +362,16 @@ async::result<void> Controller::createNamespace(unsigned int nsid) {
 	if (!lbaShift)
 		lbaShift = 9;
 
-	auto ns = std::make_unique<Namespace>(this, nsid, lbaShift);
+	auto ns = std::make_unique<Namespace>(this, nsid, lbaShift,
+			convert_endian<endian::little>(id.nsze));
 	activeNamespaces_.push_back(std::move(ns));
 }
 
 async::result<Command::Result> Controller::submitIoCommand(std::unique_ptr<Command> cmd) {
-	auto &ioQ = activeQueues_.back();
+	// All requests arrive on the driver's single thread, so there is no caller CPU
+	// to pick a queue by. Spread them over the queues instead.
+	auto &ioQ = activeQueues_[1 + nextIoQueue_];
+	nextIoQueue_ = (nextIoQueue_ + 1) % (activeQueues_.size() - 1);
 
 	return ioQ->submitCommand(std::move(cmd));
 }
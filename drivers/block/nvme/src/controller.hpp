@@ -10,7 +10,7 @@
 
 struct Controller {
 	Controller(int64_t parentId, protocols::hw::Device hwDevice, helix::Mapping hbaRegs,
-			   helix::UniqueDescriptor ahciBar, helix::UniqueDescriptor irq);
+			   helix::UniqueDescriptor ahciBar, helix::UniqueDescriptor irq, unsigned int numMsis);
 
 	async::detached run();
 
@@ -19,23 +19,36 @@ struct Controller {
 	inline int64_t getParentId() const {
 		return parentId_;
 	}
+
+	// Buffers in this cache are not translated on each I/O.
+	helix::PhysicalCache &physicalCache() {
+		return physicalCache_;
+	}
 private:
 	static constexpr int IO_QUEUE_DEPTH = 1024;
+	// Upper bound on the number of I/O queues; the driver creates at most one per CPU.
+	static constexpr unsigned int MAX_IO_QUEUES = 64;
 
 	protocols::hw::Device hwDevice_;
 	helix::Mapping regsMapping_;
 	arch::mem_space regs_;
-	helix::UniqueDescriptor irq_;
+	// Indexed by MSI-X vector. Without MSI-X, only the pin-based IRQ is used.
+	std::vector<helix::UniqueDescriptor> irqs_;
+	unsigned int numMsis_;
 
+	// The admin queue is at index 0, followed by the I/O queues.
 	std::vector<std::unique_ptr<Queue>> activeQueues_;
 	std::vector<std::unique_ptr<Namespace>> activeNamespaces_;
 
+	helix::PhysicalCache physicalCache_;
+
 	int64_t parentId_;
 	unsigned int queueDepth_;
 	uint32_t dbStride_;
 	uint32_t version_;
 
-	uint64_t irqSequence_;
+	// I/O commands are distributed round-robin among the I/O queues.
+	size_t nextIoQueue_ = 0;
 
 	async::result<void> reset();
 	async::result<void> scanNamespaces();
@@ -44,6 +57,7 @@ private:
 	async::result<void> enable();
 	async::result<void> disable();
 
+	async::result<unsigned int> requestIoQueues(unsigned int count);
 	async::result<bool> setupIoQueue(Queue *q);
 	async::result<Command::Result> createCQ(Queue *q);
 	async::result<Command::Result> createSQ(Queue *q);
@@ -54,5 +68,5 @@ private:
 
 	async::result<void> createNamespace(unsigned int nsid);
 
-	async::detached handleIrqs();
+	async::detached handleIrqs(unsigned int vector);
 };
@@ -3,9 +3,9 @@
 #include "namespace.hpp"
 #include "controller.hpp"
 
-Namespace::Namespace(Controller *controller, unsigned int nsid, int lbaShift)
+Namespace::Namespace(Controller *controller, unsigned int nsid, int lbaShift, uint64_t numSectors)
 	: BlockDevice{(size_t)1 << lbaShift, controller->getParentId()}, controller_(controller), nsid_(nsid),
-	  lbaShift_(lbaShift) {
+	  lbaShift_(lbaShift), numSectors_(numSectors) {
 }
 
 async::detached Namespace::run() {
@@ -25,7 +25,8 @@ async::result<void> Namespace::readSectors(uint64_t sector, void *buffer, size_t
 	cmdBuf.nsid = convert_endian<endian::little, endian::native>(nsid_);
 	cmdBuf.startLba = convert_endian<endian::little, endian::native>(sector);
 	cmdBuf.length = convert_endian<endian::little, endian::native>((uint16_t)numSectors - 1);
-	cmd->setupBuffer(arch::dma_buffer_view{nullptr, buffer, numSectors << lbaShift_});
+	cmd->setupBuffer(arch::dma_buffer_view{nullptr, buffer, numSectors << lbaShift_},
+			&controller_->physicalCache());
 
 	co_await controller_->submitIoCommand(std::move(cmd));
 }
@@ -41,12 +42,12 @@ async::result<void> Namespace::writeSectors(uint64_t sector, const void *buffer,
 	cmdBuf.nsid = convert_endian<endian::little, endian::native>(nsid_);
 	cmdBuf.startLba = convert_endian<endian::little, endian::native>(sector);
 	cmdBuf.length = convert_endian<endian::little, endian::native>((uint16_t)numSectors - 1);
-	cmd->setupBuffer(arch::dma_buffer_view{nullptr, (char *)buffer, numSectors << lbaShift_});
+	cmd->setupBuffer(arch::dma_buffer_view{nullptr, (char *)buffer, numSectors << lbaShift_},
+			&controller_->physicalCache());
 
 	co_await controller_->submitIoCommand(std::move(cmd));
 }
 
 async::result<size_t> Namespace::getSize() {
-	std::cout << "nvme: Namespace::getSize() is a stub!" << std::endl;
-	co_return 1;
+	co_return numSectors_ << lbaShift_;
 }
@@ -6,10 +6,17 @@
 struct Controller;
 
 struct Namespace : blockfs::BlockDevice {
-	Namespace(Controller *controller, unsigned int nsid, int lbaShift);
+	Namespace(Controller *controller, unsigned int nsid, int lbaShift, uint64_t numSectors);
 
 	async::detached run();
 
+	int getLbaShift() const {
+		return lbaShift_;
+	}
+	uint64_t getNumSectors() const {
+		return numSectors_;
+	}
+
 	async::result<void> readSectors(uint64_t sector, void *buf, size_t numSectors) override;
 	async::result<void> writeSectors(uint64_t sector, const void *buf, size_t numSectors) override;
 	async::result<size_t> getSize() override;
@@ -18,4 +25,5 @@ private:
 	Controller *controller_;
 	unsigned int nsid_;
 	int lbaShift_;
+	uint64_t numSectors_;
 };
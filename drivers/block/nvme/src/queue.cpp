@@ -5,8 +5,10 @@
 #include "queue.hpp"
 #include "spec.hpp"
 
-Queue::Queue(unsigned int qid, unsigned int depth, arch::mem_space doorbells)
-	: qid_(qid), depth_(depth), doorbells_(doorbells), sqTail_(0), cqHead_(0), cqPhase_(1) {
+Queue::Queue(unsigned int qid, unsigned int depth, arch::mem_space doorbells,
+			 unsigned int irqVector)
+	: qid_(qid), depth_(depth), irqVector_(irqVector), doorbells_(doorbells),
+	  sqTail_(0), cqHead_(0), cqPhase_(1), commandsInFlight_(0) {
 	queuedCmds_.resize(depth);
 }
 
@@ -68,7 +70,7 @@ int Queue::handleIrq() {
 		cqe = &cqes_[cqHead_];
 	}
 
-	if (commandsInFlight_ == depth_ && found > 0)
+	if (commandsInFlight_ == maxCommandsInFlight() && found > 0)
 		freeSlotDoorbell_.raise();
 
 	commandsInFlight_ -= found;
@@ -80,7 +82,7 @@ int Queue::handleIrq() {
 }
 
 async::result<size_t> Queue::findFreeSlot() {
-	if (commandsInFlight_ >= depth_)
+	while (commandsInFlight_ >= maxCommandsInFlight())
 		co_await freeSlotDoorbell_.async_wait();
 
 	for (size_t i = 0; i < queuedCmds_.size(); i++) {
@@ -97,11 +99,23 @@ async::detached Queue::submitPendingLoop() {
 	while (true) {
 		auto cmd = co_await pendingCmdQueue_.async_get();
 		assert(cmd);
-		co_await submitCommandToDevice(std::move(cmd.value()));
+		co_await writeCommand(std::move(cmd.value()));
+
+		// Batch all commands that are already pending such that
+		// the submission doorbell is only written once.
+		// Once the submission queue is full, the remaining commands wait for completions.
+		while (commandsInFlight_ < maxCommandsInFlight()) {
+			auto next = pendingCmdQueue_.maybe_get();
+			if (!next)
+				break;
+			co_await writeCommand(std::move(next.value()));
+		}
+
+		doorbells_.store(arch::scalar_register<uint32_t>{0}, sqTail_);
 	}
 }
 
-async::result<void> Queue::submitCommandToDevice(std::unique_ptr<Command> cmd) {
+async::result<void> Queue::writeCommand(std::unique_ptr<Command> cmd) {
 	auto slot = co_await findFreeSlot();
 
 	auto &cmdBuf = cmd->getCommandBuffer();
@@ -110,7 +124,6 @@ async::result<void> Queue::submitCommandToDevice(std::unique_ptr<Command> cmd) {
 	memcpy((uint8_t *)sqCmds_ + (sqTail_ << 6), &cmdBuf, sizeof(spec::Command));
 	if (++sqTail_ == depth_)
 		sqTail_ = 0;
-	doorbells_.store(arch::scalar_register<uint32_t>{0}, sqTail_);
 
 	queuedCmds_[slot] = std::move(cmd);
 	commandsInFlight_++;
@@ -11,7 +11,8 @@
 #include "spec.hpp"
 
 struct Queue {
-	Queue(unsigned int index, unsigned int depth, arch::mem_space doorbells);
+	Queue(unsigned int index, unsigned int depth, arch::mem_space doorbells,
+			unsigned int irqVector = 0);
 
 	void init();
 	async::detached run();
@@ -22,6 +23,9 @@ struct Queue {
 	unsigned int getQueueDepth() const {
 		return depth_;
 	}
+	unsigned int getIrqVector() const {
+		return irqVector_;
+	}
 
 	uintptr_t getCqPhysAddr() const {
 		return cqPhys_;
@@ -37,6 +41,7 @@ struct Queue {
 private:
 	unsigned int qid_;
 	unsigned int depth_;
+	unsigned int irqVector_;
 	arch::mem_space doorbells_;
 	spec::CompletionEntry *cqes_;
 	void *sqCmds_;
@@ -52,8 +57,15 @@ private:
 	async::recurring_event freeSlotDoorbell_;
 	size_t commandsInFlight_;
 
+	// The submission queue is full if its tail is one entry behind its head.
+	// Limiting the commands in flight ensures that the queue never overflows,
+	// even if the controller has not fetched any of them yet.
+	size_t maxCommandsInFlight() const {
+		return depth_ - 1;
+	}
+
 	async::result<size_t> findFreeSlot();
 	async::detached submitPendingLoop();
 
-	async::result<void> submitCommandToDevice(std::unique_ptr<Command> cmd);
+	async::result<void> writeCommand(std::unique_ptr<Command> cmd);
 };
@@ -13,6 +13,12 @@ enum AdminOpcode {
 	kDeleteCQ = 0x4,
 	kCreateCQ = 0x5,
 	kIdentify = 0x6,
+	kSetFeatures = 0x9,
+	kGetFeatures = 0xA,
+};
+
+enum FeatureId {
+	kNumberOfQueues = 0x7,
 };
 
 enum CommandFlags {
@@ -258,12 +264,25 @@ struct IdentifyCommand {
 	uint32_t __reserved11[5];
 };
 
+struct FeaturesCommand {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t commandId;
+	uint32_t nsid;
+	uint64_t __reserved2[2];
+	DataPointer dataPtr;
+	uint32_t fid;
+	uint32_t dword11;
+	uint32_t __reserved12[4];
+};
+
 union Command {
 	CommonCommand common;
 	ReadWriteCommand readWrite;
 	CreateCQCommand createCQ;
 	CreateSQCommand createSQ;
 	IdentifyCommand identify;
+	FeaturesCommand features;
 };
 static_assert(sizeof(Command) == 64);
 
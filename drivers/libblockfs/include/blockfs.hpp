@@ -28,4 +28,23 @@ protected:
 
 async::detached runDevice(BlockDevice *device);
 
+// Parameters of measureRandomIops().
+struct RandomIoBenchmark {
+	// Size of each request. It is rounded up to a multiple of the sector size.
+	size_t requestSize = 4096;
+	// Number of concurrent requests.
+	size_t depth = 1;
+	// Whether each read is followed by a write of the same data to the same sectors.
+	bool write = false;
+	uint64_t runtimeNs = 2'000'000'000;
+	// depth buffers of bufferSize bytes each; one for each concurrent request.
+	uint8_t *buffers = nullptr;
+	size_t bufferSize = 0;
+};
+
+// Issues random I/O to the device and returns the number of requests per second.
+// Used by the built-in benchmarks of block drivers. Writes do not modify the disk,
+// but the benchmark must not run while the device is in use.
+async::result<uint64_t> measureRandomIops(BlockDevice *device, const RandomIoBenchmark &params);
+
 } // namespace blockfs
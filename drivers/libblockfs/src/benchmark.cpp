@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cassert>
+
+#include <async/oneshot-event.hpp>
+#include <helix/clock.hpp>
+
+#include <blockfs.hpp>
+
+namespace blockfs {
+
+namespace {
+
+struct RandomIoRun {
+	BlockDevice *device;
+	const RandomIoBenchmark *params;
+	size_t sectorsPerRequest;
+	uint64_t numRequests;
+	uint64_t deadline;
+	size_t numActive;
+	uint64_t completed = 0;
+	async::oneshot_event done;
+};
+
+// Issues random I/O until the deadline is reached. Writes store the data
+// that was just read from the same sectors, i.e., they do not modify the disk.
+async::detached runWorker(RandomIoRun *run, uint64_t seed, uint8_t *buffer) {
+	auto device = run->device;
+
+	uint64_t state = seed;
+	while(helix::currentClock() < run->deadline) {
+		// xorshift64.
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		auto sector = (state % run->numRequests) * run->sectorsPerRequest;
+
+		co_await device->readSectors(sector, buffer, run->sectorsPerRequest);
+		run->completed++;
+		if(run->params->write) {
+			co_await device->writeSectors(sector, buffer, run->sectorsPerRequest);
+			run->completed++;
+		}
+	}
+
+	if(!--run->numActive)
+		run->done.raise();
+}
+
+} // anonymous namespace
+
+async::result<uint64_t> measureRandomIops(BlockDevice *device, const RandomIoBenchmark &params) {
+	assert(params.depth);
+
+	RandomIoRun run;
+	run.device = device;
+	run.params = &params;
+	run.sectorsPerRequest = std::max((params.requestSize + device->sectorSize - 1)
+			/ device->sectorSize, size_t{1});
+	run.numRequests = (co_await device->getSize())
+			/ (run.sectorsPerRequest * device->sectorSize);
+	run.numActive = params.depth;
+	assert(params.bufferSize >= run.sectorsPerRequest * device->sectorSize);
+	if(!run.numRequests)
+		co_return 0;
+
+	auto start = helix::currentClock();
+	run.deadline = start + params.runtimeNs;
+	for(size_t i = 0; i < params.depth; i++)
+		runWorker(&run, 0x9E3779B97F4A7C15 * (i + 1), params.buffers + i * params.bufferSize);
+	co_await run.done.wait();
+	auto elapsed = helix::currentClock() - start;
+
+	co_return run.completed * 1'000'000'000 / elapsed;
+}
+
+} // namespace blockfs
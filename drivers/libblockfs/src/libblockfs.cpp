@@ -6,6 +6,7 @@
 #include <sys/epoll.h>
 #include <linux/cdrom.h>
 
+#include <helix/clock.hpp>
 #include <helix/ipc.hpp>
 #include <protocols/fs/server.hpp>
 #include <protocols/mbus/client.hpp>
@@ -68,8 +69,7 @@ async::result<protocols::fs::ReadResult> read(void *object, const char *,
 	if (!length)
 		co_return size_t{0};
 
-	uint64_t start;
-	HEL_CHECK(helGetClock(&start));
+	auto start = helix::currentClock();
 
 	auto self = static_cast<ext2fs::OpenFile *>(object);
 	co_await self->inode->readyJump.wait();
@@ -111,8 +111,7 @@ async::result<protocols::fs::ReadResult> read(void *object, const char *,
 			chunk_offset, chunkSize, buffer);
 	HEL_CHECK(readMemory.error());
 
-	uint64_t end;
-	HEL_CHECK(helGetClock(&end));
+	auto end = helix::currentClock();
 
 	protocols::ostrace::Event oste{&ostContext, ostReadEvent};
 	oste.withCounter(ostByteCounter, static_cast<int64_t>(length));
@@ -157,6 +156,55 @@ async::result<protocols::fs::ReadResult> pread(void *object, int64_t offset, con
 	co_return chunk_size;
 }
 
+// Instead of copying the data out of the page cache, we let the kernel send it
+// directly from the page cache to the client.
+async::result<protocols::fs::ReadCachedResult> readCached(void *object, const char *,
+		size_t length) {
+	auto start = helix::currentClock();
+
+	auto self = static_cast<ext2fs::OpenFile *>(object);
+	co_await self->inode->readyJump.wait();
+
+	size_t chunkSize = 0;
+	if(self->offset < self->inode->fileSize())
+		chunkSize = std::min(length, self->inode->fileSize() - self->offset);
+
+	auto chunkOffset = self->offset;
+	self->offset += chunkSize;
+
+	auto end = helix::currentClock();
+
+	protocols::ostrace::Event oste{&ostContext, ostReadEvent};
+	oste.withCounter(ostByteCounter, static_cast<int64_t>(length));
+	oste.withCounter(ostTimeCounter, static_cast<int64_t>(end - start));
+	co_await oste.emit();
+
+	co_return protocols::fs::CachedRange{
+		.memory = helix::BorrowedDescriptor{self->inode->frontalMemory},
+		.offset = chunkOffset,
+		.length = chunkSize
+	};
+}
+
+async::result<protocols::fs::ReadCachedResult> preadCached(void *object, int64_t offset,
+		const char *, size_t length) {
+	auto self = static_cast<ext2fs::OpenFile *>(object);
+	co_await self->inode->readyJump.wait();
+
+	if(offset < 0)
+		co_return protocols::fs::Error::illegalArguments;
+
+	size_t chunkSize = 0;
+	if(static_cast<uint64_t>(offset) < self->inode->fileSize())
+		chunkSize = std::min(length, self->inode->fileSize() - offset);
+
+	co_return protocols::fs::CachedRange{
+		.memory = helix::BorrowedDescriptor{self->inode->frontalMemory},
+		.offset = static_cast<uintptr_t>(offset),
+		.length = chunkSize
+	};
+}
+
 async::result<frg::expected<protocols::fs::Error, size_t>> write(void *object, const char *,
 		const void *buffer, size_t length) {
 	if(!length) {
@@ -220,6 +268,8 @@ constexpr protocols::fs::FileOperations fileOperations {
 	.seekEof      = &seekEof,
 	.read         = &read,
 	.pread        = &pread,
+	.readCached   = &readCached,
+	.preadCached  = &preadCached,
 	.write        = &write,
 	.pwrite       = &pwrite,
 	.readEntries  = &readEntries,
@@ -503,8 +553,7 @@ async::result<protocols::fs::ReadResult> rawRead(void *object, const char *,
 		void *buffer, size_t length) {
 	assert(length);
 
-	uint64_t start;
-	HEL_CHECK(helGetClock(&start));
+	auto start = helix::currentClock();
 
 	auto self = static_cast<raw::OpenFile *>(object);
 	auto file_size = co_await self->rawFs->device->getSize();
@@ -525,8 +574,7 @@ async::result<protocols::fs::ReadResult> rawRead(void *object, const char *,
 			chunk_offset, chunkSize, buffer);
 	HEL_CHECK(readMemory.error());
 
-	uint64_t end;
-	HEL_CHECK(helGetClock(&end));
+	auto end = helix::currentClock();
 
 	protocols::ostrace::Event oste{&ostContext, ostReadEvent};
 	oste.withCounter(ostByteCounter, static_cast<int64_t>(length));
@@ -150,6 +150,11 @@ extern inline __attribute__ (( always_inline )) HelError helForkMemory(HelHandle
 	return error;
 };
 
+extern inline __attribute__ (( always_inline )) HelError helForkSpace(HelHandle space,
+		struct HelForkItem *items, size_t numItems) {
+	return helSyscall3(kHelCallForkSpace, (HelWord)space, (HelWord)items, (HelWord)numItems);
+};
+
 extern inline __attribute__ (( always_inline )) HelError helCreateSpace(HelHandle *handle) {
 	HelWord handle_word;
 	HelError error = helSyscall0_1(kHelCallCreateSpace, &handle_word);
@@ -224,6 +229,16 @@ extern inline __attribute__ (( always_inline )) HelError helPointerPhysical(cons
 	return error;
 };
 
+extern inline __attribute__ (( always_inline )) HelError helLockPhysical(const void *pointer,
+		size_t length, struct HelPhysicalSegment *segments, size_t *numSegments,
+		HelHandle *handle) {
+	HelWord handle_word;
+	HelError error = helSyscall4_1(kHelCallLockPhysical, (HelWord)pointer, (HelWord)length,
+			(HelWord)segments, (HelWord)numSegments, &handle_word);
+	*handle = (HelHandle)handle_word;
+	return error;
+};
+
 extern inline __attribute__ (( always_inline )) HelError helSubmitReadMemory(HelHandle handle,
 		uintptr_t address, size_t length, void *buffer,
 		HelHandle queue, uintptr_t context) {
@@ -312,6 +327,12 @@ extern inline __attribute__ (( always_inline )) HelError helResume(HelHandle han
 	return helSyscall1(kHelCallResume, (HelWord)handle);
 };
 
+extern inline __attribute__ (( always_inline )) HelError helCompleteSuperCall(HelHandle handle,
+		HelError error, uintptr_t out0, uintptr_t out1) {
+	return helSyscall4(kHelCallCompleteSuperCall, (HelWord)handle, (HelWord)error,
+			(HelWord)out0, (HelWord)out1);
+};
+
 extern inline __attribute__ (( always_inline )) HelError helLoadRegisters(HelHandle handle,
 		int set, void *image) {
 	return helSyscall3(kHelCallLoadRegisters, (HelWord)handle, (HelWord)set, (HelWord)image);
@@ -373,6 +394,32 @@ extern inline __attribute__ (( always_inline )) HelError helFutexWake(int *point
 	return helSyscall1(kHelCallFutexWake, (HelWord)pointer);
 };
 
+extern inline __attribute__ (( always_inline )) HelError helFutexWaitBitset(int *pointer,
+		int expected, int64_t deadline, uint32_t bitset) {
+	return helSyscall4(kHelCallFutexWaitBitset, (HelWord)pointer, (HelWord)expected,
+			(HelWord)deadline, (HelWord)bitset);
+};
+
+extern inline __attribute__ (( always_inline )) HelError helFutexWakeBitset(int *pointer,
+		int count, uint32_t bitset, int *woken) {
+	HelWord woken_word;
+	HelError error = helSyscall3_1(kHelCallFutexWakeBitset, (HelWord)pointer, (HelWord)count,
+			(HelWord)bitset, &woken_word);
+	*woken = (int)woken_word;
+	return error;
+};
+
+extern inline __attribute__ (( always_inline )) HelError helFutexRequeue(int *pointer,
+		int *target, int expected, int wakeCount, int requeueCount, uint32_t flags,
+		int *affected) {
+	HelWord affected_word;
+	HelError error = helSyscall6_1(kHelCallFutexRequeue, (HelWord)pointer, (HelWord)target,
+			(HelWord)expected, (HelWord)wakeCount, (HelWord)requeueCount, (HelWord)flags,
+			&affected_word);
+	*affected = (int)affected_word;
+	return error;
+};
+
 extern inline __attribute__ (( always_inline )) HelError helCreateOneshotEvent(HelHandle *handle) {
 	HelWord handle_word;
 	HelError error = helSyscall0_1(kHelCallCreateOneshotEvent, &handle_word);
@@ -405,6 +452,11 @@ extern inline __attribute__ (( always_inline )) HelError helAcknowledgeIrq(HelHa
 			(HelWord)sequence);
 };
 
+extern inline __attribute__ (( always_inline )) HelError helSetIrqAffinity(HelHandle handle,
+		unsigned int cpu) {
+	return helSyscall2(kHelCallSetIrqAffinity, (HelWord)handle, (HelWord)cpu);
+};
+
 extern inline __attribute__ (( always_inline )) HelError helSubmitAwaitEvent(HelHandle handle,
 		uint64_t sequence, HelHandle queue, uintptr_t context) {
 	return helSyscall4(kHelCallSubmitAwaitEvent, (HelWord)handle, (HelWord)sequence,
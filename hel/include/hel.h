@@ -18,7 +18,7 @@
 
 enum {
 	// largest system call number plus 1
-	kHelNumCalls = 103,
+	kHelNumCalls = 110,
 
 	kHelCallLog = 1,
 	kHelCallPanic = 10,
@@ -42,6 +42,7 @@ enum {
 	kHelCallAccessPhysical = 30,
 	kHelCallCreateSliceView = 88,
 	kHelCallForkMemory = 40,
+	kHelCallForkSpace = 103,
 	kHelCallCreateSpace = 27,
 	kHelCallCreateIndirectMemory = 45,
 	kHelCallAlterMemoryIndirection = 52,
@@ -67,6 +68,7 @@ enum {
 	kHelCallKillThread = 87,
 	kHelCallInterruptThread = 86,
 	kHelCallResume = 61,
+	kHelCallCompleteSuperCall = 107,
 	kHelCallLoadRegisters = 75,
 	kHelCallStoreRegisters = 76,
 	kHelCallQueryRegisterInfo = 102,
@@ -83,6 +85,9 @@ enum {
 
 	kHelCallFutexWait = 73,
 	kHelCallFutexWake = 71,
+	kHelCallFutexWaitBitset = 104,
+	kHelCallFutexWakeBitset = 105,
+	kHelCallFutexRequeue = 106,
 
 	kHelCallCreateOneshotEvent = 96,
 	kHelCallCreateBitsetEvent = 97,
@@ -91,6 +96,8 @@ enum {
 	kHelCallAcknowledgeIrq = 81,
 	kHelCallSubmitAwaitEvent = 82,
 	kHelCallAutomateIrq = 94,
+	kHelCallSetIrqAffinity = 108,
+	kHelCallLockPhysical = 109,
 
 	kHelCallAccessIo = 11,
 	kHelCallEnableIo = 12,
@@ -124,6 +131,7 @@ enum {
 	kHelErrRemoteFault = 21,
 	kHelErrNoHardwareSupport = 16,
 	kHelErrNoMemory = 17,
+	kHelErrFutexRace = 22,
 };
 
 struct HelX86SegmentRegister {
@@ -191,6 +199,9 @@ enum {
 	kHelActionExtractCredentials = 9,
 	kHelActionSendFromBuffer = 1,
 	kHelActionSendFromBufferSg = 10,
+	// Sends length bytes of the memory view identified by handle,
+	// starting at the offset that is passed in the buffer field.
+	kHelActionSendFromMemory = 12,
 	kHelActionRecvInline = 7,
 	kHelActionRecvToBuffer = 3,
 	kHelActionPushDescriptor = 2,
@@ -248,6 +259,48 @@ enum HelMapFlags {
 	kHelMapFixed = 2048
 };
 
+//! Physically contiguous part of a buffer that is locked by ::helLockPhysical.
+struct HelPhysicalSegment {
+	//! Physical address of the segment.
+	uintptr_t physical;
+	//! Length of the segment in bytes.
+	size_t length;
+};
+
+enum HelFutexFlags {
+	// Compare the futex value before requeueing (see ::helFutexRequeue).
+	kHelFutexCompare = 1
+};
+
+enum HelForkFlags {
+	// Fork the memory object (see ::helForkMemory) instead of sharing it.
+	kHelForkCopyOnWrite = 1
+};
+
+enum {
+	// Maximal number of items that ::helForkSpace accepts in a single call.
+	kHelMaxForkItems = 1024
+};
+
+//! Describes a single mapping that is established by ::helForkSpace.
+struct HelForkItem {
+	//! Handle to the memory object that backs the mapping.
+	HelHandle memory;
+	//! Address of the mapping in the target address space.
+	void *pointer;
+	//! Offset in bytes, relative to @p memory.
+	uintptr_t offset;
+	//! Size of the mapping in bytes.
+	size_t size;
+	//! Protection flags of the mapping (see ::HelMapFlags).
+	uint32_t mapFlags;
+	//! Combination of ::HelForkFlags.
+	uint32_t forkFlags;
+	//! Output: handle to the forked memory object.
+	//! Only valid if @p forkFlags contains ::kHelForkCopyOnWrite.
+	HelHandle forkedHandle;
+};
+
 enum HelThreadFlags {
 	kHelThreadStopped = 1
 };
@@ -424,6 +477,35 @@ struct HelChunk {
 	char buffer[];
 };
 
+//! Address at which the kernel maps the clock page into every address space.
+static const uintptr_t kHelClockPageAddress = 0x7FFFFFFFF000;
+
+//! Set if the parameters of the clock page are valid.
+//! Otherwise, user space has to fall back to ::helGetClock.
+static const uint32_t kHelClockPageValid = (1 << 0);
+
+//! Set if the clock page describes the x86 time stamp counter (read by rdtsc).
+static const uint32_t kHelClockPageTsc = (1 << 1);
+
+//! Set if the clock page describes the AArch64 physical counter (read from cntpct_el0).
+static const uint32_t kHelClockPageCntpct = (1 << 2);
+
+//! Read-only page that allows user space to read the monotone clock without a syscall.
+//!
+//! The clock (see ::helGetClock) is computed as
+//! refNanos + (((counter - refCounter) * multiplier) >> shift),
+//! where the multiplication is carried out in 128-bit arithmetic.
+struct HelClockPage {
+	//! Seqlock that protects the remaining fields. Odd while the kernel updates the page.
+	uint32_t seqlock;
+	uint32_t flags;
+	uint64_t refCounter;
+	uint64_t refNanos;
+	uint64_t multiplier;
+	uint32_t shift;
+	uint32_t reserved;
+};
+
 //! A single element of a HelQueue.
 struct HelElement {
 	//! Length of the element in bytes.
@@ -455,6 +537,9 @@ struct HelObserveResult {
 	HelError error;
 	unsigned int observation;
 	uint64_t sequence;
+	// For supercall observations: the first three supercall arguments
+	// (i.e., kHelRegArg0 to kHelRegArg2). Zero otherwise.
+	uintptr_t args[3];
 };
 
 struct HelInlineResult {
@@ -690,6 +775,23 @@ HEL_C_LINKAGE HelError helCreateSliceView(HelHandle bundle, uintptr_t offset, si
 //!    	Handle to the new (i.e., forked) memory object.
 HEL_C_LINKAGE HelError helForkMemory(HelHandle handle, HelHandle *forkedHandle);
 
+//! Populates an address space from a list of mappings in a single call.
+//!
+//! This is equivalent to calling ::helForkMemory (for items that specify
+//! ::kHelForkCopyOnWrite) followed by ::helMapMemory for each item,
+//! but it only enters the kernel once. Page tables are not copied;
+//! the target address space is populated lazily on page faults.
+//! If an error is returned, the contents of the target address space are unspecified.
+//! @param[in] spaceHandle
+//!     Handle to the target address space (see ::helCreateSpace).
+//! @param[in,out] items
+//!     Array of mappings to establish. On success, the kernel stores
+//!     handles to the forked memory objects in @p items.
+//! @param[in] numItems
+//!     Number of elements of @p items. Must not exceed ::kHelMaxForkItems.
+HEL_C_LINKAGE HelError helForkSpace(HelHandle spaceHandle, struct HelForkItem *items,
+		size_t numItems);
+
 //! Creates a virtual address space that threads can run in.
 //! @param[out] handle
 //!     Handle to the new address space.
@@ -763,6 +865,30 @@ HEL_C_LINKAGE HelError helUnmapMemory(HelHandle spaceHandle, void *pointer, size
 
 HEL_C_LINKAGE HelError helPointerPhysical(const void *pointer, uintptr_t *physical);
 
+//! Locks a buffer into physical memory and returns its physical segments.
+//!
+//! This is intended for DMA buffers that are used repeatedly:
+//! instead of translating each page on every transfer (see ::helPointerPhysical),
+//! drivers can lock the buffer once and cache the resulting segments.
+//! Physically contiguous pages are merged into a single segment.
+//! @param[in] pointer
+//!     Start of the buffer. Does not need to be page-aligned.
+//!     The buffer must be contained in a single mapping.
+//! @param[in] length
+//!     Length of the buffer in bytes.
+//! @param[out] segments
+//!     Array that receives the physical segments of the buffer.
+//! @param[in,out] numSegments
+//!     On entry, the capacity of @p segments.
+//!     On return, the number of segments of the buffer.
+//!     If this exceeds the capacity, ::kHelErrBufferTooSmall is returned
+//!     and no lock is taken.
+//! @param[out] handle
+//!     Handle to the lock. The buffer stays at its physical location until
+//!     the handle is closed, even if it is unmapped in the meantime.
+HEL_C_LINKAGE HelError helLockPhysical(const void *pointer, size_t length,
+		struct HelPhysicalSegment *segments, size_t *numSegments, HelHandle *handle);
+
 //! Load memory (i.e., bytes) from a descriptor.
 //!
 //! This is an asynchronous operation.
@@ -889,6 +1015,25 @@ HEL_C_LINKAGE HelError helInterruptThread(HelHandle handle);
 //!     Handle to the thread.
 HEL_C_LINKAGE HelError helResume(HelHandle handle);
 
+//! Complete a supercall and resume the thread that issued it.
+//!
+//! This is equivalent to loading the general purpose registers,
+//! setting kHelRegError, kHelRegOut0 and kHelRegOut1,
+//! storing the registers and calling ::helResume, but it only takes
+//! a single system call. Together with the arguments that are passed
+//! in ::HelObserveResult, simple supercalls can be handled without
+//! touching the register image at all.
+//! @param[in] handle
+//!     Handle to the thread.
+//! @param[in] error
+//!     Value that is stored to kHelRegError.
+//! @param[in] out0
+//!     Value that is stored to kHelRegOut0.
+//! @param[in] out1
+//!     Value that is stored to kHelRegOut1.
+HEL_C_LINKAGE HelError helCompleteSuperCall(HelHandle handle, HelError error,
+		uintptr_t out0, uintptr_t out1);
+
 //! Load a register image (e.g., from a thread).
 //! @param[in] handle
 //!     Handle to the thread.
@@ -918,6 +1063,7 @@ HEL_C_LINKAGE HelError helWriteFsBase(void *pointer);
 
 //! Read the system-wide monotone clock.
 //!
+//! See ::HelClockPage for a way to read the clock without a syscall.
 //! @param[out] counter
 //!     Current value of the system-wide clock in nanoseconds since boot.
 HEL_C_LINKAGE HelError helGetClock(uint64_t *counter);
@@ -990,6 +1136,50 @@ HEL_C_LINKAGE HelError helFutexWait(int *pointer, int expected, int64_t deadline
 //!     Pointer that identifies the futex.
 HEL_C_LINKAGE HelError helFutexWake(int *pointer);
 
+//! Waits on a futex, only waking up for a subset of wake operations.
+//!
+//! Like ::helFutexWait but only ::helFutexWakeBitset calls whose bitset
+//! intersects with @p bitset wake up the waiter.
+//! @param[in] bitset
+//!     Non-zero bitset. ::helFutexWait is equivalent to passing all ones.
+HEL_C_LINKAGE HelError helFutexWaitBitset(int *pointer, int expected, int64_t deadline,
+		uint32_t bitset);
+
+//! Wakes up a limited number of waiters of a futex.
+//! @param[in] pointer
+//!     Pointer that identifies the futex.
+//! @param[in] count
+//!     Maximal number of waiters to wake up. Negative values wake up all waiters.
+//! @param[in] bitset
+//!     Only waiters whose bitset intersects with this value are woken up.
+//! @param[out] woken
+//!     Number of waiters that were woken up.
+HEL_C_LINKAGE HelError helFutexWakeBitset(int *pointer, int count, uint32_t bitset,
+		int *woken);
+
+//! Wakes up waiters of a futex and moves the remaining waiters to another futex.
+//!
+//! This avoids thundering herds when broadcasting condition variables:
+//! only @p wakeCount waiters are woken while the others are transferred to the
+//! futex that protects the associated mutex.
+//! @param[in] pointer
+//!     Pointer that identifies the futex.
+//! @param[in] target
+//!     Pointer that identifies the futex that waiters are moved to.
+//! @param[in] expected
+//!     If ::kHelFutexCompare is passed, the operation fails with ::kHelErrFutexRace
+//!     (without waking up anyone) unless the futex pointed to by @p pointer matches this value.
+//! @param[in] wakeCount
+//!     Maximal number of waiters to wake up.
+//! @param[in] requeueCount
+//!     Maximal number of waiters to move. Negative values move all waiters.
+//! @param[in] flags
+//!     Zero or ::kHelFutexCompare.
+//! @param[out] affected
+//!     Number of waiters that were woken up or moved.
+HEL_C_LINKAGE HelError helFutexRequeue(int *pointer, int *target, int expected,
+		int wakeCount, int requeueCount, uint32_t flags, int *affected);
+
 //! @}
 //! @name Event Handling
 //! @{
@@ -1025,6 +1215,19 @@ HEL_C_LINKAGE HelError helSubmitAwaitEvent(HelHandle handle, uint64_t sequence,
 
 HEL_C_LINKAGE HelError helAutomateIrq(HelHandle handle, uint32_t flags, HelHandle kernlet);
 
+//! Route an IRQ to a specific CPU.
+//!
+//! Multi-queue devices use this to deliver the IRQ of each queue
+//! to the CPU that processes the queue.
+//! @param[in] handle
+//!     Handle to the IRQ.
+//! @param[in] cpu
+//!     Index of the CPU that the IRQ will be delivered to.
+//! @return
+//!     ::kHelErrNoHardwareSupport if the IRQ controller cannot route the IRQ
+//!     to the given CPU, ::kHelErrNoMemory if the CPU has no free IRQ vectors.
+HEL_C_LINKAGE HelError helSetIrqAffinity(HelHandle handle, unsigned int cpu);
+
 //! @}
 //! @name Input/Output
 //! @{
@@ -1091,6 +1294,8 @@ extern inline __attribute__ (( always_inline )) const char *_helErrorString(HelE
 		return "Missing hardware support for this feature";
 	case kHelErrNoMemory:
 		return "Out of memory";
+	case kHelErrFutexRace:
+		return "Futex value changed";
 	case kHelErrTransmissionMismatch:
 		return "Transmission mismatch";
 	case kHelErrCancelled:
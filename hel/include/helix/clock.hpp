@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <hel.h>
+#include <hel-syscalls.h>
+
+namespace helix {
+
+namespace detail {
+	inline uint64_t readClockCounter() {
+#if defined(__x86_64__)
+		return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+		uint64_t cntpct;
+		asm volatile ("isb; mrs %0, cntpct_el0" : "=r"(cntpct) : : "memory");
+		return cntpct;
+#else
+		return 0;
+#endif
+	}
+
+	inline bool clockCounterSupported(uint32_t flags) {
+#if defined(__x86_64__)
+		return flags & kHelClockPageTsc;
+#elif defined(__aarch64__)
+		return flags & kHelClockPageCntpct;
+#else
+		return false;
+#endif
+	}
+} // namespace detail
+
+// Reads the system-wide monotone clock (in nanoseconds, see helGetClock()).
+// This uses the kernel-published clock page and only enters the kernel if the
+// page does not describe a counter that can be read from user space.
+inline uint64_t currentClock() {
+	auto page = reinterpret_cast<const HelClockPage *>(kHelClockPageAddress);
+
+	while(true) {
+		// Start the seqlock read.
+		auto seq = __atomic_load_n(&page->seqlock, __ATOMIC_ACQUIRE);
+		if(seq & 1)
+			continue;
+
+		// Perform the actual loads.
+		auto flags = __atomic_load_n(&page->flags, __ATOMIC_RELAXED);
+		auto refCounter = __atomic_load_n(&page->refCounter, __ATOMIC_RELAXED);
+		auto refNanos = __atomic_load_n(&page->refNanos, __ATOMIC_RELAXED);
+		auto multiplier = __atomic_load_n(&page->multiplier, __ATOMIC_RELAXED);
+		auto shift = __atomic_load_n(&page->shift, __ATOMIC_RELAXED);
+
+		// Finish the seqlock read.
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&page->seqlock, __ATOMIC_RELAXED) != seq)
+			continue;
+
+		if(!(flags & kHelClockPageValid) || !detail::clockCounterSupported(flags)) {
+			uint64_t nanos;
+			HEL_CHECK(helGetClock(&nanos));
+			return nanos;
+		}
+
+		auto ticks = detail::readClockCounter() - refCounter;
+		return refNanos + static_cast<uint64_t>(
+				(static_cast<unsigned __int128>(ticks) * multiplier) >> shift);
+	}
+}
+
+} // namespace helix
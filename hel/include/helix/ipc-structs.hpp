@@ -248,6 +248,26 @@ private:
 	HelError _error;
 };
 
+struct SendMemoryResult {
+	SendMemoryResult() :_valid{false} {}
+
+	HelError error() {
+		FRG_ASSERT(_valid);
+		return _error;
+	}
+
+	void parse(void *&ptr, ElementHandle) {
+		auto result = reinterpret_cast<HelSimpleResult *>(ptr);
+		_error = result->error;
+		ptr = (char *)ptr + sizeof(HelSimpleResult);
+		_valid = true;
+	}
+
+private:
+	bool _valid;
+	HelError _error;
+};
+
 struct SendBufferSgResult {
 	SendBufferSgResult() :_valid{false} {}
 
@@ -433,6 +453,12 @@ struct SendBufferSg {
 	size_t size;
 };
 
+struct SendMemory {
+	HelHandle handle;
+	uintptr_t offset;
+	size_t size;
+};
+
 struct RecvBuffer {
 	void *buf;
 	size_t size;
@@ -525,6 +551,11 @@ inline auto sendBufferSg(const HelSgItem *data, size_t length) {
 	return SendBufferSg{data, length};
 }
 
+// Sends a range of a memory object without copying it through the sender's address space.
+inline auto sendMemory(BorrowedDescriptor memory, uintptr_t offset, size_t length) {
+	return SendMemory{memory.getHandle(), offset, length};
+}
+
 inline auto recvBuffer(void *data, size_t length) {
 	return RecvBuffer{data, length};
 }
@@ -658,6 +689,17 @@ inline auto createActionsArrayFor(bool chain, const SendBufferSg &item) {
 	return frg::array<HelAction, 1>{action};
 }
 
+inline auto createActionsArrayFor(bool chain, const SendMemory &item) {
+	HelAction action{};
+	action.type = kHelActionSendFromMemory;
+	action.flags = chain ? kHelItemChain : 0;
+	action.buffer = reinterpret_cast<void *>(item.offset);
+	action.length = item.size;
+	action.handle = item.handle;
+
+	return frg::array<HelAction, 1>{action};
+}
+
 inline auto createActionsArrayFor(bool chain, const RecvBuffer &item) {
 	HelAction action{};
 	action.type = kHelActionRecvToBuffer;
@@ -759,6 +801,10 @@ inline auto resultTypeTuple(const SendBufferSg &) {
 	return frg::tuple<SendBufferSgResult>{};
 }
 
+inline auto resultTypeTuple(const SendMemory &) {
+	return frg::tuple<SendMemoryResult>{};
+}
+
 inline auto resultTypeTuple(const RecvBuffer &) {
 	return frg::tuple<RecvBufferResult>{};
 }
@@ -650,6 +650,12 @@ struct Observe : Operation {
 		return result()->sequence;
 	}
 
+	// Only valid for supercall observations.
+	uintptr_t superCallArg(int n) {
+		assert(n >= 0 && n < 3);
+		return result()->args[n];
+	}
+
 private:
 	HelObserveResult *result() {
 		return reinterpret_cast<HelObserveResult *>(OperationBase::element());
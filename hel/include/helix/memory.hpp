@@ -1,6 +1,10 @@
 #pragma once
 
 #include <string.h>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
 
 #include <hel.h>
 #include <helix/ipc.hpp>
@@ -81,4 +85,84 @@ inline uintptr_t addressToPhysical(uintptr_t p) {
 	return phys;
 }
 
+// Buffer that is locked into physical memory (see helLockPhysical()).
+// Translating addresses within the buffer does not require system calls.
+struct LockedPhysical {
+	static constexpr size_t pageSize = 0x1000;
+
+	LockedPhysical() = default;
+
+	LockedPhysical(const void *pointer, size_t size)
+	: _base{reinterpret_cast<uintptr_t>(pointer)}, _size{size} {
+		// Each page contributes at most one segment.
+		size_t numSegments = (size + pageSize - 1) / pageSize + 1;
+		_segments.resize(numSegments);
+		HelHandle handle;
+		HEL_CHECK(helLockPhysical(pointer, size, _segments.data(), &numSegments, &handle));
+		_segments.resize(numSegments);
+		_lock = UniqueDescriptor{handle};
+	}
+
+	explicit operator bool () const {
+		return _size;
+	}
+
+	bool contains(const void *pointer, size_t size) const {
+		auto address = reinterpret_cast<uintptr_t>(pointer);
+		return address >= _base && size <= _size && address - _base <= _size - size;
+	}
+
+	// Returns the physical address of pointer and the number of bytes
+	// that are physically contiguous from there on.
+	std::pair<uintptr_t, size_t> translate(const void *pointer) const {
+		auto offset = reinterpret_cast<uintptr_t>(pointer) - _base;
+		assert(offset < _size);
+		for(auto &segment : _segments) {
+			if(offset < segment.length)
+				return {segment.physical + offset, segment.length - offset};
+			offset -= segment.length;
+		}
+		__builtin_unreachable();
+	}
+
+	const std::vector<HelPhysicalSegment> &segments() const {
+		return _segments;
+	}
+
+private:
+	uintptr_t _base = 0;
+	size_t _size = 0;
+	std::vector<HelPhysicalSegment> _segments;
+	UniqueDescriptor _lock;
+};
+
+// Keeps hot DMA buffers locked such that their physical addresses are only looked up once.
+struct PhysicalCache {
+	const LockedPhysical &add(const void *pointer, size_t size) {
+		auto address = reinterpret_cast<uintptr_t>(pointer);
+		auto [it, inserted] = _buffers.try_emplace(address, pointer, size);
+		assert(inserted);
+		return it->second;
+	}
+
+	void remove(const void *pointer) {
+		auto erased = _buffers.erase(reinterpret_cast<uintptr_t>(pointer));
+		assert(erased);
+	}
+
+	// Returns the buffer that contains [pointer, pointer + size) or nullptr.
+	const LockedPhysical *find(const void *pointer, size_t size) const {
+		auto it = _buffers.upper_bound(reinterpret_cast<uintptr_t>(pointer));
+		if(it == _buffers.begin())
+			return nullptr;
+		it = std::prev(it);
+		if(!it->second.contains(pointer, size))
+			return nullptr;
+		return &it->second;
+	}
+
+private:
+	std::map<uintptr_t, LockedPhysical> _buffers;
+};
+
 } // namespace helix
@@ -3,6 +3,7 @@
 #include <thor-internal/arch/gic.hpp>
 #include <thor-internal/debug.hpp>
 #include <thor-internal/thread.hpp>
+#include <thor-internal/tracepoint.hpp>
 #include <assert.h>
 
 namespace thor {
@@ -24,10 +25,16 @@ void suspendSelf() {
 extern frg::manual_box<GicDistributor> dist;
 
 void sendPingIpi(int id) {
+	if(ipiTracepoint.enabled()) [[unlikely]]
+		ipiTracepoint.record(0, ipiTraceIndexPing);
+
 	dist->sendIpi(getCpuData(id)->gicCpuInterface->interfaceNumber(), 0);
 }
 
 void sendShootdownIpi() {
+	if(ipiTracepoint.enabled()) [[unlikely]]
+		ipiTracepoint.record(0, ipiTraceIndexShootdown);
+
 	dist->sendIpiToOthers(1);
 }
 
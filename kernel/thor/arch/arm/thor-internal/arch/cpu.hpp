@@ -238,8 +238,10 @@ struct Executor {
 
 	Word *arg0() { return &general()->x[1]; }
 	Word *arg1() { return &general()->x[2]; }
+	Word *arg2() { return &general()->x[3]; }
 	Word *result0() { return &general()->x[0]; }
 	Word *result1() { return &general()->x[1]; }
+	Word *result2() { return &general()->x[2]; }
 
 	Frame *general() {
 		return reinterpret_cast<Frame *>(_pointer);
@@ -1,5 +1,6 @@
 #include <thor-internal/arch/timer.hpp>
 #include <thor-internal/arch/cpu.hpp>
+#include <thor-internal/clock-page.hpp>
 #include <thor-internal/cpu-data.hpp>
 #include <thor-internal/timer.hpp>
 #include <thor-internal/schedule.hpp>
@@ -12,6 +13,7 @@ namespace thor {
 
 static uint64_t ticksPerSecond;
 static uint64_t ticksPerMilli;
+static uint64_t clockMultiplier;
 
 uint64_t getRawTimestampCounter() {
 	uint64_t cntpct;
@@ -37,7 +39,7 @@ struct PhysicalGenericTimer : IrqSink, ClockSource {
 	}
 
 	uint64_t currentNanos() override {
-		return getRawTimestampCounter() * 1000000 / ticksPerMilli;
+		return scaleClockTicks(getRawTimestampCounter(), clockMultiplier);
 	}
 };
 
@@ -81,12 +83,21 @@ struct VirtualGenericTimer : IrqSink, AlarmTracker {
 	}
 };
 
+// Allow EL0 to read cntpct_el0 (EL0PCTEN) such that user space can use the clock page.
+static void enableUserCounterAccess() {
+	uint64_t cntkctl;
+	asm volatile ("mrs %0, cntkctl_el1" : "=r"(cntkctl));
+	asm volatile ("msr cntkctl_el1, %0" :: "r"(cntkctl | 1));
+}
+
 frg::manual_box<PhysicalGenericTimer> globalPGTInstance;
 frg::manual_box<VirtualGenericTimer> globalVGTInstance;
 
 void initializeTimers() {
 	asm volatile ("mrs %0, cntfrq_el0" : "=r"(ticksPerSecond));
 	ticksPerMilli = ticksPerSecond / 1000;
+	clockMultiplier = computeClockMultiplier(ticksPerMilli);
+	enableUserCounterAccess();
 
 	// enable and unmask generic timers
 	asm volatile ("msr cntp_cval_el0, %0" :: "r"(0xFFFFFFFFFFFFFFFF));
@@ -122,6 +133,7 @@ static initgraph::Task initTimerIrq{&globalInitEngine, "arm.init-timer-irq",
 	[] {
 		globalPGTInstance.initialize();
 		globalClockSource = globalPGTInstance.get();
+		publishClockPage(kHelClockPageValid | kHelClockPageCntpct, clockMultiplier);
 
 		globalVGTInstance.initialize();
 		globalTimerEngine = frg::construct<PrecisionTimerEngine>(*kernelAlloc,
@@ -158,6 +170,8 @@ bool haveTimer() {
 
 // Sets up the proper interrupt trigger and polarity for the PPI
 void initTimerOnThisCpu() {
+	enableUserCounterAccess();
+
 	auto irqPhys = timerNode->irqs()[1];
 	auto physPin = dist->getPin(irqPhys.id);
 	physPin->setMode(irqPhys.trigger, irqPhys.polarity);
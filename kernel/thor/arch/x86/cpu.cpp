@@ -335,6 +335,11 @@ PlatformCpuData::PlatformCpuData() {
 	for(int i = 0; i < maxPcidCount; i++)
 		pcidBindings[i].setupPcid(i);
 
+	for(int i = 0; i < 64; i++) {
+		irqVectorSlots[i] = -1;
+		irqVectorReleaseDeadlines[i] = 0;
+	}
+
 	// Setup the GDT.
 	// Note: the TSS requires two slots in the GDT.
 	common::x86::makeGdtNullSegment(gdt, kGdtIndexNull);
@@ -376,7 +376,17 @@ extern "C" void onPlatformIrq(IrqImageAccessor image, int number) {
 	assert(!irqMutex().nesting());
 	disableUserAccess();
 
-	handleIrq(image, number);
+	// Translate the per-CPU vector to a global IRQ slot.
+	// Vectors can be stale for a short time after an IRQ is moved to another CPU.
+	int slot = getPlatformCpuData()->irqVectorSlots[number];
+	if(slot < 0) {
+		infoLogger() << "\e[31m" "thor: IRQ on unused vector " << (64 + number)
+				<< "\e[39m" << frg::endlog;
+		acknowledgeIrq(0);
+		return;
+	}
+
+	handleIrq(image, slot);
 }
 
 extern "C" void onPlatformLegacyIrq(IrqImageAccessor image, int number) {
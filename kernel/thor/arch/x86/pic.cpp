@@ -3,11 +3,14 @@
 #include <arch/mem_space.hpp>
 #include <arch/register.hpp>
 #include <thor-internal/arch/hpet.hpp>
+#include <thor-internal/arch/system.hpp>
+#include <thor-internal/clock-page.hpp>
 #include <thor-internal/debug.hpp>
 #include <thor-internal/fiber.hpp>
 #include <initgraph.hpp>
 #include <thor-internal/irq.hpp>
 #include <thor-internal/main.hpp>
+#include <thor-internal/tracepoint.hpp>
 
 namespace thor {
 
@@ -339,11 +342,15 @@ uint64_t localTicks() {
 
 namespace {
 	struct TscClockSource final : ClockSource {
+		TscClockSource(uint64_t multiplier)
+		: multiplier{multiplier} { }
+
 		uint64_t currentNanos() override {
-			auto r = getRawTimestampCounter() * 1'000'000 / localApicContext()->tscTicksPerMilli;
-	//		infoLogger() << r << frg::endlog;
-			return r;
+			return scaleClockTicks(getRawTimestampCounter(), multiplier);
 		}
+
+		// Same scaling as published in the clock page.
+		uint64_t multiplier;
 	};
 
 	frg::manual_box<TscClockSource> globalTscClockSource;
@@ -388,13 +395,18 @@ static initgraph::Task assessTimersTask{&globalInitEngine, "x86.assess-timers",
 	initgraph::Entails{getTaskingAvailableStage()},
 	[] {
 		if(getGlobalCpuFeatures()->haveInvariantTsc) {
-			globalTscClockSource.initialize();
+			auto multiplier = computeClockMultiplier(localApicContext()->tscTicksPerMilli);
+			globalTscClockSource.initialize(multiplier);
 			globalClockSource = globalTscClockSource.get();
+
+			// The invariant TSC can be read from user space on all CPUs.
+			publishClockPage(kHelClockPageValid | kHelClockPageTsc, multiplier);
 		}else{
 			infoLogger() << "thor: No invariant TSC; using HPET as system clock source"
 					<< frg::endlog;
 
 			globalClockSource = hpetClockSource;
+			publishClockPage(0, 0);
 		}
 
 		globalTimerEngine = frg::construct<PrecisionTimerEngine>(*kernelAlloc,
@@ -455,6 +467,9 @@ void raiseStartupIpi(uint32_t dest_apic_id, uint32_t page) {
 }
 
 void sendShootdownIpi() {
+	if(ipiTracepoint.enabled()) [[unlikely]]
+		ipiTracepoint.record(0, ipiTraceIndexShootdown);
+
 	if(picBase.isUsingX2apic()) {
 		picBase.store(lX2ApicIcr, x2apicIcrLowVector(0xF0) | x2apicIcrLowDelivMode(0)
 				| x2apicIcrLowLevel(true) | x2apicIcrLowShorthand(2) | x2apicIcrHighDestField(0));
@@ -469,6 +484,9 @@ void sendShootdownIpi() {
 }
 
 void sendPingIpi(int id) {
+	if(ipiTracepoint.enabled()) [[unlikely]]
+		ipiTracepoint.record(0, ipiTraceIndexPing);
+
 	auto apic = getCpuData(id)->localApicId;
 //	infoLogger() << "thor [CPU" << getLocalApicId() << "]: Sending ping" << frg::endlog;
 	if(picBase.isUsingX2apic()) {
@@ -512,14 +530,97 @@ IrqPin *getGlobalSystemIrq(size_t n) {
 // MSI management
 // --------------------------------------------------------
 
-// TODO: Replace this by proper IRQ allocation.
-extern frg::manual_box<IrqSlot> globalIrqSlots[64];
+extern frg::manual_box<IrqSlot> globalIrqSlots[numIrqSlots];
 extern IrqSpinlock globalIrqSlotsLock;
 
+namespace {
+	// The following functions must be called with globalIrqSlotsLock held.
+
+	int allocateIrqSlot(IrqPin *pin) {
+		for(int i = 0; i < numIrqSlots; i++) {
+			if(!globalIrqSlots[i]->isAvailable())
+				continue;
+			globalIrqSlots[i]->link(pin);
+			return i;
+		}
+		return -1;
+	}
+
+	// Time that a vector stays bound to its IRQ slot after the IRQ moved to another vector.
+	// IRQs that are already in flight still arrive at the old vector during this time.
+	constexpr uint64_t irqVectorGracePeriod = 10'000'000;
+
+	// Returns true if the vector (relative to vector 64) is free.
+	// Releases the vector if its grace period is over.
+	bool checkIrqVectorFree(int cpu, int i) {
+		auto cpuData = getCpuData(cpu);
+		if(cpuData->irqVectorSlots[i] < 0)
+			return true;
+		auto deadline = cpuData->irqVectorReleaseDeadlines[i];
+		if(!deadline || systemClockSource()->currentNanos() < deadline)
+			return false;
+		cpuData->irqVectorSlots[i] = -1;
+		cpuData->irqVectorReleaseDeadlines[i] = 0;
+		return true;
+	}
+
+	// Returns a free IDT vector or -1 if the CPU has no free vectors left.
+	int findFreeIrqVector(int cpu) {
+		for(int i = 0; i < 64; i++) {
+			if(checkIrqVectorFree(cpu, i))
+				return 64 + i;
+		}
+		return -1;
+	}
+
+	void bindIrqVector(int cpu, int vector, int slot) {
+		auto cpuData = getCpuData(cpu);
+		assert(cpuData->irqVectorSlots[vector - 64] < 0);
+		cpuData->irqVectorSlots[vector - 64] = slot;
+	}
+
+	// Frees the vector once its grace period is over.
+	void retireIrqVector(int cpu, int vector) {
+		auto cpuData = getCpuData(cpu);
+		assert(cpuData->irqVectorSlots[vector - 64] >= 0);
+		assert(!cpuData->irqVectorReleaseDeadlines[vector - 64]);
+		cpuData->irqVectorReleaseDeadlines[vector - 64]
+				= systemClockSource()->currentNanos() + irqVectorGracePeriod;
+	}
+
+	// Returns the CPU with the most free vectors.
+	int pickIrqCpu() {
+		int bestCpu = 0;
+		int bestFree = -1;
+		for(int cpu = 0; cpu < getCpuCount(); cpu++) {
+			int free = 0;
+			for(int i = 0; i < 64; i++) {
+				if(checkIrqVectorFree(cpu, i))
+					free++;
+			}
+			if(free > bestFree) {
+				bestCpu = cpu;
+				bestFree = free;
+			}
+		}
+		return bestCpu;
+	}
+
+	// MSIs are delivered in physical destination mode, i.e.,
+	// we can only target CPUs whose APIC ID fits into the MSI address.
+	bool canTargetCpu(int cpu) {
+		return getCpuData(cpu)->localApicId < 256;
+	}
+}
+
+// --------------------------------------------------------
+// MSI management
+// --------------------------------------------------------
+
 namespace {
 	struct ApicMsiPin final : MsiPin {
-		ApicMsiPin(frg::string<KernelAlloc> name, unsigned int vector)
-		: MsiPin{std::move(name)}, vector_{vector} { }
+		ApicMsiPin(frg::string<KernelAlloc> name, int cpu, unsigned int vector)
+		: MsiPin{std::move(name)}, cpu_{cpu}, vector_{vector} { }
 
 		IrqStrategy program(TriggerMode mode, Polarity) override {
 			assert(mode == TriggerMode::edge);
@@ -540,43 +641,92 @@ namespace {
 			acknowledgeIrq(0);
 		}
 
+		int affinity() override {
+			return cpu_;
+		}
+
+		Error retarget(int cpu) override {
+			if(cpu == cpu_)
+				return Error::success;
+			if(!canTargetCpu(cpu) || !canReprogram())
+				return Error::noHardwareSupport;
+
+			int oldCpu;
+			unsigned int oldVector;
+			{
+				auto guard = frg::guard(&globalIrqSlotsLock);
+
+				int vector = findFreeIrqVector(cpu);
+				if(vector < 0)
+					return Error::noMemory;
+				bindIrqVector(cpu, vector, slot_);
+				oldCpu = std::exchange(cpu_, cpu);
+				oldVector = std::exchange(vector_, vector);
+			}
+
+			// This needs to be done without holding globalIrqSlotsLock.
+			reprogram();
+
+			// IRQs that the device raised before the reprogramming can still arrive
+			// at the old vector; hence, the old vector is only freed after a grace period.
+			auto guard = frg::guard(&globalIrqSlotsLock);
+			retireIrqVector(oldCpu, oldVector);
+			return Error::success;
+		}
+
 		uint64_t getMessageAddress() override {
-			return 0xFEE00000;
+			return 0xFEE00000 | (getCpuData(cpu_)->localApicId << 12);
 		}
 
 		uint32_t getMessageData() override {
 			return vector_;
 		}
 
+		int slot_ = -1;
+
 	private:
+		int cpu_;
 		unsigned int vector_;
 	};
 }
 
-MsiPin *allocateApicMsi(frg::string<KernelAlloc> name) {
-	auto guard = frg::guard(&globalIrqSlotsLock);
-
-	int slotIndex = -1;
-	for(int i = 0; i < 64; i++) {
-		if(!globalIrqSlots[i]->isAvailable())
-			continue;
-		slotIndex = i;
-		break;
+MsiPin *allocateApicMsi(frg::string<KernelAlloc> name, int cpu) {
+	ApicMsiPin *pin;
+	int slotIndex;
+	int vector;
+	{
+		auto guard = frg::guard(&globalIrqSlotsLock);
+
+		if(cpu < 0)
+			cpu = pickIrqCpu();
+		if(!canTargetCpu(cpu))
+			cpu = 0;
+
+		vector = findFreeIrqVector(cpu);
+		if(vector < 0)
+			return nullptr;
+
+		// Create an IRQ pin for the MSI.
+		pin = frg::construct<ApicMsiPin>(*kernelAlloc,
+				std::move(name), cpu, vector);
+		slotIndex = allocateIrqSlot(pin);
+		if(slotIndex < 0) {
+			frg::destruct(*kernelAlloc, pin);
+			return nullptr;
+		}
+		pin->slot_ = slotIndex;
+		bindIrqVector(cpu, vector, slotIndex);
 	}
-	if(slotIndex == -1)
-		return nullptr;
 
-	// Create an IRQ pin for the MSI.
-	auto pin = frg::construct<ApicMsiPin>(*kernelAlloc,
-			std::move(name), 64 + slotIndex);
+	// This needs to be done without holding globalIrqSlotsLock.
 	pin->configure(IrqConfiguration{
 		.trigger = TriggerMode::edge,
 		.polarity = Polarity::high
 	});
 
 	infoLogger() << "thor: Allocating IRQ slot " << slotIndex
+			<< " (vector " << vector << " on CPU #" << cpu << ")"
 			<< " to " << pin->name() << frg::endlog;
-	globalIrqSlots[slotIndex]->link(pin);
 
 	return pin;
 }
@@ -620,10 +770,16 @@ namespace {
 			void mask() override;
 			void unmask() override;
 			void sendEoi() override;
+			int affinity() override;
+			Error retarget(int cpu) override;
 
 		private:
+			void _storeEntry(bool masked);
+
 			IoApic *_chip;
 			unsigned int _index;
+			int _slot = -1;
+			int _cpu = 0;
 			int _vector = -1;
 
 			// The following variables store the current pin configuration.
@@ -709,31 +865,59 @@ namespace {
 			_activeLow = true;
 		}
 
-		// Allocate an IRQ vector for the I/O APIC pin.
+		// Allocate an IRQ slot and a vector (on the BSP) for the I/O APIC pin.
 		if(_vector == -1) {
 			auto guard = frg::guard(&globalIrqSlotsLock);
 
-			for(int i = 0; i < 64; i++) {
-				if(!globalIrqSlots[i]->isAvailable())
-					continue;
-				infoLogger() << "thor: Allocating IRQ slot " << i
-						<< " to " << name() << frg::endlog;
-				globalIrqSlots[i]->link(this);
-				_vector = 64 + i;
-				break;
-			}
+			_slot = allocateIrqSlot(this);
+			_vector = findFreeIrqVector(_cpu);
+			if(_slot == -1 || _vector == -1)
+				panicLogger() << "thor: Could not allocate interrupt vector for "
+						<< name() << frg::endlog;
+			bindIrqVector(_cpu, _vector, _slot);
+			infoLogger() << "thor: Allocating IRQ slot " << _slot
+					<< " (vector " << _vector << ")"
+					<< " to " << name() << frg::endlog;
 		}
-		if(_vector == -1)
-			panicLogger() << "thor: Could not allocate interrupt vector for "
-					<< name() << frg::endlog;
 
+		_storeEntry(false);
+		return strategy;
+	}
+
+	void IoApic::Pin::_storeEntry(bool masked) {
 		_chip->_storeRegister(kIoApicInts + _index * 2 + 1,
-				static_cast<uint32_t>(pin_word2::destination(0)));
+				static_cast<uint32_t>(pin_word2::destination(getCpuData(_cpu)->localApicId)));
 		_chip->_storeRegister(kIoApicInts + _index * 2,
 				static_cast<uint32_t>(pin_word1::vector(_vector)
 				| pin_word1::deliveryMode(0) | pin_word1::levelTriggered(_levelTriggered)
-				| pin_word1::activeLow(_activeLow)));
-		return strategy;
+				| pin_word1::activeLow(_activeLow) | pin_word1::masked(masked)));
+	}
+
+	int IoApic::Pin::affinity() {
+		return _cpu;
+	}
+
+	Error IoApic::Pin::retarget(int cpu) {
+		if(cpu == _cpu)
+			return Error::success;
+		if(!canTargetCpu(cpu))
+			return Error::noHardwareSupport;
+
+		auto guard = frg::guard(&globalIrqSlotsLock);
+
+		int vector = findFreeIrqVector(cpu);
+		if(vector < 0)
+			return Error::noMemory;
+		bindIrqVector(cpu, vector, _slot);
+
+		// Preserve the current mask state of the pin.
+		arch::bit_value<uint32_t> word1{_chip->_loadRegister(kIoApicInts + _index * 2)};
+		int oldCpu = std::exchange(_cpu, cpu);
+		int oldVector = std::exchange(_vector, vector);
+		_storeEntry(word1 & pin_word1::masked);
+		// IRQs that are already in flight can still arrive at the old vector.
+		retireIrqVector(oldCpu, oldVector);
+		return Error::success;
 	}
 
 	void IoApic::Pin::mask() {
@@ -403,8 +403,10 @@ struct Executor {
 
 	Word *arg0() { return &general()->rsi; }
 	Word *arg1() { return &general()->rdx; }
+	Word *arg2() { return &general()->rax; }
 	Word *result0() { return &general()->rdi; }
 	Word *result1() { return &general()->rsi; }
+	Word *result2() { return &general()->rdx; }
 
 private:
 	// note: this struct is accessed from assembly.
@@ -591,6 +593,13 @@ struct PlatformCpuData : public AssemblyCpuData {
 
 	LocalApicContext apicContext;
 
+	// Maps IRQ vectors (relative to vector 64) to global IRQ slots (or -1 if unused).
+	// Protected by globalIrqSlotsLock.
+	int irqVectorSlots[64];
+	// Vectors that are no longer used by their IRQ stay bound to its slot until this time
+	// (in nanoseconds; or 0 if the vector is in use). Protected by globalIrqSlotsLock.
+	uint64_t irqVectorReleaseDeadlines[64];
+
 	// TODO: This is not really arch-specific!
 	smarter::borrowed_ptr<Thread> activeExecutor;
 };
@@ -126,7 +126,8 @@ void sendGlobalNmi();
 // MSI management
 // --------------------------------------------------------
 
-MsiPin *allocateApicMsi(frg::string<KernelAlloc> name);
+// Allocates an MSI that targets the given CPU (or a CPU with free vectors if cpu is -1).
+MsiPin *allocateApicMsi(frg::string<KernelAlloc> name, int cpu = -1);
 
 // --------------------------------------------------------
 // I/O APIC management
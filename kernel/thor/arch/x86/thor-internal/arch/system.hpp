@@ -2,7 +2,8 @@
 
 namespace thor {
 
-static inline constexpr int numIrqSlots = 64;
+// IRQ slots are global while IRQ vectors are per-CPU (see irqVectorSlots).
+static inline constexpr int numIrqSlots = 256;
 
 void initializeArchitecture();
 
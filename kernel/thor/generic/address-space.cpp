@@ -229,6 +229,9 @@ void Mapping::tie(smarter::shared_ptr<VirtualSpace> newOwner, VirtualAddr addres
 }
 
 void Mapping::protect(MappingFlags protectFlags) {
+	if(flags & MappingFlags::fixedProtection)
+		return;
+
 	std::underlying_type_t<MappingFlags> newFlags = flags;
 	newFlags &= ~(MappingFlags::protRead | MappingFlags::protWrite | MappingFlags::protExecute);
 	newFlags |= protectFlags;
@@ -461,6 +464,8 @@ VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
 
 		if(flags & kMapDontRequireBacking)
 			mappingFlags |= MappingFlags::dontRequireBacking;
+		if(flags & kMapFixedProtection)
+			mappingFlags |= MappingFlags::fixedProtection;
 
 		mapping = smarter::allocate_shared<Mapping>(Allocator{},
 				length, static_cast<MappingFlags>(mappingFlags),
@@ -711,6 +716,49 @@ VirtualSpace::retrievePhysical(VirtualAddr address, smarter::shared_ptr<WorkQueu
 	}
 }
 
+coroutine<frg::expected<Error, MemoryViewLockHandle>>
+VirtualSpace::lockPhysical(VirtualAddr address, size_t length,
+		frg::vector<PhysicalAddr, KernelAlloc> &physicals,
+		smarter::shared_ptr<WorkQueue> wq) {
+	assert(!(address & (kPageSize - 1)));
+	assert(!(length & (kPageSize - 1)));
+
+	// We do not take _consistencyMutex here since we are only interested in a snapshot.
+
+	smarter::shared_ptr<Mapping> mapping;
+	{
+		auto irq_lock = frg::guard(&irqMutex());
+		auto space_guard = frg::guard(&_snapshotMutex);
+
+		mapping = _findMapping(address);
+	}
+	if(!mapping)
+		co_return Error::fault;
+	auto offset = address - mapping->address;
+	if(length > mapping->length - offset)
+		co_return Error::fault;
+
+	MemoryViewLockHandle lockHandle{mapping->view, mapping->viewOffset + offset, length};
+	co_await lockHandle.acquire(wq);
+	if(!lockHandle)
+		co_return Error::fault;
+
+	FetchFlags fetchFlags = 0;
+	if(mapping->flags & MappingFlags::dontRequireBacking)
+		fetchFlags |= fetchDisallowBacking;
+	FRG_CO_TRY(co_await mapping->view->touchRange(mapping->viewOffset + offset, length,
+			fetchFlags, wq));
+
+	for(size_t progress = 0; progress < length; progress += kPageSize) {
+		auto physicalRange = mapping->view->peekRange(mapping->viewOffset + offset + progress);
+		// Since we have locked the MemoryView, touchRange() made the page available for good.
+		assert(physicalRange.get<0>() != PhysicalAddr(-1));
+		physicals.push_back(physicalRange.get<0>());
+	}
+
+	co_return std::move(lockHandle);
+}
+
 smarter::shared_ptr<Mapping> VirtualSpace::_findMapping(VirtualAddr address) {
 	auto current = _mappings.get_root();
 	while(current) {
@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include <thor-internal/clock-page.hpp>
+#include <thor-internal/physical.hpp>
+
+namespace thor {
+
+namespace {
+	frg::manual_box<PageAccessor> clockPageAccessor;
+	frg::manual_box<smarter::shared_ptr<MemorySlice>> clockPageSlice;
+	bool clockPageAllocated = false;
+
+	HelClockPage *accessClockPage() {
+		return reinterpret_cast<HelClockPage *>(clockPageAccessor->get());
+	}
+}
+
+void publishClockPage(uint32_t flags, uint64_t multiplier) {
+	if(!clockPageAllocated) {
+		auto physical = physicalAllocator->allocate(kPageSize);
+		assert(physical != PhysicalAddr(-1) && "OOM when allocating the clock page");
+		clockPageAccessor.initialize(physical);
+		memset(clockPageAccessor->get(), 0, kPageSize);
+
+		auto memory = smarter::allocate_shared<HardwareMemory>(*kernelAlloc,
+				physical, kPageSize, CachingMode::null);
+		clockPageSlice.initialize(smarter::allocate_shared<MemorySlice>(*kernelAlloc,
+				std::move(memory), 0, kPageSize));
+		clockPageAllocated = true;
+	}
+
+	// Seqlock write. The counter becomes odd while the page is updated.
+	auto page = accessClockPage();
+	auto seq = __atomic_load_n(&page->seqlock, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->seqlock, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&page->flags, flags, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->refCounter, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->refNanos, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->multiplier, multiplier, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->shift, clockShift, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&page->seqlock, seq + 2, __ATOMIC_RELEASE);
+}
+
+coroutine<void> mapClockPage(smarter::shared_ptr<AddressSpace, BindableHandle> space) {
+	assert(clockPageAllocated);
+
+	auto outcome = co_await space->map(*clockPageSlice, kHelClockPageAddress, 0, kPageSize,
+			AddressSpace::kMapFixed | AddressSpace::kMapProtRead
+				| AddressSpace::kMapFixedProtection);
+	assert(outcome);
+}
+
+} // namespace thor
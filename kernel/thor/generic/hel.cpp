@@ -6,6 +6,7 @@
 #include <frg/container_of.hpp>
 #include <frg/dyn_array.hpp>
 #include <frg/small_vector.hpp>
+#include <thor-internal/clock-page.hpp>
 #include <thor-internal/event.hpp>
 #include <thor-internal/coroutine.hpp>
 #include <thor-internal/io.hpp>
@@ -110,6 +111,7 @@ HelError translateError(Error error) {
 	case Error::bufferTooSmall: return kHelErrBufferTooSmall;
 	case Error::fault: return kHelErrFault;
 	case Error::remoteFault: return kHelErrRemoteFault;
+	case Error::futexRace: return kHelErrFutexRace;
 	default:
 		assert(!"Unexpected error");
 		__builtin_unreachable();
@@ -144,18 +146,12 @@ HelError helSubmitAsyncNop(HelHandle queueHandle, uintptr_t context) {
 	auto thisThread = getCurrentThread();
 	auto thisUniverse = thisThread->getUniverse();
 
-	smarter::shared_ptr<IpcQueue> queue;
-	{
-		auto irqLock = frg::guard(&irqMutex());
-		Universe::Guard universeGuard(thisUniverse->lock);
-
-		auto queueWrapper = thisUniverse->getDescriptor(universeGuard, queueHandle);
-		if(!queueWrapper)
-			return kHelErrNoDescriptor;
-		if(!queueWrapper->is<QueueDescriptor>())
-			return kHelErrBadDescriptor;
-		queue = queueWrapper->get<QueueDescriptor>().queue;
-	}
+	auto queueWrapper = thisUniverse->fetchDescriptor(queueHandle);
+	if(!queueWrapper)
+		return kHelErrNoDescriptor;
+	if(!queueWrapper->is<QueueDescriptor>())
+		return kHelErrBadDescriptor;
+	auto queue = std::move(queueWrapper->get<QueueDescriptor>().queue);
 
 	[] (smarter::shared_ptr<IpcQueue> queue, uintptr_t context,
 			enable_detached_coroutine = {}) -> void {
@@ -247,23 +243,18 @@ HelError helGetCredentials(HelHandle handle, uint32_t flags, char *credentials)
 	assert(!flags);
 
 	smarter::shared_ptr<Credentials> creds;
-	{
-		auto irqLock = frg::guard(&irqMutex());
-		Universe::Guard universe_guard(thisUniverse->lock);
-
-		if(handle == kHelThisThread) {
-			creds = thisThread.lock();
-		}else{
-			auto wrapper = thisUniverse->getDescriptor(universe_guard, handle);
-			if(!wrapper)
-				return kHelErrNoDescriptor;
-			if(wrapper->is<ThreadDescriptor>())
-				creds = remove_tag_cast(wrapper->get<ThreadDescriptor>().thread);
-			else if(wrapper->is<LaneDescriptor>())
-				creds = wrapper->get<LaneDescriptor>().handle.getStream().lock();
-			else
-				return kHelErrBadDescriptor;
-		}
+	if(handle == kHelThisThread) {
+		creds = thisThread.lock();
+	}else{
+		auto wrapper = thisUniverse->fetchDescriptor(handle);
+		if(!wrapper)
+			return kHelErrNoDescriptor;
+		if(wrapper->is<ThreadDescriptor>())
+			creds = remove_tag_cast(wrapper->get<ThreadDescriptor>().thread);
+		else if(wrapper->is<LaneDescriptor>())
+			creds = wrapper->get<LaneDescriptor>().handle.getStream().lock();
+		else
+			return kHelErrBadDescriptor;
 	}
 
 	if(!writeUserMemory(credentials, creds->credentials(), 16))
@@ -335,18 +326,12 @@ HelError helCancelAsync(HelHandle handle, uint64_t async_id) {
 	auto this_thread = getCurrentThread();
 	auto this_universe = this_thread->getUniverse();
 
-	smarter::shared_ptr<IpcQueue> queue;
-	{
-		auto irq_lock = frg::guard(&irqMutex());
-		Universe::Guard universe_guard(this_universe->lock);
-
-		auto queue_wrapper = this_universe->getDescriptor(universe_guard, handle);
-		if(!queue_wrapper)
-			return kHelErrNoDescriptor;
-		if(!queue_wrapper->is<QueueDescriptor>())
-			return kHelErrBadDescriptor;
-		queue = queue_wrapper->get<QueueDescriptor>().queue;
-	}
+	auto queue_wrapper = this_universe->fetchDescriptor(handle);
+	if(!queue_wrapper)
+		return kHelErrNoDescriptor;
+	if(!queue_wrapper->is<QueueDescriptor>())
+		return kHelErrBadDescriptor;
+	auto queue = std::move(queue_wrapper->get<QueueDescriptor>().queue);
 
 	queue->cancel(async_id);
 
@@ -641,6 +626,7 @@ HelError helCreateSpace(HelHandle *handle) {
 	auto this_universe = this_thread->getUniverse();
 
 	auto space = AddressSpace::create();
+	Thread::asyncBlockCurrent(mapClockPage(space));
 
 	auto irq_lock = frg::guard(&irqMutex());
 	Universe::Guard universe_guard(this_universe->lock);
@@ -850,6 +836,117 @@ HelError helMapMemory(HelHandle memory_handle, HelHandle space_handle,
 	return kHelErrNone;
 }
 
+HelError helForkSpace(HelHandle spaceHandle, HelForkItem *itemsPtr, size_t numItems) {
+	// Bound the size of the kernel-side copy of the items.
+	if(!numItems || numItems > kHelMaxForkItems)
+		return kHelErrIllegalArgs;
+
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+
+	struct Item {
+		HelForkItem recipe;
+		smarter::shared_ptr<MemoryView> view;
+		smarter::shared_ptr<MemoryView> forkedView;
+	};
+
+	frg::dyn_array<Item, KernelAlloc> items{numItems, *kernelAlloc};
+	for(size_t i = 0; i < numItems; i++) {
+		auto &recipe = items[i].recipe;
+		if(!readUserObject(itemsPtr + i, recipe))
+			return kHelErrFault;
+		if(!recipe.size)
+			return kHelErrIllegalArgs;
+		if(!recipe.pointer)
+			return kHelErrIllegalArgs;
+		if((uintptr_t)recipe.pointer % kPageSize
+				|| recipe.offset % kPageSize
+				|| recipe.size % kPageSize)
+			return kHelErrIllegalArgs;
+		if(recipe.forkFlags & ~uint32_t{kHelForkCopyOnWrite})
+			return kHelErrIllegalArgs;
+	}
+
+	// Resolve all descriptors while taking the universe lock only once.
+	smarter::shared_ptr<AddressSpace, BindableHandle> space;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		auto spaceWrapper = thisUniverse->getDescriptor(universeGuard, spaceHandle);
+		if(!spaceWrapper)
+			return kHelErrNoDescriptor;
+		if(!spaceWrapper->is<AddressSpaceDescriptor>())
+			return kHelErrBadDescriptor;
+		space = spaceWrapper->get<AddressSpaceDescriptor>().space;
+
+		for(auto &item : items) {
+			auto memoryWrapper = thisUniverse->getDescriptor(universeGuard,
+					item.recipe.memory);
+			if(!memoryWrapper)
+				return kHelErrNoDescriptor;
+			if(!memoryWrapper->is<MemoryViewDescriptor>())
+				return kHelErrBadDescriptor;
+			item.view = memoryWrapper->get<MemoryViewDescriptor>().memory;
+		}
+	}
+
+	for(auto &item : items) {
+		auto memory = item.view;
+		if(item.recipe.forkFlags & kHelForkCopyOnWrite) {
+			auto [error, forkedView] = Thread::asyncBlockCurrent(item.view->fork());
+			if(error == Error::illegalObject)
+				return kHelErrUnsupportedOperation;
+			assert(error == Error::success);
+			item.forkedView = forkedView;
+			memory = std::move(forkedView);
+		}
+
+		uint32_t mapFlags = AddressSpace::kMapFixed;
+		if(item.recipe.mapFlags & kHelMapProtRead)
+			mapFlags |= AddressSpace::kMapProtRead;
+		if(item.recipe.mapFlags & kHelMapProtWrite)
+			mapFlags |= AddressSpace::kMapProtWrite;
+		if(item.recipe.mapFlags & kHelMapProtExecute)
+			mapFlags |= AddressSpace::kMapProtExecute;
+		if(item.recipe.mapFlags & kHelMapDontRequireBacking)
+			mapFlags |= AddressSpace::kMapDontRequireBacking;
+
+		auto sliceLength = memory->getLength();
+		auto slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
+				std::move(memory), 0, sliceLength);
+
+		auto mapResult = Thread::asyncBlockCurrent(space->map(std::move(slice),
+				(VirtualAddr)item.recipe.pointer, item.recipe.offset, item.recipe.size,
+				mapFlags));
+		if(!mapResult) {
+			assert(mapResult.error() == Error::bufferTooSmall);
+			return kHelErrBufferTooSmall;
+		}
+	}
+
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		for(auto &item : items) {
+			if(!item.forkedView) {
+				item.recipe.forkedHandle = kHelNullHandle;
+				continue;
+			}
+			item.recipe.forkedHandle = thisUniverse->attachDescriptor(universeGuard,
+					MemoryViewDescriptor(std::move(item.forkedView)));
+		}
+	}
+
+	for(size_t i = 0; i < numItems; i++) {
+		if(!writeUserObject(&itemsPtr[i].forkedHandle, items[i].recipe.forkedHandle))
+			return kHelErrFault;
+	}
+
+	return kHelErrNone;
+}
+
 HelError helSubmitProtectMemory(HelHandle space_handle,
 		void *pointer, size_t length, uint32_t flags,
 		HelHandle queue_handle, uintptr_t context) {
@@ -1005,6 +1102,70 @@ HelError helPointerPhysical(const void *pointer, uintptr_t *physical) {
 	return kHelErrNone;
 }
 
+HelError helLockPhysical(const void *pointer, size_t length,
+		HelPhysicalSegment *segments, size_t *numSegments, HelHandle *handle) {
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+	auto space = thisThread->getAddressSpace().lock();
+
+	auto address = reinterpret_cast<VirtualAddr>(pointer);
+	if(!length || address + length < address)
+		return kHelErrIllegalArgs;
+
+	size_t capacity;
+	if(!readUserObject(numSegments, capacity))
+		return kHelErrFault;
+
+	auto misalign = address & (kPageSize - 1);
+	auto alignedAddress = address - misalign;
+	auto alignedLength = (misalign + length + kPageSize - 1) & ~(kPageSize - 1);
+
+	frg::vector<PhysicalAddr, KernelAlloc> physicals{*kernelAlloc};
+	auto lockOrError = Thread::asyncBlockCurrent(space->lockPhysical(alignedAddress, alignedLength,
+			physicals, thisThread->mainWorkQueue()->take()));
+	if(!lockOrError) {
+		assert(lockOrError.error() == Error::fault);
+		return kHelErrFault;
+	}
+
+	// Merge physically contiguous pages into segments.
+	frg::vector<HelPhysicalSegment, KernelAlloc> merged{*kernelAlloc};
+	for(size_t i = 0; i < physicals.size(); i++) {
+		auto physical = physicals[i];
+		size_t chunk = kPageSize;
+		if(!i) {
+			physical += misalign;
+			chunk -= misalign;
+		}
+		chunk = frg::min(chunk, length - (i ? i * kPageSize - misalign : 0));
+
+		if(merged.size() && merged.back().physical + merged.back().length == physical) {
+			merged.back().length += chunk;
+		}else{
+			merged.push_back(HelPhysicalSegment{physical, chunk});
+		}
+	}
+
+	if(!writeUserObject(numSegments, merged.size()))
+		return kHelErrFault;
+	if(merged.size() > capacity)
+		return kHelErrBufferTooSmall;
+	if(!writeUserArray(segments, merged.data(), merged.size()))
+		return kHelErrFault;
+
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		*handle = thisUniverse->attachDescriptor(universeGuard,
+				MemoryViewLockDescriptor{
+					smarter::allocate_shared<NamedMemoryViewLock>(
+						*kernelAlloc, std::move(lockOrError.value()))});
+	}
+
+	return kHelErrNone;
+}
+
 HelError helSubmitReadMemory(HelHandle handle, uintptr_t address,
 		size_t length, void *buffer,
 		HelHandle queueHandle, uintptr_t context) {
@@ -1696,7 +1857,7 @@ HelError helSubmitObserve(HelHandle handle, uint64_t inSeq,
 			enable_detached_coroutine = {}) -> void {
 		auto [error, sequence, interrupt] = co_await thread->observe(inSeq);
 
-		HelObserveResult helResult{translateError(error), 0, sequence};
+		HelObserveResult helResult{translateError(error), 0, sequence, {}};
 		if(interrupt == kIntrNull) {
 			helResult.observation = kHelObserveNull;
 		}else if(interrupt == kIntrRequested) {
@@ -1713,6 +1874,11 @@ HelError helSubmitObserve(HelHandle handle, uint64_t inSeq,
 			helResult.observation = kHelObserveIllegalInstruction;
 		}else if(interrupt >= kIntrSuperCall) {
 			helResult.observation = kHelObserveSuperCall + (interrupt - kIntrSuperCall);
+			// Pass the arguments inline such that the observer does not need
+			// to call helLoadRegisters() for simple supercalls.
+			helResult.args[0] = *thread->_executor.arg0();
+			helResult.args[1] = *thread->_executor.arg1();
+			helResult.args[2] = *thread->_executor.arg2();
 		}else{
 			thor::panicLogger() << "Unexpected interrupt" << frg::endlog;
 			__builtin_unreachable();
@@ -1794,6 +1960,28 @@ HelError helResume(HelHandle handle) {
 	return kHelErrNone;
 }
 
+HelError helCompleteSuperCall(HelHandle handle, HelError error,
+		uintptr_t out0, uintptr_t out1) {
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+
+	auto threadWrapper = thisUniverse->fetchDescriptor(handle);
+	if(!threadWrapper)
+		return kHelErrNoDescriptor;
+	if(!threadWrapper->is<ThreadDescriptor>())
+		return kHelErrBadDescriptor;
+	auto thread = remove_tag_cast(threadWrapper->get<ThreadDescriptor>().thread);
+
+	if(auto e = Thread::resumeOther(thread, error, out0, out1); e != Error::success) {
+		if(e == Error::threadExited)
+			return kHelErrThreadTerminated;
+		assert(e == Error::illegalState);
+		return kHelErrIllegalState;
+	}
+
+	return kHelErrNone;
+}
+
 HelError helLoadRegisters(HelHandle handle, int set, void *image) {
 	auto this_thread = getCurrentThread();
 	auto this_universe = this_thread->getUniverse();
@@ -2090,18 +2278,12 @@ HelError helSubmitAwaitClock(uint64_t counter, HelHandle queue_handle, uintptr_t
 	auto this_thread = getCurrentThread();
 	auto this_universe = this_thread->getUniverse();
 
-	smarter::shared_ptr<IpcQueue> queue;
-	{
-		auto irq_lock = frg::guard(&irqMutex());
-		Universe::Guard universe_guard(this_universe->lock);
-
-		auto queue_wrapper = this_universe->getDescriptor(universe_guard, queue_handle);
-		if(!queue_wrapper)
-			return kHelErrNoDescriptor;
-		if(!queue_wrapper->is<QueueDescriptor>())
-			return kHelErrBadDescriptor;
-		queue = queue_wrapper->get<QueueDescriptor>().queue;
-	}
+	auto queue_wrapper = this_universe->fetchDescriptor(queue_handle);
+	if(!queue_wrapper)
+		return kHelErrNoDescriptor;
+	if(!queue_wrapper->is<QueueDescriptor>())
+		return kHelErrBadDescriptor;
+	auto queue = std::move(queue_wrapper->get<QueueDescriptor>().queue);
 
 	if(!queue->validSize(ipcSourceSize(sizeof(HelSimpleResult))))
 		return kHelErrQueueTooSmall;
@@ -2139,33 +2321,26 @@ HelError helSubmitAsync(HelHandle handle, const HelAction *actions, size_t count
 	auto thisThread = getCurrentThread();
 	auto thisUniverse = thisThread->getUniverse();
 
-	LaneHandle lane;
-	smarter::shared_ptr<IpcQueue> queue;
-	{
-		auto irq_lock = frg::guard(&irqMutex());
-		Universe::Guard universe_guard(thisUniverse->lock);
-
-		auto wrapper = thisUniverse->getDescriptor(universe_guard, handle);
-		if(!wrapper)
-			return kHelErrNoDescriptor;
-		if(wrapper->is<LaneDescriptor>()) {
-			lane = wrapper->get<LaneDescriptor>().handle;
-		}else{
-			return kHelErrBadDescriptor;
-		}
+	auto wrapper = thisUniverse->fetchDescriptor(handle);
+	if(!wrapper)
+		return kHelErrNoDescriptor;
+	if(!wrapper->is<LaneDescriptor>())
+		return kHelErrBadDescriptor;
+	auto lane = std::move(wrapper->get<LaneDescriptor>().handle);
 
-		auto queueWrapper = thisUniverse->getDescriptor(universe_guard, queueHandle);
-		if(!queueWrapper)
-			return kHelErrNoDescriptor;
-		if(!queueWrapper->is<QueueDescriptor>())
-			return kHelErrBadDescriptor;
-		queue = queueWrapper->get<QueueDescriptor>().queue;
-	}
+	auto queueWrapper = thisUniverse->fetchDescriptor(queueHandle);
+	if(!queueWrapper)
+		return kHelErrNoDescriptor;
+	if(!queueWrapper->is<QueueDescriptor>())
+		return kHelErrBadDescriptor;
+	auto queue = std::move(queueWrapper->get<QueueDescriptor>().queue);
 
 	struct Item {
 		HelAction recipe;
 		size_t link;
 		StreamNode transmit;
+		// Only used by kHelActionSendFromMemory.
+		smarter::shared_ptr<MemoryView> view;
 		QueueSource mainSource;
 		QueueSource dataSource;
 		union {
@@ -2279,6 +2454,29 @@ HelError helSubmitAsync(HelHandle handle, const HelAction *actions, size_t count
 				ipcSize += ipcSourceSize(sizeof(HelSimpleResult));
 				break;
 			}
+			case kHelActionSendFromMemory: {
+				auto wrapper = thisUniverse->fetchDescriptor(recipe->handle);
+				if(!wrapper)
+					return kHelErrNoDescriptor;
+				if(!wrapper->is<MemoryViewDescriptor>())
+					return kHelErrBadDescriptor;
+				auto view = std::move(wrapper->get<MemoryViewDescriptor>().memory);
+
+				auto offset = reinterpret_cast<uintptr_t>(recipe->buffer);
+				uintptr_t limit;
+				if(__builtin_add_overflow(offset, recipe->length, &limit)
+						|| limit > view->getLength())
+					return kHelErrIllegalArgs;
+
+				// Copying from the view can block on page-ins,
+				// hence we always use the flow protocol (even for small buffers).
+				node->_tag = kTagSendFlow;
+				node->_maxLength = recipe->length;
+				items[i].view = std::move(view);
+				++numFlows;
+				ipcSize += ipcSourceSize(sizeof(HelSimpleResult));
+				break;
+			}
 			case kHelActionRecvInline:
 				// TODO: For now, we hardcode a size of 128 bytes.
 				node->_tag = kTagRecvKernelBuffer;
@@ -2404,7 +2602,8 @@ HelError helSubmitAsync(HelHandle handle, const HelAction *actions, size_t count
 							sizeof(HelCredentialsResult));
 					link(&item->mainSource);
 				}else if(recipe->type == kHelActionSendFromBuffer
-						|| recipe->type == kHelActionSendFromBufferSg) {
+						|| recipe->type == kHelActionSendFromBufferSg
+						|| recipe->type == kHelActionSendFromMemory) {
 					item->helSimpleResult = {translateError(node->error()), 0};
 					item->mainSource.setup(&item->helSimpleResult, sizeof(HelSimpleResult));
 					link(&item->mainSource);
@@ -2544,7 +2743,27 @@ HelError helSubmitAsync(HelHandle handle, const HelAction *actions, size_t count
 				peer->_transmitBuffer = std::move(buffer);
 				peer->complete();
 				node->complete();
-			}else if(recipe->type == kHelActionSendFromBuffer
+			}else if(recipe->type == kHelActionSendFromMemory
+					&& peer->tag() == kTagRecvKernelBuffer) {
+				frg::unique_memory<KernelAlloc> buffer(*kernelAlloc, recipe->length);
+
+				auto outcome = co_await item->view->copyFrom(
+						reinterpret_cast<uintptr_t>(recipe->buffer),
+						buffer.data(), recipe->length, thread->mainWorkQueue()->take());
+				if(!outcome) {
+					peer->_error = Error::success;
+					node->_error = outcome.error();
+					peer->complete();
+					node->complete();
+					continue;
+				}
+
+				// Both nodes complete successfully.
+				peer->_transmitBuffer = std::move(buffer);
+				peer->complete();
+				node->complete();
+			}else if((recipe->type == kHelActionSendFromBuffer
+						|| recipe->type == kHelActionSendFromMemory)
 					&& node->tag() == kTagSendFlow
 					&& peer->tag() == kTagRecvFlow) {
 				// Empty packets are handled by the generic stream code.
@@ -2605,9 +2824,19 @@ HelError helSubmitAsync(HelHandle handle, const HelAction *actions, size_t count
 					auto chunkSize = frg::min(recipe->length - progress, xb.size());
 					assert(chunkSize);
 
-					co_await thread->mainWorkQueue()->enter();
-					auto outcome = readUserMemory(xb.data(),
-							reinterpret_cast<std::byte *>(recipe->buffer) + progress, chunkSize);
+					bool outcome;
+					if(recipe->type == kHelActionSendFromMemory) {
+						// Copy straight out of the view's pages; the sender's address space
+						// is not involved at all.
+						auto copyOutcome = co_await item->view->copyFrom(
+								reinterpret_cast<uintptr_t>(recipe->buffer) + progress,
+								xb.data(), chunkSize, thread->mainWorkQueue()->take());
+						outcome = static_cast<bool>(copyOutcome);
+					}else{
+						co_await thread->mainWorkQueue()->enter();
+						outcome = readUserMemory(xb.data(),
+								reinterpret_cast<std::byte *>(recipe->buffer) + progress, chunkSize);
+					}
 					if(!outcome) {
 						// Send the packet (may deallocate the peer!).
 						peer->flowQueue.put({ .terminate = true, .fault = true });
@@ -2749,6 +2978,13 @@ HelError helShutdownLane(HelHandle handle) {
 }
 
 HelError helFutexWait(int *pointer, int expected, int64_t deadline) {
+	return helFutexWaitBitset(pointer, expected, deadline, FutexRealm::anyBitset);
+}
+
+HelError helFutexWaitBitset(int *pointer, int expected, int64_t deadline, uint32_t bitset) {
+	if(!bitset)
+		return kHelErrIllegalArgs;
+
 	auto thisThread = getCurrentThread();
 	auto space = thisThread->getAddressSpace();
 
@@ -2764,14 +3000,14 @@ HelError helFutexWait(int *pointer, int expected, int64_t deadline) {
 			return kHelErrIllegalArgs;
 
 		Thread::asyncBlockCurrent(
-			getGlobalFutexRealm()->wait(std::move(futex), expected)
+			getGlobalFutexRealm()->wait(std::move(futex), expected, {}, bitset)
 		);
 	}else{
 		Thread::asyncBlockCurrent(
 			async::race_and_cancel(
 				[&] (async::cancellation_token cancellation) {
 					return getGlobalFutexRealm()->wait(std::move(futex), expected,
-							cancellation);
+							cancellation, bitset);
 				},
 				[&] (async::cancellation_token cancellation) {
 					return generalTimerEngine()->sleep(deadline, cancellation);
@@ -2795,6 +3031,61 @@ HelError helFutexWake(int *pointer) {
 	return kHelErrNone;
 }
 
+HelError helFutexWakeBitset(int *pointer, int count, uint32_t bitset, int *woken) {
+	if(!bitset)
+		return kHelErrIllegalArgs;
+
+	auto thisThread = getCurrentThread();
+	auto space = thisThread->getAddressSpace();
+
+	auto identityOrError = space->resolveGlobalFutex(reinterpret_cast<uintptr_t>(pointer));
+	if(!identityOrError)
+		return kHelErrFault;
+	*woken = getGlobalFutexRealm()->wake(identityOrError.value(),
+			count < 0 ? SIZE_MAX : count, bitset);
+
+	return kHelErrNone;
+}
+
+HelError helFutexRequeue(int *pointer, int *target, int expected,
+		int wakeCount, int requeueCount, uint32_t flags, int *affected) {
+	if(flags & ~kHelFutexCompare)
+		return kHelErrIllegalArgs;
+	if(wakeCount < 0)
+		return kHelErrIllegalArgs;
+
+	auto thisThread = getCurrentThread();
+	auto space = thisThread->getAddressSpace();
+
+	auto toOrError = space->resolveGlobalFutex(reinterpret_cast<uintptr_t>(target));
+	if(!toOrError)
+		return kHelErrFault;
+	size_t maxRequeue = requeueCount < 0 ? SIZE_MAX : requeueCount;
+
+	if(flags & kHelFutexCompare) {
+		// The futex needs to be pinned since it is read while the realm is locked.
+		auto futexOrError = Thread::asyncBlockCurrent(
+				space->grabGlobalFutex(reinterpret_cast<uintptr_t>(pointer),
+						thisThread->mainWorkQueue()->take()));
+		if(!futexOrError)
+			return kHelErrFault;
+
+		auto outcome = getGlobalFutexRealm()->compareRequeue(std::move(futexOrError.value()),
+				expected, toOrError.value(), wakeCount, maxRequeue);
+		if(!outcome)
+			return translateError(outcome.error());
+		*affected = outcome.value();
+	}else{
+		auto fromOrError = space->resolveGlobalFutex(reinterpret_cast<uintptr_t>(pointer));
+		if(!fromOrError)
+			return kHelErrFault;
+		*affected = getGlobalFutexRealm()->requeue(fromOrError.value(), toOrError.value(),
+				wakeCount, maxRequeue);
+	}
+
+	return kHelErrNone;
+}
+
 HelError helCreateOneshotEvent(HelHandle *handle) {
 	auto this_thread = getCurrentThread();
 	auto this_universe = this_thread->getUniverse();
@@ -2919,6 +3210,37 @@ HelError helAcknowledgeIrq(HelHandle handle, uint32_t flags, uint64_t sequence)
 	}
 }
 
+HelError helSetIrqAffinity(HelHandle handle, unsigned int cpu) {
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+
+	if(cpu >= static_cast<unsigned int>(getCpuCount()))
+		return kHelErrIllegalArgs;
+
+	auto irqWrapper = thisUniverse->fetchDescriptor(handle);
+	if(!irqWrapper)
+		return kHelErrNoDescriptor;
+	if(!irqWrapper->is<IrqDescriptor>())
+		return kHelErrBadDescriptor;
+	auto irq = std::move(irqWrapper->get<IrqDescriptor>().irq);
+
+	auto pin = irq->getPin();
+	if(!pin)
+		return kHelErrIllegalState;
+
+	auto error = pin->setAffinity(cpu);
+	if(error == Error::noHardwareSupport) {
+		return kHelErrNoHardwareSupport;
+	}else if(error == Error::noMemory) {
+		return kHelErrNoMemory;
+	}else if(error == Error::illegalState) {
+		return kHelErrIllegalState;
+	}else{
+		assert(error == Error::success);
+		return kHelErrNone;
+	}
+}
+
 HelError helSubmitAwaitEvent(HelHandle handle, uint64_t sequence,
 		HelHandle queue_handle, uintptr_t context) {
 	struct IrqClosure final : IpcNode {
@@ -2931,6 +3253,7 @@ HelError helSubmitAwaitEvent(HelHandle handle, uint64_t sequence,
 
 		static void awaited(Worklet *worklet) {
 			auto closure = frg::container_of(worklet, &IrqClosure::worklet);
+			closure->irqNode.traceWakeup();
 			closure->result.error = translateError(closure->irqNode.error());
 			closure->result.sequence = closure->irqNode.sequence();
 			closure->_queue->submit(closure);
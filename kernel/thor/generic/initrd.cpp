@@ -0,0 +1,233 @@
+#include <string.h>
+
+#include <thor-internal/debug.hpp>
+#include <thor-internal/module.hpp>
+#include <thor-internal/physical.hpp>
+
+namespace thor {
+
+namespace {
+	// Layout of compressed initrd files. The file is split into page-sized chunks that are
+	// compressed independently (as LZ4 blocks), such that pages can be decompressed on demand.
+	struct CompressedHeader {
+		char magic[4]; // "TLZ4"
+		uint32_t chunkSize;
+		uint64_t fileSize;
+		// Followed by (number of chunks + 1) offsets of type uint32_t,
+		// relative to the start of the file's data.
+	};
+
+	size_t uncompressedSize(const char *data, size_t dataSize, bool compressed) {
+		if(!compressed)
+			return dataSize;
+
+		CompressedHeader header;
+		assert(dataSize >= sizeof(CompressedHeader));
+		memcpy(&header, data, sizeof(CompressedHeader));
+		if(memcmp(header.magic, "TLZ4", 4) || header.chunkSize != kPageSize)
+			panicLogger() << "thor: Unsupported compressed initrd file" << frg::endlog;
+		return header.fileSize;
+	}
+
+	// Decompresses a single LZ4 block. Returns the number of decompressed bytes
+	// or -1 if the input is malformed.
+	ptrdiff_t decompressLz4Block(const uint8_t *src, size_t srcSize,
+			uint8_t *dst, size_t dstCapacity) {
+		auto ip = src;
+		auto ipEnd = src + srcSize;
+		auto op = dst;
+		auto opEnd = dst + dstCapacity;
+
+		auto readLength = [&] (size_t &length) -> bool {
+			uint8_t b;
+			do {
+				if(ip == ipEnd)
+					return false;
+				b = *ip++;
+				length += b;
+			} while(b == 255);
+			return true;
+		};
+
+		while(ip < ipEnd) {
+			auto token = *ip++;
+
+			// Copy the literals.
+			size_t numLiterals = token >> 4;
+			if(numLiterals == 15 && !readLength(numLiterals))
+				return -1;
+			if(numLiterals > static_cast<size_t>(ipEnd - ip)
+					|| numLiterals > static_cast<size_t>(opEnd - op))
+				return -1;
+			memcpy(op, ip, numLiterals);
+			ip += numLiterals;
+			op += numLiterals;
+
+			// The last sequence only consists of literals.
+			if(ip == ipEnd)
+				break;
+
+			// Copy the match. Source and destination may overlap.
+			if(ipEnd - ip < 2)
+				return -1;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if(!offset || offset > static_cast<size_t>(op - dst))
+				return -1;
+
+			size_t matchLength = (token & 0xF) + 4;
+			if((token & 0xF) == 15 && !readLength(matchLength))
+				return -1;
+			if(matchLength > static_cast<size_t>(opEnd - op))
+				return -1;
+			auto match = op - offset;
+			for(size_t i = 0; i < matchLength; i++)
+				op[i] = match[i];
+			op += matchLength;
+		}
+
+		return op - dst;
+	}
+}
+
+InitrdMemory::InitrdMemory(PhysicalAddr modulePhysical, const char *window,
+		size_t dataOffset, size_t dataSize, bool compressed)
+: _modulePhysical{modulePhysical}, _window{window}, _dataOffset{dataOffset},
+		_dataSize{dataSize}, _compressed{compressed},
+		_fileSize{uncompressedSize(window + dataOffset, dataSize, compressed)},
+		_length{(_fileSize + (kPageSize - 1)) & ~(kPageSize - 1)},
+		_pages{_length / kPageSize, *kernelAlloc} {
+	assert(!(modulePhysical % kPageSize));
+
+	if(_compressed)
+		_chunkTable = reinterpret_cast<const uint32_t *>(_window + _dataOffset
+				+ sizeof(CompressedHeader));
+	for(size_t i = 0; i < _pages.size(); i++)
+		_pages[i] = PhysicalAddr(-1);
+}
+
+InitrdMemory::~InitrdMemory() {
+	for(size_t i = 0; i < _pages.size(); i++) {
+		if(_pages[i] != PhysicalAddr(-1))
+			physicalAllocator->free(_pages[i], kPageSize);
+	}
+}
+
+PhysicalAddr InitrdMemory::_directPage(size_t index) {
+	if(_compressed)
+		return PhysicalAddr(-1);
+	auto moduleOffset = _dataOffset + index * kPageSize;
+	if(moduleOffset % kPageSize)
+		return PhysicalAddr(-1);
+	// The tail page would expose the following bytes of the module.
+	if((index + 1) * kPageSize > _fileSize)
+		return PhysicalAddr(-1);
+	return _modulePhysical + moduleOffset;
+}
+
+void InitrdMemory::_materialize(size_t index, void *page) {
+	auto pageOffset = index * kPageSize;
+	auto chunkSize = frg::min(kPageSize, _fileSize - pageOffset);
+
+	if(_compressed) {
+		uint32_t begin, end;
+		memcpy(&begin, &_chunkTable[index], sizeof(uint32_t));
+		memcpy(&end, &_chunkTable[index + 1], sizeof(uint32_t));
+		if(begin > end || end > _dataSize)
+			panicLogger() << "thor: Corrupted compressed initrd file" << frg::endlog;
+
+		auto n = decompressLz4Block(
+				reinterpret_cast<const uint8_t *>(_window + _dataOffset + begin), end - begin,
+				static_cast<uint8_t *>(page), kPageSize);
+		if(n != static_cast<ptrdiff_t>(chunkSize))
+			panicLogger() << "thor: Corrupted compressed initrd file" << frg::endlog;
+	}else{
+		memcpy(page, _window + _dataOffset + pageOffset, chunkSize);
+	}
+
+	memset(static_cast<char *>(page) + chunkSize, 0, kPageSize - chunkSize);
+}
+
+size_t InitrdMemory::getLength() {
+	return _length;
+}
+
+frg::expected<Error, frg::tuple<smarter::shared_ptr<GlobalFutexSpace>, uintptr_t>>
+InitrdMemory::resolveGlobalFutex(uintptr_t) {
+	return Error::illegalObject;
+}
+
+coroutine<frg::expected<Error>> InitrdMemory::copyTo(uintptr_t, const void *, size_t,
+		smarter::shared_ptr<WorkQueue>) {
+	// Writing would modify the module's pages.
+	co_return Error::illegalObject;
+}
+
+Error InitrdMemory::lockRange(uintptr_t, size_t) {
+	// Pages are never evicted.
+	return Error::success;
+}
+
+void InitrdMemory::unlockRange(uintptr_t, size_t) {
+	// Pages are never evicted.
+}
+
+frg::tuple<PhysicalAddr, CachingMode> InitrdMemory::peekRange(uintptr_t offset) {
+	assert(offset % kPageSize == 0);
+	auto index = offset / kPageSize;
+
+	auto physical = _directPage(index);
+	if(physical != PhysicalAddr(-1))
+		return frg::tuple<PhysicalAddr, CachingMode>{physical, CachingMode::null};
+
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+	return frg::tuple<PhysicalAddr, CachingMode>{_pages[index], CachingMode::null};
+}
+
+coroutine<frg::expected<Error, PhysicalRange>>
+InitrdMemory::fetchRange(uintptr_t offset, FetchFlags, smarter::shared_ptr<WorkQueue>) {
+	assert(offset % kPageSize == 0);
+	auto index = offset / kPageSize;
+	if(index >= _pages.size())
+		co_return Error::bufferTooSmall;
+
+	auto physical = _directPage(index);
+	if(physical != PhysicalAddr(-1))
+		co_return PhysicalRange{physical, kPageSize, CachingMode::null};
+
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&_mutex);
+		if(_pages[index] != PhysicalAddr(-1))
+			co_return PhysicalRange{_pages[index], kPageSize, CachingMode::null};
+	}
+
+	// Materialize the page outside of the lock; decompression can take a while.
+	physical = physicalAllocator->allocate(kPageSize);
+	if(physical == PhysicalAddr(-1))
+		co_return Error::noMemory;
+	{
+		PageAccessor accessor{physical};
+		_materialize(index, accessor.get());
+	}
+
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&_mutex);
+		if(_pages[index] == PhysicalAddr(-1)) {
+			_pages[index] = physical;
+			co_return PhysicalRange{physical, kPageSize, CachingMode::null};
+		}
+	}
+
+	// Another fetchRange() raced with us.
+	physicalAllocator->free(physical, kPageSize);
+	co_return PhysicalRange{_pages[index], kPageSize, CachingMode::null};
+}
+
+void InitrdMemory::markDirty(uintptr_t, size_t) {
+	// Writes are not supported, there is no need to track dirty pages.
+}
+
+} // namespace thor
@@ -1,13 +1,36 @@
+#include <frg/vector.hpp>
+#include <thor-internal/arch/system.hpp>
 #include <thor-internal/coroutine.hpp>
 #include <thor-internal/cpu-data.hpp>
 #include <thor-internal/debug.hpp>
+#include <thor-internal/fiber.hpp>
 #include <thor-internal/irq.hpp>
 #include <thor-internal/timer.hpp>
+#include <thor-internal/tracepoint.hpp>
 
 namespace thor {
 
+extern frg::manual_box<IrqSlot> globalIrqSlots[numIrqSlots];
+extern IrqSpinlock globalIrqSlotsLock;
+
 namespace {
 	constexpr bool logService = false;
+	constexpr bool logBalancing = false;
+
+	// Time from raising an IRQ until the thread that awaits it runs again.
+	HistogramTracepoint<1> irqWakeupTracepoint{"thor.irq-wakeup"};
+}
+
+// --------------------------------------------------------
+// AwaitIrqNode
+// --------------------------------------------------------
+
+void AwaitIrqNode::traceWakeup() {
+	if(!_raisedAt) [[likely]]
+		return;
+	if(!irqWakeupTracepoint.enabled())
+		return;
+	irqWakeupTracepoint.record(systemClockSource()->currentNanos() - _raisedAt);
 }
 
 // --------------------------------------------------------
@@ -189,6 +212,9 @@ void IrqPin::raise() {
 	assert(!intsAreEnabled());
 	auto lock = frg::guard(&_mutex);
 
+	_raiseCount.store(_raiseCount.load(std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed);
+
 	if(_strategy == IrqStrategy::null) {
 		infoLogger() << "\e[35mthor: Unconfigured IRQ was raised\e[39m" << frg::endlog;
 		dumpHardwareState();
@@ -248,6 +274,17 @@ void IrqPin::raise() {
 	sendEoi();
 }
 
+Error IrqPin::setAffinity(int cpu) {
+	assert(cpu >= 0 && cpu < getCpuCount());
+
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	if(!_activeCfg.specified())
+		return Error::illegalState;
+	return retarget(cpu);
+}
+
 void IrqPin::_acknowledge() {
 	assert(_inService);
 	assert(_dueSinks);
@@ -461,10 +498,15 @@ void IrqObject::automate(smarter::shared_ptr<BoundKernlet> kernlet) {
 }
 
 IrqStatus IrqObject::raise() {
+	uint64_t raisedAt = 0;
+	if(irqWakeupTracepoint.enabled()) [[unlikely]]
+		raisedAt = systemClockSource()->currentNanos();
+
 	while(!_waitQueue.empty()) {
 		auto node = _waitQueue.pop_front();
 		node->_error = Error::success;
 		node->_sequence = currentSequence();
+		node->_raisedAt = raisedAt;
 		WorkQueue::post(node->_awaited);
 	}
 
@@ -497,4 +539,111 @@ void IrqObject::submitAwait(AwaitIrqNode *node, uint64_t sequence) {
 	}
 }
 
+// --------------------------------------------------------
+// IRQ balancing.
+// --------------------------------------------------------
+
+namespace {
+	std::atomic<bool> irqBalancingEnabled{false};
+	std::atomic<bool> irqBalancerRunning{false};
+
+	// Only balance if the busiest CPU handles at least this many IRQs per round.
+	constexpr uint64_t minBalanceRate = 1000;
+
+	IrqPin *getSlotPin(int slot) {
+		auto guard = frg::guard(&globalIrqSlotsLock);
+		return globalIrqSlots[slot]->pin();
+	}
+
+	// IRQ count of a slot in the previous round.
+	struct SlotBaseline {
+		// The pin that the count belongs to. Counts of different pins are not comparable.
+		IrqPin *pin = nullptr;
+		uint64_t count = 0;
+	};
+
+	// Moves (at most) one IRQ from the busiest to the least busy CPU.
+	void balanceIrqs(frg::vector<SlotBaseline, KernelAlloc> &baselines) {
+		frg::vector<uint64_t, KernelAlloc> rates{*kernelAlloc};
+		frg::vector<uint64_t, KernelAlloc> loads{*kernelAlloc};
+		for(int cpu = 0; cpu < getCpuCount(); cpu++)
+			loads.push_back(0);
+
+		for(int slot = 0; slot < numIrqSlots; slot++) {
+			uint64_t rate = 0;
+			auto pin = getSlotPin(slot);
+			if(pin) {
+				auto count = pin->raiseCount();
+				// If the slot was reassigned, we do not know the rate until the next round.
+				if(pin == baselines[slot].pin)
+					rate = count - baselines[slot].count;
+				baselines[slot].pin = pin;
+				baselines[slot].count = count;
+
+				auto cpu = pin->affinity();
+				if(cpu >= 0)
+					loads[cpu] += rate;
+			}
+			rates.push_back(rate);
+		}
+
+		int busiest = 0;
+		int idlest = 0;
+		for(int cpu = 1; cpu < getCpuCount(); cpu++) {
+			if(loads[cpu] > loads[busiest])
+				busiest = cpu;
+			if(loads[cpu] < loads[idlest])
+				idlest = cpu;
+		}
+		if(loads[busiest] < minBalanceRate)
+			return;
+		auto imbalance = loads[busiest] - loads[idlest];
+
+		// Only move IRQs that at most halve the imbalance.
+		// Otherwise, IRQs would bounce between CPUs.
+		int best = -1;
+		for(int slot = 0; slot < numIrqSlots; slot++) {
+			if(!rates[slot] || rates[slot] > imbalance / 2)
+				continue;
+			auto pin = getSlotPin(slot);
+			if(!pin || pin->affinity() != busiest)
+				continue;
+			if(best < 0 || rates[slot] > rates[best])
+				best = slot;
+		}
+		if(best < 0)
+			return;
+
+		auto pin = getSlotPin(best);
+		if(!pin)
+			return;
+		auto error = pin->setAffinity(idlest);
+		if(logBalancing && error == Error::success)
+			infoLogger() << "thor: Moving IRQ " << pin->name() << " (" << rates[best]
+					<< " IRQs/s) from CPU #" << busiest << " to CPU #" << idlest
+					<< frg::endlog;
+	}
+
+	void runIrqBalancer() {
+		frg::vector<SlotBaseline, KernelAlloc> baselines{*kernelAlloc};
+		for(int slot = 0; slot < numIrqSlots; slot++)
+			baselines.push_back(SlotBaseline{});
+
+		while(true) {
+			KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(1'000'000'000));
+			if(!irqBalancingEnabled.load(std::memory_order_relaxed))
+				continue;
+			balanceIrqs(baselines);
+		}
+	}
+}
+
+void setIrqBalancing(bool enable) {
+	irqBalancingEnabled.store(enable, std::memory_order_relaxed);
+	if(enable && !irqBalancerRunning.exchange(true, std::memory_order_relaxed))
+		KernelFiber::run([] {
+			runIrqBalancer();
+		});
+}
+
 } // namespace thor
@@ -1,13 +1,17 @@
 #include <frg/string.hpp>
 
+#include <thor-internal/arch/system.hpp>
 #include <thor-internal/universe.hpp>
 #include <thor-internal/coroutine.hpp>
+#include <thor-internal/cpu-data.hpp>
 #include <thor-internal/fiber.hpp>
+#include <thor-internal/irq.hpp>
 #include <thor-internal/kerncfg.hpp>
 #include <thor-internal/ostrace.hpp>
 #include <thor-internal/profile.hpp>
 #include <thor-internal/stream.hpp>
 #include <thor-internal/timer.hpp>
+#include <thor-internal/tracepoint.hpp>
 
 #include "kerncfg.frigg_pb.hpp"
 #include "mbus.frigg_pb.hpp"
@@ -19,6 +23,8 @@ namespace thor {
 extern frg::manual_box<LaneHandle> mbusClient;
 extern frg::manual_box<frg::string<KernelAlloc>> kernelCommandLine;
 extern frg::manual_box<LogRingBuffer> allocLog;
+extern frg::manual_box<IrqSlot> globalIrqSlots[numIrqSlots];
+extern IrqSpinlock globalIrqSlotsLock;
 
 namespace {
 
@@ -47,6 +53,158 @@ coroutine<Error> handleReq(LaneHandle boundLane) {
 		memcpy(cmdlineBuffer.data(), kernelCommandLine->data(), kernelCommandLine->size());
 		auto cmdlineError = co_await SendBufferSender{lane, std::move(cmdlineBuffer)};
 		assert(cmdlineError == Error::success && "Unexpected mbus transaction");
+	}else if(req.req_type() == managarm::kerncfg::CntReqType::LIST_TRACEPOINTS) {
+		// Each line has the form "<name> <enabled> <number of histograms>".
+		auto formatLine = [] (Tracepoint *tp, char *out) -> size_t {
+			size_t n = strlen(tp->name());
+			if(out) {
+				memcpy(out, tp->name(), n);
+				out[n] = ' ';
+				out[n + 1] = tp->enabled() ? '1' : '0';
+				out[n + 2] = ' ';
+			}
+			n += 3;
+
+			char digits[20];
+			size_t numDigits = 0;
+			auto numHistograms = tp->numHistograms();
+			do {
+				digits[numDigits++] = '0' + numHistograms % 10;
+				numHistograms /= 10;
+			} while(numHistograms);
+			for(size_t i = 0; i < numDigits; i++) {
+				if(out)
+					out[n] = digits[numDigits - i - 1];
+				n++;
+			}
+
+			if(out)
+				out[n] = '\n';
+			return n + 1;
+		};
+
+		size_t size = 0;
+		for(auto tp = Tracepoint::first(); tp; tp = tp->next())
+			size += formatLine(tp, nullptr);
+		frg::unique_memory<KernelAlloc> listBuffer{*kernelAlloc, size};
+		size_t progress = 0;
+		for(auto tp = Tracepoint::first(); tp; tp = tp->next())
+			progress += formatLine(tp, reinterpret_cast<char *>(listBuffer.data()) + progress);
+		assert(progress == size);
+
+		managarm::kerncfg::SvrResponse<KernelAlloc> resp(*kernelAlloc);
+		resp.set_error(managarm::kerncfg::Error::SUCCESS);
+		resp.set_size(size);
+
+		frg::string<KernelAlloc> ser(*kernelAlloc);
+		resp.SerializeToString(&ser);
+		frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, ser.size()};
+		memcpy(respBuffer.data(), ser.data(), ser.size());
+		auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
+		assert(respError == Error::success && "Unexpected mbus transaction");
+		auto listError = co_await SendBufferSender{lane, std::move(listBuffer)};
+		assert(listError == Error::success && "Unexpected mbus transaction");
+	}else if(req.req_type() == managarm::kerncfg::CntReqType::SET_TRACEPOINT) {
+		managarm::kerncfg::SvrResponse<KernelAlloc> resp(*kernelAlloc);
+
+		auto tp = Tracepoint::find(req.name());
+		if(tp) {
+			tp->setEnabled(req.enable());
+			resp.set_error(managarm::kerncfg::Error::SUCCESS);
+		}else{
+			resp.set_error(managarm::kerncfg::Error::NO_SUCH_TRACEPOINT);
+		}
+
+		frg::string<KernelAlloc> ser(*kernelAlloc);
+		resp.SerializeToString(&ser);
+		frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, ser.size()};
+		memcpy(respBuffer.data(), ser.data(), ser.size());
+		auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
+		assert(respError == Error::success && "Unexpected mbus transaction");
+	}else if(req.req_type() == managarm::kerncfg::CntReqType::GET_HISTOGRAM) {
+		managarm::kerncfg::SvrResponse<KernelAlloc> resp(*kernelAlloc);
+
+		auto tp = Tracepoint::find(req.name());
+		if(!tp || req.index() >= tp->numHistograms()) {
+			resp.set_error(managarm::kerncfg::Error::NO_SUCH_TRACEPOINT);
+
+			frg::string<KernelAlloc> ser(*kernelAlloc);
+			resp.SerializeToString(&ser);
+			frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, ser.size()};
+			memcpy(respBuffer.data(), ser.data(), ser.size());
+			auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
+			assert(respError == Error::success && "Unexpected mbus transaction");
+			co_return Error::success;
+		}
+
+		// The histogram is sent as an array of uint64_t, one entry per bucket.
+		auto &histogram = tp->histogram(req.index());
+		frg::unique_memory<KernelAlloc> bucketBuffer{*kernelAlloc,
+				Log2Histogram::numBuckets * sizeof(uint64_t)};
+		auto buckets = reinterpret_cast<uint64_t *>(bucketBuffer.data());
+		for(size_t i = 0; i < Log2Histogram::numBuckets; i++)
+			buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+
+		resp.set_error(managarm::kerncfg::Error::SUCCESS);
+		resp.set_size(Log2Histogram::numBuckets);
+
+		frg::string<KernelAlloc> ser(*kernelAlloc);
+		resp.SerializeToString(&ser);
+		frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, ser.size()};
+		memcpy(respBuffer.data(), ser.data(), ser.size());
+		auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
+		assert(respError == Error::success && "Unexpected mbus transaction");
+		auto bucketError = co_await SendBufferSender{lane, std::move(bucketBuffer)};
+		assert(bucketError == Error::success && "Unexpected mbus transaction");
+	}else if(req.req_type() == managarm::kerncfg::CntReqType::GET_IRQ_STATS) {
+		// Each line has the form "<slot> <name> <count on CPU 0> ... <count on CPU n-1>".
+		frg::string<KernelAlloc> text{*kernelAlloc};
+		for(int slot = 0; slot < numIrqSlots; slot++) {
+			IrqPin *pin;
+			{
+				auto guard = frg::guard(&globalIrqSlotsLock);
+				pin = globalIrqSlots[slot]->pin();
+			}
+			if(!pin)
+				continue;
+
+			text = text + frg::to_allocated_string(*kernelAlloc, slot)
+					+ frg::string<KernelAlloc>{*kernelAlloc, " "} + pin->name();
+			for(int cpu = 0; cpu < getCpuCount(); cpu++) {
+				auto count = getCpuData(cpu)->irqSlotCounts[slot].load(std::memory_order_relaxed);
+				text = text + frg::string<KernelAlloc>{*kernelAlloc, " "}
+						+ frg::to_allocated_string(*kernelAlloc, count);
+			}
+			text = text + frg::string<KernelAlloc>{*kernelAlloc, "\n"};
+		}
+
+		frg::unique_memory<KernelAlloc> textBuffer{*kernelAlloc, text.size()};
+		memcpy(textBuffer.data(), text.data(), text.size());
+
+		managarm::kerncfg::SvrResponse<KernelAlloc> resp(*kernelAlloc);
+		resp.set_error(managarm::kerncfg::Error::SUCCESS);
+		resp.set_size(text.size());
+
+		frg::string<KernelAlloc> ser(*kernelAlloc);
+		resp.SerializeToString(&ser);
+		frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, ser.size()};
+		memcpy(respBuffer.data(), ser.data(), ser.size());
+		auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
+		assert(respError == Error::success && "Unexpected mbus transaction");
+		auto textError = co_await SendBufferSender{lane, std::move(textBuffer)};
+		assert(textError == Error::success && "Unexpected mbus transaction");
+	}else if(req.req_type() == managarm::kerncfg::CntReqType::SET_IRQ_BALANCING) {
+		setIrqBalancing(req.enable());
+
+		managarm::kerncfg::SvrResponse<KernelAlloc> resp(*kernelAlloc);
+		resp.set_error(managarm::kerncfg::Error::SUCCESS);
+
+		frg::string<KernelAlloc> ser(*kernelAlloc);
+		resp.SerializeToString(&ser);
+		frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, ser.size()};
+		memcpy(respBuffer.data(), ser.data(), ser.size());
+		auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
+		assert(respError == Error::success && "Unexpected mbus transaction");
 	}else{
 		managarm::kerncfg::SvrResponse<KernelAlloc> resp(*kernelAlloc);
 		resp.set_error(managarm::kerncfg::Error::ILLEGAL_REQUEST);
@@ -19,6 +19,8 @@
 #include <thor-internal/random.hpp>
 #include <thor-internal/servers.hpp>
 #include <thor-internal/thread.hpp>
+#include <thor-internal/timer.hpp>
+#include <thor-internal/tracepoint.hpp>
 
 namespace thor {
 
@@ -30,6 +32,11 @@ static constexpr bool logEverySyscall = false;
 
 static constexpr bool noScheduleOnIrq = false;
 
+// Duration of each syscall, with one histogram per call number.
+static HistogramTracepoint<kHelNumCalls> syscallTracepoint{"hel.syscall"};
+// Time that it takes to resolve a page fault.
+static HistogramTracepoint<1> pageFaultTracepoint{"thor.page-fault"};
+
 bool debugToSerial = false;
 bool debugToBochs = false;
 
@@ -207,10 +214,11 @@ extern "C" void thorMain() {
 
 		mfsRoot = frg::construct<MfsDirectory>(*kernelAlloc);
 		{
+			// The module stays mapped since initrd files reference it.
 			assert(modules[0].physicalBase % kPageSize == 0);
-			assert(modules[0].length <= 0x2000000);
-			auto base = static_cast<const char *>(KernelVirtualMemory::global().allocate(0x2000000));
-			for(size_t pg = 0; pg < modules[0].length; pg += kPageSize)
+			auto windowSize = (modules[0].length + (kPageSize - 1)) & ~(kPageSize - 1);
+			auto base = static_cast<const char *>(KernelVirtualMemory::global().allocate(windowSize));
+			for(size_t pg = 0; pg < windowSize; pg += kPageSize)
 				KernelPageSpace::global().mapSingle4k(reinterpret_cast<VirtualAddr>(base) + pg,
 						modules[0].physicalBase + pg, 0, CachingMode::null);
 
@@ -268,9 +276,14 @@ extern "C" void thorMain() {
 				auto mode = parseHex(header.mode, 8);
 				auto name_size = parseHex(header.nameSize, 8);
 				auto file_size = parseHex(header.fileSize, 8);
+				auto check = parseHex(header.check, 8);
 				auto data = p + ((sizeof(Header) + name_size + 3) & ~uint32_t{3});
 
-				frg::string_view path{p + sizeof(Header), name_size - 1};
+				// gen-initrd.py pads names with NUL bytes to page-align the file data.
+				size_t path_length = 0;
+				while(path_length < name_size && p[sizeof(Header) + path_length])
+					path_length++;
+				frg::string_view path{p + sizeof(Header), path_length};
 				if(path == "TRAILER!!!")
 					break;
 
@@ -302,18 +315,16 @@ extern "C" void thorMain() {
 	//				if(logInitialization)
 						infoLogger() << "thor: initrd file " << path << frg::endlog;
 
-					auto memory = smarter::allocate_shared<AllocatedMemory>(*kernelAlloc,
-							(file_size + (kPageSize - 1)) & ~size_t{kPageSize - 1});
-					memory->selfPtr = memory;
-					auto copyOutcome = KernelFiber::asyncBlockCurrent(memory->copyTo(0,
-							data, file_size,
-							thisFiber()->associatedWorkQueue()->take()));
-					assert(copyOutcome);
+					// The file's pages are not copied; they are materialized on demand.
+					auto memory = smarter::allocate_shared<InitrdMemory>(*kernelAlloc,
+							modules[0].physicalBase, base, data - base, file_size,
+							magic == 0x070701 && check == initrdCompressedCheck);
+					auto size = memory->fileSize();
 
 					auto name = frg::string<KernelAlloc>{*kernelAlloc,
 							path.sub_string(it - path.data(), end - it)};
 					dir->link(std::move(name), frg::construct<MfsRegular>(*kernelAlloc,
-							std::move(memory), file_size));
+							std::move(memory), size));
 				}
 
 				p = data + ((file_size + 3) & ~uint32_t{3});
@@ -443,9 +454,17 @@ void handlePageFault(FaultImageAccessor image, uintptr_t address, Word errorCode
 	if(errorCode & kPfInstruction)
 		flags |= AddressSpace::kFaultExecute;
 
+	uint64_t faultStart = 0;
+	if(pageFaultTracepoint.enabled()) [[unlikely]]
+		faultStart = systemClockSource()->currentNanos();
+
 	auto wq = this_thread->pagingWorkQueue();
-	if(Thread::asyncBlockCurrent(
-			address_space->handleFault(address, flags, wq->take()), wq))
+	auto handled = Thread::asyncBlockCurrent(
+			address_space->handleFault(address, flags, wq->take()), wq);
+
+	if(faultStart) [[unlikely]]
+		pageFaultTracepoint.record(systemClockSource()->currentNanos() - faultStart);
+	if(handled)
 		return;
 
 	// If we get here, the page fault could not be handled.
@@ -508,6 +527,9 @@ void handleIrq(IrqImageAccessor image, int number) {
 	if(logEveryIrq)
 		infoLogger() << "thor: IRQ slot #" << number << frg::endlog;
 
+	auto &count = cpuData->irqSlotCounts[number];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
 	globalIrqSlots[number]->raise();
 
 	// Inject IRQ timing entropy into the PRNG accumulator.
@@ -566,6 +588,10 @@ void handleSyscall(SyscallImageAccessor image) {
 	Word arg4 = *image.in4();
 	Word arg5 = *image.in5();
 
+	uint64_t syscallStart = 0;
+	if(syscallTracepoint.enabled()) [[unlikely]]
+		syscallStart = systemClockSource()->currentNanos();
+
 	switch(*image.number()) {
 	case kHelCallLog: {
 		*image.error() = helLog((const char *)arg0, (size_t)arg1);
@@ -657,6 +683,9 @@ void handleSyscall(SyscallImageAccessor image) {
 		*image.error() = helForkMemory((HelHandle)arg0, &forkedHandle);
 		*image.out0() = forkedHandle;
 	} break;
+	case kHelCallForkSpace: {
+		*image.error() = helForkSpace((HelHandle)arg0, (HelForkItem *)arg1, (size_t)arg2);
+	} break;
 	case kHelCallCreateSpace: {
 		HelHandle handle;
 		*image.error() = helCreateSpace(&handle);
@@ -684,6 +713,12 @@ void handleSyscall(SyscallImageAccessor image) {
 		*image.error() = helPointerPhysical((void *)arg0, &physical);
 		*image.out0() = physical;
 	} break;
+	case kHelCallLockPhysical: {
+		HelHandle handle;
+		*image.error() = helLockPhysical((void *)arg0, (size_t)arg1,
+				(HelPhysicalSegment *)arg2, (size_t *)arg3, &handle);
+		*image.out0() = handle;
+	} break;
 	case kHelCallSubmitReadMemory: {
 		*image.error() = helSubmitReadMemory((HelHandle)arg0, (uintptr_t)arg1,
 				(size_t)arg2, (void *)arg3,
@@ -762,6 +797,10 @@ void handleSyscall(SyscallImageAccessor image) {
 	case kHelCallResume: {
 		*image.error() = helResume((HelHandle)arg0);
 	} break;
+	case kHelCallCompleteSuperCall: {
+		*image.error() = helCompleteSuperCall((HelHandle)arg0, (HelError)arg1,
+				(uintptr_t)arg2, (uintptr_t)arg3);
+	} break;
 	case kHelCallLoadRegisters: {
 		*image.error() = helLoadRegisters((HelHandle)arg0, (int)arg1, (void *)arg2);
 	} break;
@@ -801,6 +840,21 @@ void handleSyscall(SyscallImageAccessor image) {
 	case kHelCallFutexWait: {
 		*image.error() = helFutexWait((int *)arg0, (int)arg1, (int64_t)arg2);
 	} break;
+	case kHelCallFutexWaitBitset: {
+		*image.error() = helFutexWaitBitset((int *)arg0, (int)arg1, (int64_t)arg2,
+				(uint32_t)arg3);
+	} break;
+	case kHelCallFutexWakeBitset: {
+		int woken = 0;
+		*image.error() = helFutexWakeBitset((int *)arg0, (int)arg1, (uint32_t)arg2, &woken);
+		*image.out0() = woken;
+	} break;
+	case kHelCallFutexRequeue: {
+		int affected = 0;
+		*image.error() = helFutexRequeue((int *)arg0, (int *)arg1, (int)arg2, (int)arg3,
+				(int)arg4, (uint32_t)arg5, &affected);
+		*image.out0() = affected;
+	} break;
 	case kHelCallFutexWake: {
 		*image.error() = helFutexWake((int *)arg0);
 	} break;
@@ -826,6 +880,9 @@ void handleSyscall(SyscallImageAccessor image) {
 	case kHelCallAcknowledgeIrq: {
 		*image.error() = helAcknowledgeIrq((HelHandle)arg0, (uint32_t)arg1, (uint64_t)arg2);
 	} break;
+	case kHelCallSetIrqAffinity: {
+		*image.error() = helSetIrqAffinity((HelHandle)arg0, (unsigned int)arg1);
+	} break;
 	case kHelCallSubmitAwaitEvent: {
 		*image.error() = helSubmitAwaitEvent((HelHandle)arg0, (uint64_t)arg1,
 				(HelHandle)arg2, (uintptr_t)arg3);
@@ -865,6 +922,10 @@ void handleSyscall(SyscallImageAccessor image) {
 		*image.error() = kHelErrIllegalSyscall;
 	}
 
+	if(syscallStart && *image.number() < kHelNumCalls) [[unlikely]]
+		syscallTracepoint.record(systemClockSource()->currentNanos() - syscallStart,
+				*image.number());
+
 	// Run more worklets that were posted by the syscall.
 	this_thread->mainWorkQueue()->run();
 
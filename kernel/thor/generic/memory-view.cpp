@@ -1480,19 +1480,20 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 		auto irqLock = frg::guard(&irqMutex());
 		auto lock = frg::guard(&_mutex);
 
-		// Create a new CowChain for both the original and the forked mapping.
-		// To correct handle locks pages, we move only non-locked pages from
-		// the original mapping to the new chain.
-		auto newChain = smarter::allocate_shared<CowChain>(*kernelAlloc, _copyChain);
-
-		// Update the original mapping
-		_copyChain = newChain;
-
 		// Create a new mapping in the forked space.
+		// Its CowChain is determined below, after inspecting the owned pages.
 		forked = smarter::allocate_shared<CopyOnWriteMemory>(*kernelAlloc,
-				_view, _viewOffset, _length, newChain);
+				_view, _viewOffset, _length);
 		forked->selfPtr = forked;
 
+		// A new CowChain for both the original and the forked mapping is only
+		// allocated once we need to move a page into it. If the original mapping does
+		// not own any (non-locked) pages, both mappings can share the existing chain.
+		// This avoids growing the chain on every fork() of mappings that were never written.
+		// To correct handle locks pages, we move only non-locked pages from
+		// the original mapping to the new chain.
+		smarter::shared_ptr<CowChain> newChain;
+
 		// Finally, inspect all copied pages owned by the original mapping.
 		for(size_t pg = 0; pg < _length; pg += kPageSize) {
 			auto osIt = _ownedPages.find(pg >> kPageShift);
@@ -1520,6 +1521,9 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 				auto physical = osIt->physical;
 				assert(physical != PhysicalAddr(-1));
 
+				if(!newChain)
+					newChain = smarter::allocate_shared<CowChain>(*kernelAlloc, _copyChain);
+
 				// Update the chains.
 				auto pageOffset = _viewOffset + pg;
 				auto newIt = newChain->_pages.insert(pageOffset >> kPageShift,
@@ -1528,6 +1532,11 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 				newIt->store(physical, std::memory_order_relaxed);
 			}
 		}
+
+		// Update the original mapping.
+		if(newChain)
+			_copyChain = std::move(newChain);
+		forked->_copyChain = _copyChain;
 	}
 
 	async::detach_with_allocator(*kernelAlloc,
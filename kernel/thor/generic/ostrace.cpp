@@ -2,6 +2,8 @@
 #include <bragi/helpers-frigg.hpp>
 #include <frg/small_vector.hpp>
 #include <frg/span.hpp>
+#include <frg/vector.hpp>
+#include <thor-internal/cpu-data.hpp>
 #include <thor-internal/fiber.hpp>
 #include <thor-internal/kernel-io.hpp>
 #include <thor-internal/main.hpp>
@@ -63,6 +65,81 @@ void commitOsTrace(R record) {
 	globalOsTraceRing->enqueue(ser.data(), ser.size(), !intsAreEnabled());
 }
 
+// Allocates the rings of all CPUs that do not have one yet.
+// Rings are allocated here and not by emitOsTrace(), since the latter can be called
+// from contexts that must not allocate (e.g., while sending TLB shootdowns).
+void allocateOsTraceRings() {
+	for(int i = 0; i < getCpuCount(); i++) {
+		auto cpuData = getCpuData(i);
+		if(cpuData->localOsTraceRing.load(std::memory_order_relaxed))
+			continue;
+		auto ring = frg::construct<OsTraceRing>(*kernelAlloc);
+		cpuData->localOsTraceRing.store(ring, std::memory_order_release);
+	}
+}
+
+// Moves records from the per-CPU rings to the global ring.
+// Records of each CPU stay in order; userspace merges the per-CPU streams by timestamp.
+void drainOsTraceRings() {
+	frg::vector<uint64_t, KernelAlloc> reportedDrops{*kernelAlloc};
+
+	while(true) {
+		// Pick up CPUs that were booted since the last iteration.
+		allocateOsTraceRings();
+
+		bool anyRecords = false;
+		for(int i = 0; i < getCpuCount(); i++) {
+			auto ring = getCpuData(i)->localOsTraceRing.load(std::memory_order_acquire);
+
+			// Bound the work per CPU such that busy CPUs do not starve the others.
+			OsTraceRecord rec;
+			for(size_t n = 0; n < OsTraceRing::numSlots && ring->pop(rec); n++) {
+				managarm::ostrace::EventRecord<KernelAlloc> record{*kernelAlloc};
+				record.set_ts(rec.ts);
+				record.set_id(rec.id);
+				for(size_t j = 0; j < rec.numCounters; j++) {
+					managarm::ostrace::CounterItem<KernelAlloc> ctr{*kernelAlloc};
+					ctr.set_id(rec.counters[j].id);
+					ctr.set_value(rec.counters[j].value);
+					record.add_ctrs(std::move(ctr));
+				}
+				commitOsTrace(std::move(record));
+				anyRecords = true;
+			}
+
+			while(reportedDrops.size() <= static_cast<size_t>(i))
+				reportedDrops.push_back(0);
+			auto drops = ring->drops();
+			if(drops != reportedDrops[i]) {
+				managarm::ostrace::DropRecord<KernelAlloc> record{*kernelAlloc};
+				record.set_cpu(i);
+				record.set_count(drops - reportedDrops[i]);
+				commitOsTrace(std::move(record));
+				reportedDrops[i] = drops;
+			}
+		}
+
+		if(!anyRecords)
+			KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(1'000'000));
+	}
+}
+
+initgraph::Task initOsTraceDrain{&globalInitEngine, "generic.init-ostrace-drain",
+	initgraph::Requires{&initOsTraceCore,
+		getFibersAvailableStage()},
+	[] {
+		if(!wantOsTrace)
+			return;
+
+		// Allocate the rings of the CPUs that are already up before the fiber first runs,
+		// such that their events are not lost.
+		allocateOsTraceRings();
+		KernelFiber::run([] {
+			drainOsTraceRings();
+		});
+	}
+};
+
 } // anonymous namespace
 
 OsTraceEventId announceOsTraceEvent(frg::string_view name) {
@@ -76,10 +153,33 @@ OsTraceEventId announceOsTraceEvent(frg::string_view name) {
 	return static_cast<OsTraceEventId>(id);
 }
 
-void emitOsTrace(managarm::ostrace::EventRecord<KernelAlloc> record) {
-	record.set_ts(systemClockSource()->currentNanos());
+OsTraceItemId announceOsTraceItem(frg::string_view name) {
+	auto id = nextId.fetch_add(1, std::memory_order_relaxed);
 
+	managarm::ostrace::AnnounceItemRecord<KernelAlloc> record{*kernelAlloc};
+	record.set_id(id);
+	record.set_name(frg::string<KernelAlloc>{*kernelAlloc, name});
 	commitOsTrace(std::move(record));
+
+	return static_cast<OsTraceItemId>(id);
+}
+
+void emitOsTrace(OsTraceRecord &record) {
+	if(!osTraceInUse.load(std::memory_order_relaxed))
+		return;
+
+	// With IRQs disabled, we are the only producer of this CPU's ring.
+	auto irqLock = frg::guard(&irqMutex());
+	auto cpuData = getCpuData();
+
+	// Events that are emitted before the ring of this CPU is allocated are lost.
+	auto ring = cpuData->localOsTraceRing.load(std::memory_order_acquire);
+	if(!ring) [[unlikely]]
+		return;
+
+	// Take the timestamp with IRQs disabled such that each ring is ordered by timestamp.
+	record.ts = systemClockSource()->currentNanos();
+	ring->push(record);
 }
 
 LogRingBuffer *getGlobalOsTraceRing() {
@@ -226,11 +326,22 @@ coroutine<Error> handleReq(LaneHandle boundLane) {
 			co_return Error::protocolViolation;
 		auto &req = maybeReq.value();
 
-		managarm::ostrace::EventRecord<KernelAlloc> record{*kernelAlloc};
-		record.set_id(req.id());
-		for(size_t i = 0; i < req.ctrs_size(); ++i)
-			record.add_ctrs(std::move(req.ctrs(i)));
-		emitOsTrace(std::move(record));
+		if(req.ctrs_size() <= OsTraceRecord::maxCounters) {
+			OsTraceRecord record;
+			record.id = req.id();
+			record.numCounters = req.ctrs_size();
+			for(size_t i = 0; i < req.ctrs_size(); ++i)
+				record.counters[i] = {req.ctrs(i).id(), req.ctrs(i).value()};
+			emitOsTrace(record);
+		}else if(osTraceInUse.load(std::memory_order_relaxed)) {
+			// Events with many counters bypass the per-CPU rings.
+			managarm::ostrace::EventRecord<KernelAlloc> record{*kernelAlloc};
+			record.set_ts(systemClockSource()->currentNanos());
+			record.set_id(req.id());
+			for(size_t i = 0; i < req.ctrs_size(); ++i)
+				record.add_ctrs(std::move(req.ctrs(i)));
+			commitOsTrace(std::move(record));
+		}
 
 		managarm::ostrace::Response<KernelAlloc> resp(*kernelAlloc);
 		resp.set_error(managarm::ostrace::Error::SUCCESS);
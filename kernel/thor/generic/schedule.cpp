@@ -6,6 +6,7 @@
 #include <thor-internal/debug.hpp>
 #include <thor-internal/schedule.hpp>
 #include <thor-internal/timer.hpp>
+#include <thor-internal/tracepoint.hpp>
 
 namespace thor {
 
@@ -48,6 +49,9 @@ namespace {
 	};
 
 	frg::eternal<IdleTask> globalIdleTask;
+
+	// Length of the time slice that ends on each context switch.
+	HistogramTracepoint<1> switchTracepoint{"thor.schedule-switch"};
 }
 
 int ScheduleEntity::orderPriority(const ScheduleEntity *a, const ScheduleEntity *b) {
@@ -280,6 +284,9 @@ void Scheduler::forceReschedule() {
 	assert(!_current);
 	assert(_scheduled);
 
+	if(switchTracepoint.enabled()) [[unlikely]]
+		switchTracepoint.record(_refClock - _sliceClock);
+
 	_current = _scheduled;
 	_scheduled = nullptr;
 	_sliceClock = _refClock;
@@ -2,6 +2,7 @@
 #include <frg/hash_map.hpp>
 #include <frg/string.hpp>
 #include <elf.h>
+#include <thor-internal/clock-page.hpp>
 #include <thor-internal/coroutine.hpp>
 #include <thor-internal/debug.hpp>
 #include <thor-internal/universe.hpp>
@@ -257,6 +258,7 @@ coroutine<void> executeModule(frg::string_view name, MfsRegular *module,
 		LaneHandle xpipe_lane,
 		Scheduler *scheduler) {
 	auto space = AddressSpace::create();
+	co_await mapClockPage(space);
 
 	ImageInfo exec_info = co_await loadModuleImage(space, 0, module->getMemory());
 
@@ -1,8 +1,15 @@
 
 #include <thor-internal/stream.hpp>
+#include <thor-internal/timer.hpp>
+#include <thor-internal/tracepoint.hpp>
 
 namespace thor {
 
+namespace {
+	// Time that an offer (or accept) waits for the matching accept (or offer).
+	HistogramTracepoint<1> offerAcceptTracepoint{"thor.offer-accept"};
+}
+
 LaneHandle::LaneHandle(const LaneHandle &other)
 : _stream(other._stream), _lane(other._lane) {
 	if(_stream)
@@ -111,6 +118,8 @@ void Stream::Submitter::run() {
 				// If both lanes have items, we need to process them.
 				// Otherwise, we just queue the new node.
 				if(s->_processQueue[q].empty()) {
+					if(offerAcceptTracepoint.enabled()) [[unlikely]]
+						u->_queuedAt = systemClockSource()->currentNanos();
 					s->_processQueue[p].push_back(u);
 					continue;
 				}
@@ -150,6 +159,13 @@ void Stream::Submitter::run() {
 
 		// Do the main work here, after we released the lock.
 		if(u->tag() == kTagOffer && v->tag() == kTagAccept) {
+			// Only the node that was queued first carries a timestamp.
+			// The tracepoint may have been disabled since the node was queued.
+			if(auto queuedAt = frg::max(u->_queuedAt, v->_queuedAt); queuedAt) [[unlikely]] {
+				if(offerAcceptTracepoint.enabled())
+					offerAcceptTracepoint.record(systemClockSource()->currentNanos() - queuedAt);
+			}
+
 			// Initially there will be 3 references to the new stream:
 			// * One reference for the original shared pointer.
 			// * One reference for each of the two lanes.
@@ -169,7 +185,7 @@ void Stream::Submitter::run() {
 		}else if(u->tag() == kTagSendKernelBuffer && v->tag() == kTagRecvKernelBuffer) {
 			transfer(SendRecvInline{}, u, v);
 		}else if(u->tag() == kTagSendFlow && v->tag() == kTagRecvKernelBuffer) {
-			if(u->_inBuffer.size() > v->_maxLength) {
+			if(u->_maxLength > v->_maxLength) {
 				// Both nodes complete with bufferTooSmall.
 				u->_error = Error::bufferTooSmall;
 				v->_error = Error::bufferTooSmall;
@@ -5,12 +5,14 @@
 #include <async/oneshot-event.hpp>
 #include <frg/container_of.hpp>
 #include <frg/expected.hpp>
+#include <frg/vector.hpp>
 #include <thor-internal/coroutine.hpp>
 #include <thor-internal/memory-view.hpp>
 
 namespace thor {
 
 struct VirtualSpace;
+struct MemoryViewLockHandle;
 
 template<typename Cursor, typename PageSpace>
 frg::expected<Error> mapPresentPagesByCursor(PageSpace *ps, VirtualAddr va,
@@ -294,7 +296,10 @@ enum MappingFlags : uint32_t {
 	protWrite = 0x20,
 	protExecute = 0x40,
 
-	dontRequireBacking = 0x100
+	dontRequireBacking = 0x100,
+
+	// protect() does not change the permissions of the mapping.
+	fixedProtection = 0x200
 };
 
 struct TouchVirtualResult {
@@ -477,6 +482,7 @@ public:
 		kMapProtExecute = 0x20,
 		kMapPopulate = 0x200,
 		kMapDontRequireBacking = 0x400,
+		kMapFixedProtection = 0x800,
 	};
 
 	enum FaultFlags : uint32_t {
@@ -511,6 +517,15 @@ public:
 	coroutine<frg::expected<Error, PhysicalAddr>>
 	retrievePhysical(VirtualAddr address, smarter::shared_ptr<WorkQueue> wq);
 
+	// Locks the pages of [address, address + length) into memory and appends
+	// their physical addresses to physicals. The range must be page-aligned and
+	// it must be contained in a single mapping. The pages stay locked
+	// (even if the range is unmapped) until the returned handle is destructed.
+	coroutine<frg::expected<Error, MemoryViewLockHandle>>
+	lockPhysical(VirtualAddr address, size_t length,
+			frg::vector<PhysicalAddr, KernelAlloc> &physicals,
+			smarter::shared_ptr<WorkQueue> wq);
+
 	size_t rss() {
 		return _ops->getRss();
 	}
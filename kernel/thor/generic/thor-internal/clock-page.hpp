@@ -0,0 +1,30 @@
+#pragma once
+
+#include <hel.h>
+#include <thor-internal/address-space.hpp>
+#include <thor-internal/coroutine.hpp>
+
+namespace thor {
+
+// Clock sources convert raw counter values to nanoseconds as (ticks * multiplier) >> clockShift.
+// User space performs the same computation based on the clock page.
+constexpr uint32_t clockShift = 32;
+
+inline uint64_t computeClockMultiplier(uint64_t ticksPerMilli) {
+	return (uint64_t{1'000'000} << clockShift) / ticksPerMilli;
+}
+
+inline uint64_t scaleClockTicks(uint64_t ticks, uint64_t multiplier) {
+	return (static_cast<unsigned __int128>(ticks) * multiplier) >> clockShift;
+}
+
+// Publishes the parameters of the system clock source.
+// flags is a combination of the kHelClockPage* flags. If the counter cannot be
+// read from user space, flags should be zero.
+// Must be called once during boot before tasking is available.
+void publishClockPage(uint32_t flags, uint64_t multiplier);
+
+// Maps the clock page read-only at kHelClockPageAddress.
+coroutine<void> mapClockPage(smarter::shared_ptr<AddressSpace, BindableHandle> space);
+
+} // namespace thor
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <thor-internal/arch/cpu.hpp>
+#include <thor-internal/arch/system.hpp>
 #include <thor-internal/executor-context.hpp>
 #include <thor-internal/kernel-locks.hpp>
 #include <thor-internal/schedule.hpp>
@@ -9,6 +10,7 @@ namespace thor {
 
 // Forward defined for pointers that are part of CpuData.
 struct KernelFiber;
+struct OsTraceRing;
 struct SingleContextRecordRing;
 struct WorkQueue;
 
@@ -40,9 +42,14 @@ struct CpuData : public PlatformCpuData {
 	std::atomic<uint64_t> heartbeat;
 
 	unsigned int irqEntropySeq = 0;
+	// Number of IRQs per slot that were handled on this CPU.
+	// Only written by this CPU (with IRQs disabled).
+	std::atomic<uint64_t> irqSlotCounts[numIrqSlots]{};
 	std::atomic<ProfileMechanism> profileMechanism{};
 	// TODO: This should be a unique_ptr instead.
 	SingleContextRecordRing *localProfileRing = nullptr;
+	// Allocated by the ostrace drain fiber.
+	std::atomic<OsTraceRing *> localOsTraceRing{nullptr};
 };
 
 CpuData *getCpuData(size_t k);
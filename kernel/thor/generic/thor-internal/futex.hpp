@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
+
 #include <async/cancellation.hpp>
+#include <frg/expected.hpp>
 #include <frg/functional.hpp>
 #include <frg/hash_map.hpp>
 #include <frg/list.hpp>
@@ -53,13 +56,22 @@ concept Futex = requires(F f) {
 };
 
 struct FutexRealm {
+	// Number of independently locked hash buckets.
+	static constexpr size_t numBuckets = 64;
+
+	// Bitset that matches all waiters.
+	static constexpr uint32_t anyBitset = ~uint32_t{0};
+
 private:
+	struct Bucket;
+
 	// Represents a single waiter.
 	struct Node {
 		friend struct FutexRealm;
 
-		Node(FutexRealm *realm, FutexIdentity id)
-		: realm_{realm}, id_{id}, cobs_{this} { }
+		Node(FutexRealm *realm, FutexIdentity id, uint32_t bitset)
+		: realm_{realm}, id_{id}, bitset_{bitset}, bucket_{realm->_bucketOf(id)},
+				cobs_{this} { }
 
 	protected:
 		virtual void complete() = 0;
@@ -70,21 +82,31 @@ private:
 		void cancel_() {
 			{
 				auto irqLock = frg::guard(&irqMutex());
-				auto lock = frg::guard(&realm_->_mutex);
-
-				if(!result_) {
-					auto sit = realm_->_slots.get(id_);
-					// Invariant: If the slot exists then its queue is not empty.
-					assert(!sit->queue.empty());
 
-					auto nit = sit->queue.iterator_to(this);
-					sit->queue.erase(nit);
-					result_ = Error::cancelled;
-
-					if(sit->queue.empty())
-						realm_->_slots.remove(id_);
-				}else{
-					assert(!queueHook_.in_list);
+				while(true) {
+					auto bucket = bucket_.load(std::memory_order_acquire);
+					auto lock = frg::guard(&bucket->mutex);
+
+					// requeue() may have moved this node to another bucket
+					// before we acquired the lock.
+					if(bucket_.load(std::memory_order_relaxed) != bucket)
+						continue;
+
+					if(!result_) {
+						auto sit = bucket->slots.get(id_);
+						// Invariant: If the slot exists then its queue is not empty.
+						assert(!sit->queue.empty());
+
+						auto nit = sit->queue.iterator_to(this);
+						sit->queue.erase(nit);
+						result_ = Error::cancelled;
+
+						if(sit->queue.empty())
+							bucket->slots.remove(id_);
+					}else{
+						assert(!queueHook_.in_list);
+					}
+					break;
 				}
 			}
 
@@ -92,29 +114,56 @@ private:
 		}
 
 		FutexRealm *realm_;
-		FutexIdentity id_;
+		FutexIdentity id_; // Protected by the bucket's mutex.
+		uint32_t bitset_;
+		std::atomic<Bucket *> bucket_; // Only changed while holding the bucket's mutex.
 		frg::optional<Error> result_; // Set after completion.
 		async::cancellation_observer<frg::bound_mem_fn<&Node::cancel_>> cobs_;
 		frg::default_list_hook<Node> queueHook_;
 	};
 
-	struct Slot {
-		frg::intrusive_list<
+	using NodeList = frg::intrusive_list<
+		Node,
+		frg::locate_member<
 			Node,
-			frg::locate_member<
-				Node,
-				frg::default_list_hook<Node>,
-				&Node::queueHook_
-			>
-		> queue;
+			frg::default_list_hook<Node>,
+			&Node::queueHook_
+		>
+	>;
+
+	struct Slot {
+		NodeList queue;
+	};
+
+	using Mutex = frg::ticket_spinlock;
+
+	// Buckets are cache line aligned to avoid false sharing between their locks.
+	struct alignas(64) Bucket {
+		Bucket()
+		: slots{FutexIdentity::Hash{}, *kernelAlloc} { }
+
+		Mutex mutex;
+
+		frg::hash_map<
+			FutexIdentity,
+			Slot,
+			FutexIdentity::Hash,
+			KernelAlloc
+		> slots;
 	};
 
 public:
-	FutexRealm()
-	: _slots{FutexIdentity::Hash{}, *kernelAlloc} { }
+	FutexRealm() = default;
 
 	bool empty() {
-		return _slots.empty();
+		for(auto &bucket : _buckets) {
+			auto irqLock = frg::guard(&irqMutex());
+			auto lock = frg::guard(&bucket.mutex);
+
+			if(!bucket.slots.empty())
+				return false;
+		}
+		return true;
 	}
 
 	// ----------------------------------------------------------------------------------
@@ -123,9 +172,9 @@ public:
 
 	template<Futex F, typename R>
 	struct WaitOperation final : private Node {
-		WaitOperation(FutexRealm *self, F f, unsigned int expected,
+		WaitOperation(FutexRealm *self, F f, unsigned int expected, uint32_t bitset,
 				async::cancellation_token ct, R receiver)
-		: Node{self, f.getIdentity()}, f_{std::move(f)}, expected_{expected}, ct_{ct},
+		: Node{self, f.getIdentity(), bitset}, f_{std::move(f)}, expected_{expected}, ct_{ct},
 				receiver_{std::move(receiver)} { }
 
 		WaitOperation(const WaitOperation &) = delete;
@@ -139,8 +188,9 @@ public:
 			F f = std::move(f_);
 
 			auto fastPath = [&] {
+				auto bucket = bucket_.load(std::memory_order_relaxed);
 				auto irqLock = frg::guard(&irqMutex());
-				auto lock = frg::guard(&realm_->_mutex);
+				auto lock = frg::guard(&bucket->mutex);
 
 				if(f.read() != expected_) {
 					result_ = Error::futexRace;
@@ -152,10 +202,10 @@ public:
 					return true;
 				}
 
-				auto sit = realm_->_slots.get(id_);
+				auto sit = bucket->slots.get(id_);
 				if(!sit) {
-					realm_->_slots.insert(id_, Slot());
-					sit = realm_->_slots.get(id_);
+					bucket->slots.insert(id_, Slot());
+					sit = bucket->slots.get(id_);
 				}
 
 				assert(!queueHook_.in_list);
@@ -190,7 +240,7 @@ public:
 
 		template<typename R>
 		WaitOperation<F, R> connect(R receiver) {
-			return {self, std::move(f), expected, ct, std::move(receiver)};
+			return {self, std::move(f), expected, bitset, ct, std::move(receiver)};
 		}
 
 		async::sender_awaiter<WaitSender> operator co_await() {
@@ -200,70 +250,183 @@ public:
 		FutexRealm *self;
 		F f;
 		unsigned int expected;
+		uint32_t bitset;
 		async::cancellation_token ct;
 	};
 
+	// Only wake() calls whose bitset intersects with the waiter's bitset complete the wait.
 	template<Futex F>
-	WaitSender<F> wait(F f, unsigned int expected, async::cancellation_token ct = {}) {
-		return {this, std::move(f), expected, ct};
+	WaitSender<F> wait(F f, unsigned int expected, async::cancellation_token ct = {},
+			uint32_t bitset = anyBitset) {
+		return {this, std::move(f), expected, bitset, ct};
 	}
 
+	// ----------------------------------------------------------------------------------
+	// wake() and requeue().
 	// ----------------------------------------------------------------------------------
 
-	void wake(FutexIdentity id) {
-		frg::intrusive_list<
-			Node,
-			frg::locate_member<
-				Node,
-				frg::default_list_hook<Node>,
-				&Node::queueHook_
-			>
-		> pending;
+	// Wakes up to count waiters whose bitset intersects with the given bitset.
+	// Returns the number of waiters that were woken.
+	size_t wake(FutexIdentity id, size_t count = SIZE_MAX, uint32_t bitset = anyBitset) {
+		NodeList pending;
+		size_t numWoken;
 		{
+			auto bucket = _bucketOf(id);
 			auto irqLock = frg::guard(&irqMutex());
-			auto lock = frg::guard(&_mutex);
-
-			auto sit = _slots.get(id);
-			if(!sit)
-				return;
-			// Invariant: If the slot exists then its queue is not empty.
-			assert(!sit->queue.empty());
-
-			// TODO: Enable users to only wake a certain number of waiters.
-			while(!sit->queue.empty()) {
-				auto node = sit->queue.front();
-				assert(!node->result_);
-				sit->queue.pop_front();
-
-				if(node->cobs_.try_reset()) {
-					node->result_ = Error::success;
-					pending.push_back(node);
-				}
+			auto lock = frg::guard(&bucket->mutex);
+
+			numWoken = _wakeLocked(bucket, id, count, bitset, pending);
+		}
+
+		_completeAll(pending);
+		return numWoken;
+	}
+
+	// Wakes up to wakeCount waiters of from and moves up to requeueCount of the
+	// remaining waiters to the futex to. Returns the number of woken and requeued waiters.
+	size_t requeue(FutexIdentity from, FutexIdentity to, size_t wakeCount, size_t requeueCount) {
+		NodeList pending;
+		size_t numAffected;
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			BucketPairGuard lock{_bucketOf(from), _bucketOf(to)};
+
+			numAffected = _requeueLocked(from, to, wakeCount, requeueCount, pending);
+		}
+
+		_completeAll(pending);
+		return numAffected;
+	}
+
+	// Like requeue() but fails with Error::futexRace unless f.read() == expected.
+	// The check is atomic with respect to wait() on the same futex.
+	template<Futex F>
+	frg::expected<Error, size_t> compareRequeue(F f, unsigned int expected, FutexIdentity to,
+			size_t wakeCount, size_t requeueCount) {
+		auto from = f.getIdentity();
+		NodeList pending;
+		size_t numAffected = 0;
+		bool race = false;
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			BucketPairGuard lock{_bucketOf(from), _bucketOf(to)};
+
+			if(f.read() != expected)
+				race = true;
+			else
+				numAffected = _requeueLocked(from, to, wakeCount, requeueCount, pending);
+		}
+		f.retire();
+
+		if(race)
+			return Error::futexRace;
+		_completeAll(pending);
+		return numAffected;
+	}
+
+private:
+	// Locks two buckets in a consistent order to avoid deadlocks.
+	struct BucketPairGuard {
+		BucketPairGuard(Bucket *a, Bucket *b)
+		: first_{a < b ? a : b}, second_{a < b ? b : a} {
+			first_->mutex.lock();
+			if(second_ != first_)
+				second_->mutex.lock();
+		}
+
+		BucketPairGuard(const BucketPairGuard &) = delete;
+
+		BucketPairGuard &operator= (const BucketPairGuard &) = delete;
+
+		~BucketPairGuard() {
+			if(second_ != first_)
+				second_->mutex.unlock();
+			first_->mutex.unlock();
+		}
+
+	private:
+		Bucket *first_;
+		Bucket *second_;
+	};
+
+	Bucket *_bucketOf(FutexIdentity id) {
+		// Use the high bits of the hash; the hash map uses the low bits.
+		return &_buckets[(FutexIdentity::Hash{}(id) >> 32) % numBuckets];
+	}
+
+	size_t _wakeLocked(Bucket *bucket, FutexIdentity id, size_t count, uint32_t bitset,
+			NodeList &pending) {
+		auto sit = bucket->slots.get(id);
+		if(!sit)
+			return 0;
+		// Invariant: If the slot exists then its queue is not empty.
+		assert(!sit->queue.empty());
+
+		size_t numWoken = 0;
+		auto nit = sit->queue.begin();
+		while(nit != sit->queue.end() && numWoken < count) {
+			auto node = *nit;
+			assert(!node->result_);
+			++nit;
+			if(!(node->bitset_ & bitset))
+				continue;
+			sit->queue.erase(sit->queue.iterator_to(node));
+
+			if(node->cobs_.try_reset()) {
+				node->result_ = Error::success;
+				pending.push_back(node);
+				++numWoken;
 			}
+		}
+
+		if(sit->queue.empty())
+			bucket->slots.remove(id);
+		return numWoken;
+	}
+
+	size_t _requeueLocked(FutexIdentity from, FutexIdentity to,
+			size_t wakeCount, size_t requeueCount, NodeList &pending) {
+		auto fromBucket = _bucketOf(from);
+		auto toBucket = _bucketOf(to);
+
+		auto numWoken = _wakeLocked(fromBucket, from, wakeCount, anyBitset, pending);
+		if(from == to)
+			return numWoken;
+
+		auto sit = fromBucket->slots.get(from);
+		if(!sit)
+			return numWoken;
+
+		size_t numRequeued = 0;
+		while(!sit->queue.empty() && numRequeued < requeueCount) {
+			auto node = sit->queue.pop_front();
+			assert(!node->result_);
 
-			if(sit->queue.empty())
-				_slots.remove(id);
+			auto tit = toBucket->slots.get(to);
+			if(!tit) {
+				toBucket->slots.insert(to, Slot());
+				tit = toBucket->slots.get(to);
+			}
+
+			node->id_ = to;
+			node->bucket_.store(toBucket, std::memory_order_release);
+			tit->queue.push_back(node);
+			++numRequeued;
 		}
 
+		if(sit->queue.empty())
+			fromBucket->slots.remove(from);
+		return numWoken + numRequeued;
+	}
+
+	static void _completeAll(NodeList &pending) {
 		while(!pending.empty()) {
 			auto node = pending.pop_front();
 			node->complete();
 		}
 	}
 
-private:
-	using Mutex = frg::ticket_spinlock;
-
-	// TODO: use a scalable hash table with fine-grained locks to
-	// improve the scalability of the futex algorithm.
-	Mutex _mutex;
-
-	frg::hash_map<
-		FutexIdentity,
-		Slot,
-		FutexIdentity::Hash,
-		KernelAlloc
-	> _slots;
+	Bucket _buckets[numBuckets];
 };
 
 } // namespace thor
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include <async/recurring-event.hpp>
 #include <frg/expected.hpp>
 #include <frg/list.hpp>
@@ -21,11 +23,16 @@ struct AwaitIrqNode {
 	Error error() { return _error; }
 	uint64_t sequence() { return _sequence; }
 
+	// Called once the waiter runs again; feeds the thor.irq-wakeup tracepoint.
+	void traceWakeup();
+
 private:
 	Worklet *_awaited;
 
 	Error _error;
 	uint64_t _sequence;
+	// Time at which the IRQ was raised (only set if the tracepoint is enabled).
+	uint64_t _raisedAt = 0;
 
 	frg::default_list_hook<AwaitIrqNode> _queueNode;
 };
@@ -187,9 +194,29 @@ public:
 
 	virtual void dumpHardwareState();
 
+	// Routes the IRQ to the given CPU.
+	// Returns Error::noHardwareSupport if the IRQ controller cannot do that.
+	Error setAffinity(int cpu);
+
+	// Returns the CPU that this IRQ is routed to (or -1 if that is not known).
+	virtual int affinity() {
+		return -1;
+	}
+
+	// Number of times that this IRQ was raised. Used to balance IRQs across CPUs.
+	uint64_t raiseCount() {
+		return _raiseCount.load(std::memory_order_relaxed);
+	}
+
 protected:
 	virtual IrqStrategy program(TriggerMode mode, Polarity polarity) = 0;
 
+	// Called with the pin's mutex held.
+	virtual Error retarget(int cpu) {
+		(void)cpu;
+		return Error::noHardwareSupport;
+	}
+
 	virtual void mask() = 0;
 	virtual void unmask() = 0;
 
@@ -207,6 +234,8 @@ private:
 	// Must be protected against IRQs.
 	frg::ticket_spinlock _mutex;
 
+	std::atomic<uint64_t> _raiseCount{0};
+
 	IrqConfiguration _activeCfg;
 
 	IrqStrategy _strategy;
@@ -243,6 +272,21 @@ private:
 	> _sinkList;
 };
 
+struct MsiPin;
+
+// Implemented by devices that own MSIs (e.g., PCI devices).
+struct MsiProgrammer {
+	// Writes the message address and data of the MSI to the device.
+	virtual void programMsi(MsiPin *msi, size_t index) = 0;
+
+	// Returns true if programMsi() masks the MSI while it updates the MSI.
+	// Otherwise, the device could send a message with a partially updated address or data.
+	virtual bool canMaskMsi(size_t index) = 0;
+
+protected:
+	~MsiProgrammer() = default;
+};
+
 struct MsiPin : IrqPin {
 	MsiPin(frg::string<KernelAlloc> name)
 	: IrqPin{std::move(name)} { }
@@ -250,8 +294,31 @@ struct MsiPin : IrqPin {
 	virtual uint64_t getMessageAddress() = 0;
 	virtual uint32_t getMessageData() = 0;
 
+	// Programs the MSI and remembers the device such that
+	// the MSI can be re-programmed when its affinity changes.
+	void bindProgrammer(MsiProgrammer *programmer, size_t index) {
+		_programmer = programmer;
+		_programmerIndex = index;
+		_programmer->programMsi(this, _programmerIndex);
+	}
+
 protected:
 	~MsiPin() = default;
+
+	// Returns true if the MSI can be re-programmed while it is in use.
+	bool canReprogram() {
+		return !_programmer || _programmer->canMaskMsi(_programmerIndex);
+	}
+
+	// Re-programs the MSI after its address or data changed.
+	void reprogram() {
+		if(_programmer)
+			_programmer->programMsi(this, _programmerIndex);
+	}
+
+private:
+	MsiProgrammer *_programmer = nullptr;
+	size_t _programmerIndex = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -278,6 +345,7 @@ struct IrqObject : IrqSink {
 		void start() {
 			worklet_.setup([] (Worklet *base) {
 				auto self = frg::container_of(base, &AwaitIrqOperation::worklet_);
+				self->traceWakeup();
 				if(self->error() != Error::success) {
 					async::execution::set_value(self->r_, self->error());
 				}else{
@@ -340,4 +408,9 @@ struct GenericIrqObject final : IrqObject {
 	: IrqObject{name} { }
 };
 
+// ----------------------------------------------------------------------------
+
+// Enables or disables the periodic migration of busy IRQs to less busy CPUs.
+void setIrqBalancing(bool enable);
+
 } // namespace thor
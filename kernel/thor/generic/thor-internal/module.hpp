@@ -1,5 +1,7 @@
 #pragma once
 
+#include <frg/dyn_array.hpp>
+#include <frg/spinlock.hpp>
 #include <frg/string.hpp>
 #include <frg/vector.hpp>
 #include <thor-internal/address-space.hpp>
@@ -54,6 +56,67 @@ private:
 	frg::vector<Link, KernelAlloc> _entries;
 };
 
+// Memory view of a file in the initrd.
+// Pages whose contents are page-aligned within the initrd module reference the module's
+// physical pages directly. All other pages (including the tail page of the file and pages of
+// compressed files) are materialized on first access. Writes are not supported;
+// users obtain private copies through CopyOnWriteMemory.
+struct InitrdMemory final : MemoryView {
+	// window points to the module's data in kernel virtual memory;
+	// it must stay valid for the lifetime of the view.
+	InitrdMemory(PhysicalAddr modulePhysical, const char *window,
+			size_t dataOffset, size_t dataSize, bool compressed);
+	InitrdMemory(const InitrdMemory &) = delete;
+	~InitrdMemory();
+
+	InitrdMemory &operator= (const InitrdMemory &) = delete;
+
+	// Size of the (uncompressed) file.
+	size_t fileSize() {
+		return _fileSize;
+	}
+
+	size_t getLength() override;
+	frg::expected<Error, frg::tuple<smarter::shared_ptr<GlobalFutexSpace>, uintptr_t>>
+			resolveGlobalFutex(uintptr_t offset) override;
+	coroutine<frg::expected<Error>> copyTo(uintptr_t offset,
+			const void *pointer, size_t size,
+			smarter::shared_ptr<WorkQueue> wq) override;
+	Error lockRange(uintptr_t offset, size_t size) override;
+	void unlockRange(uintptr_t offset, size_t size) override;
+	frg::tuple<PhysicalAddr, CachingMode> peekRange(uintptr_t offset) override;
+	coroutine<frg::expected<Error, PhysicalRange>>
+			fetchRange(uintptr_t offset, FetchFlags flags,
+			smarter::shared_ptr<WorkQueue> wq) override;
+	void markDirty(uintptr_t offset, size_t size) override;
+
+private:
+	// Returns the physical address of the module page that backs the given page of the file,
+	// or PhysicalAddr(-1) if the page needs to be materialized.
+	PhysicalAddr _directPage(size_t index);
+
+	void _materialize(size_t index, void *page);
+
+	frg::ticket_spinlock _mutex;
+
+	PhysicalAddr _modulePhysical;
+	const char *_window;
+	size_t _dataOffset;
+	size_t _dataSize;
+	bool _compressed;
+	size_t _fileSize;
+	size_t _length;
+
+	// Offsets of the compressed chunks (one per page), relative to the start of the data.
+	const uint32_t *_chunkTable = nullptr;
+
+	// Materialized pages. Protected by _mutex.
+	frg::dyn_array<PhysicalAddr, KernelAlloc> _pages;
+};
+
+// Initrd files with this value in the CPIO check field are compressed, see InitrdMemory.
+inline constexpr uint32_t initrdCompressedCheck = 0x544C5A34; // "TLZ4"
+
 struct MfsRegular : MfsNode {
 	MfsRegular(smarter::shared_ptr<MemoryView> memory, size_t size)
 	: MfsNode{MfsType::regular}, _memory{std::move(memory)}, _size{size} {
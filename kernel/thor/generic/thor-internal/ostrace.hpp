@@ -12,30 +12,101 @@ extern bool wantOsTrace;
 extern std::atomic<bool> osTraceInUse;
 
 enum class OsTraceEventId : uint64_t { };
+enum class OsTraceItemId : uint64_t { };
+
+// Fixed-layout event record. In contrast to the bragi records that end up in the
+// global ring, these records can be emitted without allocating memory.
+struct OsTraceRecord {
+	static constexpr size_t maxCounters = 6;
+
+	struct Counter {
+		uint64_t id;
+		int64_t value;
+	};
+
+	uint64_t ts;
+	uint64_t id;
+	size_t numCounters;
+	Counter counters[maxCounters];
+};
+
+// Lock-free single-producer single-consumer ring of OsTraceRecords.
+// The producer is the CPU that owns the ring (with IRQs disabled);
+// the consumer is the fiber that drains the ring into the global ring.
+// If the ring is full, records are dropped (and counted).
+struct OsTraceRing {
+	static constexpr size_t numSlots = 2048;
+
+	void push(const OsTraceRecord &record) {
+		auto head = head_.load(std::memory_order_relaxed);
+		if(head - tail_.load(std::memory_order_acquire) == numSlots) {
+			// Only the producer writes this counter.
+			drops_.store(drops_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+
+		slots_[head & (numSlots - 1)] = record;
+		head_.store(head + 1, std::memory_order_release);
+	}
+
+	bool pop(OsTraceRecord &record) {
+		auto tail = tail_.load(std::memory_order_relaxed);
+		if(tail == head_.load(std::memory_order_acquire))
+			return false;
+
+		record = slots_[tail & (numSlots - 1)];
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	uint64_t drops() {
+		return drops_.load(std::memory_order_relaxed);
+	}
+
+private:
+	// Producer and consumer indices live on separate cache lines.
+	alignas(64) std::atomic<uint64_t> head_{0};
+	std::atomic<uint64_t> drops_{0};
+	alignas(64) std::atomic<uint64_t> tail_{0};
+	alignas(64) OsTraceRecord slots_[numSlots];
+};
 
 LogRingBuffer *getGlobalOsTraceRing();
 
 OsTraceEventId announceOsTraceEvent(frg::string_view name);
-void emitOsTrace(managarm::ostrace::EventRecord<KernelAlloc> record);
+OsTraceItemId announceOsTraceItem(frg::string_view name);
+
+// Sets the timestamp of the record and enqueues it into the current CPU's ring.
+// Can be called from any context (it never allocates).
+void emitOsTrace(OsTraceRecord &record);
 
 initgraph::Stage *getOsTraceAvailableStage();
 
 struct OsTraceEvent {
 	OsTraceEvent(OsTraceEventId id) {
 		live_ = osTraceInUse.load(std::memory_order_relaxed);
-		if(live_)
-			rec_.set_id(static_cast<uint64_t>(id));
+		if(live_) {
+			rec_.id = static_cast<uint64_t>(id);
+			rec_.numCounters = 0;
+		}
+	}
+
+	void withCounter(OsTraceItemId id, int64_t value) {
+		if(!live_)
+			return;
+		assert(rec_.numCounters < OsTraceRecord::maxCounters);
+		rec_.counters[rec_.numCounters++] = {static_cast<uint64_t>(id), value};
 	}
 
 	void emit() {
 		if(!live_)
 			return;
-		emitOsTrace(std::move(rec_));
+		emitOsTrace(rec_);
 	}
 
 private:
 	bool live_; // Whether we emit an event at all.
-	managarm::ostrace::EventRecord<KernelAlloc> rec_{*kernelAlloc};
+	OsTraceRecord rec_;
 };
 
 } // namespace thor
@@ -124,6 +124,9 @@ public:
 
 	StreamNode *peerNode = nullptr;
 
+	// Time at which the node was queued (only set if the thor.offer-accept tracepoint is enabled).
+	uint64_t _queuedAt = 0;
+
 	async::oneshot_event issueFlow;
 	async::queue<FlowPacket, KernelAlloc> flowQueue{*kernelAlloc};
 
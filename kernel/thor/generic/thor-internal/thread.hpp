@@ -184,6 +184,10 @@ public:
 	static void killOther(smarter::borrowed_ptr<Thread> thread);
 	static void interruptOther(smarter::borrowed_ptr<Thread> thread);
 	static Error resumeOther(smarter::borrowed_ptr<Thread> thread);
+	// Like resumeOther() but also stores the results of the thread's supercall.
+	// The results are only stored if the thread is interrupted (and is thus resumed).
+	static Error resumeOther(smarter::borrowed_ptr<Thread> thread,
+			Word result0, Word result1, Word result2);
 
 	// These signals let the thread change its RunState.
 	// Do not confuse them with POSIX signals!
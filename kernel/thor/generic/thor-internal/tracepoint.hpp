@@ -0,0 +1,96 @@
+#pragma once
+
+#include <assert.h>
+#include <atomic>
+
+#include <frg/string.hpp>
+#include <thor-internal/ostrace.hpp>
+
+namespace thor {
+
+// Histogram with power-of-two buckets.
+// Bucket k > 0 counts values v with 2^(k - 1) <= v < 2^k, bucket 0 counts zeros.
+struct Log2Histogram {
+	static constexpr size_t numBuckets = 65;
+
+	void record(uint64_t value) {
+		size_t k = value ? 64 - __builtin_clzll(value) : 0;
+		buckets[k].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64_t> buckets[numBuckets]{};
+};
+
+// Tracepoints are always compiled into the kernel but they are disabled by default.
+// While a tracepoint is disabled, checking enabled() is the only cost at the call site.
+// Enabled tracepoints record values (usually, latencies in ns) into in-kernel histograms
+// and additionally emit ostrace events if ostrace is in use.
+// Tracepoints are toggled and read out via kerncfg.
+struct Tracepoint {
+	static Tracepoint *first();
+	static Tracepoint *find(frg::string_view name);
+
+	Tracepoint(const char *name, Log2Histogram *histograms = nullptr, size_t numHistograms = 0);
+
+	Tracepoint(const Tracepoint &) = delete;
+
+	Tracepoint &operator= (const Tracepoint &) = delete;
+
+	const char *name() {
+		return name_;
+	}
+
+	Tracepoint *next() {
+		return next_;
+	}
+
+	bool enabled() {
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	// Must be called from a context that can allocate (as it might announce the ostrace event).
+	void setEnabled(bool enable);
+
+	size_t numHistograms() {
+		return numHistograms_;
+	}
+
+	Log2Histogram &histogram(size_t index) {
+		assert(index < numHistograms_);
+		return histograms_[index];
+	}
+
+	// Records the value into histogram #index (if the tracepoint has histograms).
+	// Can be called from any context. Callers check enabled() first.
+	void record(uint64_t value, size_t index = 0);
+
+private:
+	const char *name_;
+	Tracepoint *next_;
+	Log2Histogram *histograms_;
+	size_t numHistograms_;
+	std::atomic<bool> enabled_{false};
+	// Zero until the ostrace event is announced.
+	std::atomic<uint64_t> osTraceId_{0};
+};
+
+// Tracepoint with N histograms, e.g., one histogram per syscall number.
+template<size_t N>
+struct HistogramTracepoint : Tracepoint {
+	HistogramTracepoint(const char *name)
+	: Tracepoint{name, histograms_, N} { }
+
+private:
+	Log2Histogram histograms_[N];
+};
+
+// Sent IPIs. Histogram #0 counts pings and histogram #1 counts TLB shootdowns;
+// the recorded value is always zero (i.e., all IPIs land in bucket 0).
+enum : size_t {
+	ipiTraceIndexPing = 0,
+	ipiTraceIndexShootdown = 1
+};
+
+extern HistogramTracepoint<2> ipiTracepoint;
+
+} // namespace thor
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <frg/dyn_array.hpp>
+#include <frg/manual_box.hpp>
 #include <frg/variant.hpp>
+#include <frg/vector.hpp>
 #include <assert.h>
 #include <smarter.hpp>
 #include <thor-internal/mm-rc.hpp>
@@ -240,6 +244,24 @@ typedef frg::variant<
 // Universe.
 // --------------------------------------------------------
 
+// Descriptors are stored in a two-level table that is indexed by the lower 32 bits
+// of the handle. The upper bits of the handle contain a generation number that
+// distinguishes descriptors that occupy the same slot over time.
+//
+// fetchDescriptor() does not take the lock. Instead, readers announce themselves
+// in the slot and detachDescriptor() waits for them before it destructs the descriptor.
+// Chunks and tables are never freed before the universe itself is destructed,
+// such that lock-free readers can always access them.
+struct DescriptorSlot {
+	// Odd iff the slot is occupied.
+	std::atomic<uint32_t> generation{0};
+
+	// Number of lock-free readers that currently access the slot.
+	std::atomic<uint32_t> readers{0};
+
+	frg::manual_box<AnyDescriptor> descriptor;
+};
+
 struct Universe {
 public:
 	typedef frg::ticket_spinlock Lock;
@@ -250,21 +272,43 @@ public:
 
 	Handle attachDescriptor(Guard &guard, AnyDescriptor descriptor);
 
+	// The returned pointer is only valid while the lock is held.
 	AnyDescriptor *getDescriptor(Guard &guard, Handle handle);
 
+	// Returns a copy of the descriptor. Does not take the lock.
+	frg::optional<AnyDescriptor> fetchDescriptor(Handle handle);
+
 	frg::optional<AnyDescriptor> detachDescriptor(Guard &guard, Handle handle);
 
+	// Serializes attachDescriptor(), detachDescriptor() and getDescriptor().
 	Lock lock;
 
 private:
-	frg::hash_map<
-		Handle,
-		AnyDescriptor,
-		frg::hash<Handle>,
-		KernelAlloc
-	> _descriptorMap;
-
-	Handle _nextHandle;
+	static constexpr size_t slotsPerChunk = 64;
+	static constexpr size_t initialChunks = 8;
+
+	struct DescriptorChunk {
+		DescriptorSlot slots[slotsPerChunk];
+	};
+
+	struct ChunkTable {
+		ChunkTable(size_t numChunks)
+		: chunks{numChunks, *kernelAlloc} { }
+
+		frg::dyn_array<std::atomic<DescriptorChunk *>, KernelAlloc> chunks;
+	};
+
+	DescriptorSlot *_findSlot(uint64_t index);
+
+	DescriptorSlot *_allocateSlot(uint32_t &index);
+
+	std::atomic<ChunkTable *> _table;
+
+	// Tables that were replaced by larger ones. Lock-free readers may still access them.
+	frg::vector<ChunkTable *, KernelAlloc> _retiredTables;
+
+	frg::vector<uint32_t, KernelAlloc> _freeSlots;
+	uint32_t _numSlots;
 };
 
 } // namespace thor
@@ -374,6 +374,30 @@ Error Thread::resumeOther(smarter::borrowed_ptr<Thread> thread) {
 	return Error::success;
 }
 
+Error Thread::resumeOther(smarter::borrowed_ptr<Thread> thread,
+		Word result0, Word result1, Word result2) {
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&thread->_mutex);
+
+	if(thread->_runState == kRunTerminated)
+		return Error::threadExited;
+	if(thread->_runState != kRunInterrupted)
+		return Error::illegalState;
+
+	// The thread cannot run while we hold its lock and it is interrupted.
+	*thread->_executor.result0() = result0;
+	*thread->_executor.result1() = result1;
+	*thread->_executor.result2() = result2;
+
+	if(logRunStates)
+		infoLogger() << "thor: " << (void *)thread.get()
+				<< " is suspended (via resume)" << frg::endlog;
+
+	thread->_runState = kRunSuspended;
+	Scheduler::resume(thread.get());
+	return Error::success;
+}
+
 Thread::Thread(smarter::shared_ptr<Universe> universe,
 		smarter::shared_ptr<AddressSpace, BindableHandle> address_space, AbiParameters abi)
 : flags{0}, _mainWorkQueue{this}, _pagingWorkQueue{this},
@@ -0,0 +1,73 @@
+#include <thor-internal/tracepoint.hpp>
+#include <thor-internal/cpu-data.hpp>
+
+namespace thor {
+
+namespace {
+
+constinit Tracepoint *tracepointList = nullptr;
+
+// ostrace items that are shared by all tracepoints.
+constinit frg::ticket_spinlock itemMutex;
+constinit uint64_t valueItem = 0;
+constinit uint64_t indexItem = 0;
+
+} // anonymous namespace
+
+HistogramTracepoint<2> ipiTracepoint{"thor.ipi"};
+
+Tracepoint *Tracepoint::first() {
+	return tracepointList;
+}
+
+Tracepoint *Tracepoint::find(frg::string_view name) {
+	for(auto tp = tracepointList; tp; tp = tp->next_) {
+		if(name == frg::string_view{tp->name_})
+			return tp;
+	}
+	return nullptr;
+}
+
+// Tracepoints are global objects; they are registered during static initialization.
+Tracepoint::Tracepoint(const char *name, Log2Histogram *histograms, size_t numHistograms)
+: name_{name}, next_{tracepointList}, histograms_{histograms}, numHistograms_{numHistograms} {
+	tracepointList = this;
+}
+
+void Tracepoint::setEnabled(bool enable) {
+	if(enable && osTraceInUse.load(std::memory_order_relaxed)
+			&& !osTraceId_.load(std::memory_order_relaxed)) {
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			auto lock = frg::guard(&itemMutex);
+
+			if(!valueItem) {
+				valueItem = static_cast<uint64_t>(announceOsTraceItem("value"));
+				indexItem = static_cast<uint64_t>(announceOsTraceItem("index"));
+			}
+		}
+
+		osTraceId_.store(static_cast<uint64_t>(announceOsTraceEvent(name_)),
+				std::memory_order_relaxed);
+	}
+
+	enabled_.store(enable, std::memory_order_relaxed);
+}
+
+void Tracepoint::record(uint64_t value, size_t index) {
+	if(numHistograms_)
+		histogram(index).record(value);
+
+	auto id = osTraceId_.load(std::memory_order_relaxed);
+	if(!id)
+		return;
+
+	OsTraceRecord rec;
+	rec.id = id;
+	rec.numCounters = 2;
+	rec.counters[0] = {valueItem, static_cast<int64_t>(value)};
+	rec.counters[1] = {indexItem, static_cast<int64_t>(index)};
+	emitOsTrace(rec);
+}
+
+} // namespace thor
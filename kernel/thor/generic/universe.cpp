@@ -1,37 +1,155 @@
+#include <thor-internal/cpu-data.hpp>
 #include <thor-internal/universe.hpp>
 
 namespace thor {
 
 namespace {
 	constexpr bool logCleanup = false;
+
+	// Generations are stored in 31 bits such that handles are always positive.
+	constexpr uint32_t generationMask = 0x7FFF'FFFF;
+
+	uint64_t handleIndex(Handle handle) {
+		return static_cast<uint64_t>(handle) & 0xFFFF'FFFF;
+	}
+
+	uint32_t handleGeneration(Handle handle) {
+		return static_cast<uint64_t>(handle) >> 32;
+	}
 }
 
 Universe::Universe()
-: _descriptorMap{frg::hash<Handle>{}, *kernelAlloc}, _nextHandle{1} { }
+: _table{frg::construct<ChunkTable>(*kernelAlloc, initialChunks)},
+		_retiredTables{*kernelAlloc}, _freeSlots{*kernelAlloc}, _numSlots{0} { }
 
 Universe::~Universe() {
 	if(logCleanup)
 		infoLogger() << "\e[31mthor: Universe is deallocated\e[39m" << frg::endlog;
+
+	auto table = _table.load(std::memory_order_relaxed);
+	for(size_t i = 0; i < table->chunks.size(); i++) {
+		auto chunk = table->chunks[i].load(std::memory_order_relaxed);
+		if(!chunk)
+			continue;
+		for(auto &slot : chunk->slots) {
+			if(slot.generation.load(std::memory_order_relaxed) & 1)
+				slot.descriptor.destruct();
+		}
+		frg::destruct(*kernelAlloc, chunk);
+	}
+	frg::destruct(*kernelAlloc, table);
+
+	for(size_t i = 0; i < _retiredTables.size(); i++)
+		frg::destruct(*kernelAlloc, _retiredTables[i]);
+}
+
+DescriptorSlot *Universe::_findSlot(uint64_t index) {
+	auto table = _table.load(std::memory_order_acquire);
+	auto chunkIndex = index / slotsPerChunk;
+	if(chunkIndex >= table->chunks.size())
+		return nullptr;
+	auto chunk = table->chunks[chunkIndex].load(std::memory_order_acquire);
+	if(!chunk)
+		return nullptr;
+	return &chunk->slots[index % slotsPerChunk];
+}
+
+DescriptorSlot *Universe::_allocateSlot(uint32_t &index) {
+	if(_freeSlots.size()) {
+		index = _freeSlots.back();
+		_freeSlots.pop();
+		return _findSlot(index);
+	}
+
+	index = _numSlots++;
+	auto chunkIndex = index / slotsPerChunk;
+
+	// Grow the table if necessary. The old table is retired (and not freed)
+	// since lock-free readers may still access it.
+	auto table = _table.load(std::memory_order_relaxed);
+	if(chunkIndex >= table->chunks.size()) {
+		auto newTable = frg::construct<ChunkTable>(*kernelAlloc, 2 * table->chunks.size());
+		for(size_t i = 0; i < table->chunks.size(); i++)
+			newTable->chunks[i].store(table->chunks[i].load(std::memory_order_relaxed),
+					std::memory_order_relaxed);
+		_table.store(newTable, std::memory_order_release);
+		_retiredTables.push(table);
+		table = newTable;
+	}
+
+	if(!table->chunks[chunkIndex].load(std::memory_order_relaxed))
+		table->chunks[chunkIndex].store(frg::construct<DescriptorChunk>(*kernelAlloc),
+				std::memory_order_release);
+	return _findSlot(index);
 }
 
 Handle Universe::attachDescriptor(Guard &guard, AnyDescriptor descriptor) {
 	assert(guard.protects(&lock));
 
-	Handle handle = _nextHandle++;
-	_descriptorMap.insert(handle, std::move(descriptor));
-	return handle;
+	uint32_t index;
+	auto slot = _allocateSlot(index);
+	assert(slot);
+
+	auto generation = (slot->generation.load(std::memory_order_relaxed) + 1) & generationMask;
+	assert(generation & 1);
+	slot->descriptor.initialize(std::move(descriptor));
+	slot->generation.store(generation, std::memory_order_release);
+
+	return (static_cast<Handle>(generation) << 32) | index;
 }
 
 AnyDescriptor *Universe::getDescriptor(Guard &guard, Handle handle) {
 	assert(guard.protects(&lock));
 
-	return _descriptorMap.get(handle);
+	if(handle <= 0)
+		return nullptr;
+	auto slot = _findSlot(handleIndex(handle));
+	if(!slot || slot->generation.load(std::memory_order_relaxed) != handleGeneration(handle))
+		return nullptr;
+	return slot->descriptor.get();
+}
+
+frg::optional<AnyDescriptor> Universe::fetchDescriptor(Handle handle) {
+	if(handle <= 0)
+		return frg::null_opt;
+	auto slot = _findSlot(handleIndex(handle));
+	if(!slot)
+		return frg::null_opt;
+
+	// Keep IRQs disabled such that detachDescriptor() never waits for a preempted reader.
+	auto irqLock = frg::guard(&irqMutex());
+
+	// Announcing the reader before checking the generation pairs with
+	// detachDescriptor(), which changes the generation before it checks for readers.
+	frg::optional<AnyDescriptor> descriptor;
+	slot->readers.fetch_add(1, std::memory_order_seq_cst);
+	if(slot->generation.load(std::memory_order_seq_cst) == handleGeneration(handle))
+		descriptor = *slot->descriptor;
+	slot->readers.fetch_sub(1, std::memory_order_release);
+	return descriptor;
 }
 
 frg::optional<AnyDescriptor> Universe::detachDescriptor(Guard &guard, Handle handle) {
 	assert(guard.protects(&lock));
 
-	return _descriptorMap.remove(handle);
+	if(handle <= 0)
+		return frg::null_opt;
+	auto index = handleIndex(handle);
+	auto slot = _findSlot(index);
+	if(!slot || slot->generation.load(std::memory_order_relaxed) != handleGeneration(handle))
+		return frg::null_opt;
+
+	slot->generation.store((handleGeneration(handle) + 1) & generationMask,
+			std::memory_order_seq_cst);
+
+	// Wait until concurrent lock-free readers are done copying the descriptor.
+	while(slot->readers.load(std::memory_order_seq_cst))
+		;
+
+	frg::optional<AnyDescriptor> descriptor{std::move(*slot->descriptor)};
+	slot->descriptor.destruct();
+	_freeSlots.push(index);
+	return descriptor;
 }
 
 } // namespace thor
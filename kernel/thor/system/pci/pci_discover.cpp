@@ -765,9 +765,8 @@ void PciDevice::setupMsi(MsiPin *msi, size_t index) {
 
 	if (msixIndex >= 0) {
 		// Setup the MSI-X table.
+		msi->bindProgrammer(this, index);
 		auto space = arch::mem_space{msixMapping}.subspace(index * 16);
-		space.store(msixMessageAddress, msi->getMessageAddress());
-		space.store(msixMessageData, msi->getMessageData());
 		space.store(msixVectorControl,
 				space.load(msixVectorControl) & ~uint32_t{1});
 	} else {
@@ -780,13 +779,48 @@ void PciDevice::setupMsi(MsiPin *msi, size_t index) {
 		auto msgControl = io->readConfigHalf(parentBus,
 				slot, function, offset + 2);
 
-		bool is64Capable = msgControl & (1 << 7);
-
 		msgControl &= ~0x0071; // Disable MSI by default, enable only 1 message
 
 		io->writeConfigHalf(parentBus,
 				slot, function, offset + 2, msgControl);
 
+		msi->bindProgrammer(this, index);
+	}
+}
+
+void PciDevice::programMsi(MsiPin *msi, size_t index) {
+	auto io = parentBus->io;
+
+	if (msixIndex >= 0) {
+		// Mask the vector while we update it (if it is not masked already).
+		auto space = arch::mem_space{msixMapping}.subspace(index * 16);
+		auto control = space.load(msixVectorControl);
+		space.store(msixVectorControl, control | 1);
+		space.store(msixMessageAddress, msi->getMessageAddress());
+		space.store(msixMessageData, msi->getMessageData());
+		space.store(msixVectorControl, control);
+		// Flush the posted writes.
+		space.load(msixVectorControl);
+	} else {
+		assert(msiIndex >= 0);
+		auto offset = caps[msiIndex].offset;
+
+		auto msgControl = io->readConfigHalf(parentBus,
+				slot, function, offset + 2);
+
+		bool is64Capable = msgControl & (1 << 7);
+		bool maskCapable = msgControl & (1 << 8);
+
+		// Mask the MSI while we update it (if the device supports per-vector masking).
+		auto maskOffset = offset + (is64Capable ? 16 : 12);
+		uint32_t maskBits = 0;
+		if (maskCapable) {
+			maskBits = io->readConfigWord(parentBus,
+					slot, function, maskOffset);
+			io->writeConfigWord(parentBus,
+					slot, function, maskOffset, maskBits | 1);
+		}
+
 		io->writeConfigWord(parentBus,
 				slot, function, offset + 4, msi->getMessageAddress() & 0xFFFFFFFF);
 
@@ -802,9 +836,24 @@ void PciDevice::setupMsi(MsiPin *msi, size_t index) {
 			io->writeConfigHalf(parentBus,
 				slot, function, offset + 8, msi->getMessageData());
 		}
+
+		if (maskCapable)
+			io->writeConfigWord(parentBus,
+					slot, function, maskOffset, maskBits);
 	}
 }
 
+bool PciDevice::canMaskMsi(size_t) {
+	if (msixIndex >= 0)
+		return true;
+
+	assert(msiIndex >= 0);
+	auto offset = caps[msiIndex].offset;
+	auto msgControl = parentBus->io->readConfigHalf(parentBus,
+			slot, function, offset + 2);
+	return msgControl & (1 << 8);
+}
+
 void PciDevice::enableMsi() {
 	auto io = parentBus->io;
 
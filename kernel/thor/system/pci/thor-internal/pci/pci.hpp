@@ -281,7 +281,7 @@ struct PciBridge final : PciEntity {
 	uint32_t subordinateId;
 };
 
-struct PciDevice final : PciEntity {
+struct PciDevice final : PciEntity, MsiProgrammer {
 
 	PciDevice(PciBus *parentBus_, uint32_t seg, uint32_t bus, uint32_t slot, uint32_t function,
 			uint16_t vendor, uint16_t device_id, uint8_t revision,
@@ -300,6 +300,10 @@ struct PciDevice final : PciEntity {
 	void setupMsi(MsiPin *msi, size_t index);
 	void enableMsi();
 
+	// Writes the MSI address and data to the MSI capability or MSI-X table.
+	void programMsi(MsiPin *msi, size_t index) override;
+	bool canMaskMsi(size_t index) override;
+
 	// mbus object ID of the device
 	int64_t mbusId;
 
@@ -1,81 +1,211 @@
-
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
 #include <sys/mount.h>
+#include <sys/signalfd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
-int main() {
-	int fd = open("/dev/helout", O_WRONLY);
-	dup2(fd, STDOUT_FILENO);
-	dup2(fd, STDERR_FILENO);
+namespace {
 
-	std::cout <<"init: Entering first stage" << std::endl;
+// Device node (below /dev) that holds the root file system.
+constexpr const char *rootDevice = "sda0";
+
+struct Service {
+	const char *name;
+	const char *action; // Passed to runsvr.
+	const char *path;
+	// Device node (below /dev) that must exist before the service is started.
+	const char *afterDevice;
 
+	pid_t pid = -1;
+	uint64_t execTime = 0;
+	uint64_t readyTime = 0;
+};
+
+// Essential bus and storage drivers. Services without a dependency are
+// started concurrently; the others are started as soon as their device appears.
+Service services[] = {
 #if defined (__x86_64__)
-	auto uart = fork();
-	if(!uart) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/uart", nullptr);
-	}else assert(uart != -1);
+	{"uart", "runsvr", "/sbin/uart", nullptr},
 #endif
+	{"ehci", "runsvr", "/sbin/ehci", nullptr},
+	{"xhci", "runsvr", "/sbin/xhci", nullptr},
+	{"virtio-block", "runsvr", "/sbin/virtio-block", nullptr},
+#if defined (__x86_64__)
+	{"block-ata", "runsvr", "/sbin/block-ata", nullptr},
+#endif
+	{"block-ahci", "run", "/lib/block-ahci.bin", nullptr},
+	{"block-nvme", "runsvr", "/sbin/block-nvme", nullptr},
+	{"storage", "runsvr", "/sbin/storage", nullptr},
+#if defined (__x86_64__)
+	// Hack: Start UHCI only after EHCI devices are ready.
+	{"uhci", "runsvr", "/sbin/uhci", rootDevice},
+#endif
+};
 
-	// Start essential bus and storage drivers.
-	auto ehci = fork();
-	if(!ehci) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/ehci", nullptr);
-	}else assert(ehci != -1);
+uint64_t bootClock() {
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC, &ts))
+		throw std::runtime_error("clock_gettime() failed");
+	return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
 
-	auto xhci = fork();
-	if(!xhci) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/xhci", nullptr);
-	}else assert(xhci != -1);
+bool deviceExists(const char *name) {
+	std::string path = "/dev/";
+	path += name;
+	if(!access(path.c_str(), F_OK))
+		return true;
+	assert(errno == ENOENT);
+	return false;
+}
 
-	auto virtio = fork();
-	if(!virtio) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/virtio-block", nullptr);
-	}else assert(virtio != -1);
+void startService(Service &service, const sigset_t &origMask) {
+	service.execTime = bootClock();
+	service.pid = fork();
+	if(!service.pid) {
+		sigprocmask(SIG_SETMASK, &origMask, nullptr);
+		execl("/bin/runsvr", "/bin/runsvr", service.action, service.path, nullptr);
+		abort();
+	}else assert(service.pid != -1);
+}
 
-#if defined (__x86_64__)
-	auto block_ata = fork();
-	if(!block_ata) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/block-ata", nullptr);
-	}else assert(block_ata != -1);
-#endif
+void printTimeline(uint64_t bootTime, uint64_t rootTime) {
+	auto ms = [&] (uint64_t t) {
+		return (t - bootTime) / 1'000'000;
+	};
+
+	std::cout << "init: Boot timeline (ms since stage1):" << std::endl;
+	for(auto &service : services) {
+		std::cout << "init:     " << service.name << ": exec +" << ms(service.execTime);
+		if(service.readyTime)
+			std::cout << ", ready +" << ms(service.readyTime)
+					<< " (" << ms(service.readyTime) - ms(service.execTime) << " ms)";
+		else
+			std::cout << ", still starting";
+		std::cout << std::endl;
+	}
+	std::cout << "init:     /dev/" << rootDevice << ": +" << ms(rootTime) << std::endl;
+}
+
+} // anonymous namespace
+
+int main() {
+	int fd = open("/dev/helout", O_WRONLY);
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
 
-	auto block_ahci = fork();
-	if(!block_ahci) {
-		execl("/bin/runsvr", "/bin/runsvr", "run", "/lib/block-ahci.bin", nullptr);
-	}else assert(block_ahci != -1);
-
-	auto block_nvme = fork();
-	if(!block_nvme) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/block-nvme", nullptr);
-	}else assert(block_nvme != -1);
-
-	auto block_usb = fork();
-	if(!block_usb) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/storage", nullptr);
-	}else assert(block_usb != -1);
-
-	// Spin until /dev/sda0 becomes available. Then mount the rootfs and prepare it.
-	while(access("/dev/sda0", F_OK)) {
-		assert(errno == ENOENT);
-		std::cout << "Waiting for /dev/sda0" << std::endl;
-		sleep(1);
+	std::cout <<"init: Entering first stage" << std::endl;
+	auto bootTime = bootClock();
+
+	// Watch /dev before starting any driver such that we never miss a device.
+	int inotifyFd = inotify_init1(IN_CLOEXEC);
+	if(inotifyFd < 0)
+		throw std::runtime_error("inotify_init1() failed");
+	if(inotify_add_watch(inotifyFd, "/dev", IN_CREATE) < 0)
+		throw std::runtime_error("inotify_add_watch() failed");
+
+	// Learn about exiting runsvr instances (i.e., started servers) via SIGCHLD.
+	sigset_t childMask, origMask;
+	sigemptyset(&childMask);
+	sigaddset(&childMask, SIGCHLD);
+	if(sigprocmask(SIG_BLOCK, &childMask, &origMask))
+		throw std::runtime_error("sigprocmask() failed");
+	int signalFd = signalfd(-1, &childMask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if(signalFd < 0)
+		throw std::runtime_error("signalfd() failed");
+
+	int epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(epollFd < 0)
+		throw std::runtime_error("epoll_create1() failed");
+	for(int watchedFd : {inotifyFd, signalFd}) {
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(struct epoll_event));
+		ev.events = EPOLLIN;
+		ev.data.fd = watchedFd;
+		if(epoll_ctl(epollFd, EPOLL_CTL_ADD, watchedFd, &ev))
+			throw std::runtime_error("epoll_ctl() failed");
 	}
 
-#if defined (__x86_64__)
-	// Hack: Start UHCI only after EHCI devices are ready.
-	auto uhci = fork();
-	if(!uhci) {
-		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/uhci", nullptr);
-	}else assert(uhci != -1);
-#endif
+	// Wait until /dev/sda0 becomes available, starting services as their dependencies appear.
+	// Device nodes are re-checked after every event since they may appear
+	// before their service is considered (or before the watch was added).
+	uint64_t rootTime = 0;
+	while(true) {
+		size_t numPending = 0;
+		for(auto &service : services) {
+			if(service.pid != -1)
+				continue;
+			if(!service.afterDevice || deviceExists(service.afterDevice)) {
+				startService(service, origMask);
+			}else{
+				numPending++;
+			}
+		}
+
+		if(!rootTime && deviceExists(rootDevice))
+			rootTime = bootClock();
+		if(rootTime && !numPending)
+			break;
+
+		struct epoll_event events[2];
+		int n = epoll_wait(epollFd, events, 2, -1);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			throw std::runtime_error("epoll_wait() failed");
+		}
+
+		for(int i = 0; i < n; i++) {
+			if(events[i].data.fd == inotifyFd) {
+				alignas(struct inotify_event) char buffer[sizeof(struct inotify_event) + NAME_MAX + 1];
+				auto size = read(inotifyFd, buffer, sizeof(buffer));
+				if(size < 0)
+					throw std::runtime_error("read() from inotify failed");
+				for(ssize_t offset = 0; offset < size; ) {
+					auto ev = reinterpret_cast<struct inotify_event *>(buffer + offset);
+					if(ev->len)
+						std::cout << "init: /dev/" << ev->name << " appeared" << std::endl;
+					offset += sizeof(struct inotify_event) + ev->len;
+				}
+			}else{
+				assert(events[i].data.fd == signalFd);
+				struct signalfd_siginfo si;
+				while(read(signalFd, &si, sizeof(struct signalfd_siginfo)) > 0)
+					;
+
+				pid_t pid;
+				while((pid = waitpid(-1, nullptr, WNOHANG)) > 0) {
+					for(auto &service : services) {
+						if(service.pid == pid)
+							service.readyTime = bootClock();
+					}
+				}
+			}
+		}
+	}
+
+	printTimeline(bootTime, rootTime);
+
+	close(epollFd);
+	close(signalFd);
+	close(inotifyFd);
+	if(sigprocmask(SIG_SETMASK, &origMask, nullptr))
+		throw std::runtime_error("sigprocmask() failed");
 
 	std::cout << "init: Mounting /dev/sda0" << std::endl;
 	if(mount("/dev/sda0", "/realfs", "ext2", 0, ""))
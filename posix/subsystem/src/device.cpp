@@ -340,8 +340,12 @@ async::result<void> serveServerLane(helix::UniqueDescriptor lane) {
 
 			auto fd = process->fileContext()->attachFile(file);
 
-			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			if(fd) {
+				resp.set_error(managarm::posix::Errors::SUCCESS);
+				resp.set_fd(fd.value());
+			}else{
+				resp.set_error(managarm::posix::Errors::TOO_MANY_FILES);
+			}
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
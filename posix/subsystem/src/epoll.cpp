@@ -13,6 +13,9 @@ namespace {
 
 bool logEpoll = false;
 
+// Flags of epoll_event::events that do not correspond to poll events.
+constexpr int epollFlags = EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE;
+
 struct OpenFile : File {
 	// ------------------------------------------------------------------------
 	// Internal API.
@@ -42,11 +45,19 @@ private:
 		smarter::shared_ptr<Item> item;
 	};
 
-	struct Item : boost::intrusive::list_base_hook<> {
+	// Items of files that support PollObservers are pushed to the pending queue
+	// (i.e., the ready list) by the file itself. For all other files,
+	// we call pollWait() on the file once the item stops being pending.
+	struct Item : boost::intrusive::list_base_hook<>, PollObserver {
 		Item(smarter::shared_ptr<OpenFile> epoll, Process *process,
 				smarter::shared_ptr<File> file, int mask, uint64_t cookie)
 		: epoll{epoll}, state{stateActive}, process{process},
-				file{std::move(file)}, eventMask{mask}, cookie{cookie} { }
+				file{std::move(file)}, eventMask{mask & ~epollFlags},
+				flags{mask & epollFlags}, cookie{cookie} { }
+
+		bool observePoll(int edges) override {
+			return epoll->_observeItem(this, edges);
+		}
 
 		smarter::shared_ptr<OpenFile> epoll;
 		State state;
@@ -55,8 +66,15 @@ private:
 		Process *process;
 		smarter::shared_ptr<File> file;
 		int eventMask;
+		int flags;
 		uint64_t cookie;
 
+		// Whether the item is registered as a PollObserver of the file.
+		bool observing = false;
+
+		// EPOLLONESHOT items are disabled after they are reported once.
+		bool disabled = false;
+
 		async::cancellation_event cancelPoll;
 
 		frg::manual_box<
@@ -108,14 +126,7 @@ private:
 			// Note that we stop watching once an item becomes pending.
 			// We do this as we have to pollStatus() again anyway before we report the item.
 			item->state &= ~statePolling;
-			if(!(item->state & statePending)) {
-				item->state |= statePending;
-
-				item->self.lock().ctr()->increment();
-				self->_pendingQueue.push_back(*item);
-				self->_currentSeq++;
-				self->_statusBell.raise();
-			}
+			self->_makePending(item);
 		}else{
 			// Here, we assume that the lambda does not execute on the current stack.
 			// TODO: Use some callback queueing mechanism to ensure this.
@@ -140,6 +151,54 @@ private:
 		}
 	}
 
+	// Called by files that support PollObservers.
+	bool _observeItem(Item *item, int edges) {
+		if(!(item->state & stateActive) || item->disabled)
+			return false;
+		if(!(edges & (item->eventMask | EPOLLERR | EPOLLHUP)))
+			return false;
+		if(logEpoll)
+			std::cout << "posix.epoll \e[1;34m" << structName() << "\e[0m"
+					<< ": Item \e[1;34m" << item->file->structName()
+					<< "\e[0m is notified about edges " << edges << std::endl;
+		_makePending(item);
+		return true;
+	}
+
+	void _makePending(Item *item) {
+		if(item->state & statePending)
+			return;
+		item->state |= statePending;
+
+		item->self.lock().ctr()->increment();
+		_pendingQueue.push_back(*item);
+		_wakeWaiters();
+	}
+
+	void _wakeWaiters() {
+		_currentSeq++;
+		_statusBell.raise();
+		notifyPollObservers(EPOLLIN);
+	}
+
+	// Starts watching an item that does not support PollObservers.
+	void _startPolling(smarter::shared_ptr<Item> item, uint64_t sequence) {
+		if(item->observing || (item->state & statePolling))
+			return;
+		item->state |= statePolling;
+
+		item->cancelPoll.reset();
+		item->pollOperation.construct_with([&] {
+			return async::execution::connect(
+				item->file->pollWait(item->process, sequence,
+						item->eventMask | EPOLLERR | EPOLLHUP, item->cancelPoll),
+				Receiver{item}
+			);
+		});
+		if(async::execution::start_inline(*item->pollOperation))
+			_awaitPoll(item.get());
+	}
+
 public:
 	~OpenFile() {
 		// Nothing to do here.
@@ -159,14 +218,16 @@ public:
 				process, std::move(file), mask, cookie);
 		item->self = item;
 
-		item->state |= statePending;
+		// EPOLLEXCLUSIVE is only honored for files that support PollObservers.
+		if(item->file->supportsPollObservers()) {
+			item->observing = true;
+			item->file->addPollObserver(item.get(), item->flags & EPOLLEXCLUSIVE);
+		}
 
 		_fileMap.insert({{item->file.get(), fd}, item});
 
-		item.ctr()->increment();
-		_pendingQueue.push_back(*item);
-		_currentSeq++;
-		_statusBell.raise();
+		// Check the status of the item on the next wait.
+		_makePending(item.get());
 		return Error::success;
 	}
 
@@ -181,19 +242,18 @@ public:
 		auto item = it->second;
 		assert(item->state & stateActive);
 
-		item->eventMask = mask;
+		// Like Linux, reject EPOLLEXCLUSIVE for EPOLL_CTL_MOD.
+		if((mask & EPOLLEXCLUSIVE) || (item->flags & EPOLLEXCLUSIVE))
+			return Error::illegalArguments;
+
+		item->eventMask = mask & ~epollFlags;
+		item->flags = mask & epollFlags;
 		item->cookie = cookie;
+		item->disabled = false;
 		item->cancelPoll.cancel();
 
 		// Mark the item as pending.
-		if(!(item->state & statePending)) {
-			item->state |= statePending;
-
-			item.ctr()->increment();
-			_pendingQueue.push_back(*item);
-			_currentSeq++;
-			_statusBell.raise();
-		}
+		_makePending(item.get());
 		return Error::success;
 	}
 
@@ -209,6 +269,8 @@ public:
 		assert(item->state & stateActive);
 
 		item->cancelPoll.cancel();
+		if(item->observing)
+			item->file->removePollObserver(item.get());
 
 		_fileMap.erase(it);
 		item->state &= ~stateActive;
@@ -238,13 +300,16 @@ public:
 				item.ctr()->decrement();
 				assert(item->state & statePending);
 
+				// Clear the pending bit before calling pollStatus() such that
+				// observers can requeue the item if an edge happens concurrently.
+				item->state &= ~statePending;
+
 				// Discard non-alive items without returning them.
-				if(!(item->state & stateActive)) {
+				if(!(item->state & stateActive) || item->disabled) {
 					if(logEpoll)
 						std::cout << "posix.epoll \e[1;34m" << structName() << "\e[0m: Discarding"
 								" inactive item \e[1;34m" << item->file->structName() << "\e[0m"
 								<< std::endl;
-					item->state &= ~statePending;
 					continue;
 				}
 
@@ -260,7 +325,6 @@ public:
 						std::cout << "posix.epoll \e[1;34m" << structName() << "\e[0m: Discarding"
 								" closed item \e[1;34m" << item->file->structName() << "\e[0m"
 								<< std::endl;
-					item->state &= ~statePending;
 					continue;
 				}
 
@@ -274,30 +338,26 @@ public:
 				// Abort early (i.e before requeuing) if the item is not pending.
 				auto status = std::get<1>(result) & (item->eventMask | EPOLLERR | EPOLLHUP);
 				if(!status) {
-					item->state &= ~statePending;
-					if(!(item->state & statePolling)) {
-						item->state |= statePolling;
-
-						// Once an item is not pending anymore, we continue watching it.
-						item->cancelPoll.reset();
-						item->pollOperation.construct_with([&] {
-							return async::execution::connect(
-								item->file->pollWait(item->process, std::get<0>(result),
-										item->eventMask | EPOLLERR | EPOLLHUP, item->cancelPoll),
-								Receiver{item}
-							);
-						});
-						if(async::execution::start_inline(*item->pollOperation))
-							_awaitPoll(item.get());
-					}
+					// Once an item is not pending anymore, we continue watching it.
+					// Observed items are requeued by the file itself.
+					_startPolling(item, std::get<0>(result));
 					continue;
 				}
 
-				// We have to increment the sequence again as concurrent waiters
-				// might have seen an empty _pendingQueue.
-				// TODO: Edge-triggered watches should not be requeued here.
-				item.ctr()->increment();
-				repoll_queue.push_back(*item);
+				if(item->flags & EPOLLONESHOT) {
+					// The item stays disabled until EPOLL_CTL_MOD.
+					item->disabled = true;
+				}else if(item->flags & EPOLLET) {
+					// Edge-triggered items are only reported again after the next edge.
+					_startPolling(item, std::get<0>(result));
+				}else if(!(item->state & statePending)) {
+					// Level-triggered items are rechecked on the next wait.
+					// We have to increment the sequence again as concurrent waiters
+					// might have seen an empty _pendingQueue.
+					item->state |= statePending;
+					item.ctr()->increment();
+					repoll_queue.push_back(*item);
+				}
 
 				assert(k < max_events);
 				memset(events + k, 0, sizeof(struct epoll_event));
@@ -321,8 +381,7 @@ public:
 		// Before returning, we have to reinsert the level-triggered events that we report.
 		if(!repoll_queue.empty()) {
 			_pendingQueue.splice(_pendingQueue.end(), repoll_queue);
-			_currentSeq++;
-			_statusBell.raise();
+			_wakeWaiters();
 		}
 
 		if(logEpoll)
@@ -345,6 +404,8 @@ public:
 			it = _fileMap.erase(it);
 			item->state &= ~stateActive;
 
+			if(item->observing)
+				item->file->removePollObserver(item.get());
 			if(item->state & statePolling)
 				item->cancelPoll.cancel();
 
@@ -394,7 +455,8 @@ public:
 	}
 
 	OpenFile()
-	: File{StructName::get("epoll"), File::defaultPipeLikeSeek}, _currentSeq{0} { }
+	: File{StructName::get("epoll"), File::defaultPipeLikeSeek | File::defaultSupportsPollObservers},
+			_currentSeq{0} { }
 
 private:
 	helix::UniqueLane _passthrough;
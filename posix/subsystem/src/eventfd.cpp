@@ -16,7 +16,7 @@ namespace {
 
 struct OpenFile : File {
 	OpenFile(unsigned int initval, bool nonBlock)
-	: File{StructName::get("eventfd")}, _currentSeq{1}, _readableSeq{0},
+	: File{StructName::get("eventfd"), File::defaultSupportsPollObservers}, _currentSeq{1}, _readableSeq{0},
 		_writeableSeq{0}, _counter{initval}, _nonBlock{nonBlock} { }
 
 	~OpenFile() {
@@ -40,6 +40,7 @@ struct OpenFile : File {
 				_counter = 0;
 				_writeableSeq = ++_currentSeq;
 				_doorbell.raise();
+				notifyPollObservers(EPOLLOUT);
 				co_return 8;
 			}
 
@@ -70,6 +71,7 @@ struct OpenFile : File {
 
 		_readableSeq = ++_currentSeq;
 		_doorbell.raise();
+		notifyPollObservers(EPOLLIN);
 		co_return length;
 	}
 
@@ -4,24 +4,127 @@
 #include <string.h>
 #include <sys/auxv.h>
 #include <iostream>
+#include <list>
+#include <optional>
+#include <unordered_map>
 
 #include "common.hpp"
 #include "vfs.hpp"
 #include "exec.hpp"
 #include <fs.bragi.hpp>
+#include <helix/memory.hpp>
 
 constexpr size_t kPageSize = 0x1000;
 
-// This struct is parsed before knowing the type of executable (PIE vs. non-PIE)
-// and also before knowing the ELF's base address.
-struct ImagePreamble {
+namespace {
+
+constexpr bool logExecCache = false;
+
+// Maximal number of ELF images that are kept in the exec cache.
+constexpr size_t execCacheCapacity = 64;
+
+struct CachedSegment {
+	// Page-aligned address of the segment, relative to the image's base address.
+	uintptr_t address;
+	size_t length;
+	bool writable;
+	// Only for read-only segments: offset of the segment in the file's memory.
+	uintptr_t fileOffset;
+	// Only for writable segments: initial contents of the segment.
+	// Processes only ever map copy-on-write views of this memory object.
+	helix::UniqueDescriptor memory;
+};
+
+// ELF image with parsed headers and pre-built writable segments.
+// Images are cached such that repeated exec() of the same file does not need to
+// re-parse the headers or to re-read the contents of writable segments.
+struct CachedImage {
+	// Used to detect nodes whose address was reused.
+	std::weak_ptr<FsNode> node;
+
+	// Right now we treat every ET_DYN object as PIE and unconditionally apply
+	// a non-zero base address.
 	bool isPie = false;
+	uintptr_t entry = 0;
+	std::optional<uintptr_t> phdrAddress;
+	size_t phdrEntrySize = 0;
+	size_t phdrCount = 0;
+
+	helix::UniqueDescriptor fileMemory;
+	std::vector<CachedSegment> segments;
 };
 
+// LRU cache of ELF images, keyed by FsNode.
+// Entries are not validated on lookup; instead, the paths that modify files
+// call invalidateExecCache() (see the comment in exec.hpp).
+struct ExecCache {
+	std::shared_ptr<CachedImage> find(FsNode *node) {
+		auto it = _map.find(node);
+		if(it == _map.end())
+			return nullptr;
+		auto image = it->second->second;
+
+		// Discard entries of nodes whose address was reused.
+		if(image->node.lock().get() != node) {
+			erase(node);
+			return nullptr;
+		}
+
+		_lru.splice(_lru.begin(), _lru, it->second);
+		return image;
+	}
+
+	void insert(FsNode *node, std::shared_ptr<CachedImage> image) {
+		erase(node);
+
+		_lru.emplace_front(node, std::move(image));
+		_map.emplace(node, _lru.begin());
+
+		while(_lru.size() > execCacheCapacity) {
+			_map.erase(_lru.back().first);
+			_lru.pop_back();
+		}
+	}
+
+	void erase(FsNode *node) {
+		auto it = _map.find(node);
+		if(it == _map.end())
+			return;
+		_lru.erase(it->second);
+		_map.erase(it);
+	}
+
+	void invalidate(FsNode *node) {
+		// Images that are currently being parsed must not be inserted.
+		_invalidations++;
+		erase(node);
+	}
+
+	// Incremented on each invalidation.
+	uint64_t invalidations() {
+		return _invalidations;
+	}
+
+private:
+	using Entry = std::pair<FsNode *, std::shared_ptr<CachedImage>>;
+
+	uint64_t _invalidations = 0;
+	std::list<Entry> _lru;
+	std::unordered_map<FsNode *, std::list<Entry>::iterator> _map;
+};
+
+ExecCache globalExecCache;
+
+} // anonymous namespace
+
+void invalidateExecCache(FsNode *node) {
+	globalExecCache.invalidate(node);
+}
+
 // This struct contains the image meta data with correct base address applied.
 struct ImageInfo {
 	ImageInfo()
-	: entryIp(nullptr) { }
+	: entryIp(nullptr), phdrPtr(nullptr) { }
 
 	void *entryIp;
 	void *phdrPtr;
@@ -29,11 +132,9 @@ struct ImageInfo {
 	size_t phdrCount;
 };
 
-async::result<frg::expected<Error, ImagePreamble>>
-parseElfPreamble(SharedFilePtr file) {
-	ImagePreamble preamble;
-
-	// Read the elf file header and verify the signature.
+// Reads the ELF header (after verifying the signature) followed by the program headers.
+async::result<frg::expected<Error, std::vector<char>>>
+readElfHeaders(SharedFilePtr file) {
 	Elf64_Ehdr ehdr;
 	FRG_CO_TRY(co_await file->seek(0, VfsSeek::absolute));
 	FRG_CO_TRY(co_await file->readExactly(nullptr, &ehdr, sizeof(Elf64_Ehdr)));
@@ -46,58 +147,46 @@ parseElfPreamble(SharedFilePtr file) {
 	if(ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
 		co_return Error::badExecutable;
 
-	// Right now we treat every ET_DYN object as PIE and unconditionally apply
-	// a non-zero base address.
-	if(ehdr.e_type == ET_DYN)
-		preamble.isPie = true;
+	std::vector<char> headers;
+	headers.resize(sizeof(Elf64_Ehdr) + ehdr.e_phnum * size_t(ehdr.e_phentsize));
+	memcpy(headers.data(), &ehdr, sizeof(Elf64_Ehdr));
+	FRG_CO_TRY(co_await file->seek(ehdr.e_phoff, VfsSeek::absolute));
+	FRG_CO_TRY(co_await file->readExactly(nullptr,
+			headers.data() + sizeof(Elf64_Ehdr), ehdr.e_phnum * size_t(ehdr.e_phentsize)));
 
-	co_return preamble;
+	co_return headers;
 }
 
-async::result<frg::expected<Error, ImageInfo>>
-loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
-	assert(!(base & (kPageSize - 1))); // Callers need to ensure this.
-	ImageInfo info;
+async::result<frg::expected<Error, std::shared_ptr<CachedImage>>>
+parseElfImage(SharedFilePtr file, std::vector<char> headers) {
+	auto image = std::make_shared<CachedImage>();
 
 	// Get a handle to the file's memory.
-	auto fileMemory = co_await file->accessMemory();
+	image->fileMemory = co_await file->accessMemory();
 
-	// Read the elf file header and verify the signature.
 	Elf64_Ehdr ehdr;
-	FRG_CO_TRY(co_await file->seek(0, VfsSeek::absolute));
-	FRG_CO_TRY(co_await file->readExactly(nullptr, &ehdr, sizeof(Elf64_Ehdr)));
+	memcpy(&ehdr, headers.data(), sizeof(Elf64_Ehdr));
+	auto phdrBuffer = headers.data() + sizeof(Elf64_Ehdr);
 
-	// Verify the ELF file again, since loadElfPreamble() is not necessarily called
-	// on every object that we load.
-	if(!(ehdr.e_ident[0] == 0x7F
-			&& ehdr.e_ident[1] == 'E'
-			&& ehdr.e_ident[2] == 'L'
-			&& ehdr.e_ident[3] == 'F'))
-		co_return Error::badExecutable;
-	if(ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
-		co_return Error::badExecutable;
-
-	info.entryIp = (char *)base + ehdr.e_entry;
-	info.phdrEntrySize = ehdr.e_phentsize;
-	info.phdrCount = ehdr.e_phnum;
-
-	// Read the elf program headers and load them into the address space.
-	std::vector<char> phdrBuffer;
-	phdrBuffer.resize(ehdr.e_phnum * ehdr.e_phentsize);
-	FRG_CO_TRY(co_await file->seek(ehdr.e_phoff, VfsSeek::absolute));
-	FRG_CO_TRY(co_await file->readExactly(nullptr,
-			phdrBuffer.data(), ehdr.e_phnum * size_t(ehdr.e_phentsize)));
+	if(ehdr.e_type == ET_DYN)
+		image->isPie = true;
+	image->entry = ehdr.e_entry;
+	image->phdrEntrySize = ehdr.e_phentsize;
+	image->phdrCount = ehdr.e_phnum;
 
 	for(int i = 0; i < ehdr.e_phnum; i++) {
-		auto phdr = (Elf64_Phdr *)(phdrBuffer.data() + i * ehdr.e_phentsize);
+		auto phdr = (Elf64_Phdr *)(phdrBuffer + i * ehdr.e_phentsize);
 
 		if(phdr->p_type == PT_LOAD) {
 			if(!phdr->p_memsz) // Skip empty segments.
 				continue;
 
 			size_t misalign = phdr->p_vaddr & (kPageSize - 1);
-			uintptr_t mapAddress = base + phdr->p_vaddr - misalign;
-			size_t mapLength = (phdr->p_memsz + misalign + kPageSize - 1) & ~(kPageSize - 1);
+
+			CachedSegment segment;
+			segment.address = phdr->p_vaddr - misalign;
+			segment.length = (phdr->p_memsz + misalign + kPageSize - 1) & ~(kPageSize - 1);
+			segment.fileOffset = 0;
 
 			// Check if we can share the segment.
 			if(!(phdr->p_flags & PF_W)) {
@@ -113,48 +202,47 @@ loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
 							<< std::endl;
 					co_return Error::badExecutable;
 				}
-
-				// Map the segment with correct permissions into the process.
-				if((phdr->p_flags & (PF_R | PF_W | PF_X)) == (PF_R | PF_X)) {
-					HEL_CHECK(helLoadahead(fileMemory.getHandle(), phdr->p_offset, mapLength));
-
-					co_await vmContext->mapFile(mapAddress,
-							fileMemory.dup(), file,
-							phdr->p_offset, mapLength, true,
-							kHelMapProtRead | kHelMapProtExecute);
-				}else{
+				if((phdr->p_flags & (PF_R | PF_W | PF_X)) != (PF_R | PF_X)) {
 					std::cout << "posix: Illegal combination of segment permissions" << std::endl;
 					co_return Error::badExecutable;
 				}
+
+				// Only the first exec() of the image performs readahead.
+				// Afterwards, the pages are usually still present in the page cache.
+				HEL_CHECK(helLoadahead(image->fileMemory.getHandle(),
+						phdr->p_offset, segment.length));
+
+				segment.writable = false;
+				segment.fileOffset = phdr->p_offset;
 			}else{
-				// Map the segment with write permission into this address space.
-				HelHandle segmentHandle;
-				HEL_CHECK(helAllocateMemory(mapLength, 0, nullptr, &segmentHandle));
-
-				void *window;
-				HEL_CHECK(helMapMemory(segmentHandle, kHelNullHandle, nullptr,
-						0, mapLength, kHelMapProtRead | kHelMapProtWrite, &window));
-
-				// Map the segment with correct permissions into the process.
-				if((phdr->p_flags & (PF_R | PF_W | PF_X)) == (PF_R | PF_W)) {
-					co_await vmContext->mapFile(mapAddress,
-							helix::UniqueDescriptor{segmentHandle}, file,
-							0, mapLength, true,
-							kHelMapProtRead | kHelMapProtWrite);
-				}else{
+				if((phdr->p_flags & (PF_R | PF_W | PF_X)) != (PF_R | PF_W)) {
 					std::cout << "posix: Illegal combination of segment permissions" << std::endl;
 					co_return Error::badExecutable;
 				}
 
+				if(phdr->p_filesz > phdr->p_memsz) {
+					std::cout << "posix: ELF segment with p_filesz > p_memsz" << std::endl;
+					co_return Error::badExecutable;
+				}
+
+				HelHandle segmentHandle;
+				HEL_CHECK(helAllocateMemory(segment.length, 0, nullptr, &segmentHandle));
+				helix::UniqueDescriptor segmentMemory{segmentHandle};
+
 				// Read the segment contents from the file.
-				memset(window, 0, mapLength);
+				helix::Mapping window{segmentMemory, 0, segment.length};
+				memset(window.get(), 0, segment.length);
 				FRG_CO_TRY(co_await file->seek(phdr->p_offset, VfsSeek::absolute));
 				FRG_CO_TRY(co_await file->readExactly(nullptr,
-						(char *)window + misalign, phdr->p_filesz));
-				HEL_CHECK(helUnmapMemory(kHelNullHandle, window, mapLength));
+						(char *)window.get() + misalign, phdr->p_filesz));
+
+				segment.writable = true;
+				segment.memory = std::move(segmentMemory);
 			}
+
+			image->segments.push_back(std::move(segment));
 		}else if(phdr->p_type == PT_PHDR) {
-			info.phdrPtr = (char *)base + phdr->p_vaddr;
+			image->phdrAddress = phdr->p_vaddr;
 		}else if(phdr->p_type == PT_DYNAMIC || phdr->p_type == PT_INTERP
 				|| phdr->p_type == PT_TLS
 				|| phdr->p_type == PT_GNU_EH_FRAME || phdr->p_type == PT_GNU_STACK
@@ -166,6 +254,60 @@ loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
 		}
 	}
 
+	co_return image;
+}
+
+// Returns the parsed ELF image of a file, either from the exec cache or by parsing it.
+async::result<frg::expected<Error, std::shared_ptr<CachedImage>>>
+lookupElfImage(SharedFilePtr file) {
+	auto node = file->associatedLink()->getTarget();
+
+	if(auto image = globalExecCache.find(node.get()); image) {
+		if(logExecCache)
+			std::cout << "posix: Exec cache hit for node " << node.get() << std::endl;
+		co_return image;
+	}
+
+	if(logExecCache)
+		std::cout << "posix: Exec cache miss for node " << node.get() << std::endl;
+	auto invalidations = globalExecCache.invalidations();
+	auto headers = FRG_CO_TRY(co_await readElfHeaders(file));
+	auto image = FRG_CO_TRY(co_await parseElfImage(file, std::move(headers)));
+	image->node = node;
+	// Do not cache images that were (potentially) modified while they were parsed.
+	if(globalExecCache.invalidations() == invalidations)
+		globalExecCache.insert(node.get(), image);
+	co_return image;
+}
+
+async::result<frg::expected<Error, ImageInfo>>
+loadElfImage(const CachedImage &image, SharedFilePtr file,
+		VmContext *vmContext, uintptr_t base) {
+	assert(!(base & (kPageSize - 1))); // Callers need to ensure this.
+	ImageInfo info;
+
+	info.entryIp = (char *)base + image.entry;
+	if(image.phdrAddress)
+		info.phdrPtr = (char *)base + *image.phdrAddress;
+	info.phdrEntrySize = image.phdrEntrySize;
+	info.phdrCount = image.phdrCount;
+
+	for(const auto &segment : image.segments) {
+		// Map the segment with correct permissions into the process.
+		if(!segment.writable) {
+			co_await vmContext->mapFile(base + segment.address,
+					image.fileMemory.dup(), file,
+					segment.fileOffset, segment.length, true,
+					kHelMapProtRead | kHelMapProtExecute);
+		}else{
+			// mapFile() maps a copy-on-write view, hence the cached contents are never modified.
+			co_await vmContext->mapFile(base + segment.address,
+					segment.memory.dup(), file,
+					0, segment.length, true,
+					kHelMapProtRead | kHelMapProtWrite);
+		}
+	}
+
 	co_return info;
 }
 
@@ -250,19 +392,20 @@ execute(ViewPath root, ViewPath workdir,
 		nRecursions++;
 	}
 
-	auto execPreamble = FRG_CO_TRY(co_await parseElfPreamble(execFile));
+	auto execImage = FRG_CO_TRY(co_await lookupElfImage(execFile));
 	ImageInfo execInfo;
-	if(execPreamble.isPie) {
+	if(execImage->isPie) {
 		// Unconditionally apply a non-zero base address to PIE objects.
-		execInfo = FRG_CO_TRY(co_await loadElfImage(execFile, vmContext.get(), 0x200000));
+		execInfo = FRG_CO_TRY(co_await loadElfImage(*execImage, execFile, vmContext.get(), 0x200000));
 	}else{
-		execInfo = FRG_CO_TRY(co_await loadElfImage(execFile, vmContext.get(), 0));
+		execInfo = FRG_CO_TRY(co_await loadElfImage(*execImage, execFile, vmContext.get(), 0));
 	}
 
 	// TODO: Should we really look up the dynamic linker in the current working dir?
 	auto ldsoFile = FRG_CO_TRY(co_await open(root, workdir, "/lib/ld-init.so", self));
 	assert(ldsoFile); // If open() succeeds, it must return a non-null file.
-	auto ldsoInfo = FRG_CO_TRY(co_await loadElfImage(ldsoFile, vmContext.get(), 0x40000000));
+	auto ldsoImage = FRG_CO_TRY(co_await lookupElfImage(ldsoFile));
+	auto ldsoInfo = FRG_CO_TRY(co_await loadElfImage(*ldsoImage, ldsoFile, vmContext.get(), 0x40000000));
 
 	constexpr size_t stackSize = 0x200000;
 
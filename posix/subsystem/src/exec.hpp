@@ -14,3 +14,9 @@ execute(ViewPath root, ViewPath workdir,
 		std::vector<std::string> args, std::vector<std::string> env,
 		std::shared_ptr<VmContext> vm_context, helix::BorrowedDescriptor universe,
 		HelHandle mbus_handle, Process *self);
+
+// Drops the cached ELF image of a node (if any). Must be called whenever
+// the contents of a regular file change: by the write and truncate paths of tmpfs,
+// when external FS files are opened for writing (as writes bypass posix), when
+// such files are truncated or closed and when files are mapped shared and writable.
+void invalidateExecCache(FsNode *node);
@@ -4,6 +4,7 @@
 #include <frg/std_compat.hpp>
 #include <protocols/fs/client.hpp>
 #include "common.hpp"
+#include "exec.hpp"
 #include "extern_fs.hpp"
 #include "fs.bragi.hpp"
 
@@ -207,20 +208,27 @@ private:
 
 public:
 	OpenFile(helix::UniqueLane control, helix::UniqueLane lane,
-			std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link)
+			std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link,
+			bool writable)
 	: File{StructName::get("externfs.file"), std::move(mount), std::move(link)},
-			_control{std::move(control)}, _file{std::move(lane)} { }
+			_control{std::move(control)}, _file{std::move(lane)}, _writable{writable} { }
 
 	~OpenFile() {
 		// It's not necessary to do any cleanup here.
 	}
 
 	void handleClose() override {
+		// Writes go directly to the FS server; drop images that might have been modified.
+		if(_writable)
+			invalidateExecCache(associatedLink()->getTarget().get());
+
 		// Close the control lane to inform the server that we closed the file.
 		_control = helix::UniqueLane{};
 	}
 
 	async::result<frg::expected<protocols::fs::Error>> truncate(size_t size) override {
+		invalidateExecCache(associatedLink()->getTarget().get());
+
 		managarm::fs::CntRequest req;
 		req.set_req_type(managarm::fs::CntReqType::PT_TRUNCATE);
 		req.set_size(size);
@@ -247,6 +255,7 @@ public:
 private:
 	helix::UniqueLane _control;
 	protocols::fs::File _file;
+	bool _writable;
 };
 
 struct RegularNode final : Node {
@@ -295,8 +304,14 @@ private:
 		resp.ParseFromArray(recv_resp.data(), recv_resp.length());
 		assert(resp.error() == managarm::fs::Errors::SUCCESS);
 
+		// Writes bypass posix, so cached images of the file cannot be trusted anymore.
+		bool writable = semantic_flags & semanticWrite;
+		if(writable)
+			invalidateExecCache(this);
+
 		auto file = smarter::make_shared<OpenFile>(pull_ctrl.descriptor(),
-				pull_passthrough.descriptor(), std::move(mount), std::move(link));
+				pull_passthrough.descriptor(), std::move(mount), std::move(link),
+				writable);
 		file->setupWeakFile(file);
 		co_return File::constructHandle(std::move(file));
 	}
@@ -777,7 +792,7 @@ private:
 		assert(resp.error() == managarm::fs::Errors::SUCCESS);
 
 		auto file = smarter::make_shared<OpenFile>(pull_ctrl.descriptor(),
-				pull_passthrough.descriptor(), std::move(mount), std::move(link));
+				pull_passthrough.descriptor(), std::move(mount), std::move(link), false);
 		file->setupWeakFile(file);
 		co_return File::constructHandle(std::move(file));
 	}
@@ -951,7 +966,7 @@ std::shared_ptr<FsLink> createRoot(helix::UniqueLane sb_lane, helix::UniqueLane
 smarter::shared_ptr<File, FileHandle>
 createFile(helix::UniqueLane lane, std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link) {
 	auto file = smarter::make_shared<OpenFile>(helix::UniqueLane{},
-			std::move(lane), std::move(mount), std::move(link));
+			std::move(lane), std::move(mount), std::move(link), false);
 	file->setupWeakFile(file);
 	return File::constructHandle(std::move(file));
 }
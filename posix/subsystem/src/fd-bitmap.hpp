@@ -0,0 +1,97 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// Tracks which file descriptors are in use and finds the lowest free one in O(log n).
+// Level 0 has one bit per descriptor. Each further level has one bit per word
+// of the level below; that bit is set iff the word is full.
+// The top level always consists of a single word.
+struct FdBitmap {
+	// Returns the lowest descriptor that is not in use.
+	int findFree() const {
+		if(_levels.empty())
+			return 0;
+
+		size_t index = 0;
+		for(size_t l = _levels.size(); l-- > 0; ) {
+			auto &level = _levels[l];
+			// Words beyond the end of a level are empty.
+			uint64_t word = (index < level.size()) ? level[index] : 0;
+			if(!~word) {
+				// Only the top level can be full (otherwise, its parent bit would be set).
+				assert(l == _levels.size() - 1);
+				return _levels[0].size() * 64;
+			}
+			index = index * 64 + __builtin_ctzll(~word);
+		}
+		return index;
+	}
+
+	bool test(int fd) const {
+		if(_levels.empty() || static_cast<size_t>(fd) / 64 >= _levels[0].size())
+			return false;
+		return _levels[0][fd / 64] & (uint64_t{1} << (fd % 64));
+	}
+
+	void set(int fd) {
+		_grow(fd);
+
+		size_t index = fd;
+		for(size_t l = 0; l < _levels.size(); l++) {
+			auto &word = _levels[l][index / 64];
+			word |= uint64_t{1} << (index % 64);
+			if(~word)
+				break;
+			index /= 64;
+		}
+	}
+
+	void clear(int fd) {
+		if(_levels.empty() || static_cast<size_t>(fd) / 64 >= _levels[0].size())
+			return;
+
+		size_t index = fd;
+		for(size_t l = 0; l < _levels.size(); l++) {
+			auto &word = _levels[l][index / 64];
+			bool wasFull = !~word;
+			word &= ~(uint64_t{1} << (index % 64));
+			if(!wasFull)
+				break;
+			index /= 64;
+		}
+	}
+
+private:
+	void _grow(int fd) {
+		size_t numWords = static_cast<size_t>(fd) / 64 + 1;
+		if(!_levels.empty() && numWords <= _levels[0].size())
+			return;
+
+		if(_levels.empty())
+			_levels.emplace_back();
+		numWords = std::max(numWords, 2 * _levels[0].size());
+		_levels[0].resize(numWords, 0);
+
+		for(size_t l = 0; _levels[l].size() > 1; l++) {
+			size_t parentWords = (_levels[l].size() + 63) / 64;
+			if(l + 1 < _levels.size()) {
+				// New words of the parent summarize new (i.e., empty) words.
+				_levels[l + 1].resize(parentWords, 0);
+				continue;
+			}
+
+			// Add a new top level that summarizes the previous one.
+			_levels.emplace_back(parentWords, 0);
+			for(size_t i = 0; i < _levels[l].size(); i++) {
+				if(!~_levels[l][i])
+					_levels[l + 1][i / 64] |= uint64_t{1} << (i % 64);
+			}
+		}
+	}
+
+	std::vector<std::vector<uint64_t>> _levels;
+};
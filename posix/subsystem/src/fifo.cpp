@@ -2,14 +2,14 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <iostream>
-#include <deque>
 #include <map>
-#include <numeric>
+#include <limits.h>
 
 #include <async/recurring-event.hpp>
 #include <bragi/helpers-std.hpp>
 #include <helix/ipc.hpp>
 #include "fifo.hpp"
+#include "process.hpp"
 #include "fs.bragi.hpp"
 
 #include <coroutine>
@@ -21,16 +21,105 @@ namespace {
 
 constexpr bool logFifos = false;
 
-struct Packet {
-	// The actual octet data that the packet consists of.
-	std::vector<char> buffer;
+constexpr size_t pipePageSize = 0x1000;
 
+// Default capacity of a pipe in pages (same as on Linux).
+constexpr size_t defaultPipePages = 16;
+
+// Maximal capacity of a pipe that can be requested via F_SETPIPE_SZ.
+constexpr size_t maxPipeSize = 1024 * 1024;
+
+// Maximal number of unused pages that are kept around for future writes.
+constexpr size_t maxPooledPages = 256;
+
+// Page that stores pipe data. The page is reference counted since tee()
+// and splice() move references to pages between pipes instead of copying them.
+struct PipePage {
+	int refCount = 0;
+	alignas(64) std::byte data[pipePageSize];
+};
+
+// Free pages are recycled to avoid a heap allocation on every write.
+std::vector<PipePage *> pagePool;
+
+PipePage *allocatePage() {
+	PipePage *page;
+	if(!pagePool.empty()) {
+		page = pagePool.back();
+		pagePool.pop_back();
+	}else{
+		page = new PipePage;
+	}
+	assert(!page->refCount);
+	return page;
+}
+
+void freePage(PipePage *page) {
+	assert(!page->refCount);
+	if(pagePool.size() < maxPooledPages) {
+		pagePool.push_back(page);
+	}else{
+		delete page;
+	}
+}
+
+// Range of bytes within a PipePage. Holds a reference to the page.
+struct PipeBuffer {
+	PipeBuffer() = default;
+
+	PipeBuffer(PipePage *page, size_t offset, size_t length)
+	: page{page}, offset{offset}, length{length} {
+		page->refCount++;
+	}
+
+	PipeBuffer(const PipeBuffer &other)
+	: page{other.page}, offset{other.offset}, length{other.length} {
+		if(page)
+			page->refCount++;
+	}
+
+	PipeBuffer(PipeBuffer &&other)
+	: PipeBuffer{} {
+		swap(*this, other);
+	}
+
+	~PipeBuffer() {
+		if(page && !--page->refCount)
+			freePage(page);
+	}
+
+	PipeBuffer &operator= (PipeBuffer other) {
+		swap(*this, other);
+		return *this;
+	}
+
+	friend void swap(PipeBuffer &x, PipeBuffer &y) {
+		using std::swap;
+		swap(x.page, y.page);
+		swap(x.offset, y.offset);
+		swap(x.length, y.length);
+	}
+
+	std::byte *data() {
+		return page->data + offset;
+	}
+
+	// Whether we can append to the page. Pages that are referenced by multiple
+	// buffers (e.g., after tee()) must not be modified.
+	size_t appendableSpace() {
+		if(page->refCount > 1)
+			return 0;
+		return pipePageSize - (offset + length);
+	}
+
+	PipePage *page = nullptr;
 	size_t offset = 0;
+	size_t length = 0;
 };
 
 struct Channel {
 	Channel()
-	: writerCount{0}, readerCount{0} { }
+	: writerCount{0}, readerCount{0}, _ring(defaultPipePages) { }
 
 	// Status management for poll().
 	async::recurring_event statusBell;
@@ -39,14 +128,183 @@ struct Channel {
 	uint64_t noWriterSeq = 0;
 	uint64_t noReaderSeq = 0;
 	uint64_t inSeq = 0;
+	uint64_t outSeq = 1;
 	int writerCount;
 	int readerCount;
 
 	async::recurring_event readerPresent;
 	async::recurring_event writerPresent;
 
-	// The actual queue of this pipe.
-	std::deque<Packet> packetQueue;
+	// Capacity of the pipe in bytes.
+	size_t capacity() {
+		return _ring.size() * pipePageSize;
+	}
+
+	// Number of bytes that are stored in the pipe.
+	size_t size() {
+		return _numBytes;
+	}
+
+	bool empty() {
+		return !_numBuffers;
+	}
+
+	bool full() {
+		return _numBuffers + _numReserved == _ring.size();
+	}
+
+	// Number of bytes that can be written without blocking.
+	size_t writableSpace() {
+		size_t space = (_ring.size() - _numBuffers - _numReserved) * pipePageSize;
+		if(_numBuffers)
+			space += back().appendableSpace();
+		return space;
+	}
+
+	size_t numBuffers() {
+		return _numBuffers;
+	}
+
+	PipeBuffer &bufferAt(size_t i) {
+		assert(i < _numBuffers);
+		return _ring[(_head + i) % _ring.size()];
+	}
+
+	PipeBuffer &front() {
+		return bufferAt(0);
+	}
+
+	PipeBuffer &back() {
+		return bufferAt(_numBuffers - 1);
+	}
+
+	void pushBuffer(PipeBuffer buffer) {
+		assert(!full());
+		_numBytes += buffer.length;
+		_ring[(_head + _numBuffers) % _ring.size()] = std::move(buffer);
+		_numBuffers++;
+	}
+
+	// Reserves a slot for a buffer that is only filled after an asynchronous operation
+	// (e.g., a read from a file), such that concurrent writers cannot fill the pipe meanwhile.
+	void reserveBuffer() {
+		assert(!full());
+		_numReserved++;
+	}
+
+	// Pushes a buffer into a slot that was reserved by reserveBuffer().
+	void pushReservedBuffer(PipeBuffer buffer) {
+		assert(_numReserved);
+		_numReserved--;
+		pushBuffer(std::move(buffer));
+	}
+
+	void cancelReservation() {
+		assert(_numReserved);
+		_numReserved--;
+	}
+
+	PipeBuffer popBuffer() {
+		assert(_numBuffers);
+		auto buffer = std::move(_ring[_head]);
+		_numBytes -= buffer.length;
+		_head = (_head + 1) % _ring.size();
+		_numBuffers--;
+		return buffer;
+	}
+
+	// Removes up to maxLength bytes from the front buffer.
+	PipeBuffer takeFront(size_t maxLength) {
+		auto &buffer = front();
+		if(buffer.length <= maxLength)
+			return popBuffer();
+		PipeBuffer partial{buffer.page, buffer.offset, maxLength};
+		buffer.offset += maxLength;
+		buffer.length -= maxLength;
+		_numBytes -= maxLength;
+		return partial;
+	}
+
+	// Copies as many bytes as possible into the pipe.
+	size_t appendBytes(const void *data, size_t length) {
+		size_t progress = 0;
+		if(_numBuffers) {
+			auto &tail = back();
+			auto chunk = std::min(tail.appendableSpace(), length);
+			memcpy(tail.data() + tail.length, data, chunk);
+			tail.length += chunk;
+			_numBytes += chunk;
+			progress += chunk;
+		}
+		while(progress < length && !full()) {
+			auto chunk = std::min(pipePageSize, length - progress);
+			PipeBuffer buffer{allocatePage(), 0, chunk};
+			memcpy(buffer.data(), reinterpret_cast<const std::byte *>(data) + progress, chunk);
+			pushBuffer(std::move(buffer));
+			progress += chunk;
+		}
+		return progress;
+	}
+
+	// Copies up to maxLength bytes out of the pipe.
+	size_t consumeBytes(void *data, size_t maxLength) {
+		size_t progress = 0;
+		while(progress < maxLength && _numBuffers) {
+			auto buffer = takeFront(maxLength - progress);
+			memcpy(reinterpret_cast<std::byte *>(data) + progress, buffer.data(), buffer.length);
+			progress += buffer.length;
+		}
+		return progress;
+	}
+
+	// Changes the capacity of the ring (in pages).
+	Error resize(size_t numPages) {
+		assert(numPages);
+		if(numPages < _numBuffers + _numReserved)
+			return Error::resourceInUse;
+
+		std::vector<PipeBuffer> ring(numPages);
+		for(size_t i = 0; i < _numBuffers; i++)
+			ring[i] = std::move(_ring[(_head + i) % _ring.size()]);
+		_ring = std::move(ring);
+		_head = 0;
+		return Error::success;
+	}
+
+	void notifyInput() {
+		inSeq = ++currentSeq;
+		statusBell.raise();
+		notifyFiles(readerFiles, EPOLLIN);
+	}
+
+	void notifyOutput() {
+		outSeq = ++currentSeq;
+		statusBell.raise();
+		notifyFiles(writerFiles, EPOLLOUT);
+	}
+
+	static void notifyFiles(const std::vector<File *> &files, int edges) {
+		for(size_t i = 0; i < files.size(); i++)
+			files[i]->notifyPollObservers(edges);
+	}
+
+	// Set while splice() writes data from the front of the pipe to a file.
+	// Other consumers wait until it is cleared (and statusBell is raised)
+	// such that they do not take the same data.
+	bool consumerBusy = false;
+
+	// Open files of the channel; used to notify PollObservers.
+	std::vector<File *> readerFiles;
+	std::vector<File *> writerFiles;
+
+private:
+	// Ring of page references; its size determines the capacity of the pipe.
+	std::vector<PipeBuffer> _ring;
+	size_t _head = 0;
+	size_t _numBuffers = 0;
+	// Slots that are reserved by reserveBuffer().
+	size_t _numReserved = 0;
+	size_t _numBytes = 0;
 };
 
 struct ReaderFile : File {
@@ -61,18 +319,22 @@ public:
 	}
 
 	ReaderFile(std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link, bool nonBlock = false)
-	: File{StructName::get("fifo.read"), mount, link, File::defaultPipeLikeSeek}, nonBlock_{nonBlock} { }
+	: File{StructName::get("fifo.read"), mount, link,
+			File::defaultPipeLikeSeek | File::defaultSupportsPollObservers}, nonBlock_{nonBlock} { }
 
 	void connectChannel(std::shared_ptr<Channel> channel) {
 		assert(!_channel);
 		_channel = std::move(channel);
 		_channel->readerCount++;
+		_channel->readerFiles.push_back(this);
 	}
 
 	void handleClose() override {
+		std::erase(_channel->readerFiles, this);
 		if(_channel->readerCount-- == 1) {
 			_channel->noReaderSeq = ++_channel->currentSeq;
 			_channel->statusBell.raise();
+			Channel::notifyFiles(_channel->writerFiles, EPOLLERR);
 		}
 		_channel = nullptr;
 	}
@@ -84,7 +346,7 @@ public:
 		if(!maxLength)
 			co_return 0;
 
-		while(_channel->packetQueue.empty() && _channel->writerCount) {
+		while(_channel->consumerBusy || (_channel->empty() && _channel->writerCount)) {
 			if(nonBlock_) {
 				if(logFifos)
 					std::cout << "posix: FIFO pipe would block" << std::endl;
@@ -93,19 +355,14 @@ public:
 			co_await _channel->statusBell.async_wait();
 		}
 
-		if(_channel->packetQueue.empty()) {
+		if(_channel->empty()) {
 			assert(!_channel->writerCount);
 			co_return 0;
 		}
 
-		// TODO: Truncate packets (for SOCK_DGRAM) here.
-		auto packet = &_channel->packetQueue.front();
-		size_t chunk = std::min(packet->buffer.size() - packet->offset, maxLength);
+		size_t chunk = _channel->consumeBytes(data, maxLength);
 		assert(chunk); // Otherwise we return above since !maxLength.
-		memcpy(data, packet->buffer.data() + packet->offset, chunk);
-		packet->offset += chunk;
-		if(packet->offset == packet->buffer.size())
-			_channel->packetQueue.pop_front();
+		_channel->notifyOutput();
 		co_return chunk;
 	}
 
@@ -136,7 +393,7 @@ public:
 		int events = 0;
 		if(!_channel->writerCount)
 			events |= EPOLLHUP;
-		if(!_channel->packetQueue.empty())
+		if(!_channel->empty())
 			events |= EPOLLIN;
 
 		co_return PollStatusResult(_channel->currentSeq, events);
@@ -165,6 +422,10 @@ public:
 		co_return 0;
 	}
 
+	std::shared_ptr<Channel> channel() {
+		return _channel;
+	}
+
 	async::result<void>
 	ioctl(Process *process, uint32_t id, helix_ng::RecvInlineResult msg, helix::UniqueLane conversation) override {
 		managarm::fs::GenericIoctlReply resp;
@@ -175,9 +436,7 @@ public:
 
 			switch(req->command()) {
 				case FIONREAD: {
-					size_t count = std::accumulate(_channel->packetQueue.cbegin(), _channel->packetQueue.cend(), 0, [](size_t sum, const Packet &p) {
-						return sum + (p.buffer.size() - p.offset);
-					});
+					size_t count = _channel->size();
 
 					resp.set_fionread_count(count);
 					resp.set_error(managarm::fs::Errors::SUCCESS);
@@ -227,36 +486,56 @@ public:
 				smarter::shared_ptr<File>{file}, &File::fileOperations));
 	}
 
-	WriterFile(std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link)
-	: File{StructName::get("fifo.write"), mount, link, File::defaultPipeLikeSeek} { }
+	WriterFile(std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link, bool nonBlock = false)
+	: File{StructName::get("fifo.write"), mount, link,
+			File::defaultPipeLikeSeek | File::defaultSupportsPollObservers}, nonBlock_{nonBlock} { }
 
 	void connectChannel(std::shared_ptr<Channel> channel) {
 		assert(!_channel);
 		_channel = std::move(channel);
 		_channel->writerCount++;
+		_channel->writerFiles.push_back(this);
 	}
 
 	void handleClose() override {
 		std::cout << "\e[35mposix: Cancel passthrough on fifo WriterFile::handleClose()\e[39m"
 				<< std::endl;
+		std::erase(_channel->writerFiles, this);
 		if(_channel->writerCount-- == 1) {
 			_channel->noWriterSeq = ++_channel->currentSeq;
 			_channel->statusBell.raise();
+			Channel::notifyFiles(_channel->readerFiles, EPOLLHUP);
 		}
 		_channel = nullptr;
 	}
 
 	async::result<frg::expected<Error, size_t>>
-	writeAll(Process *process, const void *data, size_t maxLength) override {
-		Packet packet;
-		packet.buffer.resize(maxLength);
-		memcpy(packet.buffer.data(), data, maxLength);
-		packet.offset = 0;
+	writeAll(Process *, const void *data, size_t length) override {
+		size_t progress = 0;
+		while(progress < length) {
+			if(!_channel->readerCount) {
+				if(progress)
+					co_return progress;
+				co_return Error::brokenPipe;
+			}
 
-		_channel->packetQueue.push_back(std::move(packet));
-		_channel->inSeq = ++_channel->currentSeq;
-		_channel->statusBell.raise();
-		co_return maxLength;
+			// Writes of at most PIPE_BUF bytes must not be interleaved with other writes.
+			auto space = _channel->writableSpace();
+			if((length <= PIPE_BUF && space < length) || !space) {
+				if(nonBlock_) {
+					if(progress)
+						co_return progress;
+					co_return Error::wouldBlock;
+				}
+				co_await _channel->statusBell.async_wait();
+				continue;
+			}
+
+			progress += _channel->appendBytes(
+					reinterpret_cast<const std::byte *>(data) + progress, length - progress);
+			_channel->notifyInput();
+		}
+		co_return progress;
 	}
 
 	async::result<frg::expected<Error, PollWaitResult>>
@@ -271,7 +550,9 @@ public:
 		if(cancellation.is_cancellation_requested())
 			std::cout << "\e[33mposix: fifo::poll() cancellation is untested\e[39m" << std::endl;
 
-		int edges = EPOLLOUT;
+		int edges = 0;
+		if(_channel->outSeq > pastSeq)
+			edges |= EPOLLOUT;
 		if(_channel->noReaderSeq > pastSeq)
 			edges |= EPOLLERR;
 
@@ -280,7 +561,9 @@ public:
 
 	async::result<frg::expected<Error, PollStatusResult>>
 	pollStatus(Process *) override {
-		int events = EPOLLOUT;
+		int events = 0;
+		if(_channel->writableSpace())
+			events |= EPOLLOUT;
 		if(!_channel->readerCount)
 			events |= EPOLLERR;
 
@@ -291,12 +574,71 @@ public:
 		return _passthrough;
 	}
 
+	async::result<void> setFileFlags(int flags) override {
+		if(flags & ~O_NONBLOCK) {
+			std::cout << "posix: setFileFlags on fifo \e[1;34m" << structName()
+					<< "\e[0m called with unknown flags" << std::endl;
+			co_return;
+		}
+		nonBlock_ = flags & O_NONBLOCK;
+		co_return;
+	}
+
+	async::result<int> getFileFlags() override {
+		if(nonBlock_)
+			co_return O_NONBLOCK;
+		co_return 0;
+	}
+
+	std::shared_ptr<Channel> channel() {
+		return _channel;
+	}
+
 private:
 	helix::UniqueLane _passthrough;
 
 	std::shared_ptr<Channel> _channel;
+
+	bool nonBlock_;
 };
 
+std::shared_ptr<Channel> getChannel(File *file) {
+	if(auto reader = dynamic_cast<ReaderFile *>(file); reader)
+		return reader->channel();
+	if(auto writer = dynamic_cast<WriterFile *>(file); writer)
+		return writer->channel();
+	return nullptr;
+}
+
+// Waits until the pipe contains data. Returns false on EOF.
+async::result<frg::expected<Error, bool>>
+waitForInput(std::shared_ptr<Channel> channel, bool nonBlock) {
+	while(channel->consumerBusy || channel->empty()) {
+		if(!channel->consumerBusy) {
+			if(!channel->writerCount)
+				co_return false;
+			if(nonBlock)
+				co_return Error::wouldBlock;
+		}
+		co_await channel->statusBell.async_wait();
+	}
+	co_return true;
+}
+
+// Waits until at least one page can be written to the pipe.
+async::result<frg::expected<Error>>
+waitForSpace(std::shared_ptr<Channel> channel, bool nonBlock) {
+	while(true) {
+		if(!channel->readerCount)
+			co_return Error::brokenPipe;
+		if(!channel->full())
+			co_return {};
+		if(nonBlock)
+			co_return Error::wouldBlock;
+		co_await channel->statusBell.async_wait();
+	}
+}
+
 } // anonymous namespace
 
 // This maps FsNodes to Channels for named pipes (FIFOs)
@@ -355,7 +697,7 @@ std::array<smarter::shared_ptr<File, FileHandle>, 2> createPair(bool nonBlock) {
 	auto link = SpecialLink::makeSpecialLink(VfsType::fifo, 0777);
 	auto channel = std::make_shared<Channel>();
 	auto r_file = smarter::make_shared<ReaderFile>(nullptr, link, nonBlock);
-	auto w_file = smarter::make_shared<WriterFile>(nullptr, link);
+	auto w_file = smarter::make_shared<WriterFile>(nullptr, link, nonBlock);
 	r_file->setupWeakFile(r_file);
 	w_file->setupWeakFile(w_file);
 	r_file->connectChannel(channel);
@@ -366,5 +708,211 @@ std::array<smarter::shared_ptr<File, FileHandle>, 2> createPair(bool nonBlock) {
 			File::constructHandle(std::move(w_file))};
 }
 
+frg::expected<Error, size_t> getPipeSize(File *file) {
+	auto channel = getChannel(file);
+	if(!channel)
+		return Error::illegalArguments;
+	return channel->capacity();
+}
+
+frg::expected<Error, size_t> setPipeSize(File *file, size_t size) {
+	auto channel = getChannel(file);
+	if(!channel)
+		return Error::illegalArguments;
+	if(size > maxPipeSize)
+		return Error::insufficientPermissions;
+
+	// Like Linux, round up to a power of two number of pages.
+	size_t numPages = 1;
+	while(numPages * pipePageSize < size)
+		numPages <<= 1;
+
+	if(auto e = channel->resize(numPages); e != Error::success)
+		return e;
+	channel->notifyOutput();
+	return channel->capacity();
+}
+
+async::result<frg::expected<Error, size_t>>
+splice(Process *process, File *in, std::optional<int64_t> inOffset,
+		File *out, std::optional<int64_t> outOffset, size_t length, bool nonBlock) {
+	auto inChannel = dynamic_cast<ReaderFile *>(in)
+			? getChannel(in) : nullptr;
+	auto outChannel = dynamic_cast<WriterFile *>(out)
+			? getChannel(out) : nullptr;
+
+	// At least one side needs to be a pipe; pipes do not have offsets.
+	if(!inChannel && !outChannel)
+		co_return Error::illegalArguments;
+	if((inChannel && inOffset) || (outChannel && outOffset))
+		co_return Error::seekOnPipe;
+	if(!length)
+		co_return size_t{0};
+
+	if(inChannel && outChannel) {
+		if(inChannel == outChannel)
+			co_return Error::illegalArguments;
+
+		// Move page references from one pipe to the other, without copying data.
+		// Both conditions need to hold at the same time, so wait again if
+		// the input changed while we waited for space.
+		while(true) {
+			if(!FRG_CO_TRY(co_await waitForInput(inChannel, nonBlock)))
+				co_return size_t{0};
+			FRG_CO_TRY(co_await waitForSpace(outChannel, nonBlock));
+			if(!inChannel->consumerBusy && !inChannel->empty())
+				break;
+		}
+
+		size_t progress = 0;
+		while(progress < length && !inChannel->empty() && !outChannel->full()) {
+			auto buffer = inChannel->takeFront(length - progress);
+			progress += buffer.length;
+			outChannel->pushBuffer(std::move(buffer));
+		}
+		inChannel->notifyOutput();
+		outChannel->notifyInput();
+		co_return progress;
+	}else if(inChannel) {
+		// Write pages from the pipe directly to the file.
+		if(!FRG_CO_TRY(co_await waitForInput(inChannel, nonBlock)))
+			co_return size_t{0};
+
+		// Keep other consumers away from the front buffer while we write it.
+		inChannel->consumerBusy = true;
+		auto releaseConsumer = [&] {
+			inChannel->consumerBusy = false;
+			inChannel->statusBell.raise();
+		};
+
+		size_t progress = 0;
+		while(progress < length && !inChannel->empty()) {
+			// Take a reference to the buffer such that the data stays in the pipe on failure.
+			auto buffer = inChannel->front();
+			auto chunk = std::min(buffer.length, length - progress);
+			frg::expected<Error, size_t> result;
+			if(outOffset) {
+				result = co_await out->pwrite(process, *outOffset + progress,
+						buffer.data(), chunk);
+			}else{
+				result = co_await out->writeAll(process, buffer.data(), chunk);
+			}
+			if(!result) {
+				if(progress)
+					break;
+				releaseConsumer();
+				co_return result.error();
+			}
+			inChannel->takeFront(result.value());
+			progress += result.value();
+			if(result.value() < chunk)
+				break;
+		}
+		releaseConsumer();
+		inChannel->notifyOutput();
+		co_return progress;
+	}else{
+		// Read from the file directly into fresh pipe pages.
+		FRG_CO_TRY(co_await waitForSpace(outChannel, nonBlock));
+
+		size_t progress = 0;
+		while(progress < length && !outChannel->full()) {
+			auto chunk = std::min(pipePageSize, length - progress);
+			PipeBuffer buffer{allocatePage(), 0, 0};
+			outChannel->reserveBuffer();
+			frg::expected<Error, size_t> result;
+			if(inOffset) {
+				result = co_await in->pread(process, *inOffset + progress,
+						buffer.data(), chunk);
+			}else{
+				result = co_await in->readSome(process, buffer.data(), chunk);
+			}
+			if(!result || !result.value()) { // Error or EOF.
+				outChannel->cancelReservation();
+				if(!result && !progress)
+					co_return result.error();
+				break;
+			}
+			buffer.length = result.value();
+			progress += result.value();
+			outChannel->pushReservedBuffer(std::move(buffer));
+			if(result.value() < chunk)
+				break;
+		}
+		if(progress)
+			outChannel->notifyInput();
+		co_return progress;
+	}
+}
+
+async::result<frg::expected<Error, size_t>>
+tee(File *in, File *out, size_t length, bool nonBlock) {
+	auto inChannel = dynamic_cast<ReaderFile *>(in)
+			? getChannel(in) : nullptr;
+	auto outChannel = dynamic_cast<WriterFile *>(out)
+			? getChannel(out) : nullptr;
+	if(!inChannel || !outChannel || inChannel == outChannel)
+		co_return Error::illegalArguments;
+
+	if(!FRG_CO_TRY(co_await waitForInput(inChannel, nonBlock)))
+		co_return size_t{0};
+	FRG_CO_TRY(co_await waitForSpace(outChannel, nonBlock));
+
+	// Duplicate page references without consuming data from the input pipe.
+	size_t progress = 0;
+	for(size_t i = 0; i < inChannel->numBuffers(); i++) {
+		if(progress == length || outChannel->full())
+			break;
+		auto &buffer = inChannel->bufferAt(i);
+		PipeBuffer copy{buffer.page, buffer.offset,
+				std::min(buffer.length, length - progress)};
+		progress += copy.length;
+		outChannel->pushBuffer(std::move(copy));
+	}
+
+	outChannel->notifyInput();
+	co_return progress;
+}
+
+async::result<frg::expected<Error, size_t>>
+vmsplice(Process *process, File *out, std::vector<std::pair<uintptr_t, size_t>> iovs,
+		bool nonBlock) {
+	auto outChannel = dynamic_cast<WriterFile *>(out)
+			? getChannel(out) : nullptr;
+	if(!outChannel)
+		co_return Error::illegalArguments;
+
+	FRG_CO_TRY(co_await waitForSpace(outChannel, nonBlock));
+
+	// Copy directly from the client's address space into pipe pages.
+	// Compared to write(), this avoids the transfer through an intermediate buffer.
+	size_t progress = 0;
+	for(auto [address, length] : iovs) {
+		size_t iovProgress = 0;
+		while(iovProgress < length && !outChannel->full()) {
+			auto chunk = std::min(pipePageSize, length - iovProgress);
+			PipeBuffer buffer{allocatePage(), 0, chunk};
+			outChannel->reserveBuffer();
+			auto load = co_await helix_ng::readMemory(process->vmContext()->getSpace(),
+					address + iovProgress, chunk, buffer.data());
+			if(load.error() == kHelErrFault) {
+				outChannel->cancelReservation();
+				if(progress || iovProgress)
+					break;
+				co_return Error::illegalArguments;
+			}
+			HEL_CHECK(load.error());
+			outChannel->pushReservedBuffer(std::move(buffer));
+			iovProgress += chunk;
+		}
+		progress += iovProgress;
+		if(iovProgress < length)
+			break;
+	}
+
+	outChannel->notifyInput();
+	co_return progress;
+}
+
 } // namespace fifo
 
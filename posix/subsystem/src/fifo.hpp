@@ -1,3 +1,7 @@
+#pragma once
+
+#include <optional>
+#include <vector>
 
 #include "file.hpp"
 #include "fs.hpp"
@@ -11,5 +15,25 @@ openNamedChannel(std::shared_ptr<MountView> mount, std::shared_ptr<FsLink> link,
 
 std::array<smarter::shared_ptr<File, FileHandle>, 2> createPair(bool nonBlock);
 
+// Implementation of F_GETPIPE_SZ and F_SETPIPE_SZ.
+// Both functions return the capacity of the pipe in bytes.
+frg::expected<Error, size_t> getPipeSize(File *file);
+frg::expected<Error, size_t> setPipeSize(File *file, size_t size);
+
+// Moves data between two files, at least one of which must be a pipe.
+// Between two pipes, this only moves references to pages.
+async::result<frg::expected<Error, size_t>>
+splice(Process *process, File *in, std::optional<int64_t> inOffset,
+		File *out, std::optional<int64_t> outOffset, size_t length, bool nonBlock);
+
+// Duplicates data from one pipe to another without consuming it.
+async::result<frg::expected<Error, size_t>>
+tee(File *in, File *out, size_t length, bool nonBlock);
+
+// Copies memory of the process to a pipe. Takes a list of (address, length) pairs.
+async::result<frg::expected<Error, size_t>>
+vmsplice(Process *process, File *out, std::vector<std::pair<uintptr_t, size_t>> iovs,
+		bool nonBlock);
+
 } // namespace fifo
 
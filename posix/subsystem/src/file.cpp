@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <string.h>
 #include <fcntl.h>
 #include <future>
@@ -13,6 +14,24 @@ namespace {
 
 constexpr bool logDestruction = false;
 
+// Shared by the SEEK_DATA and SEEK_HOLE handlers.
+protocols::fs::SeekResult translateSeekResult(frg::expected<Error, off_t> result) {
+	if(!result) {
+		switch(result.error()) {
+		case Error::seekOnPipe:
+			return protocols::fs::Error::seekOnPipe;
+		case Error::noBackingDevice:
+			return protocols::fs::Error::noBackingDevice;
+		case Error::illegalArguments:
+			return protocols::fs::Error::illegalArguments;
+		default:
+			return protocols::fs::Error::illegalOperationTarget;
+		}
+	}else{
+		return result.value();
+	}
+}
+
 } // anonymous namespace
 
 // --------------------------------------------------------
@@ -55,6 +74,20 @@ File::ptSeekEof(void *object, int64_t offset) {
 	}
 }
 
+async::result<protocols::fs::SeekResult>
+File::ptSeekData(void *object, int64_t offset) {
+	auto self = static_cast<File *>(object);
+	auto result = co_await self->seekData(offset);
+	co_return translateSeekResult(result);
+}
+
+async::result<protocols::fs::SeekResult>
+File::ptSeekHole(void *object, int64_t offset) {
+	auto self = static_cast<File *>(object);
+	auto result = co_await self->seekHole(offset);
+	co_return translateSeekResult(result);
+}
+
 async::result<protocols::fs::ReadResult>
 File::ptRead(void *object, const char *credentials,
 		void *buffer, size_t length) {
@@ -67,6 +100,8 @@ File::ptRead(void *object, const char *credentials,
 			co_return protocols::fs::Error::illegalArguments;
 		case Error::wouldBlock:
 			co_return protocols::fs::Error::wouldBlock;
+		case Error::notConnected:
+			co_return protocols::fs::Error::notConnected;
 		default:
 			assert(!"Unexpected error from readSome()");
 			__builtin_unreachable();
@@ -107,6 +142,10 @@ async::result<frg::expected<protocols::fs::Error, size_t>> File::ptWrite(void *o
 			co_return protocols::fs::Error::noSpaceLeft;
 		case Error::notConnected:
 			co_return protocols::fs::Error::notConnected;
+		case Error::wouldBlock:
+			co_return protocols::fs::Error::wouldBlock;
+		case Error::brokenPipe:
+			co_return protocols::fs::Error::brokenPipe;
 		default:
 			assert(!"Unexpected error from writeAll()");
 			__builtin_unreachable();
@@ -300,6 +339,41 @@ async::result<frg::expected<Error, size_t>> File::pread(Process *, int64_t, void
 	co_return Error::seekOnPipe;
 }
 
+void File::addPollObserver(PollObserver *observer, bool exclusive) {
+	assert(_defaultOps & defaultSupportsPollObservers);
+	_pollObservers.push_back({observer, exclusive});
+}
+
+void File::removePollObserver(PollObserver *observer) {
+	auto it = std::find_if(_pollObservers.begin(), _pollObservers.end(),
+			[&] (const PollObserverEntry &entry) { return entry.observer == observer; });
+	assert(it != _pollObservers.end());
+	_pollObservers.erase(it);
+}
+
+void File::notifyPollObservers(int edges) {
+	assert(_defaultOps & defaultSupportsPollObservers);
+
+	// Observers can be removed while we iterate (if waiters are resumed inline),
+	// hence we use indices instead of iterators.
+	PollObserver *woken = nullptr;
+	for(size_t i = 0; i < _pollObservers.size(); i++) {
+		auto [observer, exclusive] = _pollObservers[i];
+		if(exclusive && woken)
+			continue;
+		if(observer->observePoll(edges) && exclusive)
+			woken = observer;
+	}
+
+	// Rotate exclusive observers such that wake ups are distributed among them.
+	if(woken) {
+		auto it = std::find_if(_pollObservers.begin(), _pollObservers.end(),
+				[&] (const PollObserverEntry &entry) { return entry.observer == woken; });
+		if(it != _pollObservers.end())
+			std::rotate(it, it + 1, _pollObservers.end());
+	}
+}
+
 void File::handleClose() {
 	std::cout << "posix \e[1;34m" << structName()
 			<< "\e[0m: Object does not implement handleClose()" << std::endl;
@@ -363,6 +437,36 @@ async::result<frg::expected<Error, off_t>> File::seek(off_t, VfsSeek) {
 	}
 }
 
+async::result<frg::expected<Error, off_t>> File::seekData(off_t offset) {
+	if(_defaultOps & defaultPipeLikeSeek)
+		co_return Error::seekOnPipe;
+	if(!_link)
+		co_return Error::illegalOperationTarget;
+
+	// Without knowledge about holes, the whole file consists of data.
+	auto stats = co_await _link->getTarget()->getStats();
+	if(!stats)
+		co_return Error::illegalOperationTarget;
+	if(offset < 0 || static_cast<uint64_t>(offset) >= stats.value().fileSize)
+		co_return Error::noBackingDevice;
+	co_return co_await seek(offset, VfsSeek::absolute);
+}
+
+async::result<frg::expected<Error, off_t>> File::seekHole(off_t offset) {
+	if(_defaultOps & defaultPipeLikeSeek)
+		co_return Error::seekOnPipe;
+	if(!_link)
+		co_return Error::illegalOperationTarget;
+
+	// Without knowledge about holes, the only hole is the one at the end of the file.
+	auto stats = co_await _link->getTarget()->getStats();
+	if(!stats)
+		co_return Error::illegalOperationTarget;
+	if(offset < 0 || static_cast<uint64_t>(offset) >= stats.value().fileSize)
+		co_return Error::noBackingDevice;
+	co_return co_await seek(stats.value().fileSize, VfsSeek::absolute);
+}
+
 expected<PollResult> File::poll(Process *, uint64_t, async::cancellation_token) {
 	std::cout << "posix \e[1;34m" << structName()
 			<< "\e[0m: Object does not implement poll()" << std::endl;
@@ -62,7 +62,13 @@ enum class Error {
 	noSpaceLeft,
 
 	// Corresponds with EISDIR
-	isDirectory
+	isDirectory,
+
+	// Corresponds with EMFILE
+	tooManyFiles,
+
+	// Corresponds with EBUSY
+	resourceInUse
 };
 
 std::ostream& operator<<(std::ostream& os, const Error& err);
@@ -78,6 +84,22 @@ using FutureMaybe = async::result<T>;
 template<typename T>
 using expected = async::result<std::variant<Error, T>>;
 
+// ----------------------------------------------------------------------------
+// PollObserver class.
+// ----------------------------------------------------------------------------
+
+// Receives poll edges of Files that support observers.
+// epoll uses this to push items into its ready list instead of calling pollWait().
+struct PollObserver {
+protected:
+	~PollObserver() = default;
+
+public:
+	// Returns true if the observer is interested in the edges.
+	// Only the first interested exclusive observer is notified (EPOLLEXCLUSIVE).
+	virtual bool observePoll(int edges) = 0;
+};
+
 // ----------------------------------------------------------------------------
 // File class.
 // ----------------------------------------------------------------------------
@@ -101,6 +123,7 @@ public:
 	using DefaultOps = uint32_t;
 	static inline constexpr DefaultOps defaultIsTerminal = 1 << 1;
 	static inline constexpr DefaultOps defaultPipeLikeSeek = 1 << 2;
+	static inline constexpr DefaultOps defaultSupportsPollObservers = 1 << 3;
 
 	// ------------------------------------------------------------------------
 	// File protocol adapters.
@@ -115,6 +138,12 @@ public:
 	static async::result<protocols::fs::SeekResult>
 	ptSeekEof(void *object, int64_t offset);
 
+	static async::result<protocols::fs::SeekResult>
+	ptSeekData(void *object, int64_t offset);
+
+	static async::result<protocols::fs::SeekResult>
+	ptSeekHole(void *object, int64_t offset);
+
 	static async::result<protocols::fs::ReadResult>
 	ptRead(void *object, const char *credentials, void *buffer, size_t length);
 
@@ -188,6 +217,8 @@ public:
 		.seekAbs = &ptSeekAbs,
 		.seekRel = &ptSeekRel,
 		.seekEof = &ptSeekEof,
+		.seekData = &ptSeekData,
+		.seekHole = &ptSeekHole,
 		.read = &ptRead,
 		.pread = &ptPread,
 		.write = &ptWrite,
@@ -276,11 +307,31 @@ public:
 
 	bool isTerminal();
 
+	// Files that set defaultSupportsPollObservers call notifyPollObservers()
+	// for every edge that they also report through pollWait().
+	bool supportsPollObservers() {
+		return _defaultOps & defaultSupportsPollObservers;
+	}
+
+	void addPollObserver(PollObserver *observer, bool exclusive);
+
+	void removePollObserver(PollObserver *observer);
+
+	void notifyPollObservers(int edges);
+
 	async::result<frg::expected<Error>> readExactly(Process *process, void *data, size_t length);
 
 	virtual async::result<frg::expected<Error, off_t>>
 	seek(off_t offset, VfsSeek whence);
 
+	// Implement SEEK_DATA and SEEK_HOLE. Files that do not track holes
+	// can rely on the default implementation (which treats the file as dense).
+	virtual async::result<frg::expected<Error, off_t>>
+	seekData(off_t offset);
+
+	virtual async::result<frg::expected<Error, off_t>>
+	seekHole(off_t offset);
+
 	virtual async::result<frg::expected<Error, size_t>>
 	readSome(Process *process, void *data, size_t max_length);
 
@@ -371,6 +422,13 @@ private:
 	DefaultOps _defaultOps;
 
 	bool _isOpen;
+
+	struct PollObserverEntry {
+		PollObserver *observer;
+		bool exclusive;
+	};
+
+	std::vector<PollObserverEntry> _pollObservers;
 };
 
 struct DummyFile final : File {
@@ -1,4 +1,6 @@
+#include <iomanip>
 #include <memory>
+#include <sstream>
 
 #include <protocols/mbus/client.hpp>
 
@@ -113,6 +115,78 @@ struct CmdlineNode final : public procfs::RegularNode {
 	}
 };
 
+struct InterruptsNode final : public procfs::RegularNode {
+	async::result<std::string> show() override {
+		managarm::kerncfg::CntRequest req;
+		req.set_req_type(managarm::kerncfg::CntReqType::GET_IRQ_STATS);
+
+		// The statistics can exceed the size of inline receives.
+		// Receive the response first; it tells us how large the statistics are.
+		auto ser = req.SerializeAsString();
+		auto [offer, send_req, recv_resp] = co_await helix_ng::exchangeMsgs(
+			kerncfgLane,
+			helix_ng::offer(
+				helix_ng::want_lane,
+				helix_ng::sendBuffer(ser.data(), ser.size()),
+				helix_ng::recvInline()
+			)
+		);
+		HEL_CHECK(offer.error());
+		HEL_CHECK(send_req.error());
+		HEL_CHECK(recv_resp.error());
+
+		managarm::kerncfg::SvrResponse resp;
+		resp.ParseFromArray(recv_resp.data(), recv_resp.length());
+		recv_resp.reset();
+		assert(resp.error() == managarm::kerncfg::Error::SUCCESS);
+
+		std::string statsBuffer(resp.size(), '\0');
+		auto [recv_stats] = co_await helix_ng::exchangeMsgs(
+			offer.descriptor(),
+			helix_ng::recvBuffer(statsBuffer.data(), statsBuffer.size())
+		);
+		HEL_CHECK(recv_stats.error());
+		statsBuffer.resize(recv_stats.actualLength());
+
+		// The kernel reports one line per IRQ: "<slot> <name> <count on CPU 0> ...".
+		// Reformat that into the layout of Linux' /proc/interrupts.
+		std::stringstream kernelStats{std::move(statsBuffer)};
+		std::vector<std::tuple<int, std::string, std::vector<uint64_t>>> irqs;
+		size_t numCpus = 0;
+		std::string line;
+		while(std::getline(kernelStats, line)) {
+			std::stringstream fields{line};
+			int slot;
+			std::string name;
+			if(!(fields >> slot >> name))
+				continue;
+			std::vector<uint64_t> counts;
+			uint64_t count;
+			while(fields >> count)
+				counts.push_back(count);
+			numCpus = std::max(numCpus, counts.size());
+			irqs.emplace_back(slot, std::move(name), std::move(counts));
+		}
+
+		std::stringstream stream;
+		stream << "    ";
+		for(size_t cpu = 0; cpu < numCpus; cpu++)
+			stream << std::setw(11) << ("CPU" + std::to_string(cpu));
+		stream << '\n';
+		for(auto &[slot, name, counts] : irqs) {
+			stream << std::setw(3) << slot << ':';
+			for(size_t cpu = 0; cpu < numCpus; cpu++)
+				stream << std::setw(11) << (cpu < counts.size() ? counts[cpu] : 0);
+			stream << "  " << name << '\n';
+		}
+		co_return stream.str();
+	}
+
+	async::result<void> store(std::string) override {
+		throw std::runtime_error("Cannot store to /proc/interrupts");
+	}
+};
+
 async::result<void> enumerateKerncfg() {
 	auto root = co_await mbus::Instance::global().getRoot();
 
@@ -133,6 +207,7 @@ async::result<void> enumerateKerncfg() {
 
 	auto procfs_root = std::static_pointer_cast<procfs::DirectoryNode>(getProcfs()->getTarget());
 	procfs_root->directMkregular("cmdline", std::make_shared<CmdlineNode>());
+	procfs_root->directMkregular("interrupts", std::make_shared<InterruptsNode>());
 }
 
 // --------------------------------------------------------
@@ -119,28 +119,19 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 		sequence = observe.sequence();
 
 		if(observe.observation() == kHelObserveSuperCall + posix::superAnonAllocate) {
-			uintptr_t gprs[kHelNumGprs];
-			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-			size_t size = gprs[kHelRegArg0];
+			size_t size = observe.superCallArg(0);
 
 			void *address = co_await self->vmContext()->mapFile(0,
 					{}, nullptr,
 					0, size, true, kHelMapProtRead | kHelMapProtWrite);
 
-			gprs[kHelRegError] = kHelErrNone;
-			gprs[kHelRegOut0] = reinterpret_cast<uintptr_t>(address);
-			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-			HEL_CHECK(helResume(thread.getHandle()));
+			HEL_CHECK(helCompleteSuperCall(thread.getHandle(), kHelErrNone,
+					reinterpret_cast<uintptr_t>(address), 0));
 		}else if(observe.observation() == kHelObserveSuperCall + posix::superAnonDeallocate) {
-			uintptr_t gprs[kHelNumGprs];
-			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+			self->vmContext()->unmapFile(reinterpret_cast<void *>(observe.superCallArg(0)),
+					observe.superCallArg(1));
 
-			self->vmContext()->unmapFile(reinterpret_cast<void *>(gprs[kHelRegArg0]), gprs[kHelRegArg1]);
-
-			gprs[kHelRegError] = kHelErrNone;
-			gprs[kHelRegOut0] = 0;
-			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-			HEL_CHECK(helResume(thread.getHandle()));
+			HEL_CHECK(helCompleteSuperCall(thread.getHandle(), kHelErrNone, 0, 0));
 		}else if(observe.observation() == kHelObserveSuperCall + posix::superGetProcessData) {
 			posix::ManagarmProcessData data = {
 				self->clientPosixLane(),
@@ -283,10 +274,8 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 			if(logRequests)
 				std::cout << "posix: SIG_MASK supercall" << std::endl;
 
-			uintptr_t gprs[kHelNumGprs];
-			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-			auto mode = gprs[kHelRegArg0];
-			auto mask = gprs[kHelRegArg1];
+			auto mode = observe.superCallArg(0);
+			auto mask = observe.superCallArg(1);
 
 			uint64_t former = self->signalMask();
 			if(mode == SIG_SETMASK) {
@@ -299,19 +288,30 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 				assert(!mode);
 			}
 
+			// Clients change their signal mask through the thread page and only issue
+			// this supercall (with mode zero) if they unblock a pending signal.
+			self->updatePendingSignals();
+
+			// Unless we need to raise a signal (which saves the registers to the
+			// signal frame), we can complete the supercall without touching the registers.
+			if(!self->checkOrRequestSignalRaise()) {
+				HEL_CHECK(helCompleteSuperCall(thread.getHandle(), kHelErrNone,
+						former, self->enteredSignalSeq()));
+				continue;
+			}
+
+			uintptr_t gprs[kHelNumGprs];
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
 			gprs[kHelRegError] = 0;
 			gprs[kHelRegOut0] = former;
 			gprs[kHelRegOut1] = self->enteredSignalSeq();
 			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
 
 			bool killed = false;
-			if(self->checkOrRequestSignalRaise()) {
-				auto active = co_await self->signalContext()->fetchSignal(
-						~self->signalMask(), true);
-				if(active) {
-					co_await self->signalContext()->raiseContext(active, self.get(), killed);
-				}
-			}
+			auto active = co_await self->signalContext()->fetchSignal(
+					~self->signalMask(), true);
+			if(active)
+				co_await self->signalContext()->raiseContext(active, self.get(), killed);
 			if(killed)
 				break;
 
@@ -478,13 +478,7 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 			if(logRequests)
 				std::cout << "posix: GET_TID supercall" << std::endl;
 
-			uintptr_t gprs[kHelNumGprs];
-			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-
-			gprs[kHelRegError] = 0;
-			gprs[kHelRegOut0] = self->tid();
-			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-			HEL_CHECK(helResume(thread.getHandle()));
+			HEL_CHECK(helCompleteSuperCall(thread.getHandle(), kHelErrNone, self->tid(), 0));
 		}else if(observe.observation() == kHelObserveInterrupt) {
 			//printf("posix: Process %s was interrupted\n", self->path().c_str());
 			bool killed = false;
@@ -496,6 +490,9 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 			}
 			if(killed)
 				break;
+			// Let the client know about blocked signals such that it can
+			// unblock them without a supercall if nothing is pending.
+			self->updatePendingSignals();
 			HEL_CHECK(helResume(thread.getHandle()));
 		}else if(observe.observation() == kHelObservePanic) {
 			printf("\e[35mposix: User space panic in process %s\n", self->path().c_str());
@@ -35,25 +35,43 @@ std::shared_ptr<VmContext> VmContext::clone(std::shared_ptr<VmContext> original)
 	HEL_CHECK(helCreateSpace(&space));
 	context->_space = helix::UniqueDescriptor(space);
 
+	if(original->_areaTree.empty())
+		return context;
+
+	// Clone all areas using as few system calls as possible.
+	std::vector<HelForkItem> items;
+	items.reserve(original->_areaTree.size());
 	for(const auto &entry : original->_areaTree) {
 		const auto &[address, area] = entry;
 
-		helix::UniqueDescriptor copyView;
+		HelForkItem item{};
+		item.pointer = reinterpret_cast<void *>(address);
+		item.size = area.areaSize;
+		item.mapFlags = area.nativeFlags;
 		if(area.copyOnWrite) {
-			HelHandle copyHandle;
-			HEL_CHECK(helForkMemory(area.copyView.getHandle(), &copyHandle));
-			copyView = helix::UniqueDescriptor{copyHandle};
-
-			void *pointer;
-			HEL_CHECK(helMapMemory(copyView.getHandle(), context->_space.getHandle(),
-					reinterpret_cast<void *>(address),
-					0, area.areaSize, area.nativeFlags, &pointer));
+			item.memory = area.copyView.getHandle();
+			item.offset = 0;
+			item.forkFlags = kHelForkCopyOnWrite;
 		}else{
-			void *pointer;
-			HEL_CHECK(helMapMemory(area.fileView.getHandle(), context->_space.getHandle(),
-					reinterpret_cast<void *>(address),
-					area.offset, area.areaSize, area.nativeFlags, &pointer));
+			item.memory = area.fileView.getHandle();
+			item.offset = area.offset;
 		}
+		items.push_back(item);
+	}
+
+	for(size_t i = 0; i < items.size(); i += kHelMaxForkItems) {
+		auto n = std::min(items.size() - i, size_t{kHelMaxForkItems});
+		HEL_CHECK(helForkSpace(context->_space.getHandle(), items.data() + i, n));
+	}
+
+	auto it = items.begin();
+	for(const auto &entry : original->_areaTree) {
+		const auto &[address, area] = entry;
+		assert(it != items.end());
+
+		helix::UniqueDescriptor copyView;
+		if(area.copyOnWrite)
+			copyView = helix::UniqueDescriptor{it->forkedHandle};
 
 		Area copy;
 		copy.copyOnWrite = area.copyOnWrite;
@@ -64,6 +82,7 @@ std::shared_ptr<VmContext> VmContext::clone(std::shared_ptr<VmContext> original)
 		copy.file = area.file;
 		copy.offset = area.offset;
 		context->_areaTree.emplace(address, std::move(copy));
+		++it;
 	}
 
 	return context;
@@ -317,9 +336,9 @@ std::shared_ptr<FileContext> FileContext::create() {
 
 	HelHandle memory;
 	void *window;
-	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &memory));
+	HEL_CHECK(helAllocateMemory(fileTableWindowSize, 0, nullptr, &memory));
 	HEL_CHECK(helMapMemory(memory, kHelNullHandle, nullptr,
-			0, 0x1000, kHelMapProtRead | kHelMapProtWrite, &window));
+			0, fileTableWindowSize, kHelMapProtRead | kHelMapProtWrite, &window));
 	context->_fileTableMemory = helix::UniqueDescriptor(memory);
 	context->_fileTableWindow = reinterpret_cast<HelHandle *>(window);
 
@@ -338,16 +357,20 @@ std::shared_ptr<FileContext> FileContext::clone(std::shared_ptr<FileContext> ori
 
 	HelHandle memory;
 	void *window;
-	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &memory));
+	HEL_CHECK(helAllocateMemory(fileTableWindowSize, 0, nullptr, &memory));
 	HEL_CHECK(helMapMemory(memory, kHelNullHandle, nullptr,
-			0, 0x1000, kHelMapProtRead | kHelMapProtWrite, &window));
+			0, fileTableWindowSize, kHelMapProtRead | kHelMapProtWrite, &window));
 	context->_fileTableMemory = helix::UniqueDescriptor(memory);
 	context->_fileTableWindow = reinterpret_cast<HelHandle *>(window);
 
-	for(auto entry : original->_fileTable) {
-		//std::cout << "Clone FD " << entry.first << std::endl;
-		context->attachFile(entry.first, entry.second.file, entry.second.closeOnExec);
+	for(size_t fd = 0; fd < original->_fileTable.size(); fd++) {
+		auto &entry = original->_fileTable[fd];
+		if(!entry.file)
+			continue;
+		context->attachFile(fd, entry.file, entry.closeOnExec);
 	}
+	context->_fdLimit = original->_fdLimit;
+	context->_fdHardLimit = original->_fdHardLimit;
 
 	HEL_CHECK(helTransferDescriptor(posixMbusClient,
 			context->_universe.getHandle(), &context->_clientMbusLane));
@@ -360,95 +383,96 @@ FileContext::~FileContext() {
 		std::cout << "\e[33mposix: FileContext is destructed\e[39m" << std::endl;
 }
 
-int FileContext::attachFile(smarter::shared_ptr<File, FileHandle> file,
+frg::expected<Error, int> FileContext::attachFile(smarter::shared_ptr<File, FileHandle> file,
 		bool close_on_exec) {
-	HelHandle handle;
-	HEL_CHECK(helTransferDescriptor(file->getPassthroughLane().getHandle(),
-			_universe.getHandle(), &handle));
+	int fd = _usedFds.findFree();
+	if(static_cast<uint64_t>(fd) >= _fdLimit)
+		return Error::tooManyFiles;
 
-	for(int fd = 0; ; fd++) {
-		if(_fileTable.find(fd) != _fileTable.end())
-			continue;
-
-		if(logFileAttach)
-			std::cout << "posix: Attaching FD " << fd << std::endl;
-
-		_fileTable.insert({fd, {std::move(file), close_on_exec}});
-		_fileTableWindow[fd] = handle;
-		return fd;
-	}
+	attachFile(fd, std::move(file), close_on_exec);
+	return fd;
 }
 
 void FileContext::attachFile(int fd, smarter::shared_ptr<File, FileHandle> file,
 		bool close_on_exec) {
+	assert(fd >= 0 && static_cast<uint64_t>(fd) < maxFileDescriptors);
+
 	HelHandle handle;
 	HEL_CHECK(helTransferDescriptor(file->getPassthroughLane().getHandle(),
 			_universe.getHandle(), &handle));
 
 	if(logFileAttach)
-		std::cout << "posix: Attaching fixed FD " << fd << std::endl;
+		std::cout << "posix: Attaching FD " << fd << std::endl;
 
-	auto it = _fileTable.find(fd);
-	if(it != _fileTable.end()) {
-		it->second = {std::move(file), close_on_exec};
-	}else{
-		_fileTable.insert({fd, {std::move(file), close_on_exec}});
-	}
+	if(static_cast<size_t>(fd) >= _fileTable.size())
+		_fileTable.resize(std::max(static_cast<size_t>(fd) + 1, 2 * _fileTable.size()));
+
+	// Replace the existing file (if any). Its handle is dropped in the universe
+	// just like for closeFile().
+	if(_fileTable[fd].file)
+		HEL_CHECK(helCloseDescriptor(_universe.getHandle(), _fileTableWindow[fd]));
+
+	_fileTable[fd] = {std::move(file), close_on_exec};
+	_usedFds.set(fd);
 	_fileTableWindow[fd] = handle;
 }
 
 std::optional<FileDescriptor> FileContext::getDescriptor(int fd) {
-	auto file = _fileTable.find(fd);
-	if(file == _fileTable.end())
+	if(fd < 0 || static_cast<size_t>(fd) >= _fileTable.size() || !_fileTable[fd].file)
 		return std::nullopt;
-	return file->second;
+	return _fileTable[fd];
 }
 
 Error FileContext::setDescriptor(int fd, bool close_on_exec) {
-	auto it = _fileTable.find(fd);
-	if(it == _fileTable.end()) {
+	if(fd < 0 || static_cast<size_t>(fd) >= _fileTable.size() || !_fileTable[fd].file)
 		return Error::noSuchFile;
-	}
-	it->second.closeOnExec = close_on_exec;
+	_fileTable[fd].closeOnExec = close_on_exec;
 	return Error::success;
 }
 
 smarter::shared_ptr<File, FileHandle> FileContext::getFile(int fd) {
-	auto file = _fileTable.find(fd);
-	if(file == _fileTable.end())
+	if(fd < 0 || static_cast<size_t>(fd) >= _fileTable.size())
 		return smarter::shared_ptr<File, FileHandle>{};
-	return file->second.file;
+	return _fileTable[fd].file;
 }
 
 Error FileContext::closeFile(int fd) {
 	if(logFileAttach)
 		std::cout << "posix: Closing FD " << fd << std::endl;
-	auto it = _fileTable.find(fd);
-	if(it == _fileTable.end()) {
+	if(fd < 0 || static_cast<size_t>(fd) >= _fileTable.size() || !_fileTable[fd].file)
 		return Error::noSuchFile;
-	}
 
 	HEL_CHECK(helCloseDescriptor(_universe.getHandle(), _fileTableWindow[fd]));
 
 	_fileTableWindow[fd] = 0;
-	_fileTable.erase(it);
+	_fileTable[fd] = {};
+	_usedFds.clear(fd);
 	return Error::success;
 }
 
 void FileContext::closeOnExec() {
-	auto it = _fileTable.begin();
-	while(it != _fileTable.end()) {
-		if(it->second.closeOnExec) {
-			HEL_CHECK(helCloseDescriptor(_universe.getHandle(), _fileTableWindow[it->first]));
+	for(size_t fd = 0; fd < _fileTable.size(); fd++) {
+		if(!_fileTable[fd].file || !_fileTable[fd].closeOnExec)
+			continue;
 
-			_fileTableWindow[it->first] = 0;
-			it = _fileTable.erase(it);
-		}else{
-			it++;
-		}
+		HEL_CHECK(helCloseDescriptor(_universe.getHandle(), _fileTableWindow[fd]));
+
+		_fileTableWindow[fd] = 0;
+		_fileTable[fd] = {};
+		_usedFds.clear(fd);
 	}
 }
 
+Error FileContext::setFdLimit(uint64_t limit, uint64_t hardLimit, bool privileged) {
+	if(limit > hardLimit || hardLimit > maxFileDescriptors)
+		return Error::illegalArguments;
+	if(hardLimit > _fdHardLimit && !privileged)
+		return Error::insufficientPermissions;
+	_fdLimit = limit;
+	_fdHardLimit = hardLimit;
+	return Error::success;
+}
+
 // ----------------------------------------------------------------------------
 // SignalContext.
 // ----------------------------------------------------------------------------
@@ -859,7 +883,7 @@ async::result<std::shared_ptr<Process>> Process::init(std::string path) {
 	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
 
 	// The initial signal mask allows all signals.
-	process->_signalMask = 0;
+	process->setSignalMask(0);
 
 	auto [server_lane, client_lane] = helix::createStream();
 	HEL_CHECK(helTransferDescriptor(client_lane.getHandle(),
@@ -872,7 +896,7 @@ async::result<std::shared_ptr<Process>> Process::init(std::string path) {
 			&process->_clientThreadPage));
 	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, fileTableWindowSize, kHelMapProtRead,
 			&process->_clientFileTable));
 	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
@@ -931,7 +955,7 @@ std::shared_ptr<Process> Process::fork(std::shared_ptr<Process> original) {
 	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
 
 	// Signal masks are copied on fork().
-	process->_signalMask = original->_signalMask;
+	process->setSignalMask(original->signalMask());
 
 	auto [server_lane, client_lane] = helix::createStream();
 	HEL_CHECK(helTransferDescriptor(client_lane.getHandle(),
@@ -944,7 +968,7 @@ std::shared_ptr<Process> Process::fork(std::shared_ptr<Process> original) {
 			&process->_clientThreadPage));
 	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, fileTableWindowSize, kHelMapProtRead,
 			&process->_clientFileTable));
 	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
@@ -997,7 +1021,7 @@ std::shared_ptr<Process> Process::clone(std::shared_ptr<Process> original, void
 	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
 
 	// Signal masks are copied on clone().
-	process->_signalMask = original->_signalMask;
+	process->setSignalMask(original->signalMask());
 
 	auto [server_lane, client_lane] = helix::createStream();
 	HEL_CHECK(helTransferDescriptor(client_lane.getHandle(),
@@ -1068,7 +1092,7 @@ async::result<Error> Process::exec(std::shared_ptr<Process> process,
 			&exec_clk_tracker_page));
 	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
 			exec_vm_context->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, fileTableWindowSize, kHelMapProtRead,
 			&exec_client_table));
 
 	// Kill the old thread.
@@ -9,6 +9,7 @@
 #include <async/recurring-event.hpp>
 #include <boost/intrusive/list.hpp>
 
+#include "fd-bitmap.hpp"
 #include "vfs.hpp"
 #include "procfs.hpp"
 
@@ -153,6 +154,16 @@ struct FileDescriptor {
 	bool closeOnExec;
 };
 
+// Size of the file table that is shared with the client.
+inline constexpr size_t fileTableWindowSize = 0x100000;
+
+// Hard upper bound on RLIMIT_NOFILE, determined by the size of the shared file table.
+inline constexpr uint64_t maxFileDescriptors = fileTableWindowSize / sizeof(HelHandle);
+
+// Default soft RLIMIT_NOFILE. Linux uses 1024, but no libc issues SetRlimitRequest yet,
+// i.e., processes could not raise the limit. Until then, default to the hard limit.
+inline constexpr uint64_t defaultFileDescriptorLimit = maxFileDescriptors;
+
 struct FileContext {
 public:
 	static std::shared_ptr<FileContext> create();
@@ -168,8 +179,11 @@ public:
 		return _fileTableMemory;
 	}
 
-	int attachFile(smarter::shared_ptr<File, FileHandle> file, bool close_on_exec = false);
+	// Attaches the file to the lowest free FD. Fails if RLIMIT_NOFILE is exceeded.
+	frg::expected<Error, int> attachFile(smarter::shared_ptr<File, FileHandle> file,
+			bool close_on_exec = false);
 
+	// Attaches the file to a fixed FD. The caller needs to check that fd is below fdLimit().
 	void attachFile(int fd, smarter::shared_ptr<File, FileHandle> file, bool close_on_exec = false);
 
 	std::optional<FileDescriptor> getDescriptor(int fd);
@@ -182,6 +196,18 @@ public:
 
 	void closeOnExec();
 
+	// Soft and hard RLIMIT_NOFILE.
+	uint64_t fdLimit() {
+		return _fdLimit;
+	}
+
+	uint64_t fdHardLimit() {
+		return _fdHardLimit;
+	}
+
+	// Only privileged processes can raise the hard limit.
+	Error setFdLimit(uint64_t limit, uint64_t hardLimit, bool privileged);
+
 	HelHandle clientMbusLane() {
 		return _clientMbusLane;
 	}
@@ -189,8 +215,14 @@ public:
 private:
 	helix::UniqueDescriptor _universe;
 
-	// TODO: replace this by a tree that remembers gaps between keys.
-	std::unordered_map<int, FileDescriptor> _fileTable;
+	// Indexed by FD. Entries without a file are unused.
+	std::vector<FileDescriptor> _fileTable;
+
+	// Tracks the FDs that are in use to quickly find the lowest free one.
+	FdBitmap _usedFds;
+
+	uint64_t _fdLimit = defaultFileDescriptorLimit;
+	uint64_t _fdHardLimit = maxFileDescriptors;
 
 	helix::UniqueDescriptor _fileTableMemory;
 
@@ -327,8 +359,23 @@ struct Generation {
 	async::oneshot_event requestsDone;
 };
 
+// Page that is shared between the POSIX server and each client thread.
+// Clients may change their signal mask by writing signalMask directly. To do so,
+// a client (i) stores the new mask, (ii) issues a full fence and (iii) re-reads
+// pendingSignals. If the re-read value contains signals that the new mask unblocks,
+// the client issues the SIG_MASK supercall (with mode zero) to have them raised.
+// Re-reading after the fence is required: a signal that is raised between
+// the store and a read issued before it would otherwise never be delivered.
+// Note that no libc writes signalMask yet, i.e., this fast path is currently unused
+// and all clients still go through the SIG_MASK supercall.
 struct ThreadPage {
 	int globalSignalFlag;
+	int reserved;
+	// Signal mask of the thread. The SIG_MASK supercall updates this field
+	// on behalf of clients that do not write it themselves.
+	uint64_t signalMask;
+	// Pending signals at the time the thread was last stopped by the server.
+	uint64_t pendingSignals;
 };
 
 // --------------------------------------------------------------------------------------
@@ -506,12 +553,20 @@ public:
 	std::shared_ptr<ProcessGroup> pgPointer() { return _pgPointer; }
 	SignalContext *signalContext() { return _signalContext.get(); }
 
+	// The signal mask lives in the thread page such that clients can change it directly.
 	void setSignalMask(uint64_t mask) {
-		_signalMask = mask;
+		__atomic_store_n(&accessThreadPage()->signalMask, mask, __ATOMIC_RELAXED);
 	}
 
 	uint64_t signalMask() {
-		return _signalMask;
+		return __atomic_load_n(&accessThreadPage()->signalMask, __ATOMIC_RELAXED);
+	}
+
+	// Publish the currently pending signals to the thread page.
+	// Precondition: the thread has to be stopped!
+	void updatePendingSignals() {
+		auto activeSet = std::get<1>(_signalContext->checkSignal());
+		__atomic_store_n(&accessThreadPage()->pendingSignals, activeSet, __ATOMIC_RELAXED);
 	}
 
 	HelHandle clientPosixLane() { return _clientPosixLane; }
@@ -530,7 +585,7 @@ public:
 
 	// Check if signals can currently be raised (via the thread page).
 	// If not, request the thread to raise its signals.
-	// Preconditon: the thread has to be stopped!
+	// Precondition: the thread has to be stopped!
 	bool checkOrRequestSignalRaise();
 
 	async::result<void> terminate(TerminationState state);
@@ -608,7 +663,6 @@ private:
 	void *_clientAuxBegin = nullptr;
 	void *_clientAuxEnd = nullptr;
 
-	uint64_t _signalMask;
 	std::vector<std::shared_ptr<Process>> _children;
 
 	// The following intrusive queue stores notifications for wait().
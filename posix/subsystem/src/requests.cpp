@@ -1,3 +1,4 @@
+#include <fcntl.h>
 #include <linux/netlink.h>
 #include <sys/mman.h>
 #include <sys/poll.h>
@@ -24,6 +25,7 @@
 #include "un-socket.hpp"
 #include "timerfd.hpp"
 #include "eventfd.hpp"
+#include "exec.hpp"
 #include "tmp_fs.hpp"
 
 #include <bragi/helpers-std.hpp>
@@ -31,6 +33,24 @@
 
 #include "debug-options.hpp"
 
+namespace {
+
+managarm::posix::Errors mapPipeError(Error e) {
+	switch(e) {
+	case Error::wouldBlock: return managarm::posix::Errors::WOULD_BLOCK;
+	case Error::brokenPipe: return managarm::posix::Errors::BROKEN_PIPE;
+	case Error::resourceInUse: return managarm::posix::Errors::RESOURCE_IN_USE;
+	case Error::insufficientPermissions: return managarm::posix::Errors::INSUFFICIENT_PERMISSION;
+	case Error::seekOnPipe: return managarm::posix::Errors::ILLEGAL_ARGUMENTS;
+	case Error::illegalArguments: return managarm::posix::Errors::ILLEGAL_ARGUMENTS;
+	default:
+		std::cout << "posix: Unexpected error " << e << " from pipe operation" << std::endl;
+		return managarm::posix::Errors::ILLEGAL_ARGUMENTS;
+	}
+}
+
+} // anonymous namespace
+
 async::result<void> serveRequests(std::shared_ptr<Process> self,
 		std::shared_ptr<Generation> generation) {
 	async::cancellation_token cancellation = generation->cancelServe;
@@ -413,6 +433,9 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				assert(file && "Illegal FD for VM_MAP");
 				auto memory = co_await file->accessMemory();
 				assert(memory);
+				// Writes through shared mappings are not observed by posix.
+				if(!copyOnWrite && (nativeFlags & kHelMapProtWrite) && file->associatedMount())
+					invalidateExecCache(file->associatedLink()->getTarget().get());
 				address = co_await self->vmContext()->mapFile(hint,
 						std::move(memory), std::move(file),
 						req->rel_offset(), req->size(), copyOnWrite, nativeFlags);
@@ -1678,12 +1701,16 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				auto result = co_await file->truncate(0);
 				assert(result || result.error() == protocols::fs::Error::illegalOperationTarget);
 			}
-			int fd = self->fileContext()->attachFile(file,
+			auto fd = self->fileContext()->attachFile(file,
 					req->flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto [sendResp] = co_await helix_ng::exchangeMsgs(
 					conversation,
@@ -1753,14 +1780,18 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				continue;
 			}
 
-			int newfd = self->fileContext()->attachFile(file,
+			auto newfd = self->fileContext()->attachFile(file,
 					req.flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
+			if(!newfd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			helix::SendBuffer send_resp;
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(newfd);
+			resp.set_fd(newfd.value());
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
@@ -1773,7 +1804,8 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 
 			auto file = self->fileContext()->getFile(req.fd());
 
-			if (!file || req.newfd() < 0) {
+			if (!file || req.newfd() < 0
+					|| static_cast<uint64_t>(req.newfd()) >= self->fileContext()->fdLimit()) {
 				helix::SendBuffer send_resp;
 
 				managarm::posix::SvrResponse resp;
@@ -2204,13 +2236,22 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 			auto pair = fifo::createPair(nonBlock);
 			auto r_fd = self->fileContext()->attachFile(std::get<0>(pair),
 					req.flags() & O_CLOEXEC);
+			if(!r_fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 			auto w_fd = self->fileContext()->attachFile(std::get<1>(pair),
 					req.flags() & O_CLOEXEC);
+			if(!w_fd) {
+				self->fileContext()->closeFile(r_fd.value());
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.add_fds(r_fd);
-			resp.add_fds(w_fd);
+			resp.add_fds(r_fd.value());
+			resp.add_fds(w_fd.value());
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
@@ -2259,7 +2300,7 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 						|| req->socktype() == SOCK_SEQPACKET);
 				assert(!req->protocol());
 
-				file = un_socket::createSocketFile(req->flags() & SOCK_NONBLOCK);
+				file = un_socket::createSocketFile(req->flags() & SOCK_NONBLOCK, req->socktype());
 			}else if(req->domain() == AF_NETLINK) {
 				assert(req->socktype() == SOCK_RAW || req->socktype() == SOCK_DGRAM);
 				// NL_ROUTE gets handled by the netserver.
@@ -2286,8 +2327,12 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 
 			auto fd = self->fileContext()->attachFile(file,
 					req->flags() & SOCK_CLOEXEC);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto [send_resp] = co_await helix_ng::exchangeMsgs(
 					conversation,
@@ -2332,16 +2377,25 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				continue;
 			}
 
-			auto pair = un_socket::createSocketPair(self.get());
+			auto pair = un_socket::createSocketPair(self.get(), req->socktype());
 			auto fd0 = self->fileContext()->attachFile(std::get<0>(pair),
 					req->flags() & SOCK_CLOEXEC);
+			if(!fd0) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 			auto fd1 = self->fileContext()->attachFile(std::get<1>(pair),
 					req->flags() & SOCK_CLOEXEC);
+			if(!fd1) {
+				self->fileContext()->closeFile(fd0.value());
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.add_fds(fd0);
-			resp.add_fds(fd1);
+			resp.add_fds(fd0.value());
+			resp.add_fds(fd1.value());
 
 			auto [send_resp] = co_await helix_ng::exchangeMsgs(
 					conversation,
@@ -2374,10 +2428,14 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 			}
 			auto newfile = newfileResult.value();
 			auto fd = self->fileContext()->attachFile(std::move(newfile));
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto [send_resp] = co_await helix_ng::exchangeMsgs(
 					conversation,
@@ -2497,10 +2555,14 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 			auto file = epoll::createFile();
 			auto fd = self->fileContext()->attachFile(file,
 					req.flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
@@ -2554,6 +2616,9 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 			if(ret == Error::noSuchFile) {
 				co_await sendErrorResponse(managarm::posix::Errors::FILE_NOT_FOUND);
 				continue;
+			}else if(ret == Error::illegalArguments) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
 			}
 			assert(ret == Error::success);
 
@@ -2607,26 +2672,30 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				co_await sendErrorResponse(managarm::posix::Errors::BAD_FD);
 				continue;
 			}
+			if(!req.size()) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
+			}
 			if(req.sigmask_needed()) {
 				self->setSignalMask(req.sigmask());
 			}
 
-			struct epoll_event events[16];
+			// Return up to 256 events per request such that busy
+			// epoll instances do not need one round trip per 16 events.
+			std::vector<struct epoll_event> events(std::min(req.size(), uint32_t(256)));
 			size_t k;
 			if(req.timeout() < 0) {
-				k = co_await epoll::wait(epfile.get(), events,
-						std::min(req.size(), uint32_t(16)));
+				k = co_await epoll::wait(epfile.get(), events.data(), events.size());
 			}else if(!req.timeout()) {
 				// Do not bother to set up a timer for zero timeouts.
 				async::cancellation_event cancel_wait;
 				cancel_wait.cancel();
-				k = co_await epoll::wait(epfile.get(), events,
-						std::min(req.size(), uint32_t(16)), cancel_wait);
+				k = co_await epoll::wait(epfile.get(), events.data(), events.size(), cancel_wait);
 			}else{
 				assert(req.timeout() > 0);
 				async::cancellation_event cancel_wait;
 				helix::TimeoutCancellation timer{static_cast<uint64_t>(req.timeout()), cancel_wait};
-				k = co_await epoll::wait(epfile.get(), events, 16, cancel_wait);
+				k = co_await epoll::wait(epfile.get(), events.data(), events.size(), cancel_wait);
 				co_await timer.retire();
 			}
 			if(req.sigmask_needed()) {
@@ -2639,7 +2708,7 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
 					helix::action(&send_resp, ser.data(), ser.size(), kHelItemChain),
-					helix::action(&send_data, events, k * sizeof(struct epoll_event)));
+					helix::action(&send_data, events.data(), k * sizeof(struct epoll_event)));
 			co_await transmit.async_wait();
 			HEL_CHECK(send_resp.error());
 		}else if(req.request_type() == managarm::posix::CntReqType::TIMERFD_CREATE) {
@@ -2652,10 +2721,14 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 
 			auto file = timerfd::createFile(req.flags() & TFD_NONBLOCK);
 			auto fd = self->fileContext()->attachFile(file, req.flags() & TFD_CLOEXEC);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
@@ -2698,10 +2771,14 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 					req.flags() & managarm::posix::OpenFlags::OF_NONBLOCK);
 			auto fd = self->fileContext()->attachFile(file,
 					req.flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
@@ -2724,10 +2801,14 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 			auto file = inotify::createFile();
 			auto fd = self->fileContext()->attachFile(file,
 					req->flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
 
 			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_fd(fd.value());
 
 			auto [send_resp] = co_await helix_ng::exchangeMsgs(
 					conversation,
@@ -2813,8 +2894,12 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				auto fd = self->fileContext()->attachFile(file,
 						req->flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
 
-				resp.set_error(managarm::posix::Errors::SUCCESS);
-				resp.set_fd(fd);
+				if(fd) {
+					resp.set_error(managarm::posix::Errors::SUCCESS);
+					resp.set_fd(fd.value());
+				}else{
+					resp.set_error(managarm::posix::Errors::TOO_MANY_FILES);
+				}
 			}
 
 			auto [send_resp] = co_await helix_ng::exchangeMsgs(
@@ -3131,10 +3216,244 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				flags |= managarm::posix::OpenFlags::OF_CLOEXEC;
 			}
 
-			int fd = self->fileContext()->attachFile(file, flags);
+			auto fd = self->fileContext()->attachFile(file, flags);
+			if(!fd) {
+				co_await sendErrorResponse(managarm::posix::Errors::TOO_MANY_FILES);
+				continue;
+			}
+
+			resp.set_error(managarm::posix::Errors::SUCCESS);
+			resp.set_fd(fd.value());
+
+			auto [sendResp] = co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
+				);
+			HEL_CHECK(sendResp.error());
+		}else if(preamble.id() == managarm::posix::GetPipeSizeRequest::message_id
+				|| preamble.id() == managarm::posix::SetPipeSizeRequest::message_id) {
+			frg::expected<Error, size_t> result;
+			if(preamble.id() == managarm::posix::GetPipeSizeRequest::message_id) {
+				auto req = bragi::parse_head_only<managarm::posix::GetPipeSizeRequest>(recv_head);
+				if(!req) {
+					std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+					break;
+				}
 
+				if(logRequests)
+					std::cout << "posix: GET_PIPE_SIZE " << req->fd() << std::endl;
+
+				auto file = self->fileContext()->getFile(req->fd());
+				if(!file) {
+					co_await sendErrorResponse(managarm::posix::Errors::NO_SUCH_FD);
+					continue;
+				}
+				result = fifo::getPipeSize(file.get());
+			}else{
+				auto req = bragi::parse_head_only<managarm::posix::SetPipeSizeRequest>(recv_head);
+				if(!req) {
+					std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+					break;
+				}
+
+				if(logRequests)
+					std::cout << "posix: SET_PIPE_SIZE " << req->fd() << " to " << req->size() << std::endl;
+
+				auto file = self->fileContext()->getFile(req->fd());
+				if(!file) {
+					co_await sendErrorResponse(managarm::posix::Errors::NO_SUCH_FD);
+					continue;
+				}
+				result = fifo::setPipeSize(file.get(), req->size());
+			}
+
+			if(!result) {
+				co_await sendErrorResponse(mapPipeError(result.error()));
+				continue;
+			}
+
+			managarm::posix::SvrResponse resp;
+			resp.set_error(managarm::posix::Errors::SUCCESS);
+			resp.set_size(result.value());
+
+			auto [sendResp] = co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
+				);
+			HEL_CHECK(sendResp.error());
+		}else if(preamble.id() == managarm::posix::GetRlimitRequest::message_id) {
+			auto req = bragi::parse_head_only<managarm::posix::GetRlimitRequest>(recv_head);
+			if(!req) {
+				std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+				break;
+			}
+
+			if(logRequests)
+				std::cout << "posix: GET_RLIMIT " << req->resource() << std::endl;
+
+			if(req->resource() != RLIMIT_NOFILE) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
+			}
+
+			managarm::posix::SvrResponse resp;
+			resp.set_error(managarm::posix::Errors::SUCCESS);
+			resp.set_rlim_cur(self->fileContext()->fdLimit());
+			resp.set_rlim_max(self->fileContext()->fdHardLimit());
+
+			auto [sendResp] = co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
+				);
+			HEL_CHECK(sendResp.error());
+		}else if(preamble.id() == managarm::posix::SetRlimitRequest::message_id) {
+			auto req = bragi::parse_head_only<managarm::posix::SetRlimitRequest>(recv_head);
+			if(!req) {
+				std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+				break;
+			}
+
+			if(logRequests)
+				std::cout << "posix: SET_RLIMIT " << req->resource()
+						<< " to " << req->current() << "/" << req->max() << std::endl;
+
+			if(req->resource() != RLIMIT_NOFILE) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
+			}
+
+			// Raising the hard limit requires root privileges (like CAP_SYS_RESOURCE on Linux).
+			auto error = self->fileContext()->setFdLimit(req->current(), req->max(),
+					self->euid() == 0);
+			if(error == Error::insufficientPermissions) {
+				co_await sendErrorResponse(managarm::posix::Errors::INSUFFICIENT_PERMISSION);
+				continue;
+			}else if(error != Error::success) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
+			}
+
+			co_await sendErrorResponse(managarm::posix::Errors::SUCCESS);
+		}else if(preamble.id() == managarm::posix::SpliceRequest::message_id) {
+			auto req = bragi::parse_head_only<managarm::posix::SpliceRequest>(recv_head);
+			if(!req) {
+				std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+				break;
+			}
+
+			if(logRequests)
+				std::cout << "posix: SPLICE " << req->fd_in() << " -> " << req->fd_out() << std::endl;
+
+			if(req->flags() & ~(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
+			}
+
+			auto inFile = self->fileContext()->getFile(req->fd_in());
+			auto outFile = self->fileContext()->getFile(req->fd_out());
+			if(!inFile || !outFile) {
+				co_await sendErrorResponse(managarm::posix::Errors::NO_SUCH_FD);
+				continue;
+			}
+
+			std::optional<int64_t> inOffset;
+			std::optional<int64_t> outOffset;
+			if(req->has_offset_in())
+				inOffset = req->offset_in();
+			if(req->has_offset_out())
+				outOffset = req->offset_out();
+
+			auto result = co_await fifo::splice(self.get(), inFile.get(), inOffset,
+					outFile.get(), outOffset, req->length(), req->flags() & SPLICE_F_NONBLOCK);
+			if(!result) {
+				co_await sendErrorResponse(mapPipeError(result.error()));
+				continue;
+			}
+
+			managarm::posix::SvrResponse resp;
+			resp.set_error(managarm::posix::Errors::SUCCESS);
+			resp.set_size(result.value());
+
+			auto [sendResp] = co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
+				);
+			HEL_CHECK(sendResp.error());
+		}else if(preamble.id() == managarm::posix::TeeRequest::message_id) {
+			auto req = bragi::parse_head_only<managarm::posix::TeeRequest>(recv_head);
+			if(!req) {
+				std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+				break;
+			}
+
+			if(logRequests)
+				std::cout << "posix: TEE " << req->fd_in() << " -> " << req->fd_out() << std::endl;
+
+			auto inFile = self->fileContext()->getFile(req->fd_in());
+			auto outFile = self->fileContext()->getFile(req->fd_out());
+			if(!inFile || !outFile) {
+				co_await sendErrorResponse(managarm::posix::Errors::NO_SUCH_FD);
+				continue;
+			}
+
+			auto result = co_await fifo::tee(inFile.get(), outFile.get(),
+					req->length(), req->flags() & SPLICE_F_NONBLOCK);
+			if(!result) {
+				co_await sendErrorResponse(mapPipeError(result.error()));
+				continue;
+			}
+
+			managarm::posix::SvrResponse resp;
+			resp.set_error(managarm::posix::Errors::SUCCESS);
+			resp.set_size(result.value());
+
+			auto [sendResp] = co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
+				);
+			HEL_CHECK(sendResp.error());
+		}else if(preamble.id() == managarm::posix::VmspliceRequest::message_id) {
+			std::vector<std::byte> tail(preamble.tail_size());
+			auto [recv_tail] = co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::recvBuffer(tail.data(), tail.size())
+				);
+			HEL_CHECK(recv_tail.error());
+
+			auto req = bragi::parse_head_tail<managarm::posix::VmspliceRequest>(recv_head, tail);
+			if(!req) {
+				std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+				break;
+			}
+
+			if(logRequests)
+				std::cout << "posix: VMSPLICE " << req->fd() << std::endl;
+
+			if(req->iov_bases().size() != req->iov_lengths().size()) {
+				co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
+				continue;
+			}
+
+			auto file = self->fileContext()->getFile(req->fd());
+			if(!file) {
+				co_await sendErrorResponse(managarm::posix::Errors::NO_SUCH_FD);
+				continue;
+			}
+
+			std::vector<std::pair<uintptr_t, size_t>> iovs;
+			for(size_t i = 0; i < req->iov_bases().size(); i++)
+				iovs.push_back({req->iov_bases()[i], req->iov_lengths()[i]});
+
+			auto result = co_await fifo::vmsplice(self.get(), file.get(),
+					std::move(iovs), req->flags() & SPLICE_F_NONBLOCK);
+			if(!result) {
+				co_await sendErrorResponse(mapPipeError(result.error()));
+				continue;
+			}
+
+			managarm::posix::SvrResponse resp;
 			resp.set_error(managarm::posix::Errors::SUCCESS);
-			resp.set_fd(fd);
+			resp.set_size(result.value());
 
 			auto [sendResp] = co_await helix_ng::exchangeMsgs(
 					conversation,
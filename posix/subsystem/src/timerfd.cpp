@@ -41,6 +41,7 @@ private:
 				_expirations++;
 				_theSeq++;
 				_seqBell.raise();
+				notifyPollObservers(EPOLLIN);
 			}else{
 				delete timer;
 				co_return;
@@ -68,6 +69,7 @@ private:
 				_expirations++;
 				_theSeq++;
 				_seqBell.raise();
+				notifyPollObservers(EPOLLIN);
 			}else{
 				delete timer;
 				co_return;
@@ -86,7 +88,7 @@ public:
 	}
 
 	OpenFile(bool non_block)
-	: File{StructName::get("timerfd")}, _nonBlock{non_block},
+	: File{StructName::get("timerfd"), File::defaultSupportsPollObservers}, _nonBlock{non_block},
 			_activeTimer{nullptr}, _expirations{0}, _theSeq{0} {
 		(void)_nonBlock;
 	}
@@ -1,12 +1,16 @@
 #include <fcntl.h>
 #include <unistd.h>
+#include <map>
+#include <mutex>
 #include <set>
 
+#include <async/mutex.hpp>
 #include <helix/memory.hpp>
 #include <protocols/fs/client.hpp>
 #include <protocols/fs/server.hpp>
 #include "common.hpp"
 #include "device.hpp"
+#include "exec.hpp"
 #include "tmp_fs.hpp"
 #include "fifo.hpp"
 #include "process.hpp"
@@ -86,6 +90,13 @@ public:
 		return _ctime;
 	}
 
+	// Called when the contents of the node change.
+	// Note that the exec cache relies on this to detect modified executables.
+	void updateMtime() {
+		// TODO: Move to CLOCK_REALTIME when supported
+		clock_gettime(CLOCK_MONOTONIC, &_mtime);
+	}
+
 	async::result<Error> chmod(int mode) override {
 		_mode = (_mode & 0xFFFFF000) | mode;
 		co_return Error::success;
@@ -303,6 +314,7 @@ private:
 			co_return Error::alreadyExists;
 		auto link = std::make_shared<Link>(shared_from_this(), std::move(name), std::move(target));
 		_entries.insert(link);
+		notifyObservers(FsObserver::createEvent, link->getName(), 0);
 		co_return link;
 	}
 
@@ -396,6 +408,10 @@ public:
 
 	async::result<frg::expected<Error, off_t>> seek(off_t delta, VfsSeek whence) override;
 
+	async::result<frg::expected<Error, off_t>> seekData(off_t offset) override;
+
+	async::result<frg::expected<Error, off_t>> seekHole(off_t offset) override;
+
 	async::result<frg::expected<Error, size_t>>
 	readSome(Process *, void *buffer, size_t max_length) override;
 
@@ -451,7 +467,6 @@ struct MemoryNode final : Node {
 	}
 
 	async::result<frg::expected<Error, FileStats>> getStats() override {
-		std::cout << "\e[31mposix: Fix tmpfs getStats() in MemoryNode\e[39m" << std::endl;
 		FileStats stats{};
 		stats.inodeNumber = inodeNumber();
 		stats.fileSize = _fileSize;
@@ -469,29 +484,38 @@ struct MemoryNode final : Node {
 	}
 
 private:
-	void _resizeFile(size_t new_size) {
-		_fileSize = new_size;
+	// Grows the memory object such that it covers at least the given size.
+	void _ensureArea(size_t size);
 
-		size_t aligned_size = (new_size + 0xFFF) & ~size_t(0xFFF);
-		if(aligned_size <= _areaSize)
-			return;
+	// Records that the pages overlapping [offset, offset + length) contain data.
+	void _markData(uint64_t offset, size_t length);
 
-		if(_memory) {
-			HEL_CHECK(helResizeMemory(_memory.getHandle(), aligned_size));
-		}else{
-			HelHandle handle;
-			HEL_CHECK(helAllocateMemory(aligned_size, 0, nullptr, &handle));
-			_memory = helix::UniqueDescriptor{handle};
-		}
+	// Changes the file size. Data beyond the new size is discarded.
+	// Callers need to hold _mutex.
+	async::result<void> _resizeFile(size_t newSize);
 
-		_mapping = helix::Mapping{_memory, 0, aligned_size};
-		_areaSize = aligned_size;
-	}
+	// Read and write file contents. Holes read as zeros.
+	async::result<void> _readData(uint64_t offset, void *buffer, size_t length);
+	async::result<void> _writeData(uint64_t offset, const void *buffer, size_t length);
+
+	// Returns the start of the next data region (or hole) at or after offset.
+	frg::expected<Error, off_t> _findData(off_t offset, bool hole);
 
+	// The file's contents are not mapped into the POSIX server; they are only accessed
+	// via helix_ng::readMemory() and helix_ng::writeMemory().
 	helix::UniqueDescriptor _memory;
-	helix::Mapping _mapping;
 	size_t _areaSize;
 	size_t _fileSize;
+	// Whether accessMemory() was called. Such files may be written through mappings.
+	bool _mapped = false;
+
+	// Serializes writes and changes of the file size (similar to the inode lock on Linux).
+	// Otherwise, a write can race with the zeroing of truncated data.
+	async::mutex _mutex;
+
+	// Extents of pages that contain data (in units of pages, maps start to end).
+	// Everything else (including everything beyond _areaSize) is a hole.
+	std::map<uint64_t, uint64_t> _dataExtents;
 };
 
 struct Superblock final : FsSuperblock {
@@ -539,9 +563,166 @@ private:
 // MemoryNode and MemoryFile implementation.
 // ----------------------------------------------------------------------------
 
+namespace {
+	constexpr size_t pageSize = 0x1000;
+	constexpr int pageShift = 12;
+
+	// Initial size of the memory object that backs a regular file.
+	constexpr size_t minimumArea = 0x10000;
+
+	// Used to clear discarded data.
+	constexpr size_t zeroChunkSize = 0x10000;
+	const char zeroChunk[zeroChunkSize] = {};
+}
+
 MemoryNode::MemoryNode(Superblock *superblock)
 : Node{superblock}, _areaSize{0}, _fileSize{0} { }
 
+void MemoryNode::_ensureArea(size_t size) {
+	size_t alignedSize = (size + pageSize - 1) & ~(pageSize - 1);
+	if(_memory && alignedSize <= _areaSize)
+		return;
+
+	// Grow geometrically such that appending through small writes
+	// only resizes the memory object O(log n) times.
+	auto newSize = std::max(alignedSize, std::max(2 * _areaSize, minimumArea));
+
+	if(_memory) {
+		HEL_CHECK(helResizeMemory(_memory.getHandle(), newSize));
+	}else{
+		HelHandle handle;
+		HEL_CHECK(helAllocateMemory(newSize, 0, nullptr, &handle));
+		_memory = helix::UniqueDescriptor{handle};
+	}
+	_areaSize = newSize;
+}
+
+void MemoryNode::_markData(uint64_t offset, size_t length) {
+	if(!length)
+		return;
+	uint64_t begin = offset >> pageShift;
+	uint64_t end = (offset + length + pageSize - 1) >> pageShift;
+
+	// Merge with the preceding extent and all extents that overlap or touch the new one.
+	auto it = _dataExtents.upper_bound(begin);
+	if(it != _dataExtents.begin()) {
+		auto prev = std::prev(it);
+		if(prev->second >= begin) {
+			begin = prev->first;
+			it = prev;
+		}
+	}
+	while(it != _dataExtents.end() && it->first <= end) {
+		end = std::max(end, it->second);
+		it = _dataExtents.erase(it);
+	}
+	_dataExtents.emplace(begin, end);
+}
+
+async::result<void> MemoryNode::_resizeFile(size_t newSize) {
+	auto oldSize = _fileSize;
+	if(newSize >= oldSize) {
+		// Writes through mappings are not tracked; the new range must be backed by memory.
+		if(_mapped) {
+			_ensureArea(newSize);
+			_markData(oldSize, newSize - oldSize);
+		}
+		_fileSize = newSize;
+		co_return;
+	}
+
+	// Data beyond the new end of the file must read as zeros if the file grows again.
+	// Determine the affected ranges first since the extents may change while we clear them.
+	std::vector<std::pair<uint64_t, uint64_t>> discarded;
+	auto keepPages = (newSize + pageSize - 1) >> pageShift;
+	auto it = _dataExtents.upper_bound(newSize >> pageShift);
+	if(it != _dataExtents.begin())
+		it = std::prev(it);
+	while(it != _dataExtents.end()) {
+		auto [begin, end] = *it;
+		if((end << pageShift) <= newSize) {
+			++it;
+			continue;
+		}
+
+		discarded.push_back({std::max(begin << pageShift, uint64_t{newSize}),
+				std::min(end << pageShift, uint64_t{_areaSize})});
+		if(begin < keepPages) {
+			it->second = keepPages;
+			++it;
+		}else{
+			it = _dataExtents.erase(it);
+		}
+	}
+
+	for(auto [begin, end] : discarded) {
+		for(auto offset = begin; offset < end; offset += zeroChunkSize) {
+			auto chunk = std::min(end - offset, uint64_t{zeroChunkSize});
+			auto writeMemory = co_await helix_ng::writeMemory(_memory, offset, chunk, zeroChunk);
+			HEL_CHECK(writeMemory.error());
+		}
+	}
+
+	// Only shrink the file once the data is cleared.
+	_fileSize = newSize;
+}
+
+async::result<void> MemoryNode::_readData(uint64_t offset, void *buffer, size_t length) {
+	auto p = reinterpret_cast<char *>(buffer);
+	auto end = offset + length;
+	while(offset < end) {
+		// Extents may change while we wait for readMemory(); look them up again every time.
+		auto page = offset >> pageShift;
+		auto it = _dataExtents.upper_bound(page);
+		if(it != _dataExtents.begin() && std::prev(it)->second > page) {
+			auto chunk = std::min(end, std::prev(it)->second << pageShift) - offset;
+			auto readMemory = co_await helix_ng::readMemory(_memory, offset, chunk, p);
+			HEL_CHECK(readMemory.error());
+			offset += chunk;
+			p += chunk;
+		}else{
+			// Holes are not backed by memory; do not touch (and thus allocate) them.
+			auto holeEnd = end;
+			if(it != _dataExtents.end())
+				holeEnd = std::min(end, it->first << pageShift);
+			memset(p, 0, holeEnd - offset);
+			p += holeEnd - offset;
+			offset = holeEnd;
+		}
+	}
+}
+
+async::result<void> MemoryNode::_writeData(uint64_t offset, const void *buffer, size_t length) {
+	_ensureArea(offset + length);
+	_markData(offset, length);
+	auto writeMemory = co_await helix_ng::writeMemory(_memory, offset, length, buffer);
+	HEL_CHECK(writeMemory.error());
+}
+
+frg::expected<Error, off_t> MemoryNode::_findData(off_t offset, bool hole) {
+	if(offset < 0)
+		return Error::illegalArguments;
+	if(static_cast<uint64_t>(offset) >= _fileSize)
+		return Error::noBackingDevice;
+
+	auto page = static_cast<uint64_t>(offset) >> pageShift;
+	auto it = _dataExtents.upper_bound(page);
+	if(it != _dataExtents.begin() && std::prev(it)->second > page) {
+		// The offset is inside of a data extent. Extents are merged,
+		// hence the next hole starts at the end of this extent.
+		if(!hole)
+			return offset;
+		return static_cast<off_t>(std::min(std::prev(it)->second << pageShift,
+				uint64_t{_fileSize}));
+	}
+
+	if(hole)
+		return offset;
+	if(it == _dataExtents.end() || (it->first << pageShift) >= _fileSize)
+		return Error::noBackingDevice;
+	return static_cast<off_t>(it->first << pageShift);
+}
+
 void MemoryFile::handleClose() {
 	_cancelServe.cancel();
 }
@@ -560,6 +741,28 @@ MemoryFile::seek(off_t delta, VfsSeek whence) {
 	co_return _offset;
 }
 
+async::result<frg::expected<Error, off_t>>
+MemoryFile::seekData(off_t offset) {
+	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+
+	auto result = node->_findData(offset, false);
+	if(!result)
+		co_return result.error();
+	_offset = result.value();
+	co_return _offset;
+}
+
+async::result<frg::expected<Error, off_t>>
+MemoryFile::seekHole(off_t offset) {
+	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+
+	auto result = node->_findData(offset, true);
+	if(!result)
+		co_return result.error();
+	_offset = result.value();
+	co_return _offset;
+}
+
 async::result<frg::expected<Error, size_t>>
 MemoryFile::readSome(Process *, void *buffer, size_t max_length) {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
@@ -568,7 +771,7 @@ MemoryFile::readSome(Process *, void *buffer, size_t max_length) {
 		co_return 0;
 	auto chunk = std::min(node->_fileSize - _offset, max_length);
 
-	memcpy(buffer, reinterpret_cast<char *>(node->_mapping.get()) + _offset, chunk);
+	co_await node->_readData(_offset, buffer, chunk);
 	_offset += chunk;
 
 	co_return chunk;
@@ -577,12 +780,16 @@ MemoryFile::readSome(Process *, void *buffer, size_t max_length) {
 async::result<frg::expected<Error, size_t>>
 MemoryFile::writeAll(Process *, const void *buffer, size_t length) {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+	co_await node->_mutex.async_lock();
+	std::unique_lock lock{node->_mutex, std::adopt_lock};
 
 	if(_offset + length > node->_fileSize)
-		node->_resizeFile(_offset + length);
+		co_await node->_resizeFile(_offset + length);
 
-	memcpy(reinterpret_cast<char *>(node->_mapping.get()) + _offset, buffer, length);
+	co_await node->_writeData(_offset, buffer, length);
 	_offset += length;
+	node->updateMtime();
+	invalidateExecCache(node);
 	co_return length;
 }
 
@@ -594,7 +801,7 @@ MemoryFile::pread(Process *, int64_t offset, void *buffer, size_t length) {
 		co_return 0;
 	auto chunk = std::min(node->_fileSize - offset, length);
 
-	memcpy(buffer, reinterpret_cast<char *>(node->_mapping.get()) + offset, chunk);
+	co_await node->_readData(offset, buffer, chunk);
 
 	co_return chunk;
 }
@@ -602,19 +809,27 @@ MemoryFile::pread(Process *, int64_t offset, void *buffer, size_t length) {
 async::result<frg::expected<Error, size_t>>
 MemoryFile::pwrite(Process *, int64_t offset, const void *buffer, size_t length) {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+	co_await node->_mutex.async_lock();
+	std::unique_lock lock{node->_mutex, std::adopt_lock};
 
 	if(offset + length > node->_fileSize)
-		node->_resizeFile(offset + length);
+		co_await node->_resizeFile(offset + length);
 
-	memcpy(reinterpret_cast<char *>(node->_mapping.get()) + offset, buffer, length);
+	co_await node->_writeData(offset, buffer, length);
+	node->updateMtime();
+	invalidateExecCache(node);
 	co_return length;
 }
 
 async::result<frg::expected<protocols::fs::Error>>
 MemoryFile::truncate(size_t size) {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+	co_await node->_mutex.async_lock();
+	std::unique_lock lock{node->_mutex, std::adopt_lock};
 
-	node->_resizeFile(size);
+	co_await node->_resizeFile(size);
+	node->updateMtime();
+	invalidateExecCache(node);
 	co_return {};
 }
 
@@ -623,17 +838,25 @@ MemoryFile::allocate(int64_t offset, size_t size) {
 	assert(!offset);
 
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+	co_await node->_mutex.async_lock();
+	std::unique_lock lock{node->_mutex, std::adopt_lock};
 
 	// TODO: Careful about overflow.
 	if(offset + size <= node->_fileSize)
 		co_return {};
-	node->_resizeFile(offset + size);
+	co_await node->_resizeFile(offset + size);
+	invalidateExecCache(node);
 	co_return {};
 }
 
 FutureMaybe<helix::UniqueDescriptor>
 MemoryFile::accessMemory() {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+
+	// Writes through mappings are not tracked; conservatively treat the whole file as data.
+	node->_mapped = true;
+	node->_ensureArea(node->_fileSize);
+	node->_markData(0, node->_fileSize);
 	co_return node->_memory.dup();
 }
 
@@ -736,6 +959,7 @@ DirectoryNode::mkdir(std::string name) {
 	auto link = std::make_shared<Link>(shared_from_this(), std::move(name), std::move(node));
 	the_node->_treeLink = link;
 	_entries.insert(link);
+	notifyObservers(FsObserver::createEvent, link->getName(), 0);
 	co_return link;
 }
 
@@ -747,6 +971,7 @@ DirectoryNode::symlink(std::string name, std::string path) {
 			std::move(path));
 	auto link = std::make_shared<Link>(shared_from_this(), std::move(name), std::move(node));
 	_entries.insert(link);
+	notifyObservers(FsObserver::createEvent, link->getName(), 0);
 	co_return link;
 }
 
@@ -758,6 +983,7 @@ DirectoryNode::mkdev(std::string name, VfsType type, DeviceId id) {
 			type, id);
 	auto link = std::make_shared<Link>(shared_from_this(), std::move(name), std::move(node));
 	_entries.insert(link);
+	notifyObservers(FsObserver::createEvent, link->getName(), 0);
 	co_return link;
 }
 
@@ -768,6 +994,7 @@ DirectoryNode::mkfifo(std::string name, mode_t mode) {
 	auto node = std::make_shared<FifoNode>(static_cast<Superblock *>(superblock()), mode);
 	auto link = std::make_shared<Link>(shared_from_this(), std::move(name), std::move(node));
 	_entries.insert(link);
+	notifyObservers(FsObserver::createEvent, link->getName(), 0);
 	co_return link;
 }
 
@@ -777,6 +1004,7 @@ async::result<frg::expected<Error, std::shared_ptr<FsLink>>> DirectoryNode::mkso
 	auto node = std::make_shared<SocketNode>(static_cast<Superblock *>(superblock()));
 	auto link = std::make_shared<Link>(shared_from_this(), std::move(name), std::move(node));
 	_entries.insert(link);
+	notifyObservers(FsObserver::createEvent, link->getName(), 0);
 	co_return link;
 }
 
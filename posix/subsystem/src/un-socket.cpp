@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <sys/epoll.h>
@@ -28,6 +29,14 @@ std::map<std::weak_ptr<FsNode>, OpenFile *,
 		std::owner_less<std::weak_ptr<FsNode>>> globalBindMap;
 std::unordered_map<std::string, OpenFile *> abstractSocketsBindMap;
 
+// Default values of SO_SNDBUF and SO_RCVBUF (same as on Linux).
+constexpr size_t defaultBufferSize = 212992;
+constexpr size_t minBufferSize = 2304;
+constexpr size_t maxBufferSize = 4 * 1024 * 1024;
+
+// Initial allocation of a ByteRing; the ring grows up to the socket buffer size on demand.
+constexpr size_t initialRingSize = 16 * 1024;
+
 struct Packet {
 	// Sender process information.
 	int senderPid;
@@ -40,6 +49,92 @@ struct Packet {
 	size_t offset = 0;
 };
 
+// Attaches received files to the process and reports their FDs in an SCM_RIGHTS message.
+// Files that cannot be attached (due to RLIMIT_NOFILE) are dropped;
+// as on Linux, this is reported by returning MSG_CTRUNC.
+uint32_t attachReceivedFiles(Process *process, protocols::fs::CtrlBuilder &ctrl,
+		std::vector<smarter::shared_ptr<File, FileHandle>> files, bool closeOnExec) {
+	uint32_t replyFlags = 0;
+	std::vector<int> fds;
+	for(auto &file : files) {
+		auto fd = process->fileContext()->attachFile(std::move(file), closeOnExec);
+		if(!fd) {
+			replyFlags |= MSG_CTRUNC;
+			continue;
+		}
+		fds.push_back(fd.value());
+	}
+	if(fds.empty())
+		return replyFlags;
+
+	if(!ctrl.message(SOL_SOCKET, SCM_RIGHTS, sizeof(int) * fds.size()))
+		throw std::runtime_error("posix: CMSG truncation is not implemented");
+	for(auto fd : fds)
+		ctrl.write<int>(fd);
+	return replyFlags;
+}
+
+// Circular byte buffer that stores the data of SOCK_STREAM sockets.
+// Writes append to the buffer and do not allocate (unless the ring needs to grow).
+struct ByteRing {
+	size_t size() {
+		return _size;
+	}
+
+	void write(const void *data, size_t length) {
+		if(_size + length > _buffer.size())
+			_grow(_size + length);
+
+		auto bytes = reinterpret_cast<const char *>(data);
+		auto tail = (_head + _size) % _buffer.size();
+		auto first = std::min(length, _buffer.size() - tail);
+		memcpy(_buffer.data() + tail, bytes, first);
+		memcpy(_buffer.data(), bytes + first, length - first);
+		_size += length;
+	}
+
+	void read(void *data, size_t length) {
+		assert(length <= _size);
+		auto bytes = reinterpret_cast<char *>(data);
+		auto first = std::min(length, _buffer.size() - _head);
+		memcpy(bytes, _buffer.data() + _head, first);
+		memcpy(bytes + first, _buffer.data(), length - first);
+		_head = (_head + length) % _buffer.size();
+		_size -= length;
+		if(!_size)
+			_head = 0;
+	}
+
+private:
+	void _grow(size_t minSize) {
+		auto newSize = std::max(_buffer.size(), initialRingSize);
+		while(newSize < minSize)
+			newSize *= 2;
+
+		std::vector<char> buffer(newSize);
+		auto first = std::min(_size, _buffer.size() - _head);
+		memcpy(buffer.data(), _buffer.data() + _head, first);
+		memcpy(buffer.data() + first, _buffer.data(), _size - first);
+		_buffer = std::move(buffer);
+		_head = 0;
+	}
+
+	std::vector<char> _buffer;
+	size_t _head = 0;
+	size_t _size = 0;
+};
+
+// Consecutive bytes in a ByteRing that were sent by the same process.
+// Small writes of the same sender are coalesced into a single segment.
+struct StreamSegment {
+	size_t length = 0;
+
+	int senderPid = 0;
+
+	// Files passed via SCM_RIGHTS; they are delivered with the first byte of the segment.
+	std::vector<smarter::shared_ptr<File, FileHandle>> files;
+};
+
 struct OpenFile : File {
 	enum class State {
 		null,
@@ -76,9 +171,10 @@ public:
 				smarter::shared_ptr<File>{file}, &File::fileOperations, file->_cancelServe));
 	}
 
-	OpenFile(Process *process = nullptr, bool nonBlock = false)
-	: File{StructName::get("un-socket"), File::defaultPipeLikeSeek}, _currentState{State::null},
-			_currentSeq{1}, _inSeq{0}, _ownerPid{0},
+	OpenFile(Process *process = nullptr, bool nonBlock = false, int socktype = SOCK_STREAM)
+	: File{StructName::get("un-socket"), File::defaultPipeLikeSeek | File::defaultSupportsPollObservers},
+			_socktype{socktype},
+			_currentState{State::null}, _currentSeq{1}, _inSeq{0}, _ownerPid{0},
 			_remote{nullptr}, _passCreds{false}, nonBlock_{nonBlock},
 			_sockpath{}, _nameType{NameType::unnamed}, _isInherited{false} {
 		if(process)
@@ -96,6 +192,7 @@ public:
 			rf->_currentState = State::remoteShutDown;
 			rf->_hupSeq = ++rf->_currentSeq;
 			rf->_statusBell.raise();
+			rf->notifyPollObservers(EPOLLHUP);
 			rf->_remote = nullptr;
 			_remote = nullptr;
 		}
@@ -107,10 +204,21 @@ public:
 public:
 	async::result<frg::expected<Error, size_t>>
 	readSome(Process *, void *data, size_t max_length) override {
-		assert(_currentState == State::connected);
 		if(logSockets)
 			std::cout << "posix: Read from socket \e[1;34m" << structName() << "\e[0m" << std::endl;
 
+		if(_socktype == SOCK_STREAM) {
+			if(_currentState != State::connected && _currentState != State::remoteShutDown)
+				co_return Error::notConnected;
+			if(!co_await _waitForStreamData(nonBlock_))
+				co_return Error::wouldBlock;
+
+			// Like on Linux, read() discards files that were passed via SCM_RIGHTS.
+			StreamSegment segment;
+			co_return _consumeStream(data, max_length, segment);
+		}
+
+		assert(_currentState == State::connected);
 		if(_recvQueue.empty() && nonBlock_) {
 			if(logSockets)
 				std::cout << "posix: UNIX socket would block" << std::endl;
@@ -139,6 +247,18 @@ public:
 		if(logSockets)
 			std::cout << "posix: Write to socket \e[1;34m" << structName() << "\e[0m" << std::endl;
 
+		if(_socktype == SOCK_STREAM) {
+			auto result = co_await _sendStream(process, data, length, {}, nonBlock_);
+			if(!result) {
+				switch(result.error()) {
+				case protocols::fs::Error::wouldBlock: co_return Error::wouldBlock;
+				case protocols::fs::Error::brokenPipe: co_return Error::brokenPipe;
+				default: co_return Error::notConnected;
+				}
+			}
+			co_return result.value();
+		}
+
 		Packet packet;
 		packet.senderPid = process->pid();
 		packet.buffer.resize(length);
@@ -148,6 +268,7 @@ public:
 		_remote->_recvQueue.push_back(std::move(packet));
 		_remote->_inSeq = ++_remote->_currentSeq;
 		_remote->_statusBell.raise();
+		_remote->notifyPollObservers(EPOLLIN);
 		co_return length;
 	}
 
@@ -156,6 +277,38 @@ public:
 			void *, size_t, size_t max_ctrl_length) override {
 		assert(!(flags & ~(MSG_DONTWAIT | MSG_CMSG_CLOEXEC)));
 
+		if(_socktype == SOCK_STREAM) {
+			if(_currentState != State::connected && _currentState != State::remoteShutDown)
+				co_return protocols::fs::Error::notConnected;
+			if(logSockets)
+				std::cout << "posix: Recv from socket \e[1;34m" << structName() << "\e[0m" << std::endl;
+
+			if(!co_await _waitForStreamData((flags & MSG_DONTWAIT) || nonBlock_))
+				co_return protocols::fs::RecvResult { protocols::fs::Error::wouldBlock };
+
+			StreamSegment segment;
+			auto chunk = _consumeStream(data, max_length, segment);
+			if(!chunk)
+				co_return protocols::fs::RecvData{{}, 0, 0, 0};
+
+			protocols::fs::CtrlBuilder ctrl{max_ctrl_length};
+			if(_passCreds) {
+				struct ucred creds;
+				memset(&creds, 0, sizeof(struct ucred));
+				creds.pid = segment.senderPid;
+
+				if(!ctrl.message(SOL_SOCKET, SCM_CREDENTIALS, sizeof(struct ucred)))
+					throw std::runtime_error("posix: Implement CMSG truncation");
+				ctrl.write<struct ucred>(creds);
+			}
+
+			uint32_t replyFlags = 0;
+			if(!segment.files.empty())
+				replyFlags = attachReceivedFiles(process, ctrl, std::move(segment.files),
+						flags & MSG_CMSG_CLOEXEC);
+			co_return protocols::fs::RecvData{ctrl.buffer(), chunk, 0, replyFlags};
+		}
+
 		if(_currentState == State::remoteShutDown)
 			co_return protocols::fs::RecvData{{}, 0, 0, 0};
 
@@ -187,15 +340,10 @@ public:
 			ctrl.write<struct ucred>(creds);
 		}
 
+		uint32_t replyFlags = 0;
 		if(!packet->files.empty()) {
-			if(ctrl.message(SOL_SOCKET, SCM_RIGHTS, sizeof(int) * packet->files.size())) {
-				for(auto &file : packet->files)
-					ctrl.write<int>(process->fileContext()->attachFile(std::move(file),
-							flags & MSG_CMSG_CLOEXEC));
-			}else{
-				throw std::runtime_error("posix: CMSG truncation is not implemented");
-			}
-
+			replyFlags = attachReceivedFiles(process, ctrl, std::move(packet->files),
+					flags & MSG_CMSG_CLOEXEC);
 			packet->files.clear();
 		}
 
@@ -206,7 +354,7 @@ public:
 
 		if(packet->offset == packet->buffer.size())
 			_recvQueue.pop_front();
-		co_return protocols::fs::RecvData{ctrl.buffer(), chunk, 0, 0};
+		co_return protocols::fs::RecvData{ctrl.buffer(), chunk, 0, replyFlags};
 	}
 
 	async::result<frg::expected<protocols::fs::Error, size_t>>
@@ -223,6 +371,10 @@ public:
 		if(logSockets)
 			std::cout << "posix: Send to socket \e[1;34m" << structName() << "\e[0m" << std::endl;
 
+		if(_socktype == SOCK_STREAM)
+			co_return co_await _sendStream(process, data, max_length, std::move(files),
+					(flags & MSG_DONTWAIT) || nonBlock_);
+
 		// We ignore MSG_DONTWAIT here as we never block anyway.
 
 		Packet packet;
@@ -235,11 +387,17 @@ public:
 		_remote->_recvQueue.push_back(std::move(packet));
 		_remote->_inSeq = ++_remote->_currentSeq;
 		_remote->_statusBell.raise();
+		_remote->notifyPollObservers(EPOLLIN);
 
 		co_return max_length;
 	}
 
 	async::result<int> getOption(int option) override {
+		if(option == SO_SNDBUF)
+			co_return _sndBuf;
+		if(option == SO_RCVBUF)
+			co_return _rcvBuf;
+
 		assert(option == SO_PEERCRED);
 		if (_currentState != State::connected)
 			co_return -1;
@@ -247,6 +405,26 @@ public:
 	}
 
 	async::result<void> setOption(int option, int value) override {
+		if(option == SO_SNDBUF || option == SO_RCVBUF) {
+			// Like Linux, double the value to account for bookkeeping overhead.
+			auto size = std::clamp(static_cast<size_t>(std::max(value, 0)) * 2,
+					minBufferSize, maxBufferSize);
+			if(option == SO_SNDBUF) {
+				_sndBuf = size;
+				_outSeq = ++_currentSeq;
+				_statusBell.raise();
+				notifyPollObservers(EPOLLOUT);
+			}else{
+				_rcvBuf = size;
+				if(_currentState == State::connected) {
+					_remote->_outSeq = ++_remote->_currentSeq;
+					_remote->_statusBell.raise();
+					_remote->notifyPollObservers(EPOLLOUT);
+				}
+			}
+			co_return;
+		}
+
 		assert(option == SO_PASSCRED);
 		_passCreds = value;
 		co_return;
@@ -266,7 +444,7 @@ public:
 		_acceptQueue.pop_front();
 
 		// Create a new socket and connect it to the queued one.
-		auto local = smarter::make_shared<OpenFile>(process);
+		auto local = smarter::make_shared<OpenFile>(process, false, _socktype);
 		local->_sockpath = _sockpath;
 		local->_nameType = _nameType;
 		local->_isInherited = true;
@@ -290,8 +468,10 @@ public:
 		if(_currentState == State::closed)
 			co_return Error::fileClosed;
 
-		// For now making sockets always writable is sufficient.
-		int edges = EPOLLOUT;
+		// Datagram sockets never block on send, hence they are always writable.
+		int edges = 0;
+		if(_socktype != SOCK_STREAM || _outSeq > past_seq)
+			edges |= EPOLLOUT;
 		if(_hupSeq > past_seq)
 			edges |= EPOLLHUP;
 		if(_inSeq > past_seq)
@@ -306,10 +486,12 @@ public:
 
 	async::result<frg::expected<Error, PollStatusResult>>
 	pollStatus(Process *) override {
-		int events = EPOLLOUT;
+		int events = 0;
+		if(_socktype != SOCK_STREAM || _currentState != State::connected || _streamSpace())
+			events |= EPOLLOUT;
 		if(_currentState == State::remoteShutDown)
 			events |= EPOLLHUP;
-		if(!_acceptQueue.empty() || !_recvQueue.empty())
+		if(!_acceptQueue.empty() || !_recvQueue.empty() || _recvRing.size())
 			events |= EPOLLIN;
 
 		co_return PollStatusResult{_currentSeq, events};
@@ -401,6 +583,7 @@ public:
 			server->_acceptQueue.push_back(this);
 			server->_inSeq = ++server->_currentSeq;
 			server->_statusBell.raise();
+			server->notifyPollObservers(EPOLLIN);
 
 			while(_currentState == State::null)
 				co_await _statusBell.async_wait();
@@ -427,6 +610,7 @@ public:
 			server->_acceptQueue.push_back(this);
 			server->_inSeq = ++server->_currentSeq;
 			server->_statusBell.raise();
+			server->notifyPollObservers(EPOLLIN);
 
 			while(_currentState == State::null)
 				co_await _statusBell.async_wait();
@@ -471,6 +655,8 @@ public:
 
 					if(_currentState != State::connected) {
 						resp.set_error(managarm::fs::Errors::NOT_CONNECTED);
+					} else if(_socktype == SOCK_STREAM) {
+						resp.set_fionread_count(_recvRing.size());
 					} else if(_recvQueue.empty()) {
 						resp.set_fionread_count(0);
 					} else {
@@ -497,6 +683,107 @@ public:
 	}
 
 private:
+	// Number of bytes that can be sent to the remote SOCK_STREAM socket without blocking.
+	// The amount of data in flight is bounded by both our SO_SNDBUF and the remote SO_RCVBUF.
+	size_t _streamSpace() {
+		assert(_currentState == State::connected);
+		auto limit = std::min(_sndBuf, _remote->_rcvBuf);
+		auto queued = _remote->_recvRing.size();
+		if(queued >= limit)
+			return 0;
+		return limit - queued;
+	}
+
+	async::result<frg::expected<protocols::fs::Error, size_t>>
+	_sendStream(Process *process, const void *data, size_t length,
+			std::vector<smarter::shared_ptr<File, FileHandle>> files, bool nonBlock) {
+		size_t progress = 0;
+		while(true) {
+			if(_currentState == State::remoteShutDown) {
+				if(progress)
+					co_return progress;
+				co_return protocols::fs::Error::brokenPipe;
+			}
+			if(_currentState != State::connected)
+				co_return protocols::fs::Error::notConnected;
+
+			auto chunk = std::min(length - progress, _streamSpace());
+			if(chunk) {
+				_remote->_appendStream(process->pid(),
+						reinterpret_cast<const char *>(data) + progress, chunk, std::move(files));
+				files.clear();
+				progress += chunk;
+			}
+			if(progress == length)
+				co_return progress;
+
+			if(nonBlock) {
+				if(progress)
+					co_return progress;
+				co_return protocols::fs::Error::wouldBlock;
+			}
+			co_await _statusBell.async_wait();
+		}
+	}
+
+	void _appendStream(int senderPid, const void *data, size_t length,
+			std::vector<smarter::shared_ptr<File, FileHandle>> files) {
+		_recvRing.write(data, length);
+
+		if(files.empty() && !_segments.empty() && _segments.back().senderPid == senderPid) {
+			_segments.back().length += length;
+		}else{
+			_segments.push_back(StreamSegment{length, senderPid, std::move(files)});
+		}
+
+		_inSeq = ++_currentSeq;
+		_statusBell.raise();
+		notifyPollObservers(EPOLLIN);
+	}
+
+	// Waits until data is available or the remote shuts down. Returns false if we would block.
+	async::result<bool> _waitForStreamData(bool nonBlock) {
+		while(!_recvRing.size() && _currentState == State::connected) {
+			if(nonBlock)
+				co_return false;
+			co_await _statusBell.async_wait();
+		}
+		co_return true;
+	}
+
+	// Reads up to maxLength bytes of stream data. Reads do not cross segments
+	// that carry files or that are sent by a different process.
+	// Returns information about the first segment in segment.
+	size_t _consumeStream(void *data, size_t maxLength, StreamSegment &segment) {
+		size_t progress = 0;
+		while(progress < maxLength && !_segments.empty()) {
+			auto &front = _segments.front();
+			if(progress && (!front.files.empty() || front.senderPid != segment.senderPid))
+				break;
+			if(!progress) {
+				segment.senderPid = front.senderPid;
+				segment.files = std::move(front.files);
+				front.files.clear();
+			}
+
+			auto chunk = std::min(maxLength - progress, front.length);
+			_recvRing.read(reinterpret_cast<char *>(data) + progress, chunk);
+			progress += chunk;
+			front.length -= chunk;
+			if(!front.length)
+				_segments.pop_front();
+			if(!segment.files.empty())
+				break;
+		}
+
+		if(progress && _remote) {
+			_remote->_outSeq = ++_remote->_currentSeq;
+			_remote->_statusBell.raise();
+			_remote->notifyPollObservers(EPOLLOUT);
+		}
+		return progress;
+	}
+
 	static size_t getNameFor(OpenFile *sock, void *addrPtr, size_t maxAddrLength) {
 		sockaddr_un sa;
 		size_t outSize = offsetof(sockaddr_un, sun_path) + sock->_sockpath.size() + 1;
@@ -542,6 +829,9 @@ private:
 	helix::UniqueLane _passthrough;
 	async::cancellation_event _cancelServe;
 
+	// One of SOCK_STREAM, SOCK_SEQPACKET or SOCK_DGRAM.
+	int _socktype;
+
 	State _currentState;
 
 	// Status management for poll().
@@ -549,13 +839,21 @@ private:
 	uint64_t _currentSeq;
 	uint64_t _hupSeq = 0;
 	uint64_t _inSeq;
+	uint64_t _outSeq = 1;
 
 	// TODO: Use weak_ptrs here!
 	std::deque<OpenFile *> _acceptQueue;
 
-	// The actual receive queue of the socket.
+	// The actual receive queue of the socket (for SOCK_SEQPACKET and SOCK_DGRAM).
 	std::deque<Packet> _recvQueue;
 
+	// Received data of SOCK_STREAM sockets.
+	ByteRing _recvRing;
+	std::deque<StreamSegment> _segments;
+
+	size_t _sndBuf = defaultBufferSize;
+	size_t _rcvBuf = defaultBufferSize;
+
 	int _ownerPid;
 
 	// For connected sockets, this is the socket we are connected to.
@@ -572,16 +870,17 @@ private:
 	bool _isInherited;
 };
 
-smarter::shared_ptr<File, FileHandle> createSocketFile(bool nonBlock) {
-	auto file = smarter::make_shared<OpenFile>(nullptr, nonBlock);
+smarter::shared_ptr<File, FileHandle> createSocketFile(bool nonBlock, int socktype) {
+	auto file = smarter::make_shared<OpenFile>(nullptr, nonBlock, socktype);
 	file->setupWeakFile(file);
 	OpenFile::serve(file);
 	return File::constructHandle(std::move(file));
 }
 
-std::array<smarter::shared_ptr<File, FileHandle>, 2> createSocketPair(Process *process) {
-	auto file0 = smarter::make_shared<OpenFile>(process);
-	auto file1 = smarter::make_shared<OpenFile>(process);
+std::array<smarter::shared_ptr<File, FileHandle>, 2>
+createSocketPair(Process *process, int socktype) {
+	auto file0 = smarter::make_shared<OpenFile>(process, false, socktype);
+	auto file1 = smarter::make_shared<OpenFile>(process, false, socktype);
 	file0->setupWeakFile(file0);
 	file1->setupWeakFile(file1);
 	OpenFile::serve(file0);
@@ -3,8 +3,9 @@
 
 namespace un_socket {
 
-smarter::shared_ptr<File, FileHandle> createSocketFile(bool nonBlock);
-std::array<smarter::shared_ptr<File, FileHandle>, 2> createSocketPair(Process *process);
+smarter::shared_ptr<File, FileHandle> createSocketFile(bool nonBlock, int socktype);
+std::array<smarter::shared_ptr<File, FileHandle>, 2>
+createSocketPair(Process *process, int socktype);
 
 } // namespace un_socket
 
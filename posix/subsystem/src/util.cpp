@@ -23,6 +23,8 @@ std::ostream& operator<<(std::ostream& os, const Error& err) {
 		case Error::noBackingDevice: err_string = "noBackingDevice"; break;
 		case Error::noSpaceLeft: err_string = "noSpaceLeft"; break;
 		case Error::isDirectory: err_string = "isDirectory"; break;
+		case Error::tooManyFiles: err_string = "tooManyFiles"; break;
+		case Error::resourceInUse: err_string = "resourceInUse"; break;
 	}
 
 	return os << err_string;
@@ -42,6 +42,15 @@ struct FileStats {
 
 using SeekResult = std::variant<Error, int64_t>;
 
+// Range of a memory object (e.g., the page cache of a file) that holds the result of a read.
+struct CachedRange {
+	helix::BorrowedDescriptor memory;
+	uintptr_t offset;
+	size_t length;
+};
+
+using ReadCachedResult = std::variant<Error, CachedRange>;
+
 using GetLinkResult = std::tuple<std::shared_ptr<void>, int64_t, FileType>;
 
 using OpenResult = std::pair<helix::UniqueLane, helix::UniqueLane>;
@@ -67,11 +76,31 @@ struct FileOperations {
 		seekEof = f;
 		return *this;
 	}
+	constexpr FileOperations &withSeekData(async::result<SeekResult> (*f)(void *object,
+			int64_t offset)) {
+		seekData = f;
+		return *this;
+	}
+	constexpr FileOperations &withSeekHole(async::result<SeekResult> (*f)(void *object,
+			int64_t offset)) {
+		seekHole = f;
+		return *this;
+	}
 	constexpr FileOperations &withRead(async::result<ReadResult> (*f)(void *object,
 			const char *, void *buffer, size_t length)) {
 		read = f;
 		return *this;
 	}
+	constexpr FileOperations &withReadCached(async::result<ReadCachedResult> (*f)(void *object,
+			const char *, size_t length)) {
+		readCached = f;
+		return *this;
+	}
+	constexpr FileOperations &withPreadCached(async::result<ReadCachedResult> (*f)(void *object,
+			int64_t offset, const char *, size_t length)) {
+		preadCached = f;
+		return *this;
+	}
 	constexpr FileOperations &withWrite(async::result<frg::expected<protocols::fs::Error, size_t>> (*f)(void *object,
 			const char *, const void *buffer, size_t length)) {
 		write = f;
@@ -149,10 +178,19 @@ struct FileOperations {
 	async::result<SeekResult> (*seekAbs)(void *object, int64_t offset);
 	async::result<SeekResult> (*seekRel)(void *object, int64_t offset);
 	async::result<SeekResult> (*seekEof)(void *object, int64_t offset);
+	async::result<SeekResult> (*seekData)(void *object, int64_t offset);
+	async::result<SeekResult> (*seekHole)(void *object, int64_t offset);
 	async::result<ReadResult> (*read)(void *object, const char *credentials,
 			void *buffer, size_t length);
 	async::result<ReadResult> (*pread)(void *object, int64_t offset, const char *credentials,
 			void *buffer, size_t length);
+	// If present, these are preferred over read() and pread().
+	// Instead of copying into a buffer, they return the location of the data,
+	// which is then sent to the client without an intermediate copy.
+	async::result<ReadCachedResult> (*readCached)(void *object, const char *credentials,
+			size_t length);
+	async::result<ReadCachedResult> (*preadCached)(void *object, int64_t offset,
+			const char *credentials, size_t length);
 	async::result<frg::expected<protocols::fs::Error, size_t>> (*write)(void *object, const char *credentials,
 			const void *buffer, size_t length);
 	async::result<frg::expected<protocols::fs::Error, size_t>> (*pwrite)(void *object, int64_t offset, const char *credentials,
@@ -17,6 +17,36 @@ namespace fs {
 
 namespace {
 
+// Replies to READ and PT_PREAD requests whose data resides in a memory object.
+// The kernel copies the data directly from the memory object to the client.
+async::result<void> sendCachedRead(helix::UniqueLane &conversation, ReadCachedResult res) {
+	managarm::fs::SvrResponse resp;
+	auto error = std::get_if<Error>(&res);
+	if(error) {
+		resp.set_error(mapFsError(*error));
+
+		auto ser = resp.SerializeAsString();
+		auto [send_resp] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::sendBuffer(ser.data(), ser.size())
+		);
+		HEL_CHECK(send_resp.error());
+		co_return;
+	}
+
+	auto range = std::get<CachedRange>(res);
+	resp.set_error(managarm::fs::Errors::SUCCESS);
+
+	auto ser = resp.SerializeAsString();
+	auto [send_resp, send_data] = co_await helix_ng::exchangeMsgs(
+		conversation,
+		helix_ng::sendBuffer(ser.data(), ser.size()),
+		helix_ng::sendMemory(range.memory, range.offset, range.length)
+	);
+	HEL_CHECK(send_resp.error());
+	HEL_CHECK(send_data.error());
+}
+
 async::detached handlePassthrough(smarter::shared_ptr<void> file,
 		const FileOperations *file_ops,
 		managarm::fs::CntRequest req, helix::UniqueLane conversation) {
@@ -99,6 +129,30 @@ async::detached handlePassthrough(smarter::shared_ptr<void> file,
 		resp.set_error(managarm::fs::Errors::SUCCESS);
 		resp.set_offset(std::get<int64_t>(result));
 
+		auto ser = resp.SerializeAsString();
+		auto [send_resp] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::sendBuffer(ser.data(), ser.size())
+		);
+		HEL_CHECK(send_resp.error());
+	}else if(req.req_type() == managarm::fs::CntReqType::SEEK_DATA
+			|| req.req_type() == managarm::fs::CntReqType::SEEK_HOLE) {
+		auto seekOp = (req.req_type() == managarm::fs::CntReqType::SEEK_DATA)
+				? file_ops->seekData : file_ops->seekHole;
+
+		managarm::fs::SvrResponse resp;
+		if(!seekOp) {
+			resp.set_error(managarm::fs::Errors::ILLEGAL_OPERATION_TARGET);
+		}else{
+			auto result = co_await seekOp(file.get(), req.rel_offset());
+			if(auto error = std::get_if<Error>(&result); error) {
+				resp.set_error(mapFsError(*error));
+			}else{
+				resp.set_error(managarm::fs::Errors::SUCCESS);
+				resp.set_offset(std::get<int64_t>(result));
+			}
+		}
+
 		auto ser = resp.SerializeAsString();
 		auto [send_resp] = co_await helix_ng::exchangeMsgs(
 			conversation,
@@ -112,6 +166,13 @@ async::detached handlePassthrough(smarter::shared_ptr<void> file,
 		);
 		HEL_CHECK(extract_creds.error());
 
+		if(file_ops->readCached) {
+			auto res = co_await file_ops->readCached(file.get(), extract_creds.credentials(),
+					req.size());
+			co_await sendCachedRead(conversation, std::move(res));
+			co_return;
+		}
+
 		if(!file_ops->read) {
 			managarm::fs::SvrResponse resp;
 			resp.set_error(managarm::fs::Errors::ILLEGAL_OPERATION_TARGET);
@@ -170,6 +231,13 @@ async::detached handlePassthrough(smarter::shared_ptr<void> file,
 		);
 		HEL_CHECK(extract_creds.error());
 
+		if(file_ops->preadCached) {
+			auto res = co_await file_ops->preadCached(file.get(), req.offset(),
+					extract_creds.credentials(), req.size());
+			co_await sendCachedRead(conversation, std::move(res));
+			co_return;
+		}
+
 		if(!file_ops->pread) {
 			managarm::fs::SvrResponse resp;
 			resp.set_error(managarm::fs::Errors::ILLEGAL_OPERATION_TARGET);
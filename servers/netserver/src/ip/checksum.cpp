@@ -1,12 +1,79 @@
 #include "checksum.hpp"
 
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
 #include <arch/bit.hpp>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+uint16_t fold(uint64_t sum) {
+	while (sum >> 16)
+		sum = (sum >> 16) + (sum & 0xffff);
+	return sum;
+}
+
+// Sums up data as 32-bit words in native byte order. Since 2^16 = 1 modulo 0xffff,
+// folding the result yields the one's complement sum of the 16-bit words. That sum
+// is independent of the byte order, up to a final byte swap (RFC 1071).
+// Requires size < 4 GiB such that the 64-bit accumulators cannot overflow.
+uint64_t sumNative(const unsigned char *data, size_t size) {
+	uint64_t sum = 0;
+
+#if defined(__SSE2__)
+	// Zero-extend each 32-bit word to 64 bits and accumulate in two registers.
+	auto zero = _mm_setzero_si128();
+	auto accA = zero;
+	auto accB = zero;
+	for (; size >= 32; data += 32, size -= 32) {
+		auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+		auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+		accA = _mm_add_epi64(accA, _mm_unpacklo_epi32(lo, zero));
+		accB = _mm_add_epi64(accB, _mm_unpackhi_epi32(lo, zero));
+		accA = _mm_add_epi64(accA, _mm_unpacklo_epi32(hi, zero));
+		accB = _mm_add_epi64(accB, _mm_unpackhi_epi32(hi, zero));
+	}
+	uint64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(accA, accB));
+	sum += lanes[0] + lanes[1];
+#elif defined(__ARM_NEON)
+	// Pairwise add adjacent 32-bit words into 64-bit lanes.
+	auto accA = vdupq_n_u64(0);
+	auto accB = vdupq_n_u64(0);
+	for (; size >= 32; data += 32, size -= 32) {
+		accA = vpadalq_u32(accA, vreinterpretq_u32_u8(vld1q_u8(data)));
+		accB = vpadalq_u32(accB, vreinterpretq_u32_u8(vld1q_u8(data + 16)));
+	}
+	auto acc = vaddq_u64(accA, accB);
+	sum += vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+	for (; size >= 8; data += 8, size -= 8) {
+		uint64_t word;
+		std::memcpy(&word, data, 8);
+		sum += (word & 0xffffffff) + (word >> 32);
+	}
+	for (; size >= 2; data += 2, size -= 2) {
+		uint16_t word;
+		std::memcpy(&word, data, 2);
+		sum += word;
+	}
+	return sum;
+}
+
+} // anonymous namespace
+
 void Checksum::update(uint16_t word)  {
 	state_ += word;
-	while (state_ >> 16 != 0) {
-		state_ = (state_ >> 16) + (state_ & 0xffff);
-	}
 }
 
 void Checksum::update(const void *data, size_t size) {
@@ -16,10 +83,8 @@ void Checksum::update(const void *data, size_t size) {
 		size--;
 		update(iter[size] << 8);
 	}
-	auto end = iter + size;
-	for (; iter < end; iter += 2) {
-		update(iter[0] << 8 | iter[1]);
-	}
+	uint16_t native = fold(sumNative(iter, size));
+	state_ += convert_endian<endian::big>(native);
 }
 
 void Checksum::update(arch::dma_buffer_view view) {
@@ -27,6 +92,110 @@ void Checksum::update(arch::dma_buffer_view view) {
 }
 
 uint16_t Checksum::finalize() {
-	auto state_ = this->state_;
-	return ~state_;
+	return ~fold(state_);
+}
+
+// Implements eqn. 3 of RFC 1624: HC' = ~(~HC + ~m + m').
+uint16_t Checksum::adjust(uint16_t checksum, uint16_t oldWord, uint16_t newWord) {
+	uint64_t sum = static_cast<uint16_t>(~checksum);
+	sum += static_cast<uint16_t>(~oldWord);
+	sum += newWord;
+	return ~fold(sum);
+}
+
+uint16_t Checksum::adjust(uint16_t checksum, uint32_t oldValue, uint32_t newValue) {
+	checksum = adjust(checksum, static_cast<uint16_t>(oldValue >> 16),
+			static_cast<uint16_t>(newValue >> 16));
+	return adjust(checksum, static_cast<uint16_t>(oldValue),
+			static_cast<uint16_t>(newValue));
+}
+
+namespace {
+
+// The previous implementation, which folds after every word.
+uint16_t referenceChecksum(const unsigned char *data, size_t size) {
+	uint32_t state = 0;
+	auto add = [&] (uint16_t word) {
+		state += word;
+		while (state >> 16 != 0)
+			state = (state >> 16) + (state & 0xffff);
+	};
+	if (size % 2 != 0) {
+		size--;
+		add(data[size] << 8);
+	}
+	for (size_t i = 0; i < size; i += 2)
+		add(data[i] << 8 | data[i + 1]);
+	return ~state;
+}
+
+} // anonymous namespace
+
+void benchmarkChecksum() {
+	std::mt19937 rng{42};
+	std::vector<unsigned char> buffer(65536 + 64);
+	for (auto &byte : buffer)
+		byte = rng();
+
+	// Compare against the reference for all small sizes and misalignments.
+	size_t failures = 0;
+	for (size_t offset = 0; offset < 16; offset++) {
+		for (size_t size = 0; size <= 1600; size++) {
+			Checksum csum;
+			csum.update(buffer.data() + offset, size);
+			if (csum.finalize() != referenceChecksum(buffer.data() + offset, size))
+				failures++;
+		}
+	}
+
+	// Rewriting a word and adjusting the checksum must match a full recomputation.
+	for (size_t i = 0; i < 1000; i++) {
+		auto header = buffer.data() + (i % 64);
+		size_t position = 2 * (rng() % 10);
+		uint16_t oldWord = header[position] << 8 | header[position + 1];
+		uint16_t newWord = rng();
+
+		auto before = referenceChecksum(header, 20);
+		header[position] = newWord >> 8;
+		header[position + 1] = newWord & 0xff;
+		auto after = referenceChecksum(header, 20);
+		// +0 and -0 are equivalent in one's complement arithmetic.
+		auto adjusted = Checksum::adjust(before, oldWord, newWord);
+		if (adjusted != after && !((adjusted == 0 || adjusted == 0xffff)
+				&& (after == 0 || after == 0xffff)))
+			failures++;
+	}
+
+	std::cout << "netserver: Checksum self-test "
+			<< (failures ? "failed" : "passed") << " (" << failures << " failures)" << std::endl;
+
+	for (size_t size : {64, 576, 1500, 9000, 65536}) {
+		size_t iterations = (size_t{256} << 20) / size;
+
+		auto measure = [&] (auto fn) {
+			uint16_t sink = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < iterations; i++) {
+				// Keep the compiler from hoisting the computation out of the loop.
+				asm volatile ("" : : : "memory");
+				sink += fn();
+			}
+			auto elapsed = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+			asm volatile ("" : : "r"(sink));
+			return iterations * size / elapsed / (1 << 30);
+		};
+
+		auto wide = measure([&] {
+			Checksum csum;
+			csum.update(buffer.data(), size);
+			return csum.finalize();
+		});
+		auto reference = measure([&] {
+			return referenceChecksum(buffer.data(), size);
+		});
+
+		std::cout << "netserver: Checksum over " << size << " bytes: "
+				<< wide << " GiB/s (word-at-a-time: " << reference << " GiB/s)" << std::endl;
+	}
 }
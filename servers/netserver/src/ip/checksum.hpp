@@ -9,6 +9,16 @@ struct Checksum {
 	void update(arch::dma_buffer_view area);
 	uint16_t finalize();
 
+	// Returns the checksum of a header in which a 16-bit word changed
+	// from oldWord to newWord, without summing up the header again (RFC 1624).
+	static uint16_t adjust(uint16_t checksum, uint16_t oldWord, uint16_t newWord);
+	static uint16_t adjust(uint16_t checksum, uint32_t oldValue, uint32_t newValue);
+
 private:
-	uint32_t state_ = 0;
+	// Carries are only folded back in finalize().
+	uint64_t state_ = 0;
 };
+
+// Compares the checksum against a word-at-a-time reference implementation
+// and prints its throughput for a range of packet sizes.
+void benchmarkChecksum();
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Identifies a connection by its local and remote endpoint, in native byte order.
+// Connections of sockets that are bound to INADDR_ANY use a local address of zero.
+struct FlowKey {
+	uint32_t localAddress = 0;
+	uint32_t remoteAddress = 0;
+	uint16_t localPort = 0;
+	uint16_t remotePort = 0;
+
+	friend bool operator==(const FlowKey &, const FlowKey &) = default;
+};
+
+struct FlowKeyHash {
+	size_t operator()(const FlowKey &key) const {
+		uint64_t x = (uint64_t{key.localAddress} << 32) | key.remoteAddress;
+		x ^= ((uint64_t{key.localPort} << 16) | key.remotePort) * 0x9E3779B97F4A7C15;
+		// Finalizer of MurmurHash3; every input bit affects every output bit.
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCD;
+		x ^= x >> 33;
+		x *= 0xC4CEB9FE1A85EC53;
+		x ^= x >> 33;
+		return x;
+	}
+};
+
+// Looks up the connection that an incoming packet belongs to,
+// first by its exact destination address, then by the wildcard address.
+template<typename Map>
+auto findFlow(Map &connections, FlowKey key) {
+	auto it = connections.find(key);
+	if(it == connections.end() && key.localAddress) {
+		key.localAddress = 0;
+		it = connections.find(key);
+	}
+	return it;
+}
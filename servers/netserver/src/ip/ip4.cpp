@@ -6,11 +6,14 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <algorithm>
+#include <bit>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <protocols/fs/server.hpp>
 #include <queue>
+#include <random>
 
 using namespace protocols::fs;
 
@@ -26,26 +29,88 @@ Ip4 &ip4() {
 	return inst;
 }
 
+namespace {
+	// Lookups of more destinations than this start over with an empty cache.
+	constexpr size_t maxCachedRoutes = 4096;
+}
+
+Ip4Router::TrieNode &Ip4Router::findNode(CidrAddress network) {
+	size_t node = 0;
+	for(int i = 0; i < network.prefix; i++) {
+		auto bit = (network.ip >> (31 - i)) & 1;
+		if(trie[node].children[bit] < 0) {
+			trie[node].children[bit] = trie.size();
+			trie.emplace_back();
+		}
+		node = trie[node].children[bit];
+	}
+	return trie[node];
+}
+
+Ip4Router::RouteIterator Ip4Router::eraseRoute(RouteIterator it) {
+	auto &node = findNode(it->network);
+	if(node.routes == it) {
+		auto next = std::next(it);
+		if(next != routes.end() && next->network == it->network)
+			node.routes = next;
+		else
+			node.routes = std::nullopt;
+	}
+	cache.clear();
+	return routes.erase(it);
+}
+
 bool Ip4Router::addRoute(Route r) {
-	return routes.emplace(std::move(r)).second;
+	if(r.network.prefix > 32)
+		return false;
+
+	// Host bits are ignored such that each network has a unique key.
+	r.network.ip &= r.network.mask();
+
+	auto [it, inserted] = routes.emplace(std::move(r));
+	if(!inserted)
+		return false;
+
+	if(it == routes.begin() || std::prev(it)->network != it->network)
+		findNode(it->network).routes = it;
+	cache.clear();
+	return true;
 }
 
 std::optional<Route> Ip4Router::resolveRoute(uint32_t ip) {
-	for (auto i = routes.begin(); i != routes.end(); i++) {
-		const auto &r = *i;
-		if (r.network.sameNet(ip)) {
-			if (r.link.expired()) {
-				i = routes.erase(i);
-				continue;
-			}
-			return { r };
+	if(auto c = cache.find(ip); c != cache.end() && !c->second->link.expired())
+		return *c->second;
+
+	while(true) {
+		std::optional<RouteIterator> best = trie[0].routes;
+		size_t node = 0;
+		for(int i = 0; i < 32; i++) {
+			auto child = trie[node].children[(ip >> (31 - i)) & 1];
+			if(child < 0)
+				break;
+			node = child;
+			if(trie[node].routes)
+				best = trie[node].routes;
 		}
+		if(!best)
+			return {};
+
+		// Drop routes whose link disappeared and look up the destination again.
+		auto it = *best;
+		if(it->link.expired()) {
+			eraseRoute(it);
+			continue;
+		}
+
+		if(cache.size() >= maxCachedRoutes)
+			cache.clear();
+		cache.emplace(ip, it);
+		return *it;
 	}
-	return {};
 }
 
-bool operator<(const CidrAddress &lhs, const CidrAddress &) {
-	return std::tie(lhs.prefix, lhs.ip) < std::tie(lhs.prefix, lhs.ip);
+bool operator<(const CidrAddress &lhs, const CidrAddress &rhs) {
+	return std::tie(lhs.prefix, lhs.ip) < std::tie(rhs.prefix, rhs.ip);
 }
 
 auto operator<=>(const Route &lhs, const Route &rhs) {
@@ -429,3 +494,139 @@ managarm::fs::Errors Ip4::serveSocket(helix::UniqueLane lane, int type, int prot
 		return managarm::fs::Errors::ILLEGAL_ARGUMENT;
 	}
 }
+
+namespace {
+
+// Discards all frames; it only serves as the target of routes.
+struct LoopbackLink final : nic::Link {
+	LoopbackLink()
+	: nic::Link{65535, nullptr} {}
+
+	async::result<void> receive(arch::dma_buffer_view) override {
+		co_return;
+	}
+
+	async::result<void> send(const arch::dma_buffer_view) override {
+		co_return;
+	}
+};
+
+// Returns the average time per call of fn() in nanoseconds.
+template<typename F>
+double measureLookups(size_t iterations, F fn) {
+	uint64_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		asm volatile ("" : : : "memory");
+		sink += fn(i);
+	}
+	auto elapsed = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count();
+	asm volatile ("" : : "r"(sink));
+	return elapsed / iterations;
+}
+
+} // anonymous namespace
+
+void benchmarkLookups() {
+	std::mt19937 rng{42};
+	auto link = std::make_shared<LoopbackLink>();
+	size_t failures = 0;
+
+	for (size_t numRoutes : {16, 256, 4096, 65536}) {
+		Ip4Router router;
+		std::vector<CidrAddress> networks{{0, 0}};
+		router.addRoute({{0, 0}, link});
+		while (networks.size() < numRoutes) {
+			CidrAddress network{static_cast<uint32_t>(rng()), static_cast<uint8_t>(8 + rng() % 25)};
+			network.ip &= network.mask();
+			if (router.addRoute({network, link}))
+				networks.push_back(network);
+		}
+
+		// Half of the destinations are inside of a known network, the rest is random.
+		std::vector<uint32_t> destinations(65536);
+		for (size_t i = 0; i < destinations.size(); i++) {
+			auto ip = static_cast<uint32_t>(rng());
+			if (i % 2) {
+				auto &network = networks[rng() % networks.size()];
+				ip = network.ip | (ip & ~network.mask());
+			}
+			destinations[i] = ip;
+		}
+
+		auto linearLookup = [&] (uint32_t ip) -> unsigned int {
+			unsigned int best = 0;
+			for (auto &network : networks) {
+				if (network.sameNet(ip) && network.prefix >= best)
+					best = network.prefix;
+			}
+			return best;
+		};
+
+		for (size_t i = 0; i < 4096; i++) {
+			auto route = router.resolveRoute(destinations[i]);
+			if (!route || route->network.prefix != linearLookup(destinations[i]))
+				failures++;
+		}
+
+		// More distinct destinations than the cache can hold.
+		auto trie = measureLookups(1 << 20, [&] (size_t i) {
+			return router.resolveRoute(destinations[i % destinations.size()])->network.prefix;
+		});
+		auto cached = measureLookups(1 << 20, [&] (size_t i) {
+			return router.resolveRoute(destinations[i % 256])->network.prefix;
+		});
+		auto linear = measureLookups(std::max(size_t{1} << 24 >> std::bit_width(numRoutes), size_t{64}),
+				[&] (size_t i) {
+			return linearLookup(destinations[i % destinations.size()]);
+		});
+
+		std::cout << "netserver: Route lookup with " << numRoutes << " routes: "
+				<< trie << " ns (cached: " << cached << " ns, linear scan: "
+				<< linear << " ns)" << std::endl;
+	}
+
+	for (size_t numConnections : {16, 256, 4096, 65536}) {
+		// Roughly every fourth socket is bound to INADDR_ANY.
+		std::unordered_map<FlowKey, size_t, FlowKeyHash> connections;
+		std::vector<FlowKey> packets;
+		while (packets.size() < numConnections) {
+			FlowKey key{0x0a0a020f, static_cast<uint32_t>(rng()),
+					static_cast<uint16_t>(rng()), static_cast<uint16_t>(rng())};
+			FlowKey stored = key;
+			if (!(rng() % 4))
+				stored.localAddress = 0;
+			if (connections.emplace(stored, packets.size()).second)
+				packets.push_back(key);
+		}
+
+		for (size_t i = 0; i < packets.size(); i++) {
+			auto it = findFlow(connections, packets[i]);
+			if (it == connections.end() || it->second != i)
+				failures++;
+		}
+
+		std::vector<std::pair<FlowKey, size_t>> list{connections.begin(), connections.end()};
+		auto hashed = measureLookups(1 << 20, [&] (size_t i) {
+			return findFlow(connections, packets[i % packets.size()])->second;
+		});
+		auto linear = measureLookups(std::max(size_t{1} << 24 >> std::bit_width(numConnections), size_t{64}),
+				[&] (size_t i) -> size_t {
+			auto &key = packets[i % packets.size()];
+			for (auto &[flow, index] : list) {
+				if ((flow.localAddress == key.localAddress || !flow.localAddress)
+						&& flow.remoteAddress == key.remoteAddress
+						&& flow.localPort == key.localPort && flow.remotePort == key.remotePort)
+					return index;
+			}
+			return 0;
+		});
+
+		std::cout << "netserver: Connection lookup with " << numConnections << " connections: "
+				<< hashed << " ns (linear scan: " << linear << " ns)" << std::endl;
+	}
+
+	std::cout << "netserver: Lookup self-test "
+			<< (failures ? "failed" : "passed") << " (" << failures << " failures)" << std::endl;
+}
@@ -11,6 +11,8 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 #include "udp4.hpp"
 #include "tcp4.hpp"
@@ -38,6 +40,7 @@ struct CidrAddress {
 	}
 
 	friend bool operator<(const CidrAddress &, const CidrAddress &);
+	friend bool operator==(const CidrAddress &, const CidrAddress &) = default;
 };
 
 struct Ip4Router {
@@ -61,15 +64,40 @@ struct Ip4Router {
 		friend bool operator==(const Route &, const Route &);
 	};
 
-	// false if insertion fails
+	Ip4Router() = default;
+
+	// The trie and the cache refer to elements of routes.
+	Ip4Router(const Ip4Router &) = delete;
+	Ip4Router &operator=(const Ip4Router &) = delete;
+
+	// false if insertion fails (e.g., the route exists or its prefix is longer than 32 bits)
 	bool addRoute(Route r);
+	// Returns the route with the longest prefix that matches ip.
 	std::optional<Route> resolveRoute(uint32_t ip);
 
 	inline const std::set<Route> &getRoutes() const {
 		return routes;
 	}
 private:
+	using RouteIterator = std::set<Route>::iterator;
+
+	// Binary trie over the bits of the network address, most significant bit first.
+	// The node at depth n stands for the prefix of length n along its path.
+	struct TrieNode {
+		int children[2] = {-1, -1};
+		// First route (in set order) for this prefix; routes for
+		// the same network are adjacent in the set.
+		std::optional<RouteIterator> routes;
+	};
+
+	TrieNode &findNode(CidrAddress network);
+	RouteIterator eraseRoute(RouteIterator it);
+
 	std::set<Route> routes;
+	// trie[0] is the root, i.e., the node for /0.
+	std::vector<TrieNode> trie = std::vector<TrieNode>(1);
+	// Results of recent lookups; cleared whenever the set of routes changes.
+	std::unordered_map<uint32_t, RouteIterator> cache;
 };
 
 class Ip4Packet {
@@ -154,3 +182,7 @@ private:
 
 Ip4 &ip4();
 Ip4Router &ip4Router();
+
+// Checks route and connection lookups against linear scans and
+// prints their latency for thousands of routes and connections.
+void benchmarkLookups();
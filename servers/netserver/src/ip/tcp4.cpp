@@ -7,6 +7,7 @@
 #include <cstring>
 #include <deque>
 #include <iomanip>
+#include <optional>
 #include <random>
 #include <fcntl.h>
 #include <sys/epoll.h>
@@ -186,6 +187,8 @@ struct Tcp4Socket {
 	: parent_(parent), nonBlock_{nonBlock}, recvRing_{14}, sendRing_{14} {}
 
 	~Tcp4Socket() {
+		if (registeredFlow_)
+			parent_->removeConnection(*registeredFlow_, this);
 		parent_->unbind(localEp_);
 	}
 
@@ -257,6 +260,8 @@ struct Tcp4Socket {
 		// Connect to the remote.
 		self->connectState_ = ConnectState::sendSyn;
 		self->remoteEp_ = connectEp;
+		self->registeredFlow_ = self->flowKey_();
+		self->parent_->addConnection(*self->registeredFlow_, self);
 		self->flushEvent_.raise();
 
 		while(true) {
@@ -439,6 +444,10 @@ struct Tcp4Socket {
 	}
 
 private:
+	FlowKey flowKey_() const {
+		return {localEp_.ipAddress, remoteEp_.ipAddress, localEp_.port, remoteEp_.port};
+	}
+
 	async::result<void> flushOutPackets_();
 
 	void handleInPacket_(TcpPacket packet);
@@ -456,6 +465,8 @@ private:
 	Tcp4 *parent_;
 	bool nonBlock_;
 	TcpEndpoint remoteEp_;
+	// Key under which the socket is registered in Tcp4::connections (if any).
+	std::optional<FlowKey> registeredFlow_;
 	TcpEndpoint localEp_;
 	smarter::weak_ptr<Tcp4Socket> holder_;
 
@@ -727,15 +738,18 @@ void Tcp4::feedDatagram(smarter::shared_ptr<const Ip4Packet> packet) {
 		std::cout << "netserver: Received TCP packet at port " << tcp.header.destPort.load()
 				<< " (" << tcp.payload().size() << " bytes)" << std::endl;
 
-	auto it = binds.lower_bound({ 0, tcp.header.destPort.load() });
-	for (; it != binds.end() && it->first.port == tcp.header.destPort.load(); it++) {
-		auto existingEp = it->first;
-		if (existingEp.ipAddress == tcp.packet->header.destination
-				|| existingEp.ipAddress == INADDR_ANY) {
-			it->second->handleInPacket_(std::move(tcp));
-			break;
-		}
+	FlowKey key{tcp.packet->header.destination, tcp.packet->header.source,
+			tcp.header.destPort.load(), tcp.header.srcPort.load()};
+	if (auto it = findFlow(connections, key); it != connections.end()) {
+		it->second->handleInPacket_(std::move(tcp));
+		return;
 	}
+
+	auto it = binds.find({ tcp.packet->header.destination, tcp.header.destPort.load() });
+	if (it == binds.end())
+		it = binds.find({ INADDR_ANY, tcp.header.destPort.load() });
+	if (it != binds.end())
+		it->second->handleInPacket_(std::move(tcp));
 }
 
 bool Tcp4::tryBind(smarter::shared_ptr<Tcp4Socket> socket, TcpEndpoint wantedEp) {
@@ -756,6 +770,17 @@ bool Tcp4::unbind(TcpEndpoint e) {
 	return binds.erase(e) != 0;
 }
 
+void Tcp4::addConnection(FlowKey key, Tcp4Socket *socket) {
+	connections.insert_or_assign(key, socket);
+}
+
+void Tcp4::removeConnection(FlowKey key, Tcp4Socket *socket) {
+	// Another socket may have registered the same key in the meantime.
+	auto it = connections.find(key);
+	if (it != connections.end() && it->second == socket)
+		connections.erase(it);
+}
+
 void Tcp4::serveSocket(int flags, helix::UniqueLane lane) {
 	using protocols::fs::servePassthrough;
 	auto sock = Tcp4Socket::makeSocket(this, flags & SOCK_NONBLOCK);
@@ -3,6 +3,9 @@
 #include <helix/ipc.hpp>
 #include <smarter.hpp>
 #include <map>
+#include <unordered_map>
+
+#include "flow.hpp"
 
 class Ip4Packet;
 
@@ -21,8 +24,12 @@ struct Tcp4 {
 	void feedDatagram(smarter::shared_ptr<const Ip4Packet>);
 	bool tryBind(smarter::shared_ptr<Tcp4Socket> socket, TcpEndpoint ipAddress);
 	bool unbind(TcpEndpoint remote);
+	void addConnection(FlowKey key, Tcp4Socket *socket);
+	void removeConnection(FlowKey key, Tcp4Socket *socket);
 	void serveSocket(int flags, helix::UniqueLane lane);
 
 private:
 	std::map<TcpEndpoint, smarter::shared_ptr<Tcp4Socket>> binds;
+	// Sockets that connected to a remote endpoint.
+	std::unordered_map<FlowKey, Tcp4Socket *, FlowKeyHash> connections;
 };
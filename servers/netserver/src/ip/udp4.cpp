@@ -10,6 +10,7 @@
 #include <protocols/fs/server.hpp>
 #include <cstring>
 #include <iomanip>
+#include <optional>
 #include <random>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -141,6 +142,8 @@ struct Udp4Socket {
 	Udp4Socket(Udp4 *parent) : parent_(parent) {}
 
 	~Udp4Socket() {
+		if (registeredFlow_)
+			parent_->removeConnection(*registeredFlow_, this);
 		parent_->unbind(local_);
 	}
 
@@ -172,7 +175,16 @@ struct Udp4Socket {
 			co_return protocols::fs::Error::accessDenied;
 		}
 
+		if (self->registeredFlow_) {
+			self->parent_->removeConnection(*self->registeredFlow_, self);
+			self->registeredFlow_.reset();
+		}
 		self->remote_ = remote;
+		// Datagrams from port zero are never delivered; hence, there is nothing to register.
+		if (self->remote_.port) {
+			self->registeredFlow_ = self->flowKey();
+			self->parent_->addConnection(*self->registeredFlow_, self);
+		}
 		co_return protocols::fs::Error::none;
 	}
 
@@ -368,9 +380,15 @@ struct Udp4Socket {
 private:
 	friend struct Udp4;
 
+	FlowKey flowKey() const {
+		return {local_.addr, remote_.addr, local_.port, remote_.port};
+	}
+
 	async::queue<Udp, stl_allocator> queue_;
 	Endpoint remote_;
 	Endpoint local_;
+	// Key under which the socket is registered in Udp4::connections (if any).
+	std::optional<FlowKey> registeredFlow_;
 	Udp4 *parent_;
 	smarter::weak_ptr<Udp4Socket> holder_;
 };
@@ -384,15 +402,18 @@ void Udp4::feedDatagram(smarter::shared_ptr<const Ip4Packet> packet) {
 
 	std::cout << "received udp datagram to port " << udp.header.dst << std::endl;
 
-	auto i = binds.lower_bound({ 0, udp.header.dst });
-	for (; i != binds.end() && i->first.port == udp.header.dst; i++) {
-		auto ep = i->first;
-		if (ep.addr == udp.packet->header.destination
-			|| ep.addr == INADDR_ANY) {
-			i->second->queue_.emplace(std::move(udp));
-			break;
-		}
+	FlowKey key{udp.packet->header.destination, udp.packet->header.source,
+		udp.header.dst, udp.header.src};
+	if (auto c = findFlow(connections, key); c != connections.end()) {
+		c->second->queue_.emplace(std::move(udp));
+		return;
 	}
+
+	auto i = binds.find({ udp.packet->header.destination, udp.header.dst });
+	if (i == binds.end())
+		i = binds.find({ INADDR_ANY, udp.header.dst });
+	if (i != binds.end())
+		i->second->queue_.emplace(std::move(udp));
 }
 
 bool Udp4::tryBind(smarter::shared_ptr<Udp4Socket> socket, Endpoint addr) {
@@ -413,6 +434,17 @@ bool Udp4::unbind(Endpoint e) {
 	return binds.erase(e) != 0;
 }
 
+void Udp4::addConnection(FlowKey key, Udp4Socket *socket) {
+	connections.insert_or_assign(key, socket);
+}
+
+void Udp4::removeConnection(FlowKey key, Udp4Socket *socket) {
+	// Another socket may have registered the same key in the meantime.
+	auto it = connections.find(key);
+	if (it != connections.end() && it->second == socket)
+		connections.erase(it);
+}
+
 void Udp4::serveSocket(helix::UniqueLane lane) {
 	using protocols::fs::servePassthrough;
 	auto sock = Udp4Socket::make_socket(this);
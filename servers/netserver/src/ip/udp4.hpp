@@ -3,6 +3,9 @@
 #include <helix/ipc.hpp>
 #include <smarter.hpp>
 #include <map>
+#include <unordered_map>
+
+#include "flow.hpp"
 
 class Ip4Packet;
 
@@ -21,7 +24,11 @@ struct Udp4 {
 	void feedDatagram(smarter::shared_ptr<const Ip4Packet>);
 	bool tryBind(smarter::shared_ptr<Udp4Socket> socket, Endpoint addr);
 	bool unbind(Endpoint remote);
+	void addConnection(FlowKey key, Udp4Socket *socket);
+	void removeConnection(FlowKey key, Udp4Socket *socket);
 	void serveSocket(helix::UniqueLane lane);
 private:
 	std::map<Endpoint, smarter::shared_ptr<Udp4Socket>> binds;
+	// Sockets that connected to a remote endpoint.
+	std::unordered_map<FlowKey, Udp4Socket *, FlowKeyHash> connections;
 };
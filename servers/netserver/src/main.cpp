@@ -20,12 +20,20 @@
 #include <sys/socket.h>
 #include "fs.bragi.hpp"
 
+#include "ip/checksum.hpp"
 #include "ip/ip4.hpp"
 #include "netlink/netlink.hpp"
 
 #include <netserver/nic.hpp>
 #include <nic/virtio/virtio.hpp>
 
+namespace {
+	// Test the checksum implementation and measure its throughput on startup.
+	constexpr bool runChecksumBenchmark = false;
+	// Test route and connection lookups and measure their latency on startup.
+	constexpr bool runLookupBenchmark = false;
+}
+
 // Maps mbus IDs to device objects
 std::unordered_map<int64_t, std::shared_ptr<nic::Link>> baseDeviceMap;
 
@@ -202,6 +210,11 @@ int main() {
 
 //	HEL_CHECK(helSetPriority(kHelThisThread, 3));
 
+	if(runChecksumBenchmark)
+		benchmarkChecksum();
+	if(runLookupBenchmark)
+		benchmarkLookups();
+
 	async::detach(protocols::svrctl::serveControl(&controlOps));
 	advertise();
 	async::run_forever(helix::currentDispatcher);
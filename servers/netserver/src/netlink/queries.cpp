@@ -94,7 +94,7 @@ void NetlinkSocket::newRoute(struct nlmsghdr *hdr) {
 
 	auto attrs = NetlinkAttr(hdr, nl::packets::rt{});
 
-	if(!attrs.has_value()) {
+	if(!attrs.has_value() || msg->rtm_dst_len > 32) {
 		sendError(hdr, EINVAL);
 		return;
 	}
@@ -183,7 +183,7 @@ void NetlinkSocket::getRoute(struct nlmsghdr *hdr) {
 
 	// Loop over all ipv4 and ipv6 routes, and return them.
 	// TODO: also return ipv6 routes.
-	auto ipv4_router = ip4Router();
+	auto &ipv4_router = ip4Router();
 
 	for(auto route : ipv4_router.getRoutes()) {
 		sendRoutePacket(hdr, route);
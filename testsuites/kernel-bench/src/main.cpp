@@ -1,7 +1,12 @@
+#include <atomic>
 #include <math.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
 
 #include <async/result.hpp>
 #include <async/algorithm.hpp>
+#include <helix/clock.hpp>
 #include <helix/ipc.hpp>
 
 namespace {
@@ -62,6 +67,49 @@ void doNopBenchmark() {
 	bench.finalizeStatistics();
 }
 
+void doGetClockBenchmark() {
+	std::cout << "helGetClock() calls" << std::endl;
+
+	IterationsPerSecondBenchmark bench;
+	for(int k = 0; k < 5; ++k) {
+		uint64_t n = 0;
+		bench.launchRepetition();
+		while(!bench.isRepetitionDone()) {
+			for(int i = 0; i < 100; ++i) {
+				uint64_t nanos;
+				HEL_CHECK(helGetClock(&nanos));
+				++n;
+			}
+		}
+		bench.announceIterations(n);
+	}
+	bench.finalizeStatistics();
+}
+
+void doClockPageBenchmark() {
+	std::cout << "clock page reads" << std::endl;
+
+	IterationsPerSecondBenchmark bench;
+	for(int k = 0; k < 5; ++k) {
+		uint64_t n = 0;
+		uint64_t last = 0;
+		bench.launchRepetition();
+		while(!bench.isRepetitionDone()) {
+			for(int i = 0; i < 100; ++i) {
+				auto nanos = helix::currentClock();
+				if(nanos < last) {
+					std::cout << "    clock went backwards" << std::endl;
+					abort();
+				}
+				last = nanos;
+				++n;
+			}
+		}
+		bench.announceIterations(n);
+	}
+	bench.finalizeStatistics();
+}
+
 async::result<void> doAsyncNopBenchmark() {
 	std::cout << "ipc ops" << std::endl;
 
@@ -100,6 +148,187 @@ void doFutexBenchmark() {
 	bench.finalizeStatistics();
 }
 
+int *futexWord(std::atomic<int> &word) {
+	return reinterpret_cast<int *>(&word);
+}
+
+void doFutexPingPongBenchmark() {
+	std::cout << "futex ping-pong round trips" << std::endl;
+
+	IterationsPerSecondBenchmark bench;
+	for(int k = 0; k < 5; ++k) {
+		std::atomic<int> word{0};
+		std::atomic<bool> stop{false};
+		int woken;
+
+		std::thread partner{[&] {
+			int partnerWoken;
+			while(true) {
+				while(!word.load())
+					HEL_CHECK(helFutexWait(futexWord(word), 0, -1));
+				if(stop.load())
+					break;
+				word.store(0);
+				HEL_CHECK(helFutexWakeBitset(futexWord(word), 1, ~0u, &partnerWoken));
+			}
+		}};
+
+		uint64_t n = 0;
+		bench.launchRepetition();
+		while(!bench.isRepetitionDone()) {
+			word.store(1);
+			HEL_CHECK(helFutexWakeBitset(futexWord(word), 1, ~0u, &woken));
+			while(word.load())
+				HEL_CHECK(helFutexWait(futexWord(word), 1, -1));
+			++n;
+		}
+
+		stop.store(true);
+		word.store(1);
+		HEL_CHECK(helFutexWakeBitset(futexWord(word), 1, ~0u, &woken));
+		partner.join();
+		bench.announceIterations(n);
+	}
+	bench.finalizeStatistics();
+}
+
+// Three-state futex mutex (0: unlocked, 1: locked, 2: locked with waiters).
+struct FutexMutex {
+	void lock() {
+		int c = 0;
+		if(word.compare_exchange_strong(c, 1))
+			return;
+		if(c != 2)
+			c = word.exchange(2);
+		while(c) {
+			HEL_CHECK(helFutexWait(futexWord(word), 2, -1));
+			c = word.exchange(2);
+		}
+	}
+
+	// Used after a condition variable wait: other waiters may have been
+	// requeued to the mutex, so unlock() must always wake.
+	void lockContended() {
+		while(word.exchange(2))
+			HEL_CHECK(helFutexWait(futexWord(word), 2, -1));
+	}
+
+	void unlock() {
+		int woken;
+		if(word.exchange(0) != 1)
+			HEL_CHECK(helFutexWakeBitset(futexWord(word), 1, ~0u, &woken));
+	}
+
+	std::atomic<int> word{0};
+};
+
+// Measures condition variable broadcasts that wake numWaiters threads.
+// With requeue, only one waiter is woken and the others are moved to the mutex.
+void doCondvarBroadcastBenchmark(int numWaiters, bool requeue) {
+	std::cout << "condvar broadcasts (" << numWaiters << " waiters, "
+			<< (requeue ? "requeue" : "wake all") << ")" << std::endl;
+
+	IterationsPerSecondBenchmark bench;
+	for(int k = 0; k < 5; ++k) {
+		FutexMutex mutex;
+		std::atomic<int> sequence{0};
+		std::atomic<uint64_t> acks{0};
+		uint64_t generation = 0; // Protected by mutex.
+		bool stop = false; // Protected by mutex.
+
+		auto broadcast = [&] {
+			auto seq = sequence.fetch_add(1) + 1;
+			int affected;
+			if(requeue) {
+				// Requeued waiters sleep on the mutex, so our unlock() needs to wake them.
+				mutex.word.store(2);
+				HEL_CHECK(helFutexRequeue(futexWord(sequence), futexWord(mutex.word), seq,
+						1, -1, kHelFutexCompare, &affected));
+			}else{
+				HEL_CHECK(helFutexWakeBitset(futexWord(sequence), -1, ~0u, &affected));
+			}
+		};
+
+		std::vector<std::thread> waiters;
+		for(int j = 0; j < numWaiters; ++j) {
+			waiters.emplace_back([&] {
+				uint64_t seen = 0;
+				mutex.lock();
+				while(true) {
+					while(generation == seen && !stop) {
+						auto seq = sequence.load();
+						mutex.unlock();
+						HEL_CHECK(helFutexWait(futexWord(sequence), seq, -1));
+						mutex.lockContended();
+					}
+					if(stop)
+						break;
+					seen = generation;
+					acks.fetch_add(1);
+				}
+				mutex.unlock();
+			});
+		}
+
+		uint64_t n = 0;
+		bench.launchRepetition();
+		while(!bench.isRepetitionDone()) {
+			mutex.lock();
+			++generation;
+			broadcast();
+			mutex.unlock();
+			++n;
+
+			while(acks.load() < n * numWaiters)
+				HEL_CHECK(helYield());
+		}
+
+		mutex.lock();
+		stop = true;
+		broadcast();
+		mutex.unlock();
+		for(auto &waiter : waiters)
+			waiter.join();
+		bench.announceIterations(n);
+	}
+	bench.finalizeStatistics();
+}
+
+// Measures how handle lookups scale when multiple threads access the same universe.
+void doHandleLookupBenchmark(int numThreads) {
+	std::cout << "handle lookups (" << numThreads << " threads)" << std::endl;
+
+	HelHandle lane1, lane2;
+	HEL_CHECK(helCreateStream(&lane1, &lane2));
+
+	IterationsPerSecondBenchmark bench;
+	for(int k = 0; k < 5; ++k) {
+		std::atomic<uint64_t> total{0};
+		std::vector<std::thread> threads;
+		bench.launchRepetition();
+		for(int j = 0; j < numThreads; ++j) {
+			threads.emplace_back([&] {
+				uint64_t n = 0;
+				char creds[16];
+				while(!bench.isRepetitionDone()) {
+					for(int i = 0; i < 100; ++i) {
+						HEL_CHECK(helGetCredentials(lane1, 0, creds));
+						++n;
+					}
+				}
+				total += n;
+			});
+		}
+		for(auto &thread : threads)
+			thread.join();
+		bench.announceIterations(total.load());
+	}
+	bench.finalizeStatistics();
+
+	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, lane1));
+	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, lane2));
+}
+
 void doAllocateBenchmark(size_t size) {
 	std::cout << "allocate memory, size = " << (size / (1024 * 1024)) << " MiB" << std::endl;
 
@@ -249,8 +478,17 @@ async::result<void> doSendRecvBufferBenchmark(size_t size) {
 
 int main() {
 	doNopBenchmark();
+	doGetClockBenchmark();
+	doClockPageBenchmark();
 	doFutexBenchmark();
+	doFutexPingPongBenchmark();
+	doCondvarBroadcastBenchmark(8, false);
+	doCondvarBroadcastBenchmark(8, true);
 	async::run(doAsyncNopBenchmark(), helix::currentDispatcher);
+	doHandleLookupBenchmark(1);
+	doHandleLookupBenchmark(2);
+	doHandleLookupBenchmark(4);
+	doHandleLookupBenchmark(8);
 	doAllocateBenchmark(1 << 20);
 	doMapBenchmark(1 << 20);
 	doMapPopulatedBenchmark(1 << 20);
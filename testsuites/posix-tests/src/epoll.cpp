@@ -1,6 +1,9 @@
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <errno.h>
+#include <iostream>
+#include <vector>
 #include <unistd.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -47,3 +50,138 @@ DEFINE_TEST(epoll_mod_active, ([] {
 	close(epfd);
 	close(fd);
 }))
+
+DEFINE_TEST(epoll_edge_triggered, ([] {
+	int e;
+	int pending;
+
+	int fd = eventfd(0, 0);
+	assert(fd >= 0);
+	int epfd = epoll_create1(0);
+	assert(epfd >= 0);
+
+	epoll_event evt;
+	memset(&evt, 0, sizeof(epoll_event));
+	evt.events = EPOLLIN | EPOLLET;
+	e = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &evt);
+	assert(!e);
+
+	uint64_t n = 1;
+	e = write(fd, &n, sizeof(uint64_t));
+	assert(e == sizeof(uint64_t));
+
+	// The edge is reported exactly once.
+	pending = epoll_wait(epfd, &evt, 1, 0);
+	assert(pending == 1);
+	assert(evt.events == EPOLLIN);
+	pending = epoll_wait(epfd, &evt, 1, 0);
+	assert(!pending);
+
+	// A new write is a new edge.
+	e = write(fd, &n, sizeof(uint64_t));
+	assert(e == sizeof(uint64_t));
+	pending = epoll_wait(epfd, &evt, 1, 0);
+	assert(pending == 1);
+
+	close(epfd);
+	close(fd);
+}))
+
+DEFINE_TEST(epoll_oneshot, ([] {
+	int e;
+	int pending;
+
+	int fd = eventfd(0, 0);
+	assert(fd >= 0);
+	int epfd = epoll_create1(0);
+	assert(epfd >= 0);
+
+	epoll_event evt;
+	memset(&evt, 0, sizeof(epoll_event));
+	evt.events = EPOLLIN | EPOLLONESHOT;
+	e = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &evt);
+	assert(!e);
+
+	uint64_t n = 1;
+	e = write(fd, &n, sizeof(uint64_t));
+	assert(e == sizeof(uint64_t));
+
+	pending = epoll_wait(epfd, &evt, 1, 0);
+	assert(pending == 1);
+
+	// The item is disabled even though the eventfd is still readable.
+	pending = epoll_wait(epfd, &evt, 1, 0);
+	assert(!pending);
+
+	// EPOLL_CTL_MOD rearms the item.
+	memset(&evt, 0, sizeof(epoll_event));
+	evt.events = EPOLLIN | EPOLLONESHOT;
+	e = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &evt);
+	assert(!e);
+	pending = epoll_wait(epfd, &evt, 1, 0);
+	assert(pending == 1);
+
+	close(epfd);
+	close(fd);
+}))
+
+// Measures epoll_wait() throughput with many idle and a few active items.
+DEFINE_TEST(epoll_many_idle, ([] {
+	using clock = std::chrono::steady_clock;
+	constexpr int numIdle = 10000;
+	constexpr int numActive = 100;
+	constexpr int rounds = 1000;
+
+	int epfd = epoll_create1(0);
+	assert(epfd >= 0);
+
+	std::vector<int> fds;
+	for(int i = 0; i < numIdle + numActive; i++) {
+		int fd = eventfd(0, 0);
+		assert_errno("eventfd", fd >= 0);
+		fds.push_back(fd);
+
+		epoll_event evt;
+		memset(&evt, 0, sizeof(epoll_event));
+		evt.events = EPOLLIN;
+		evt.data.u32 = i;
+		int e = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &evt);
+		assert_errno("epoll_ctl", !e);
+	}
+
+	// Let epoll check all items once.
+	epoll_event events[numActive];
+	int pending = epoll_wait(epfd, events, numActive, 0);
+	assert(!pending);
+
+	auto before = clock::now();
+	for(int r = 0; r < rounds; r++) {
+		uint64_t n = 1;
+		for(int i = 0; i < numActive; i++) {
+			auto ret = write(fds[numIdle + i], &n, sizeof(uint64_t));
+			assert(ret == sizeof(uint64_t));
+		}
+
+		int seen = 0;
+		while(seen < numActive) {
+			pending = epoll_wait(epfd, events, numActive, -1);
+			assert_errno("epoll_wait", pending > 0);
+			for(int j = 0; j < pending; j++) {
+				auto i = events[j].data.u32;
+				assert(i >= numIdle);
+				auto ret = read(fds[i], &n, sizeof(uint64_t));
+				assert(ret == sizeof(uint64_t));
+			}
+			seen += pending;
+		}
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			clock::now() - before);
+
+	std::cout << "posix-tests: epoll_many_idle: "
+			<< (elapsed.count() / (rounds * numActive)) << " ns per event" << std::endl;
+
+	for(auto fd : fds)
+		close(fd);
+	close(epfd);
+}))
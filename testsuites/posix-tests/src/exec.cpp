@@ -0,0 +1,43 @@
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "testsuite.hpp"
+
+// Measures the rate of fork() + execve() + waitpid() of a small binary.
+// Repeated exec() of the same binary benefits from the posix subsystem's exec cache.
+DEFINE_TEST(exec_rate, ([] {
+	using clock = std::chrono::steady_clock;
+
+	auto forkExec = [] {
+		int pid = fork();
+		assert_errno("fork", pid >= 0);
+		if(!pid) {
+			execl("/usr/bin/true", "true", nullptr);
+			_exit(127);
+		}
+
+		int status;
+		int ret = waitpid(pid, &status, 0);
+		assert_errno("waitpid", ret == pid);
+		assert(WIFEXITED(status));
+		assert(WEXITSTATUS(status) == 0);
+	};
+
+	// Warm up the caches.
+	forkExec();
+
+	uint64_t n = 0;
+	auto before = clock::now();
+	while(clock::now() - before < std::chrono::seconds(1)) {
+		forkExec();
+		++n;
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+			clock::now() - before);
+
+	std::cout << "posix-tests: exec_rate: " << (n * 1'000'000 / elapsed.count())
+			<< " fork+exec per second" << std::endl;
+}))
@@ -1,8 +1,13 @@
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <vector>
 #include <unistd.h>
 #include <poll.h>
+#include <sys/wait.h>
 
 #include "testsuite.hpp"
 
@@ -37,3 +42,90 @@ DEFINE_TEST(pipe_close_reader, ([] {
 	assert(pfd.revents & POLLERR);
 	assert(!(pfd.revents & POLLHUP));
 }))
+
+DEFINE_TEST(pipe_nonblock_full, ([] {
+	int fds[2];
+	int e = pipe(fds);
+	assert(!e);
+	e = fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	assert_errno("fcntl", e == 0);
+
+	// Pipes are bounded: writes eventually fail with EAGAIN.
+	char buffer[4096];
+	memset(buffer, 0x42, sizeof(buffer));
+	size_t total = 0;
+	while(true) {
+		auto ret = write(fds[1], buffer, sizeof(buffer));
+		if(ret < 0) {
+			assert(errno == EAGAIN);
+			break;
+		}
+		total += ret;
+	}
+	assert(total >= 4096);
+
+	pollfd pfd;
+	memset(&pfd, 0, sizeof(pollfd));
+	pfd.fd = fds[1];
+	pfd.events = POLLOUT;
+	e = poll(&pfd, 1, 0);
+	assert(e == 0);
+
+	// Draining the pipe makes it writable again.
+	auto ret = read(fds[0], buffer, sizeof(buffer));
+	assert(ret == sizeof(buffer));
+	e = poll(&pfd, 1, 0);
+	assert(e == 1);
+	assert(pfd.revents & POLLOUT);
+
+	close(fds[0]);
+	close(fds[1]);
+}))
+
+// Measures the throughput of a pipe between two processes for different chunk sizes.
+DEFINE_TEST(pipe_throughput, ([] {
+	using clock = std::chrono::steady_clock;
+	constexpr size_t totalBytes = size_t{64} << 20;
+
+	for(size_t chunk = 4096; chunk <= (size_t{1} << 20); chunk <<= 2) {
+		int fds[2];
+		int e = pipe(fds);
+		assert(!e);
+#ifdef F_SETPIPE_SZ
+		fcntl(fds[1], F_SETPIPE_SZ, chunk);
+#endif
+
+		int pid = fork();
+		assert_errno("fork", pid >= 0);
+		if(!pid) {
+			close(fds[1]);
+			std::vector<char> buffer(chunk);
+			while(true) {
+				auto ret = read(fds[0], buffer.data(), chunk);
+				assert(ret >= 0);
+				if(!ret)
+					break;
+			}
+			_exit(0);
+		}
+		close(fds[0]);
+
+		std::vector<char> buffer(chunk, 0x42);
+		auto before = clock::now();
+		for(size_t progress = 0; progress < totalBytes; ) {
+			auto ret = write(fds[1], buffer.data(), chunk);
+			assert_errno("write", ret > 0);
+			progress += ret;
+		}
+		close(fds[1]);
+
+		int status;
+		int ret = waitpid(pid, &status, 0);
+		assert_errno("waitpid", ret == pid);
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+				clock::now() - before);
+
+		std::cout << "posix-tests: pipe_throughput: " << chunk << " byte chunks: "
+				<< (totalBytes / elapsed.count()) << " MB/s" << std::endl;
+	}
+}))
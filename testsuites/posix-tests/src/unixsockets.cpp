@@ -0,0 +1,158 @@
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "testsuite.hpp"
+
+DEFINE_TEST(unix_stream_coalesce, ([] {
+	int fds[2];
+	int e = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	assert_errno("socketpair", e == 0);
+
+	// Stream sockets do not preserve message boundaries.
+	for(int i = 0; i < 4; i++) {
+		auto ret = write(fds[0], "abcd", 4);
+		assert_errno("write", ret == 4);
+	}
+
+	char buffer[16];
+	auto ret = read(fds[1], buffer, 16);
+	assert_errno("read", ret == 16);
+	assert(!memcmp(buffer, "abcdabcdabcdabcd", 16));
+
+	// Partial reads leave the remaining data in the socket.
+	ret = write(fds[0], "0123456789", 10);
+	assert_errno("write", ret == 10);
+	ret = read(fds[1], buffer, 4);
+	assert_errno("read", ret == 4);
+	assert(!memcmp(buffer, "0123", 4));
+	ret = read(fds[1], buffer, 16);
+	assert_errno("read", ret == 6);
+	assert(!memcmp(buffer, "456789", 6));
+
+	// Reads return EOF once the remote is closed.
+	close(fds[0]);
+	ret = read(fds[1], buffer, 16);
+	assert_errno("read", ret == 0);
+	close(fds[1]);
+}))
+
+DEFINE_TEST(unix_stream_sndbuf, ([] {
+	int fds[2];
+	int e = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	assert_errno("socketpair", e == 0);
+
+	int size = 16 * 1024;
+	e = setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(int));
+	assert_errno("setsockopt", e == 0);
+	e = fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	assert_errno("fcntl", e == 0);
+
+	// The socket buffer is bounded: writes eventually fail with EAGAIN.
+	char buffer[4096];
+	memset(buffer, 0x42, sizeof(buffer));
+	size_t total = 0;
+	while(true) {
+		auto ret = write(fds[0], buffer, sizeof(buffer));
+		if(ret < 0) {
+			assert(errno == EAGAIN);
+			break;
+		}
+		total += ret;
+	}
+	assert(total >= 16 * 1024);
+	assert(total <= 64 * 1024);
+
+	pollfd pfd;
+	memset(&pfd, 0, sizeof(pollfd));
+	pfd.fd = fds[0];
+	pfd.events = POLLOUT;
+	e = poll(&pfd, 1, 0);
+	assert(e == 0);
+
+	// Draining the socket makes it writable again.
+	auto ret = read(fds[1], buffer, sizeof(buffer));
+	assert_errno("read", ret == sizeof(buffer));
+	e = poll(&pfd, 1, 0);
+	assert(e == 1);
+	assert(pfd.revents & POLLOUT);
+
+	close(fds[0]);
+	close(fds[1]);
+}))
+
+// Measures the round trip latency and the throughput of a SOCK_STREAM socket pair.
+DEFINE_TEST(unix_stream_benchmark, ([] {
+	using clock = std::chrono::steady_clock;
+	constexpr int roundTrips = 10000;
+	constexpr size_t totalBytes = size_t{64} << 20;
+	constexpr size_t chunk = 64 * 1024;
+
+	int fds[2];
+	int e = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	assert_errno("socketpair", e == 0);
+
+	int pid = fork();
+	assert_errno("fork", pid >= 0);
+	if(!pid) {
+		close(fds[0]);
+
+		// Echo single bytes for the latency measurement.
+		char c;
+		for(int i = 0; i < roundTrips; i++) {
+			auto ret = read(fds[1], &c, 1);
+			assert(ret == 1);
+			ret = write(fds[1], &c, 1);
+			assert(ret == 1);
+		}
+
+		// Sink data for the throughput measurement.
+		std::vector<char> buffer(chunk);
+		while(true) {
+			auto ret = read(fds[1], buffer.data(), chunk);
+			assert(ret >= 0);
+			if(!ret)
+				break;
+		}
+		_exit(0);
+	}
+	close(fds[1]);
+
+	auto before = clock::now();
+	for(int i = 0; i < roundTrips; i++) {
+		char c = 'x';
+		auto ret = write(fds[0], &c, 1);
+		assert_errno("write", ret == 1);
+		ret = read(fds[0], &c, 1);
+		assert_errno("read", ret == 1);
+	}
+	auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			clock::now() - before);
+
+	std::vector<char> buffer(chunk, 0x42);
+	before = clock::now();
+	for(size_t progress = 0; progress < totalBytes; ) {
+		auto ret = write(fds[0], buffer.data(), chunk);
+		assert_errno("write", ret > 0);
+		progress += ret;
+	}
+	close(fds[0]);
+
+	int status;
+	int ret = waitpid(pid, &status, 0);
+	assert_errno("waitpid", ret == pid);
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+			clock::now() - before);
+
+	std::cout << "posix-tests: unix_stream_benchmark: "
+			<< (latency.count() / roundTrips) << " ns per round trip, "
+			<< (totalBytes / elapsed.count()) << " MB/s" << std::endl;
+}))
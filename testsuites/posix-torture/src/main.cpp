@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <time.h>
 
 #include "testsuite.hpp"
 
@@ -18,8 +19,22 @@ int main() {
 		for(abstract_test_case *tcp : test_case_ptrs()) {
 			std::cout << "posix-torture: Running " << tcp->name()
 					<< " for " << n << " iterations" << std::endl;
+			if(!tcp->setup()) {
+				std::cout << "posix-torture: Skipping " << tcp->name() << std::endl;
+				continue;
+			}
+			timespec before, after;
+			clock_gettime(CLOCK_MONOTONIC, &before);
 			for(int i = 0; i < n; i++)
 				tcp->run();
+			clock_gettime(CLOCK_MONOTONIC, &after);
+			tcp->teardown();
+
+			auto nanos = (after.tv_sec - before.tv_sec) * 1'000'000'000LL
+					+ (after.tv_nsec - before.tv_nsec);
+			std::cout << "posix-torture: " << tcp->name() << " took "
+					<< (nanos / 1'000'000) << " ms ("
+					<< (nanos / n) << " ns per iteration)" << std::endl;
 		}
 	}
 }
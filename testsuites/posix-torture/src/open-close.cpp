@@ -1,11 +1,46 @@
 #include <cassert>
+#include <iostream>
+#include <fcntl.h>
 #include <linux/netlink.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
+#include <vector>
 
 #include "testsuite.hpp"
 
+namespace {
+
+// Keeps the given number of FDs open such that FD allocation has to skip them.
+// Returns false if that many FDs cannot be opened (e.g., due to RLIMIT_NOFILE).
+bool setLiveFdCount(size_t count) {
+	static std::vector<int> liveFds;
+
+	if(liveFds.size() < count) {
+		// Raise RLIMIT_NOFILE if possible; otherwise, stay below the current limit.
+		struct rlimit limit;
+		if(!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < count + 64) {
+			limit.rlim_cur = std::min<rlim_t>(count + 64, limit.rlim_max);
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+
+	while(liveFds.size() < count) {
+		int fd = open("/dev/null", O_RDONLY);
+		if(fd < 0)
+			break;
+		liveFds.push_back(fd);
+	}
+	while(liveFds.size() > count) {
+		close(liveFds.back());
+		liveFds.pop_back();
+	}
+	return liveFds.size() == count;
+}
+
+} // anonymous namespace
+
 DEFINE_TEST(open_close_netlink, ([] {
 	int fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_KOBJECT_UEVENT);
 	assert(fd > 0);
@@ -23,3 +58,21 @@ DEFINE_TEST(open_close_unix, ([] {
 	assert(fd > 0);
 	close(fd);
 }))
+
+// open() has to find the lowest free FD; its cost should not depend on the number of live FDs.
+// The live FDs are closed after each batch such that other tests (e.g., fork()) are not affected.
+DEFINE_TEST_WITH_FIXTURE(open_close_16384_live_fds, ([] {
+	if(!setLiveFdCount(16384)) {
+		std::cout << "posix-torture: Cannot keep 16384 FDs open (RLIMIT_NOFILE is too low)"
+				<< std::endl;
+		setLiveFdCount(0);
+		return false;
+	}
+	return true;
+}), ([] {
+	int fd = open("/dev/null", O_RDONLY);
+	assert(fd > 0);
+	close(fd);
+}), ([] {
+	setLiveFdCount(0);
+}))
@@ -0,0 +1,67 @@
+#include <cassert>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testsuite.hpp"
+
+namespace {
+
+// Reads from a file on the root file system. The file is read once up front,
+// such that all reads are served from the page cache.
+struct CachedReader {
+	void open() {
+		fd = ::open("/usr/bin/posix-torture", O_RDONLY);
+		assert(fd >= 0);
+
+		struct stat st;
+		auto result = fstat(fd, &st);
+		assert(!result);
+		size = st.st_size;
+		assert(size);
+
+		for(size_t offset = 0; offset < size; offset += sizeof(buffer)) {
+			auto chunk = pread(fd, buffer, sizeof(buffer), offset);
+			assert(chunk > 0);
+		}
+	}
+
+	void close() {
+		::close(fd);
+	}
+
+	void read(size_t length) {
+		assert(length <= sizeof(buffer));
+
+		if(offset + length > size)
+			offset = 0;
+		auto chunk = pread(fd, buffer, length, offset);
+		assert(chunk > 0);
+		offset += length;
+	}
+
+	int fd = -1;
+	size_t size = 0;
+	size_t offset = 0;
+	char buffer[0x10000];
+};
+
+CachedReader reader;
+
+} // anonymous namespace
+
+DEFINE_TEST_WITH_FIXTURE(cached_pread_4096, ([] {
+	reader.open();
+}), ([] {
+	reader.read(4096);
+}), ([] {
+	reader.close();
+}))
+
+DEFINE_TEST_WITH_FIXTURE(cached_pread_65536, ([] {
+	reader.open();
+}), ([] {
+	reader.read(65536);
+}), ([] {
+	reader.close();
+}))
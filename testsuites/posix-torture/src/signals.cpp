@@ -0,0 +1,17 @@
+#include <cassert>
+#include <signal.h>
+
+#include "testsuite.hpp"
+
+// If libc writes the signal mask to the thread page, changing the mask does not require
+// a round trip to the POSIX server unless a pending signal is unblocked.
+// Otherwise, this measures two SIG_MASK supercalls.
+DEFINE_TEST(sigprocmask_block_unblock, ([] {
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	auto result = sigprocmask(SIG_BLOCK, &set, nullptr);
+	assert(!result);
+	result = sigprocmask(SIG_UNBLOCK, &set, nullptr);
+	assert(!result);
+}))
@@ -0,0 +1,21 @@
+#include <cassert>
+#include <signal.h>
+#include <unistd.h>
+
+#include "testsuite.hpp"
+
+// On managarm, these calls are implemented as supercalls that are handled
+// by the POSIX server. They measure the supercall round trip.
+
+DEFINE_TEST(supercall_gettid, ([] {
+	auto tid = gettid();
+	assert(tid > 0);
+}))
+
+// This remains a supercall unless libc changes the mask through the thread page.
+DEFINE_TEST(supercall_sigprocmask, ([] {
+	sigset_t set;
+	sigemptyset(&set);
+	auto result = sigprocmask(SIG_BLOCK, &set, nullptr);
+	assert(!result);
+}))
@@ -1,11 +1,38 @@
 #include <cassert>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <vector>
 
 #include "testsuite.hpp"
 
-DEFINE_TEST(fork_exit_waitpid, ([] {
+namespace {
+
+std::vector<void *> extraMappings;
+
+// Adjusts the number of distinct (i.e., non-mergeable) mappings that are inherited on fork().
+void setMappingCount(size_t count) {
+	while(extraMappings.size() < count) {
+		// Alternate the protection to prevent adjacent mappings from being merged.
+		bool writable = extraMappings.size() & 1;
+		int prot = PROT_READ;
+		if(writable)
+			prot |= PROT_WRITE;
+		void *window = mmap(nullptr, 0x2000, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		assert(window != MAP_FAILED);
+		// Touch the mapping such that fork() needs to deal with CoW pages.
+		if(writable)
+			*static_cast<volatile char *>(window) = 1;
+		extraMappings.push_back(window);
+	}
+	while(extraMappings.size() > count) {
+		munmap(extraMappings.back(), 0x2000);
+		extraMappings.pop_back();
+	}
+}
+
+void forkExitWaitpid() {
 	int pid = fork();
 	assert(pid >= 0);
 	if(!pid) {
@@ -15,4 +42,27 @@ DEFINE_TEST(fork_exit_waitpid, ([] {
 		auto res = waitpid(pid, &status, 0);
 		assert(res > 0);
 	}
+}
+
+} // anonymous namespace
+
+DEFINE_TEST(fork_exit_waitpid, ([] {
+	setMappingCount(0);
+	forkExitWaitpid();
+}))
+
+// The cost of fork() depends on the number of mappings of the parent.
+DEFINE_TEST(fork_exit_waitpid_64_mappings, ([] {
+	setMappingCount(64);
+	forkExitWaitpid();
+}))
+
+DEFINE_TEST(fork_exit_waitpid_256_mappings, ([] {
+	setMappingCount(256);
+	forkExitWaitpid();
+}))
+
+DEFINE_TEST(fork_exit_waitpid_1024_mappings, ([] {
+	setMappingCount(1024);
+	forkExitWaitpid();
 }))
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <type_traits>
 #include <utility>
 
 #define DEFINE_TEST(s, f) \
 	static test_case test_ ## s{#s, f};
 
+// Like DEFINE_TEST() but runs u before and t after each batch of iterations
+// (outside of the measurement). If u returns false, the batch is skipped.
+#define DEFINE_TEST_WITH_FIXTURE(s, u, f, t) \
+	static test_case_with_fixture test_ ## s{#s, u, f, t};
+
 struct abstract_test_case {
 private:
 	static void register_case(abstract_test_case *tcp);
@@ -27,6 +33,13 @@ public:
 
 	virtual void run() = 0;
 
+	// Returns false if the test cannot run.
+	virtual bool setup() {
+		return true;
+	}
+
+	virtual void teardown() { }
+
 private:
 	const char *name_;
 };
@@ -43,3 +56,27 @@ struct test_case : abstract_test_case {
 private:
 	F functor_;
 };
+
+template<typename U, typename F, typename T>
+struct test_case_with_fixture : test_case<F> {
+	test_case_with_fixture(const char *name, U setup, F functor, T teardown)
+	: test_case<F>{name, std::move(functor)},
+			setup_{std::move(setup)}, teardown_{std::move(teardown)} { }
+
+	bool setup() override {
+		if constexpr (std::is_same_v<decltype(setup_()), bool>) {
+			return setup_();
+		}else{
+			setup_();
+			return true;
+		}
+	}
+
+	void teardown() override {
+		teardown_();
+	}
+
+private:
+	U setup_;
+	T teardown_;
+};
@@ -0,0 +1,50 @@
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "testsuite.hpp"
+
+namespace {
+
+// Appends to a tmpfs file; the file is truncated once it reaches the size limit.
+struct Appender {
+	Appender(const char *path) {
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		assert(fd >= 0);
+		unlink(path);
+	}
+
+	void append(size_t length) {
+		static char buffer[0x4000];
+		assert(length <= sizeof(buffer));
+
+		if(size + length > sizeLimit) {
+			auto result = ftruncate(fd, 0);
+			assert(!result);
+			auto offset = lseek(fd, 0, SEEK_SET);
+			assert(!offset);
+			size = 0;
+		}
+
+		auto written = write(fd, buffer, length);
+		assert(written == static_cast<ssize_t>(length));
+		size += length;
+	}
+
+	static constexpr size_t sizeLimit = 64 << 20;
+
+	int fd;
+	size_t size = 0;
+};
+
+} // anonymous namespace
+
+DEFINE_TEST(tmpfs_append_512, ([] {
+	static Appender appender{"/tmp/posix-torture-append-512"};
+	appender.append(512);
+}))
+
+DEFINE_TEST(tmpfs_append_4096, ([] {
+	static Appender appender{"/tmp/posix-torture-append-4096"};
+	appender.append(4096);
+}))
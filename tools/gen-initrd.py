@@ -2,6 +2,7 @@
 
 import os
 import shutil
+import struct
 import subprocess
 import tempfile
 import sys
@@ -11,6 +12,9 @@ parser = argparse.ArgumentParser(description = 'Generate a managarm initrd')
 parser.add_argument('-t', '--triple', dest = 'arch',
 		choices = ['x86_64-managarm', 'aarch64-managarm'], default = 'x86_64-managarm',
 		help = 'Target system triple (default: x86_64-managarm)')
+parser.add_argument('--compress', action='store_true',
+		help = 'Compress large files (requires the lz4 Python module); '
+			'thor decompresses them on demand')
 
 args = parser.parse_args()
 
@@ -96,30 +100,72 @@ for fname in os.listdir('system-root/usr/lib/managarm/server'):
 		continue
 	add_file('system-root/usr/lib/managarm/server', 'managarm/server', fname)
 
-# Copy (= hard link) the files to a temporary directory, run GNU cpio.
+# Copy (= hard link) the files to a temporary directory, then write the CPIO archive.
+# We do not use GNU cpio since thor wants the file data to be page-aligned:
+# this allows it to use the initrd's pages directly instead of copying them.
+
+page_size = 0x1000
+
+# Files larger than this are compressed if --compress is given.
+compress_threshold = 64 * 1024
+
+# Value of the CPIO check field that marks compressed files (see thor's InitrdMemory).
+compressed_check = 0x544C5A34
+
+def compress_file(data):
+	import lz4.block
+
+	# Pages are compressed independently such that thor can decompress them on demand.
+	chunks = [lz4.block.compress(data[i:i + page_size], store_size=False)
+			for i in range(0, len(data), page_size)]
+	header_size = 16 + 4 * (len(chunks) + 1)
+	offsets = [header_size]
+	for chunk in chunks:
+		offsets.append(offsets[-1] + len(chunk))
+	return (b'TLZ4' + struct.pack('<IQ', page_size, len(data))
+			+ struct.pack(f'<{len(offsets)}I', *offsets) + b''.join(chunks))
+
+def write_entry(out, ino, name, mode, data=b'', check=0):
+	name_bytes = name.encode('ascii') + b'\0'
+	if data:
+		# Pad the name with NUL bytes such that the data starts at a page boundary.
+		data_start = out.tell() + 110 + len(name_bytes)
+		name_bytes += b'\0' * (-data_start % page_size)
+	header = '070701' + ''.join(f'{v:08X}' for v in [ino, mode, 0, 0, 1, 0, len(data),
+			0, 0, 0, 0, len(name_bytes), check])
+	out.write(header.encode('ascii'))
+	out.write(name_bytes)
+	out.write(b'\0' * (-out.tell() % 4))
+	out.write(data)
+	out.write(b'\0' * (-out.tell() % 4))
 
 tree_path = tempfile.mkdtemp(prefix='initrd-', dir='.')
 
 file_list = sorted(file_dict.keys())
-for rel_path in file_list:
-	entry = file_dict[rel_path]
-	dest_path = os.path.join(tree_path, rel_path)
-
-	if entry.is_dir:
-		os.mkdir(dest_path)
-	elif entry.strip:
-		subprocess.check_call([f'{args.arch}-strip', '-o', dest_path, entry.source])
-	else:
-		os.link(entry.source, dest_path)
-
-proc = subprocess.Popen(['cpio', '--create', '--format=newc',
-			'-D', tree_path,
-			'--file', 'initrd.cpio',
-			'--quiet'],
-		stdin=subprocess.PIPE,
-		encoding='ascii')
-proc.communicate(input='\n'.join(file_list))
-if proc.returncode != 0:
-	sys.exit(1)
+with open('initrd.cpio', 'wb') as out:
+	for ino, rel_path in enumerate(file_list, start=1):
+		entry = file_dict[rel_path]
+		dest_path = os.path.join(tree_path, rel_path)
+
+		if entry.is_dir:
+			os.mkdir(dest_path)
+			write_entry(out, ino, rel_path, 0o040755)
+			continue
+
+		if entry.strip:
+			subprocess.check_call([f'{args.arch}-strip', '-o', dest_path, entry.source])
+			source_path = dest_path
+		else:
+			source_path = entry.source
+
+		with open(source_path, 'rb') as f:
+			data = f.read()
+		mode = 0o100000 | (os.stat(source_path).st_mode & 0o7777)
+		if args.compress and len(data) >= compress_threshold:
+			write_entry(out, ino, rel_path, mode, compress_file(data), compressed_check)
+		else:
+			write_entry(out, ino, rel_path, mode, data)
+
+	write_entry(out, 0, 'TRAILER!!!', 0)
 
 shutil.rmtree(tree_path)
@@ -3,7 +3,10 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 #include <bragi/helpers-std.hpp>
 #include <CLI/App.hpp>
@@ -61,11 +64,18 @@ int main(int argc, char **argv) {
 	frg::span<const char> buffer{reinterpret_cast<const char *>(ptr),
 			static_cast<size_t>(st.st_size)};
 
-	uint64_t filteredEventId = 0;
-	uint64_t desiredItemId = 0;
+	// The kernel drains per-CPU rings in batches, hence events are only ordered per CPU.
+	// We collect all events and merge them by timestamp before extracting anything.
+	struct Event {
+		uint64_t ts;
+		uint64_t id;
+		std::vector<std::pair<uint64_t, int64_t>> ctrs;
+	};
 
-	std::vector<uint64_t> ts;
-	std::vector<uint64_t> value;
+	std::vector<Event> events;
+	std::unordered_map<std::string, uint64_t> eventIds;
+	std::unordered_map<std::string, uint64_t> itemIds;
+	uint64_t nDropped = 0;
 
 	auto extractRecord = [&] () -> bool {
 		auto preamble = bragi::read_preamble(buffer);
@@ -88,18 +98,10 @@ int main(int argc, char **argv) {
 			}
 			auto &record = maybeRecord.value();
 
-			if(record.id() == filteredEventId) {
-				if(mode == ExtractMode::eventOnly) {
-					ts.push_back(record.ts());
-				}else if(mode == ExtractMode::specificItem) {
-					for(size_t i = 0; i < record.ctrs_size(); ++i) {
-						if(record.ctrs(i).id() != desiredItemId)
-							continue;
-						ts.push_back(record.ts());
-						value.push_back(record.ctrs(i).value());
-					}
-				}
-			}
+			Event event{record.ts(), record.id(), {}};
+			for(size_t i = 0; i < record.ctrs_size(); ++i)
+				event.ctrs.emplace_back(record.ctrs(i).id(), record.ctrs(i).value());
+			events.push_back(std::move(event));
 		} break;
 		case bragi::message_id<managarm::ostrace::AnnounceEventRecord>: {
 			auto maybeRecord = bragi::parse_head_tail<managarm::ostrace::AnnounceEventRecord>(
@@ -107,8 +109,7 @@ int main(int argc, char **argv) {
 			assert(maybeRecord);
 			auto &record = maybeRecord.value();
 
-			if(record.name() == eventName)
-				filteredEventId = record.id();
+			eventIds[record.name()] = record.id();
 		} break;
 		case bragi::message_id<managarm::ostrace::AnnounceItemRecord>: {
 			auto maybeRecord = bragi::parse_head_tail<managarm::ostrace::AnnounceItemRecord>(
@@ -116,8 +117,16 @@ int main(int argc, char **argv) {
 			assert(maybeRecord);
 			auto &record = maybeRecord.value();
 
-			if(record.name() == itemName)
-				desiredItemId = record.id();
+			itemIds[record.name()] = record.id();
+		} break;
+		case bragi::message_id<managarm::ostrace::DropRecord>: {
+			auto maybeRecord = bragi::parse_head_tail<managarm::ostrace::DropRecord>(
+					head_span, tail_span);
+			assert(maybeRecord);
+			auto &record = maybeRecord.value();
+
+			std::cerr << record.count() << " records dropped on CPU " << record.cpu() << std::endl;
+			nDropped += record.count();
 		} break;
 		default:
 			warnx("halting due to unexpected message ID %u", preamble.id());
@@ -135,6 +144,37 @@ int main(int argc, char **argv) {
 		++nRecords;
 	}
 
+	// Events of each CPU are already sorted, so a stable sort merges the per-CPU streams.
+	std::stable_sort(events.begin(), events.end(), [] (const Event &a, const Event &b) {
+		return a.ts < b.ts;
+	});
+
+	uint64_t filteredEventId = 0;
+	uint64_t desiredItemId = 0;
+	if(auto it = eventIds.find(eventName); it != eventIds.end())
+		filteredEventId = it->second;
+	if(auto it = itemIds.find(itemName); it != itemIds.end())
+		desiredItemId = it->second;
+
+	std::vector<uint64_t> ts;
+	std::vector<uint64_t> value;
+
+	for(auto &event : events) {
+		if(event.id != filteredEventId)
+			continue;
+
+		if(mode == ExtractMode::eventOnly) {
+			ts.push_back(event.ts);
+		}else if(mode == ExtractMode::specificItem) {
+			for(auto [id, v] : event.ctrs) {
+				if(id != desiredItemId)
+					continue;
+				ts.push_back(event.ts);
+				value.push_back(v);
+			}
+		}
+	}
+
 	std::cout << "{\n";
 	std::cout << "\"ts\": [";
 	for(size_t i = 0; i < ts.size(); ++i)
@@ -152,4 +192,6 @@ int main(int argc, char **argv) {
 	std::cerr << "extracted " << nRecords << " records"
 			<< " (" << buffer.size() << " bytes remain)" << std::endl;
 	std::cerr << "found " << ts.size() << " matches" << std::endl;
+	if(nDropped)
+		std::cerr << nDropped << " records were dropped by the kernel" << std::endl;
 }
@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <iostream>
@@ -65,6 +66,41 @@ static std::vector<std::byte> readEntireFile(const char *path) {
 	return buffer;
 }
 
+// Maps a file into memory. This avoids copying the file through read() before
+// its contents are sent to the kernel.
+struct FileMapping {
+	FileMapping(const char *path) {
+		auto fd = open(path, O_RDONLY);
+		if(fd < 0)
+			throw std::runtime_error("Could not open file");
+
+		struct stat st;
+		if(fstat(fd, &st)) {
+			close(fd);
+			throw std::runtime_error("fstat() failed");
+		}
+		size = st.st_size;
+
+		if(size)
+			data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(data == MAP_FAILED)
+			throw std::runtime_error("mmap() failed");
+	}
+
+	FileMapping(const FileMapping &) = delete;
+
+	FileMapping &operator= (const FileMapping &) = delete;
+
+	~FileMapping() {
+		if(size)
+			munmap(data, size);
+	}
+
+	void *data = nullptr;
+	size_t size = 0;
+};
+
 // ----------------------------------------------------------------------------
 // svrctl handling.
 // ----------------------------------------------------------------------------
@@ -117,8 +153,6 @@ async::result<helix::UniqueLane> runServer(const char *name) {
 }
 
 async::result<void> uploadFile(const char *name) {
-	std::vector<std::byte> buffer;
-
 	auto optimisticUpload = [&] () -> async::result<bool> {
 		managarm::svrctl::CntRequest req;
 		req.set_req_type(managarm::svrctl::CntReqType::FILE_UPLOAD);
@@ -144,7 +178,7 @@ async::result<void> uploadFile(const char *name) {
 		co_return true;
 	};
 
-	auto uploadWithData = [&] () -> async::result<void> {
+	auto uploadWithData = [&] (const FileMapping &file) -> async::result<void> {
 		managarm::svrctl::CntRequest req;
 		req.set_req_type(managarm::svrctl::CntReqType::FILE_UPLOAD_DATA);
 		req.set_name(name);
@@ -154,7 +188,7 @@ async::result<void> uploadFile(const char *name) {
 			svrctlLane,
 			helix_ng::offer(
 				helix_ng::sendBuffer(ser.data(), ser.size()),
-				helix_ng::sendBuffer(buffer.data(), buffer.size()),
+				helix_ng::sendBuffer(file.data, file.size),
 				helix_ng::recvInline())
 		);
 		HEL_CHECK(offer.error());
@@ -172,9 +206,9 @@ async::result<void> uploadFile(const char *name) {
 	if(co_await optimisticUpload())
 		co_return;
 
-	// The kernel does not know the file; we have to read the entire contents.
-	buffer = readEntireFile(name);
-	co_await uploadWithData();
+	// The kernel does not know the file; we have to send the entire contents.
+	FileMapping file{name};
+	co_await uploadWithData(file);
 }
 
 async::result<void> bindServer(helix::UniqueLane &lane, int mbusId) {